@@ -7,30 +7,19 @@
 /** @name Local static functions */
 /*@{*/
 
-/**
-Write a bit
-@param bio BIO handle
-@param b Bit to write (0 or 1)
-*/
-static void mi_bio_putbit(mi_bio_t *bio, mi_UINT32 b);
-/**
-Read a bit
-@param bio BIO handle
-@return Returns the read bit
-*/
-static mi_UINT32 mi_bio_getbit(mi_bio_t *bio);
 /**
 Write a byte
 @param bio BIO handle
+@param b Byte to write
 @return Returns mi_TRUE if successful, returns mi_FALSE otherwise
 */
-static mi_BOOL mi_bio_byteout(mi_bio_t *bio);
+static mi_BOOL mi_bio_byteout(mi_bio_t *bio, mi_UINT32 b);
 /**
-Read a byte
+Read bytes in advance, until the register holds more than 56 bits or the end
+of the buffer is reached
 @param bio BIO handle
-@return Returns mi_TRUE if successful, returns mi_FALSE otherwise
 */
-static mi_BOOL mi_bio_bytein(mi_bio_t *bio);
+static void mi_bio_fill(mi_bio_t *bio);
 
 /*@}*/
 
@@ -42,40 +31,22 @@ static mi_BOOL mi_bio_bytein(mi_bio_t *bio);
 ==========================================================
 */
 
-static mi_BOOL mi_bio_byteout(mi_bio_t *bio) {
-	bio->buf = (bio->buf << 8) & 0xffff;
-	bio->ct = bio->buf == 0xff00 ? 7 : 8;
+static mi_BOOL mi_bio_byteout(mi_bio_t *bio, mi_UINT32 b) {
+	bio->last = b;
 	if ((mi_SIZE_T)bio->bp >= (mi_SIZE_T)bio->end) {
 		return mi_FALSE;
 	}
-	*bio->bp++ = (mi_BYTE)(bio->buf >> 8);
+	*bio->bp++ = (mi_BYTE)b;
 	return mi_TRUE;
 }
 
-static mi_BOOL mi_bio_bytein(mi_bio_t *bio) {
-	bio->buf = (bio->buf << 8) & 0xffff;
-	bio->ct = bio->buf == 0xff00 ? 7 : 8;
-	if ((mi_SIZE_T)bio->bp >= (mi_SIZE_T)bio->end) {
-		return mi_FALSE;
+static void mi_bio_fill(mi_bio_t *bio) {
+	while ((bio->ct <= 56U) && ((mi_SIZE_T)bio->bp < (mi_SIZE_T)bio->end)) {
+		mi_UINT32 w = bio->last == 0xff ? 7U : 8U;
+		bio->last = *bio->bp++;
+		bio->buf = (bio->buf << w) | (bio->last & ((1U << w) - 1U));
+		bio->ct += w;
 	}
-	bio->buf |= *bio->bp++;
-	return mi_TRUE;
-}
-
-static void mi_bio_putbit(mi_bio_t *bio, mi_UINT32 b) {
-	if (bio->ct == 0) {
-		mi_bio_byteout(bio); /* MSD: why not check the return value of this function ? */
-	}
-	bio->ct--;
-	bio->buf |= b << bio->ct;
-}
-
-static mi_UINT32 mi_bio_getbit(mi_bio_t *bio) {
-	if (bio->ct == 0) {
-		mi_bio_bytein(bio); /* MSD: why not check the return value of this function ? */
-	}
-	bio->ct--;
-	return (bio->buf >> bio->ct) & 1;
 }
 
 /* 
@@ -104,7 +75,8 @@ void mi_bio_init_enc(mi_bio_t *bio, mi_BYTE *bp, mi_UINT32 len) {
 	bio->end = bp + len;
 	bio->bp = bp;
 	bio->buf = 0;
-	bio->ct = 8;
+	bio->ct = 0;
+	bio->last = 0;
 }
 
 void mi_bio_init_dec(mi_bio_t *bio, mi_BYTE *bp, mi_UINT32 len) {
@@ -113,37 +85,60 @@ void mi_bio_init_dec(mi_bio_t *bio, mi_BYTE *bp, mi_UINT32 len) {
 	bio->bp = bp;
 	bio->buf = 0;
 	bio->ct = 0;
+	bio->last = 0;
 }
 
-mi_NOSANITIZE("unsigned-integer-overflow")
 void mi_bio_write(mi_bio_t *bio, mi_UINT32 v, mi_UINT32 n) {
-	mi_UINT32 i;
-	
+	mi_UINT32 w;
+
 	assert((n > 0U) && (n <= 32U));
-	for (i = n - 1; i < n; i--) { /* overflow used for end-loop condition */
-		mi_bio_putbit(bio, (v >> i) & 1);
+	bio->buf = (bio->buf << n) | (v & (mi_UINT32)(((mi_UINT64)1 << n) - 1U));
+	bio->ct += n;
+	/* a byte is written once a bit of the next one is known: the current */
+	/* byte is the one ended by mi_bio_flush                                */
+	w = bio->last == 0xff ? 7U : 8U;
+	while (bio->ct > w) {
+		bio->ct -= w;
+		mi_bio_byteout(bio, (mi_UINT32)(bio->buf >> bio->ct) & ((1U << w) - 1U)); /* MSD: why not check the return value of this function ? */
+		w = bio->last == 0xff ? 7U : 8U;
 	}
 }
 
-mi_NOSANITIZE("unsigned-integer-overflow")
 mi_UINT32 mi_bio_read(mi_bio_t *bio, mi_UINT32 n) {
-	mi_UINT32 i;
 	mi_UINT32 v;
-	
-	assert((n > 0U) /* && (n <= 32U)*/);
-	v = 0U;
-	for (i = n - 1; i < n; i--) { /* overflow used for end-loop condition */
-		v |= mi_bio_getbit(bio) << i; /* can't overflow, mi_bio_getbit returns 0 or 1 */
+
+	assert(n > 0U);
+	if (n > 32U) {
+		/* only the last 32 bits fit in the result */
+		mi_bio_read(bio, n - 32U);
+		n = 32U;
+	}
+	if (bio->ct < n) {
+		mi_bio_fill(bio);
+		if (bio->ct < n) {
+			/* end of the buffer: the missing bits are 0's */
+			v = (mi_UINT32)((bio->buf & (((mi_UINT64)1 << bio->ct) - 1U)) << (n - bio->ct));
+			bio->buf = 0;
+			bio->ct = 0;
+			bio->last = 0;
+			return v;
+		}
 	}
-	return v;
+	bio->ct -= n;
+	return (mi_UINT32)(bio->buf >> bio->ct) & (mi_UINT32)(((mi_UINT64)1 << n) - 1U);
 }
 
 mi_BOOL mi_bio_flush(mi_bio_t *bio) {
-	if (! mi_bio_byteout(bio)) {
+	mi_UINT32 w = bio->last == 0xff ? 7U : 8U;
+
+	/* the current byte, completed with 0's */
+	if (! mi_bio_byteout(bio, (mi_UINT32)(bio->buf << (w - bio->ct)) & ((1U << w) - 1U))) {
 		return mi_FALSE;
 	}
-	if (bio->ct == 7) {
-		if (! mi_bio_byteout(bio)) {
+	bio->buf = 0;
+	bio->ct = 0;
+	if (bio->last == 0xff) {
+		if (! mi_bio_byteout(bio, 0U)) {
 			return mi_FALSE;
 		}
 	}
@@ -151,11 +146,29 @@ mi_BOOL mi_bio_flush(mi_bio_t *bio) {
 }
 
 mi_BOOL mi_bio_inalign(mi_bio_t *bio) {
-	if ((bio->buf & 0xff) == 0xff) {
-		if (! mi_bio_bytein(bio)) {
+	mi_UINT32 cur = bio->last;
+
+	/* give back the bytes read in advance from which no bit has been read */
+	if (bio->ct > 0U) {
+		for (;;) {
+			mi_UINT32 w = ((bio->bp - bio->start) >= 2 && bio->bp[-2] == 0xff) ? 7U : 8U;
+			if ((bio->bp == bio->start) || (bio->ct < w)) {
+				break;
+			}
+			bio->ct -= w;
+			--bio->bp;
+		}
+		cur = (bio->bp > bio->start) ? bio->bp[-1] : 0U;
+	}
+	/* a 0xff byte is followed by a stuffed one */
+	if (cur == 0xff) {
+		if ((mi_SIZE_T)bio->bp >= (mi_SIZE_T)bio->end) {
 			return mi_FALSE;
 		}
+		cur = *bio->bp++;
 	}
+	bio->buf = 0;
 	bio->ct = 0;
+	bio->last = cur;
 	return mi_TRUE;
 }
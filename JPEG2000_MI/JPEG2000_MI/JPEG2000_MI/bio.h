@@ -9,6 +9,10 @@
 @brief Implementation of an individual bit input-output (BIO)
 
 The functions in BIO.C have for goal to realize an individual bit input - output.
+The bits go through a 64-bit register: the decoder reads the bytes in advance and
+extracts several bits at once, the encoder gathers the bits and writes whole bytes.
+Both apply the bit-stuffing of the packet headers (a 0xff byte is followed by a
+byte of 7 bits).
 */
 
 /** @defgroup BIO BIO - Individual bit input-output stream */
@@ -24,10 +28,12 @@ typedef struct mi_bio {
 	mi_BYTE *end;
 	/** pointer to the present position in the buffer */
 	mi_BYTE *bp;
-	/** temporary place where each byte is read or written */
-	mi_UINT32 buf;
-	/** coder : number of bits free to write. decoder : number of bits read */
+	/** coder : bits waiting to be written. decoder : bits read in advance */
+	mi_UINT64 buf;
+	/** number of bits in buf */
 	mi_UINT32 ct;
+	/** last byte written or read (after a 0xff byte, the next one has only 7 bits) */
+	mi_UINT32 last;
 } mi_bio_t;
 
 /** @name Exported functions */
@@ -44,9 +50,10 @@ Destroy a previously created BIO handle
 */
 void mi_bio_destroy(mi_bio_t *bio);
 /**
-Number of bytes written.
+Number of bytes written or read.
+The decoder reads the bytes in advance: its count is right after mi_bio_inalign.
 @param bio BIO handle
-@return Returns the number of bytes written
+@return Returns the number of bytes written or read
 */
 ptrdiff_t mi_bio_numbytes(mi_bio_t *bio);
 /**
@@ -67,13 +74,13 @@ void mi_bio_init_dec(mi_bio_t *bio, mi_BYTE *bp, mi_UINT32 len);
 Write bits
 @param bio BIO handle
 @param v Value of bits
-@param n Number of bits to write
+@param n Number of bits to write (1 to 32)
 */
 void mi_bio_write(mi_bio_t *bio, mi_UINT32 v, mi_UINT32 n);
 /**
 Read bits
 @param bio BIO handle
-@param n Number of bits to read 
+@param n Number of bits to read (1 to 32); the bits after the end of the buffer are 0's
 @return Returns the corresponding read number
 */
 mi_UINT32 mi_bio_read(mi_bio_t *bio, mi_UINT32 n);
@@ -84,7 +91,7 @@ Flush bits
 */
 mi_BOOL mi_bio_flush(mi_bio_t *bio);
 /**
-Passes the ending bits (coming from flushing)
+Passes the ending bits (coming from flushing), and gives back the bytes read in advance
 @param bio BIO handle
 @return Returns mi_TRUE if successful, returns mi_FALSE otherwise
 */
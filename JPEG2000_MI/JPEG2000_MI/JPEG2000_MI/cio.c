@@ -159,7 +159,9 @@ void mi_CALLCONV mi_stream_destroy(mi_stream_t* p_stream)
 		if (l_stream->m_free_user_data_fn) {
 			l_stream->m_free_user_data_fn(l_stream->m_user_data);
 		}
-		mi_free(l_stream->m_stored_data);
+		if ((! (l_stream->m_status & mi_STREAM_STATUS_MAPPED)) || (l_stream->m_status & mi_STREAM_STATUS_GROWABLE)) {
+			mi_free(l_stream->m_stored_data);
+		}
 		l_stream->m_stored_data = 00;
 		mi_free(l_stream);
 	}
@@ -225,6 +227,31 @@ void mi_CALLCONV mi_stream_set_user_data_length(mi_stream_t* p_stream, mi_UINT64
 	l_stream->m_user_data_length = data_length;
 }
 
+mi_stream_t* mi_CALLCONV mi_stream_create_memory_stream(mi_BYTE * p_buffer, mi_SIZE_T p_size, mi_BOOL p_is_read_stream)
+{
+	if (p_is_read_stream) {
+		if (! p_buffer) {
+			return 00;
+		}
+		return (mi_stream_t *) mi_stream_create_mapped_input(p_buffer, p_size, 00);
+	}
+
+	return (mi_stream_t *) mi_stream_create_mapped_output(p_buffer, p_size);
+}
+
+mi_BYTE * mi_CALLCONV mi_stream_get_memory_data(mi_stream_t* p_stream, mi_SIZE_T * p_size)
+{
+	mi_stream_private_t* l_stream = (mi_stream_private_t*) p_stream;
+	if ((! l_stream) || (! (l_stream->m_status & mi_STREAM_STATUS_MAPPED))) {
+		return 00;
+	}
+
+	if (p_size) {
+		*p_size = (mi_SIZE_T)l_stream->m_user_data_length;
+	}
+	return l_stream->m_stored_data;
+}
+
 mi_SIZE_T mi_stream_read_data (mi_stream_private_t * p_stream,mi_BYTE * p_buffer, mi_SIZE_T p_size, mi_event_mgr_t * p_event_mgr)
 {
 	mi_SIZE_T l_read_nb_bytes = 0;
@@ -344,6 +371,20 @@ mi_SIZE_T mi_stream_write_data (mi_stream_private_t * p_stream,
 		return (mi_SIZE_T)-1;
 	}
 
+	/* the bytes are written in place, there is nothing to flush */
+	if (p_stream->m_status & mi_STREAM_STATUS_MAPPED) {
+		if (! mi_stream_mapped_reserve(p_stream, (mi_UINT64)p_stream->m_byte_offset + p_size, p_event_mgr)) {
+			return (mi_SIZE_T)-1;
+		}
+		memcpy(p_stream->m_current_data, p_buffer, p_size);
+		p_stream->m_current_data += p_size;
+		p_stream->m_byte_offset += (mi_OFF_T)p_size;
+		if ((mi_UINT64)p_stream->m_byte_offset > p_stream->m_user_data_length) {
+			p_stream->m_user_data_length = (mi_UINT64)p_stream->m_byte_offset;
+		}
+		return p_size;
+	}
+
 	for (;;) {
 		l_remaining_bytes = p_stream->m_buffer_size - p_stream->m_bytes_in_buffer;
 		
@@ -385,6 +426,10 @@ mi_BOOL mi_stream_flush (mi_stream_private_t * p_stream, mi_event_mgr_t * p_even
 	/* the number of bytes written on the media. */
 	mi_SIZE_T l_current_write_nb_bytes = 0;
 
+	if (p_stream->m_status & mi_STREAM_STATUS_MAPPED) {
+		return (p_stream->m_status & mi_STREAM_STATUS_ERROR) ? mi_FALSE : mi_TRUE;
+	}
+
 	p_stream->m_current_data = p_stream->m_stored_data;
 
 	while (p_stream->m_bytes_in_buffer) {
@@ -572,7 +617,195 @@ mi_BOOL mi_stream_seek (mi_stream_private_t * p_stream, mi_OFF_T p_size, struct
 
 mi_BOOL mi_stream_has_seek (const mi_stream_private_t * p_stream)
 {
-	return p_stream->m_seek_fn != mi_stream_default_seek;
+	return (p_stream->m_seek_fn != mi_stream_default_seek) || (p_stream->m_status & mi_STREAM_STATUS_MAPPED);
+}
+
+mi_stream_private_t * mi_stream_create_mapped_input (const mi_BYTE * p_data, mi_SIZE_T p_size, mi_stream_release_fn p_release)
+{
+	mi_stream_private_t * l_stream = 00;
+	l_stream = (mi_stream_private_t*) mi_calloc(1,sizeof(mi_stream_private_t));
+	if (! l_stream) {
+		return 00;
+	}
+
+	/* the whole stream is the buffer, which is never refilled: the read and skip
+	   functions are not called as the end is reached with the buffer */
+	l_stream->m_stored_data = (mi_BYTE *) p_data;
+	l_stream->m_current_data = l_stream->m_stored_data;
+	l_stream->m_buffer_size = p_size;
+	l_stream->m_bytes_in_buffer = p_size;
+	l_stream->m_user_data_length = p_size;
+	l_stream->m_status = mi_STREAM_STATUS_INPUT | mi_STREAM_STATUS_END | mi_STREAM_STATUS_MAPPED;
+	l_stream->m_mi_skip = mi_stream_read_skip;
+	l_stream->m_mi_seek = mi_stream_mapped_seek;
+
+	l_stream->m_read_fn = mi_stream_default_read;
+	l_stream->m_write_fn = mi_stream_default_write;
+	l_stream->m_skip_fn = mi_stream_default_skip;
+	l_stream->m_seek_fn = mi_stream_default_seek;
+	l_stream->m_release_fn = p_release;
+
+	return l_stream;
+}
+
+mi_stream_private_t * mi_stream_create_mapped_output (mi_BYTE * p_buffer, mi_SIZE_T p_size)
+{
+	mi_stream_private_t * l_stream = 00;
+	l_stream = (mi_stream_private_t*) mi_calloc(1,sizeof(mi_stream_private_t));
+	if (! l_stream) {
+		return 00;
+	}
+
+	l_stream->m_status = mi_STREAM_STATUS_OUTPUT | mi_STREAM_STATUS_MAPPED;
+	if (! p_buffer) {
+		if (! p_size) {
+			p_size = mi_J2K_STREAM_CHUNK_SIZE;
+		}
+		p_buffer = (mi_BYTE *) mi_malloc(p_size);
+		if (! p_buffer) {
+			mi_free(l_stream);
+			return 00;
+		}
+		l_stream->m_status |= mi_STREAM_STATUS_GROWABLE;
+	}
+
+	/* m_buffer_size is the room in the buffer and m_user_data_length the number of bytes written,
+	   the stream buffer is not used: m_bytes_in_buffer stays 0 */
+	l_stream->m_stored_data = p_buffer;
+	l_stream->m_current_data = l_stream->m_stored_data;
+	l_stream->m_buffer_size = p_size;
+	l_stream->m_mi_skip = mi_stream_mapped_write_skip;
+	l_stream->m_mi_seek = mi_stream_mapped_seek;
+
+	l_stream->m_read_fn = mi_stream_default_read;
+	l_stream->m_write_fn = mi_stream_default_write;
+	l_stream->m_skip_fn = mi_stream_default_skip;
+	l_stream->m_seek_fn = mi_stream_default_seek;
+
+	return l_stream;
+}
+
+mi_BOOL mi_stream_reads_in_place (const mi_stream_private_t * p_stream)
+{
+	return (p_stream->m_status & mi_STREAM_STATUS_MAPPED) && (p_stream->m_status & mi_STREAM_STATUS_INPUT);
+}
+
+mi_BYTE * mi_stream_read_in_place (mi_stream_private_t * p_stream, mi_SIZE_T p_size, mi_SIZE_T * p_read_size)
+{
+	mi_BYTE * l_data = p_stream->m_current_data;
+
+	if (! mi_stream_reads_in_place(p_stream)) {
+		*p_read_size = 0;
+		return 00;
+	}
+
+	if (p_size > p_stream->m_bytes_in_buffer) {
+		p_size = p_stream->m_bytes_in_buffer;
+	}
+	p_stream->m_current_data += p_size;
+	p_stream->m_bytes_in_buffer -= p_size;
+	p_stream->m_byte_offset += (mi_OFF_T)p_size;
+	*p_read_size = p_size;
+
+	return l_data;
+}
+
+void mi_stream_release_in_place (const mi_stream_private_t * p_stream, const mi_BYTE * p_data, mi_SIZE_T p_size)
+{
+	if (p_stream->m_release_fn && p_size) {
+		p_stream->m_release_fn(p_data, p_size, p_stream->m_user_data);
+	}
+}
+
+mi_BOOL mi_stream_mapped_seek (mi_stream_private_t * p_stream, mi_OFF_T p_size, mi_event_mgr_t * p_event_mgr)
+{
+	mi_ARG_NOT_USED(p_event_mgr);
+
+	/* the position is one of the bytes of the stream, or its end */
+	if ((mi_UINT64)p_size > p_stream->m_user_data_length) {
+		if (p_stream->m_status & mi_STREAM_STATUS_OUTPUT) {
+			p_stream->m_status |= mi_STREAM_STATUS_ERROR;
+		}
+		return mi_FALSE;
+	}
+
+	p_stream->m_current_data = p_stream->m_stored_data + p_size;
+	if (p_stream->m_status & mi_STREAM_STATUS_INPUT) {
+		p_stream->m_bytes_in_buffer = (mi_SIZE_T)(p_stream->m_user_data_length - (mi_UINT64)p_size);
+	}
+	p_stream->m_byte_offset = p_size;
+
+	return mi_TRUE;
+}
+
+mi_OFF_T mi_stream_mapped_write_skip (mi_stream_private_t * p_stream, mi_OFF_T p_size, mi_event_mgr_t * p_event_mgr)
+{
+	mi_UINT64 l_end;
+
+	if (p_stream->m_status & mi_STREAM_STATUS_ERROR) {
+		return (mi_OFF_T) -1;
+	}
+
+	l_end = (mi_UINT64)p_stream->m_byte_offset + (mi_UINT64)p_size;
+	if (! mi_stream_mapped_reserve(p_stream, l_end, p_event_mgr)) {
+		return (mi_OFF_T) -1;
+	}
+
+	if (l_end > p_stream->m_user_data_length) {
+		memset(p_stream->m_stored_data + p_stream->m_user_data_length, 0, (mi_SIZE_T)(l_end - p_stream->m_user_data_length));
+		p_stream->m_user_data_length = l_end;
+	}
+	p_stream->m_current_data += p_size;
+	p_stream->m_byte_offset += p_size;
+
+	return p_size;
+}
+
+mi_BOOL mi_stream_mapped_reserve (mi_stream_private_t * p_stream, mi_UINT64 p_end, mi_event_mgr_t * p_event_mgr)
+{
+	mi_SIZE_T l_new_size;
+	mi_BYTE * l_new_data;
+
+	if (p_end <= (mi_UINT64)p_stream->m_buffer_size) {
+		return mi_TRUE;
+	}
+
+	if (! (p_stream->m_status & mi_STREAM_STATUS_GROWABLE)) {
+		p_stream->m_status |= mi_STREAM_STATUS_ERROR;
+		mi_event_msg(p_event_mgr, EVT_ERROR, "The output buffer of the stream is too small\n");
+		return mi_FALSE;
+	}
+
+	if (p_end > (mi_UINT64)((mi_SIZE_T)-1)) {
+		p_stream->m_status |= mi_STREAM_STATUS_ERROR;
+		mi_event_msg(p_event_mgr, EVT_ERROR, "Not enough memory to write the stream\n");
+		return mi_FALSE;
+	}
+
+	/* the buffer at least doubles so that the bytes are not copied too often */
+	l_new_size = p_stream->m_buffer_size;
+	if (l_new_size > ((mi_SIZE_T)-1) / 2) {
+		l_new_size = (mi_SIZE_T)-1;
+	}
+	else {
+		l_new_size *= 2;
+	}
+	if ((mi_UINT64)l_new_size < p_end) {
+		l_new_size = (mi_SIZE_T)p_end;
+	}
+
+	l_new_data = (mi_BYTE *) mi_realloc(p_stream->m_stored_data, l_new_size);
+	if (! l_new_data) {
+		p_stream->m_status |= mi_STREAM_STATUS_ERROR;
+		mi_event_msg(p_event_mgr, EVT_ERROR, "Not enough memory to write the stream\n");
+		return mi_FALSE;
+	}
+
+	p_stream->m_current_data = l_new_data + p_stream->m_byte_offset;
+	p_stream->m_stored_data = l_new_data;
+	p_stream->m_buffer_size = l_new_size;
+
+	return mi_TRUE;
 }
 
 mi_SIZE_T mi_stream_default_read (void * p_buffer, mi_SIZE_T p_nb_bytes, void * p_user_data)
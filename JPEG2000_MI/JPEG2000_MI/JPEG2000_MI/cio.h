@@ -27,6 +27,15 @@ The functions in CIO.C have for goal to realize a byte input / output process.
 #define mi_STREAM_STATUS_INPUT   0x2U
 #define mi_STREAM_STATUS_END     0x4U
 #define mi_STREAM_STATUS_ERROR   0x8U
+/** the whole stream is in m_stored_data, which is read or written in place */
+#define mi_STREAM_STATUS_MAPPED  0x10U
+/** m_stored_data of a mapped output stream is owned by the stream and grows as the stream is written */
+#define mi_STREAM_STATUS_GROWABLE 0x20U
+
+/**
+ * Function called with bytes read in place which are not used any more, see mi_stream_release_in_place.
+ */
+typedef void (* mi_stream_release_fn) (const mi_BYTE * p_data, mi_SIZE_T p_size, void * p_user_data);
 
 /**
 Byte input-output stream.
@@ -71,6 +80,11 @@ typedef struct mi_stream_private
 	 */
 	mi_stream_seek_fn		m_seek_fn;
 
+	/**
+	 * Pointer to the function releasing the bytes read in place (if available).
+	 */
+	mi_stream_release_fn	m_release_fn;
+
 	/**
 	 * Actual data stored into the stream if readed from. Data is read by chunk of fixed size.
 	 * you should never access this data directly.
@@ -316,6 +330,78 @@ mi_BOOL mi_stream_seek (mi_stream_private_t * p_stream, mi_OFF_T p_size, struct
  */
 mi_BOOL mi_stream_has_seek (const mi_stream_private_t * p_stream);
 
+/**
+ * Creates an input stream over bytes that are all in memory. The bytes are not copied and must be
+ * kept by the caller until the stream is destroyed.
+ * @param		p_data		the bytes of the stream.
+ * @param		p_size		the number of bytes of the stream.
+ * @param		p_release	the function releasing the bytes not used any more, or 00.
+ * @return		the stream, or 00 if there is not enough memory.
+ */
+mi_stream_private_t * mi_stream_create_mapped_input (const mi_BYTE * p_data, mi_SIZE_T p_size, mi_stream_release_fn p_release);
+
+/**
+ * Creates an output stream writing its bytes in place in a memory buffer, without going through the
+ * buffer of the stream. The number of bytes written is kept in m_user_data_length.
+ * @param		p_buffer	the buffer receiving the bytes, kept by the caller until the stream is destroyed,
+ *							or 00 for a buffer owned by the stream and growing as needed.
+ * @param		p_size		the size of p_buffer, or the initial size of the buffer owned by the stream.
+ * @return		the stream, or 00 if there is not enough memory.
+ */
+mi_stream_private_t * mi_stream_create_mapped_output (mi_BYTE * p_buffer, mi_SIZE_T p_size);
+
+/**
+ * Tells if the data of the given stream can be read in place with mi_stream_read_in_place.
+ */
+mi_BOOL mi_stream_reads_in_place (const mi_stream_private_t * p_stream);
+
+/**
+ * Reads some bytes from a stream created by mi_stream_create_mapped_input without copying them.
+ * @param		p_stream	the stream to read data from.
+ * @param		p_size		number of bytes to read.
+ * @param		p_read_size	the number of bytes actually read, less than p_size at the end of the stream.
+ * @return		a pointer to the bytes read, valid as long as the stream, or 00 if the stream is not read in place.
+ */
+mi_BYTE * mi_stream_read_in_place (mi_stream_private_t * p_stream, mi_SIZE_T p_size, mi_SIZE_T * p_read_size);
+
+/**
+ * Tells the stream that bytes given by mi_stream_read_in_place are not used any more, so that their
+ * memory can be given back. The bytes stay readable. This function may be called from any thread.
+ * @param		p_stream	the stream the bytes were read from.
+ * @param		p_data		the bytes not used any more.
+ * @param		p_size		the number of bytes.
+ */
+void mi_stream_release_in_place (const mi_stream_private_t * p_stream, const mi_BYTE * p_data, mi_SIZE_T p_size);
+
+/**
+ * Seeks in a stream created by mi_stream_create_mapped_input.
+ * @param		p_stream	the stream to seek in.
+ * @param		p_size		the position to seek to.
+ * @param		p_event_mgr	the user event manager to be notified of special events.
+ * @return		mi_TRUE if success, or mi_FALSE if the position is past the end of the stream.
+ */
+mi_BOOL mi_stream_mapped_seek (mi_stream_private_t * p_stream, mi_OFF_T p_size, struct mi_event_mgr * p_event_mgr);
+
+/**
+ * Skips a number of bytes in a stream created by mi_stream_create_mapped_output, the bytes skipped
+ * past the end of the stream being set to 0.
+ * @param		p_stream	the stream to skip data from.
+ * @param		p_size		the number of bytes to skip.
+ * @param		p_event_mgr	the user event manager to be notified of special events.
+ * @return		the number of bytes skipped, or -1 if an error occurred.
+ */
+mi_OFF_T mi_stream_mapped_write_skip (mi_stream_private_t * p_stream, mi_OFF_T p_size, struct mi_event_mgr * p_event_mgr);
+
+/**
+ * Makes sure that the buffer of a stream created by mi_stream_create_mapped_output holds a number of bytes,
+ * growing it if the stream owns it.
+ * @param		p_stream	the stream to write data to.
+ * @param		p_end		the number of bytes the buffer should hold.
+ * @param		p_event_mgr	the user event manager to be notified of special events.
+ * @return		mi_TRUE if success, or mi_FALSE if the buffer is too small or there is not enough memory.
+ */
+mi_BOOL mi_stream_mapped_reserve (mi_stream_private_t * p_stream, mi_UINT64 p_end, struct mi_event_mgr * p_event_mgr);
+
 /**
  * FIXME DOC.
  */
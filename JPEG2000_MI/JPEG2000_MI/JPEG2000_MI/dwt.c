@@ -1,8 +1,4 @@
 
-#ifdef __SSE__
-#include <xmmintrin.h>
-#endif
-
 #include "mi_includes.h"
 
 /** @defgroup DWT DWT - Implementation of a discrete wavelet transform */
@@ -32,6 +28,19 @@ typedef struct v4dwt_local {
 	mi_INT32		cas ;
 } mi_v4dwt_t ;
 
+#ifdef mi_HAVE_AVX2
+typedef union {
+	mi_FLOAT32	f[8];
+} mi_v8_t;
+
+typedef struct v8dwt_local {
+	mi_v8_t*	wavelet ;
+	mi_INT32		dn ;
+	mi_INT32		sn ;
+	mi_INT32		cas ;
+} mi_v8dwt_t ;
+#endif
+
 static const mi_FLOAT32 mi_dwt_alpha =  1.586134342f; /*  12994 */
 static const mi_FLOAT32 mi_dwt_beta  =  0.052980118f; /*    434 */
 static const mi_FLOAT32 mi_dwt_gamma = -0.882911075f; /*  -7233 */
@@ -45,7 +54,38 @@ static const mi_FLOAT32 mi_c13318 = 1.625732422f;
 /**
 Virtual function type for wavelet transform in 1-D 
 */
-typedef void (*DWT1DFN)(mi_dwt_t* v);
+typedef void (*DWT1DFN)(mi_INT32 *a, mi_INT32 dn, mi_INT32 sn, mi_INT32 cas, mi_INT32 width);
+
+/**
+Pass of a 2-D wavelet transform on a range of rows or columns of a resolution level
+*/
+typedef struct dwt_pass {
+	DWT1DFN fn;				/* 1-D transform (5-3 and forward 9-7) */
+	void* mem;				/* scratch buffer of the job */
+	void* tiledp;			/* samples of the tile component */
+	mi_UINT32 w;			/* width of the tile component */
+	mi_UINT32 size;			/* number of samples of the tile component */
+	mi_UINT32 rw;			/* width of the resolution level computed */
+	mi_UINT32 rh;			/* height of the resolution level computed */
+	mi_INT32 dn;
+	mi_INT32 sn;
+	mi_INT32 cas;
+	mi_UINT32 min_j;		/* first row or column of the job */
+	mi_UINT32 max_j;		/* row or column after the last one of the job */
+	mi_UINT32 l0;			/* inverse transforms: first low-pass element read in a row or column */
+	mi_UINT32 h0;			/* inverse transforms: first high-pass element read in a row or column */
+	mi_UINT32 o0;			/* inverse transforms: first sample written in a row or column */
+} mi_dwt_pass_t;
+
+/**
+Jobs a pass of a 2-D wavelet transform is split in
+*/
+typedef struct dwt_workers {
+	mi_job_group_t* group;	/* jobs of the passes on the thread pool, 00 if run here */
+	mi_UINT32 nb_jobs;		/* maximum number of jobs of a pass */
+	mi_dwt_pass_t* jobs;	/* parameters of the jobs */
+	void** mems;			/* scratch buffers of the jobs */
+} mi_dwt_workers_t;
 
 /** @name Local static functions */
 /*@{*/
@@ -55,30 +95,156 @@ Forward lazy transform (horizontal)
 */
 static void mi_dwt_deinterleave_h(mi_INT32 *a, mi_INT32 *b, mi_INT32 dn, mi_INT32 sn, mi_INT32 cas);
 /**
-Forward lazy transform (vertical)
+Forward lazy transform (vertical) of a strip of columns
+@param a       first column of the strip in the tile component
+@param b       strip: low-pass elements then high-pass ones, of mi_DWT_NB_COLS values each
+@param dn      number of high-pass elements
+@param sn      number of low-pass elements
+@param x       width of the tile component
+@param cas     0 if the first sample is low-pass, 1 otherwise
+@param nb_cols number of columns of the strip (at most mi_DWT_NB_COLS)
 */
-static void mi_dwt_deinterleave_v(mi_INT32 *a, mi_INT32 *b, mi_INT32 dn, mi_INT32 sn, mi_INT32 x, mi_INT32 cas);
+static void mi_dwt_deinterleave_v(mi_INT32 *a, mi_INT32 *b, mi_INT32 dn, mi_INT32 sn, mi_INT32 x, mi_INT32 cas, mi_INT32 nb_cols);
 /**
 Inverse lazy transform (horizontal)
 */
 static void mi_dwt_interleave_h(mi_dwt_t* h, mi_INT32 *a);
 /**
-Inverse lazy transform (vertical)
+Inverse lazy transform (vertical) of a strip of columns
 */
-static void mi_dwt_interleave_v(mi_dwt_t* v, mi_INT32 *a, mi_INT32 x);
+static void mi_dwt_interleave_v(mi_dwt_t* v, mi_INT32 *a, mi_INT32 x, mi_INT32 nb_cols);
 /**
 Forward 5-3 wavelet transform in 1-D
+@param a     low-pass elements followed by the high-pass ones
+@param dn    number of high-pass elements
+@param sn    number of low-pass elements
+@param cas   0 if the first sample is low-pass, 1 otherwise
+@param width number of values of an element (1 for a row, mi_DWT_NB_COLS for a strip of columns)
 */
-static void mi_dwt_encode_1(mi_INT32 *a, mi_INT32 dn, mi_INT32 sn, mi_INT32 cas);
+static void mi_dwt_encode_1(mi_INT32 *a, mi_INT32 dn, mi_INT32 sn, mi_INT32 cas, mi_INT32 width);
 /**
 Inverse 5-3 wavelet transform in 1-D
 */
-static void mi_dwt_decode_1(mi_dwt_t *v);
-static void mi_dwt_decode_1_(mi_INT32 *a, mi_INT32 dn, mi_INT32 sn, mi_INT32 cas);
+static void mi_dwt_decode_1(mi_INT32 *a, mi_INT32 dn, mi_INT32 sn, mi_INT32 cas, mi_INT32 width);
 /**
 Forward 9-7 wavelet transform in 1-D
 */
-static void mi_dwt_encode_1_real(mi_INT32 *a, mi_INT32 dn, mi_INT32 sn, mi_INT32 cas);
+static void mi_dwt_encode_1_real(mi_INT32 *a, mi_INT32 dn, mi_INT32 sn, mi_INT32 cas, mi_INT32 width);
+/**
+Clamp an index to [0, n-1]
+*/
+static INLINE mi_INT32 mi_dwt_clamp(mi_INT32 i, mi_INT32 n);
+/**
+Lifting step of the 5-3 wavelet transform:
+w[i] -= (l[i+off] + l[i+off+1] + rnd) >> shift (+= if add), the indexes in l being clamped to [0, nb_l-1]
+@param w     elements to update
+@param l     neighbour elements
+@param count number of elements to update
+@param nb_l  number of neighbour elements
+@param off   offset of the first neighbour
+@param rnd   rounding offset
+@param shift right shift
+@param add   mi_TRUE to add, mi_FALSE to subtract
+@param width number of values of an element
+*/
+static void mi_dwt_lift_53(mi_INT32 *w, const mi_INT32 *l, mi_INT32 count, mi_INT32 nb_l, mi_INT32 off, mi_INT32 rnd, mi_INT32 shift, mi_BOOL add, mi_INT32 width);
+/**
+Lifting step of the 5-3 wavelet transform on n contiguous values:
+w[j] -= (l0[j] + l1[j] + rnd) >> shift (+= if add)
+*/
+static void mi_dwt_lift_53_run(mi_INT32 * restrict w, const mi_INT32 *l0, const mi_INT32 *l1, mi_INT32 n, mi_INT32 rnd, mi_INT32 shift, mi_BOOL add);
+#ifdef mi_HAVE_SSE2
+/**
+SSE2 version of mi_dwt_lift_53_run
+*/
+static void mi_dwt_lift_53_run_sse2(mi_INT32 * restrict w, const mi_INT32 *l0, const mi_INT32 *l1, mi_INT32 n, mi_INT32 rnd, mi_INT32 shift, mi_BOOL add);
+#endif
+#ifdef mi_HAVE_AVX2
+/**
+AVX2 version of mi_dwt_lift_53_run
+*/
+static mi_TARGET_AVX2 void mi_dwt_lift_53_run_avx2(mi_INT32 * restrict w, const mi_INT32 *l0, const mi_INT32 *l1, mi_INT32 n, mi_INT32 rnd, mi_INT32 shift, mi_BOOL add);
+#endif
+/**
+Lifting step of the forward 9-7 wavelet transform:
+w[i] -= fix_mul(l[i+off] + l[i+off+1], k) (+= if add), the indexes in l being clamped to [0, nb_l-1]
+*/
+static void mi_dwt_lift_97(mi_INT32 *w, const mi_INT32 *l, mi_INT32 count, mi_INT32 nb_l, mi_INT32 off, mi_INT32 k, mi_BOOL add, mi_INT32 width);
+/**
+Lifting step of the forward 9-7 wavelet transform on n contiguous values:
+w[j] -= fix_mul(l0[j] + l1[j], k) (+= if add)
+*/
+static void mi_dwt_lift_97_run(mi_INT32 * restrict w, const mi_INT32 *l0, const mi_INT32 *l1, mi_INT32 n, mi_INT32 k, mi_BOOL add);
+/**
+Scaling step of the forward 9-7 wavelet transform on n contiguous values: w[j] = fix_mul(w[j], k)
+*/
+static void mi_dwt_scale_97(mi_INT32 * restrict w, mi_INT32 n, mi_INT32 k);
+/**
+Allocate the jobs and scratch buffers used by the passes of a 2-D transform
+@param wk       jobs to initialize
+@param tp       thread pool running the jobs (may be 00)
+@param mem_size size of the scratch buffer of a job
+@return mi_FALSE if the allocation failed
+*/
+static mi_BOOL mi_dwt_workers_init(mi_dwt_workers_t* wk, mi_thread_pool_t* tp, size_t mem_size);
+/**
+Free the jobs and scratch buffers of a 2-D transform
+*/
+static void mi_dwt_workers_clear(mi_dwt_workers_t* wk);
+/**
+Run a pass on the rows or columns [0, n) of a resolution level, split in
+several jobs when the pool has worker threads. Returns once every job is done,
+so that the next pass sees the whole result.
+@param wk   jobs of the transform
+@param fn   job function of the pass
+@param pass parameters of the pass, without the range of rows or columns
+@param n    number of rows or columns
+*/
+static void mi_dwt_run_pass(mi_dwt_workers_t* wk, mi_job_fn fn, const mi_dwt_pass_t* pass, mi_UINT32 n);
+/**
+Run a pass of an inverse transform on the rows or columns [j0, j1) of a resolution level
+(see mi_dwt_run_pass)
+*/
+static void mi_dwt_run_pass_range(mi_dwt_workers_t* wk, mi_job_fn fn, const mi_dwt_pass_t* pass, mi_UINT32 j0, mi_UINT32 j1, mi_UINT32 stride);
+/**
+Set the elements an inverse 1-D transform of a pass reads, in the window of the
+resolution level below and of the high-pass subband, and the samples it writes.
+The rows or columns of a windowed decoding are transformed on the part of them
+the decoded area depends on (see mi_tcd_init_decode_windows), which gives exact
+samples away from its ends.
+@param pass  pass to set
+@param l0    first low-pass element read
+@param l1    low-pass element after the last one read
+@param h0    first high-pass element read, from the first high-pass element
+@param h1    high-pass element after the last one read, from the first high-pass element
+@param sn    number of low-pass elements of the rows or columns
+@param cas   0 if the first sample of the rows or columns is low-pass, 1 otherwise
+*/
+static void mi_dwt_set_pass_window(mi_dwt_pass_t* pass, mi_UINT32 l0, mi_UINT32 l1, mi_UINT32 h0, mi_UINT32 h1, mi_UINT32 sn, mi_UINT32 cas);
+/**
+Horizontal pass of the forward 5-3 and 9-7 transforms (job function)
+*/
+static void mi_dwt_encode_h_processor(void* user_data, mi_tls_t* tls);
+/**
+Vertical pass of the forward 5-3 and 9-7 transforms (job function)
+*/
+static void mi_dwt_encode_v_processor(void* user_data, mi_tls_t* tls);
+/**
+Horizontal pass of the inverse 5-3 transform (job function)
+*/
+static void mi_dwt_decode_h_processor(void* user_data, mi_tls_t* tls);
+/**
+Vertical pass of the inverse 5-3 transform (job function)
+*/
+static void mi_dwt_decode_v_processor(void* user_data, mi_tls_t* tls);
+/**
+Horizontal pass of the inverse 9-7 transform (job function)
+*/
+static void mi_dwt_decode_h_real_processor(void* user_data, mi_tls_t* tls);
+/**
+Vertical pass of the inverse 9-7 transform (job function)
+*/
+static void mi_dwt_decode_v_real_processor(void* user_data, mi_tls_t* tls);
 /**
 Explicit calculation of the Quantization Stepsizes 
 */
@@ -86,10 +252,10 @@ static void mi_dwt_encode_stepsize(mi_INT32 stepsize, mi_INT32 numbps, mi_stepsi
 /**
 Inverse wavelet transform in 2-D.
 */
-static mi_BOOL mi_dwt_decode_tile(mi_tcd_tilecomp_t* tilec, mi_UINT32 i, DWT1DFN fn);
+static mi_BOOL mi_dwt_decode_tile(mi_thread_pool_t* tp, mi_tcd_tilecomp_t* tilec, mi_UINT32 i, DWT1DFN fn);
 
-static mi_BOOL mi_dwt_encode_procedure(	mi_tcd_tilecomp_t * tilec,
-										    void (*p_function)(mi_INT32 *, mi_INT32,mi_INT32,mi_INT32) );
+static mi_BOOL mi_dwt_encode_procedure(	mi_thread_pool_t * tp, mi_tcd_tilecomp_t * tilec,
+										    void (*p_function)(mi_INT32 *, mi_INT32,mi_INT32,mi_INT32,mi_INT32) );
 
 static mi_UINT32 mi_dwt_max_resolution(mi_tcd_resolution_t* restrict r, mi_UINT32 i);
 
@@ -98,26 +264,79 @@ static mi_UINT32 mi_dwt_max_resolution(mi_tcd_resolution_t* restrict r, mi_UINT3
 /* </summary>                            */
 static void mi_v4dwt_decode(mi_v4dwt_t* restrict dwt);
 
-static void mi_v4dwt_interleave_h(mi_v4dwt_t* restrict w, mi_FLOAT32* restrict a, mi_INT32 x, mi_INT32 size);
+/**
+Inverse lazy transform (horizontal) of 4 rows
+@param w     transform of the rows
+@param a     first low-pass sample of the first row
+@param x     width of the tile component
+@param size  number of samples from a to the end of the tile component
+@param h_off offset of the first high-pass sample from a
+*/
+static void mi_v4dwt_interleave_h(mi_v4dwt_t* restrict w, mi_FLOAT32* restrict a, mi_INT32 x, mi_INT32 size, mi_INT32 h_off);
 
-static void mi_v4dwt_interleave_v(mi_v4dwt_t* restrict v , mi_FLOAT32* restrict a , mi_INT32 x, mi_INT32 nb_elts_read);
+/**
+Inverse lazy transform (vertical) of at most 4 columns
+@param v            transform of the columns
+@param a            first low-pass sample of the first column
+@param x            width of the tile component
+@param h_off        offset in rows of the first high-pass sample from a
+@param nb_elts_read number of columns
+*/
+static void mi_v4dwt_interleave_v(mi_v4dwt_t* restrict v , mi_FLOAT32* restrict a , mi_INT32 x, mi_INT32 h_off, mi_INT32 nb_elts_read);
 
 static void mi_v4dwt_decode_step1(mi_v4_t* w, mi_INT32 count, const mi_FLOAT32 c);
 
 static void mi_v4dwt_decode_step2(mi_v4_t* l, mi_v4_t* w, mi_INT32 k, mi_INT32 m, mi_FLOAT32 c);
 
+#ifdef mi_HAVE_SSE2
+/**
+Inverse lazy transform (horizontal) of 4 complete rows with SSE2
+@param bi    first interleaved element to write
+@param a     first sample of the first row
+@param x     width of the tile component
+@param count number of samples to read per row
+*/
+static void mi_v4dwt_interleave_h_sse2(mi_FLOAT32* restrict bi, const mi_FLOAT32* restrict a, mi_INT32 x, mi_INT32 count);
+
+/**
+SSE2 version of mi_v4dwt_decode_step1
+*/
+static void mi_v4dwt_decode_step1_sse2(mi_v4_t* w, mi_INT32 count, const mi_FLOAT32 c);
+
+/**
+SSE2 version of mi_v4dwt_decode_step2
+*/
+static void mi_v4dwt_decode_step2_sse2(mi_v4_t* l, mi_v4_t* w, mi_INT32 k, mi_INT32 m, mi_FLOAT32 c);
+#endif
+
+#ifdef mi_HAVE_AVX2
+/**
+Inverse 9-7 wavelet transform in 1-D of 8 rows or columns with AVX2
+*/
+static mi_TARGET_AVX2 void mi_v8dwt_decode_avx2(mi_v8dwt_t* restrict dwt);
+
+/**
+Inverse lazy transform (horizontal) of 8 complete rows with AVX2
+*/
+static mi_TARGET_AVX2 void mi_v8dwt_interleave_h_avx2(mi_v8dwt_t* restrict w, const mi_FLOAT32* restrict a, mi_INT32 x, mi_INT32 h_off);
+
+/**
+Inverse lazy transform (vertical) of 8 columns with AVX2
+*/
+static mi_TARGET_AVX2 void mi_v8dwt_interleave_v_avx2(mi_v8dwt_t* restrict v, const mi_FLOAT32* restrict a, mi_INT32 x, mi_INT32 h_off);
+
+static mi_TARGET_AVX2 void mi_v8dwt_decode_step1_avx2(mi_v8_t* w, mi_INT32 count, const mi_FLOAT32 c);
+
+static mi_TARGET_AVX2 void mi_v8dwt_decode_step2_avx2(mi_v8_t* l, mi_v8_t* w, mi_INT32 k, mi_INT32 m, mi_FLOAT32 c);
+#endif
+
 
 /*@}*/
 
 /*@}*/
 
-#define mi_S(i) a[(i)*2]
-#define mi_D(i) a[(1+(i)*2)]
-#define mi_S_(i) ((i)<0?mi_S(0):((i)>=sn?mi_S(sn-1):mi_S(i)))
-#define mi_D_(i) ((i)<0?mi_D(0):((i)>=dn?mi_D(dn-1):mi_D(i)))
-/* new */
-#define mi_SS_(i) ((i)<0?mi_S(0):((i)>=dn?mi_S(dn-1):mi_S(i)))
-#define mi_DD_(i) ((i)<0?mi_D(0):((i)>=sn?mi_D(sn-1):mi_D(i)))
+/** Number of columns transformed together by the vertical passes of the 5-3 and forward 9-7 transforms */
+#define mi_DWT_NB_COLS 8
 
 /* <summary>                                                              */
 /* This table contains the norms of the 5-3 wavelets for different bands. */
@@ -167,91 +386,208 @@ static void mi_dwt_deinterleave_h(mi_INT32 *a, mi_INT32 *b, mi_INT32 dn, mi_INT3
 	}
 }
 
-/* <summary>                             */  
-/* Forward lazy transform (vertical).    */
-/* </summary>                            */ 
-static void mi_dwt_deinterleave_v(mi_INT32 *a, mi_INT32 *b, mi_INT32 dn, mi_INT32 sn, mi_INT32 x, mi_INT32 cas) {
-    mi_INT32 i = sn;
+/* <summary>                                      */  
+/* Forward lazy transform (vertical) of a strip.  */
+/* </summary>                                     */ 
+static void mi_dwt_deinterleave_v(mi_INT32 *a, mi_INT32 *b, mi_INT32 dn, mi_INT32 sn, mi_INT32 x, mi_INT32 cas, mi_INT32 nb_cols) {
+	mi_INT32 i;
+	size_t l_row_size = (size_t)nb_cols * sizeof(mi_INT32);
+	size_t l_pad_size = (size_t)(mi_DWT_NB_COLS - nb_cols) * sizeof(mi_INT32);
 	mi_INT32 * l_dest = b;
-	mi_INT32 * l_src = a+cas;
+	mi_INT32 * l_src = a + cas * x;
 
-    while (i--) {
-		*l_dest = *l_src;
-		l_dest += x;
-		l_src += 2;
-		} /* b[i*x]=a[2*i+cas]; */
+	/* the unused columns of the last strip are cleared to keep them defined */
+	for (i = 0; i < sn; ++i) {
+		memcpy(l_dest, l_src, l_row_size);
+		if (l_pad_size) {
+			memset(l_dest + nb_cols, 0, l_pad_size);
+		}
+		l_dest += mi_DWT_NB_COLS;
+		l_src += 2 * x;
+	} /* b[i]=a[(2*i+cas)*x]; */
 
-	l_dest = b + sn * x;
-	l_src = a + 1 - cas;
-	
-	i = dn;
-    while (i--) {
-		*l_dest = *l_src;
-		l_dest += x;
-		l_src += 2;
-        } /*b[(sn+i)*x]=a[(2*i+1-cas)];*/
+	l_dest = b + sn * mi_DWT_NB_COLS;
+	l_src = a + (1 - cas) * x;
+
+	for (i = 0; i < dn; ++i) {
+		memcpy(l_dest, l_src, l_row_size);
+		if (l_pad_size) {
+			memset(l_dest + nb_cols, 0, l_pad_size);
+		}
+		l_dest += mi_DWT_NB_COLS;
+		l_src += 2 * x;
+	} /* b[sn+i]=a[(2*i+1-cas)*x]; */
 }
 
 /* <summary>                             */
 /* Inverse lazy transform (horizontal).  */
 /* </summary>                            */
 static void mi_dwt_interleave_h(mi_dwt_t* h, mi_INT32 *a) {
-    mi_INT32 *ai = a;
-    mi_INT32 *bi = h->mem + h->cas;
+    mi_INT32 *ai = a + h->cas;
+    mi_INT32 *bi = h->mem;
     mi_INT32  i	= h->sn;
     while( i-- ) {
-      *bi = *(ai++);
-	  bi += 2;
+      *ai = *(bi++);
+	  ai += 2;
     }
-    ai	= a + h->sn;
-    bi	= h->mem + 1 - h->cas;
+    ai	= a + 1 - h->cas;
     i	= h->dn ;
     while( i-- ) {
-      *bi = *(ai++);
-	  bi += 2;
+      *ai = *(bi++);
+	  ai += 2;
     }
 }
 
-/* <summary>                             */  
-/* Inverse lazy transform (vertical).    */
-/* </summary>                            */ 
-static void mi_dwt_interleave_v(mi_dwt_t* v, mi_INT32 *a, mi_INT32 x) {
-    mi_INT32 *ai = a;
-    mi_INT32 *bi = v->mem + v->cas;
+/* <summary>                                      */  
+/* Inverse lazy transform (vertical) of a strip.  */
+/* </summary>                                     */ 
+static void mi_dwt_interleave_v(mi_dwt_t* v, mi_INT32 *a, mi_INT32 x, mi_INT32 nb_cols) {
+    size_t l_row_size = (size_t)nb_cols * sizeof(mi_INT32);
+    mi_INT32 *ai = a + v->cas * x;
+    mi_INT32 *bi = v->mem;
     mi_INT32  i = v->sn;
     while( i-- ) {
-      *bi = *ai;
-	  bi += 2;
-	  ai += x;
+      memcpy(ai, bi, l_row_size);
+	  bi += mi_DWT_NB_COLS;
+	  ai += 2 * x;
     }
-    ai = a + (v->sn * x);
-    bi = v->mem + 1 - v->cas;
+    ai = a + (1 - v->cas) * x;
     i = v->dn ;
     while( i-- ) {
-      *bi = *ai;
-	  bi += 2;  
-	  ai += x;
+      memcpy(ai, bi, l_row_size);
+	  bi += mi_DWT_NB_COLS;
+	  ai += 2 * x;
     }
 }
 
+static INLINE mi_INT32 mi_dwt_clamp(mi_INT32 i, mi_INT32 n) {
+	return i < 0 ? 0 : (i >= n ? n - 1 : i);
+}
+
+static void mi_dwt_lift_53_run(mi_INT32 * restrict w, const mi_INT32 *l0, const mi_INT32 *l1, mi_INT32 n, mi_INT32 rnd, mi_INT32 shift, mi_BOOL add) {
+	mi_INT32 j;
+	if (add) {
+		for (j = 0; j < n; ++j) w[j] += (l0[j] + l1[j] + rnd) >> shift;
+	} else {
+		for (j = 0; j < n; ++j) w[j] -= (l0[j] + l1[j] + rnd) >> shift;
+	}
+}
+
+#ifdef mi_HAVE_SSE2
+static void mi_dwt_lift_53_run_sse2(mi_INT32 * restrict w, const mi_INT32 *l0, const mi_INT32 *l1, mi_INT32 n, mi_INT32 rnd, mi_INT32 shift, mi_BOOL add) {
+	const __m128i vrnd = _mm_set1_epi32(rnd);
+	const __m128i vshift = _mm_cvtsi32_si128(shift);
+	mi_INT32 j;
+	for (j = 0; j + 4 <= n; j += 4) {
+		__m128i vl = _mm_add_epi32(_mm_add_epi32(_mm_loadu_si128((const __m128i*)(l0 + j)), _mm_loadu_si128((const __m128i*)(l1 + j))), vrnd);
+		__m128i vw = _mm_loadu_si128((const __m128i*)(w + j));
+		vl = _mm_sra_epi32(vl, vshift);
+		_mm_storeu_si128((__m128i*)(w + j), add ? _mm_add_epi32(vw, vl) : _mm_sub_epi32(vw, vl));
+	}
+	mi_dwt_lift_53_run(w + j, l0 + j, l1 + j, n - j, rnd, shift, add);
+}
+#endif
+
+#ifdef mi_HAVE_AVX2
+static mi_TARGET_AVX2 void mi_dwt_lift_53_run_avx2(mi_INT32 * restrict w, const mi_INT32 *l0, const mi_INT32 *l1, mi_INT32 n, mi_INT32 rnd, mi_INT32 shift, mi_BOOL add) {
+	const __m256i vrnd = _mm256_set1_epi32(rnd);
+	const __m128i vshift = _mm_cvtsi32_si128(shift);
+	mi_INT32 j;
+	for (j = 0; j + 8 <= n; j += 8) {
+		__m256i vl = _mm256_add_epi32(_mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(l0 + j)), _mm256_loadu_si256((const __m256i*)(l1 + j))), vrnd);
+		__m256i vw = _mm256_loadu_si256((const __m256i*)(w + j));
+		vl = _mm256_sra_epi32(vl, vshift);
+		_mm256_storeu_si256((__m256i*)(w + j), add ? _mm256_add_epi32(vw, vl) : _mm256_sub_epi32(vw, vl));
+	}
+	mi_dwt_lift_53_run(w + j, l0 + j, l1 + j, n - j, rnd, shift, add);
+}
+#endif
+
+static void mi_dwt_lift_53(mi_INT32 *w, const mi_INT32 *l, mi_INT32 count, mi_INT32 nb_l, mi_INT32 off, mi_INT32 rnd, mi_INT32 shift, mi_BOOL add, mi_INT32 width) {
+	void (*l_run)(mi_INT32 * restrict, const mi_INT32 *, const mi_INT32 *, mi_INT32, mi_INT32, mi_INT32, mi_BOOL) = mi_dwt_lift_53_run;
+	mi_UINT32 l_features = mi_cpu_get_features();
+	mi_INT32 i, i0, i1;
+
+#ifdef mi_HAVE_SSE2
+	if (l_features & mi_CPU_SSE2) {
+		l_run = mi_dwt_lift_53_run_sse2;
+	}
+#endif
+#ifdef mi_HAVE_AVX2
+	if (l_features & mi_CPU_AVX2) {
+		l_run = mi_dwt_lift_53_run_avx2;
+	}
+#endif
+	(void)l_features;
+
+	/* [i0, i1) are the elements whose two neighbours are inside l: */
+	/* there, w and both neighbours are runs of contiguous values   */
+	i0 = mi_int_min(mi_int_max(0, -off), count);
+	i1 = mi_int_max(mi_int_min(count, nb_l - 1 - off), i0);
+
+	for (i = 0; i < i0; ++i) {
+		(*l_run)(w + i*width, l + mi_dwt_clamp(i + off, nb_l)*width, l + mi_dwt_clamp(i + off + 1, nb_l)*width, width, rnd, shift, add);
+	}
+	if (i1 > i0) {
+		(*l_run)(w + i0*width, l + (i0 + off)*width, l + (i0 + off + 1)*width, (i1 - i0)*width, rnd, shift, add);
+	}
+	for (i = i1; i < count; ++i) {
+		(*l_run)(w + i*width, l + mi_dwt_clamp(i + off, nb_l)*width, l + mi_dwt_clamp(i + off + 1, nb_l)*width, width, rnd, shift, add);
+	}
+}
+
+static void mi_dwt_lift_97_run(mi_INT32 * restrict w, const mi_INT32 *l0, const mi_INT32 *l1, mi_INT32 n, mi_INT32 k, mi_BOOL add) {
+	mi_INT32 j;
+	if (add) {
+		for (j = 0; j < n; ++j) w[j] += mi_int_fix_mul(l0[j] + l1[j], k);
+	} else {
+		for (j = 0; j < n; ++j) w[j] -= mi_int_fix_mul(l0[j] + l1[j], k);
+	}
+}
+
+static void mi_dwt_lift_97(mi_INT32 *w, const mi_INT32 *l, mi_INT32 count, mi_INT32 nb_l, mi_INT32 off, mi_INT32 k, mi_BOOL add, mi_INT32 width) {
+	mi_INT32 i, i0, i1;
+
+	/* same split as mi_dwt_lift_53 */
+	i0 = mi_int_min(mi_int_max(0, -off), count);
+	i1 = mi_int_max(mi_int_min(count, nb_l - 1 - off), i0);
+
+	for (i = 0; i < i0; ++i) {
+		mi_dwt_lift_97_run(w + i*width, l + mi_dwt_clamp(i + off, nb_l)*width, l + mi_dwt_clamp(i + off + 1, nb_l)*width, width, k, add);
+	}
+	if (i1 > i0) {
+		mi_dwt_lift_97_run(w + i0*width, l + (i0 + off)*width, l + (i0 + off + 1)*width, (i1 - i0)*width, k, add);
+	}
+	for (i = i1; i < count; ++i) {
+		mi_dwt_lift_97_run(w + i*width, l + mi_dwt_clamp(i + off, nb_l)*width, l + mi_dwt_clamp(i + off + 1, nb_l)*width, width, k, add);
+	}
+}
+
+static void mi_dwt_scale_97(mi_INT32 * restrict w, mi_INT32 n, mi_INT32 k) {
+	mi_INT32 j;
+	for (j = 0; j < n; ++j) w[j] = mi_int_fix_mul(w[j], k);
+}
 
 /* <summary>                            */
 /* Forward 5-3 wavelet transform in 1-D. */
 /* </summary>                           */
-static void mi_dwt_encode_1(mi_INT32 *a, mi_INT32 dn, mi_INT32 sn, mi_INT32 cas) {
-	mi_INT32 i;
-	
+static void mi_dwt_encode_1(mi_INT32 *a, mi_INT32 dn, mi_INT32 sn, mi_INT32 cas, mi_INT32 width) {
+	mi_INT32 *l = a;				/* low-pass elements  */
+	mi_INT32 *h = a + sn * width;	/* high-pass elements */
+	mi_INT32 c;
+
 	if (!cas) {
 		if ((dn > 0) || (sn > 1)) {	/* NEW :  CASE ONE ELEMENT */
-			for (i = 0; i < dn; i++) mi_D(i) -= (mi_S_(i) + mi_S_(i + 1)) >> 1;
-			for (i = 0; i < sn; i++) mi_S(i) += (mi_D_(i - 1) + mi_D_(i) + 2) >> 2;
+			mi_dwt_lift_53(h, l, dn, sn, 0, 0, 1, mi_FALSE, width);
+			mi_dwt_lift_53(l, h, sn, dn, -1, 2, 2, mi_TRUE, width);
 		}
 	} else {
-		if (!sn && dn == 1)		    /* NEW :  CASE ONE ELEMENT */
-			mi_S(0) *= 2;
+		if (!sn && dn == 1) {		    /* NEW :  CASE ONE ELEMENT */
+			for (c = 0; c < width; c++) h[c] *= 2;
+		}
 		else {
-			for (i = 0; i < dn; i++) mi_S(i) -= (mi_DD_(i) + mi_DD_(i - 1)) >> 1;
-			for (i = 0; i < sn; i++) mi_D(i) += (mi_SS_(i) + mi_SS_(i + 1) + 2) >> 2;
+			mi_dwt_lift_53(h, l, dn, sn, -1, 0, 1, mi_FALSE, width);
+			mi_dwt_lift_53(l, h, sn, dn, 0, 2, 2, mi_TRUE, width);
 		}
 	}
 }
@@ -259,67 +595,240 @@ static void mi_dwt_encode_1(mi_INT32 *a, mi_INT32 dn, mi_INT32 sn, mi_INT32 cas)
 /* <summary>                            */
 /* Inverse 5-3 wavelet transform in 1-D. */
 /* </summary>                           */ 
-static void mi_dwt_decode_1_(mi_INT32 *a, mi_INT32 dn, mi_INT32 sn, mi_INT32 cas) {
-	mi_INT32 i;
-	
+static void mi_dwt_decode_1(mi_INT32 *a, mi_INT32 dn, mi_INT32 sn, mi_INT32 cas, mi_INT32 width) {
+	mi_INT32 *l = a;				/* low-pass elements  */
+	mi_INT32 *h = a + sn * width;	/* high-pass elements */
+	mi_INT32 c;
+
 	if (!cas) {
 		if ((dn > 0) || (sn > 1)) { /* NEW :  CASE ONE ELEMENT */
-			for (i = 0; i < sn; i++) mi_S(i) -= (mi_D_(i - 1) + mi_D_(i) + 2) >> 2;
-			for (i = 0; i < dn; i++) mi_D(i) += (mi_S_(i) + mi_S_(i + 1)) >> 1;
+			mi_dwt_lift_53(l, h, sn, dn, -1, 2, 2, mi_FALSE, width);
+			mi_dwt_lift_53(h, l, dn, sn, 0, 0, 1, mi_TRUE, width);
 		}
 	} else {
-		if (!sn  && dn == 1)          /* NEW :  CASE ONE ELEMENT */
-			mi_S(0) /= 2;
+		if (!sn  && dn == 1) {         /* NEW :  CASE ONE ELEMENT */
+			for (c = 0; c < width; c++) h[c] /= 2;
+		}
 		else {
-			for (i = 0; i < sn; i++) mi_D(i) -= (mi_SS_(i) + mi_SS_(i + 1) + 2) >> 2;
-			for (i = 0; i < dn; i++) mi_S(i) += (mi_DD_(i) + mi_DD_(i - 1)) >> 1;
+			mi_dwt_lift_53(l, h, sn, dn, 0, 2, 2, mi_FALSE, width);
+			mi_dwt_lift_53(h, l, dn, sn, -1, 0, 1, mi_TRUE, width);
 		}
 	}
 }
 
-/* <summary>                            */
-/* Inverse 5-3 wavelet transform in 1-D. */
-/* </summary>                           */ 
-static void mi_dwt_decode_1(mi_dwt_t *v) {
-	mi_dwt_decode_1_(v->mem, v->dn, v->sn, v->cas);
-}
-
 /* <summary>                             */
 /* Forward 9-7 wavelet transform in 1-D. */
 /* </summary>                            */
-static void mi_dwt_encode_1_real(mi_INT32 *a, mi_INT32 dn, mi_INT32 sn, mi_INT32 cas) {
-	mi_INT32 i;
+static void mi_dwt_encode_1_real(mi_INT32 *a, mi_INT32 dn, mi_INT32 sn, mi_INT32 cas, mi_INT32 width) {
+	mi_INT32 *l = a;				/* low-pass elements  */
+	mi_INT32 *h = a + sn * width;	/* high-pass elements */
+
 	if (!cas) {
 		if ((dn > 0) || (sn > 1)) {	/* NEW :  CASE ONE ELEMENT */
-			for (i = 0; i < dn; i++)
-				mi_D(i) -= mi_int_fix_mul(mi_S_(i) + mi_S_(i + 1), 12993);
-			for (i = 0; i < sn; i++)
-				mi_S(i) -= mi_int_fix_mul(mi_D_(i - 1) + mi_D_(i), 434);
-			for (i = 0; i < dn; i++)
-				mi_D(i) += mi_int_fix_mul(mi_S_(i) + mi_S_(i + 1), 7233);
-			for (i = 0; i < sn; i++)
-				mi_S(i) += mi_int_fix_mul(mi_D_(i - 1) + mi_D_(i), 3633);
-			for (i = 0; i < dn; i++)
-				mi_D(i) = mi_int_fix_mul(mi_D(i), 5038);	/*5038 */
-			for (i = 0; i < sn; i++)
-				mi_S(i) = mi_int_fix_mul(mi_S(i), 6659);	/*6660 */
+			mi_dwt_lift_97(h, l, dn, sn, 0, 12993, mi_FALSE, width);
+			mi_dwt_lift_97(l, h, sn, dn, -1, 434, mi_FALSE, width);
+			mi_dwt_lift_97(h, l, dn, sn, 0, 7233, mi_TRUE, width);
+			mi_dwt_lift_97(l, h, sn, dn, -1, 3633, mi_TRUE, width);
+			mi_dwt_scale_97(h, dn * width, 5038);	/*5038 */
+			mi_dwt_scale_97(l, sn * width, 6659);	/*6660 */
 		}
 	} else {
 		if ((sn > 0) || (dn > 1)) {	/* NEW :  CASE ONE ELEMENT */
-			for (i = 0; i < dn; i++)
-				mi_S(i) -= mi_int_fix_mul(mi_DD_(i) + mi_DD_(i - 1), 12993);
-			for (i = 0; i < sn; i++)
-				mi_D(i) -= mi_int_fix_mul(mi_SS_(i) + mi_SS_(i + 1), 434);
-			for (i = 0; i < dn; i++)
-				mi_S(i) += mi_int_fix_mul(mi_DD_(i) + mi_DD_(i - 1), 7233);
-			for (i = 0; i < sn; i++)
-				mi_D(i) += mi_int_fix_mul(mi_SS_(i) + mi_SS_(i + 1), 3633);
-			for (i = 0; i < dn; i++)
-				mi_S(i) = mi_int_fix_mul(mi_S(i), 5038);	/*5038 */
-			for (i = 0; i < sn; i++)
-				mi_D(i) = mi_int_fix_mul(mi_D(i), 6659);	/*6660 */
+			mi_dwt_lift_97(h, l, dn, sn, -1, 12993, mi_FALSE, width);
+			mi_dwt_lift_97(l, h, sn, dn, 0, 434, mi_FALSE, width);
+			mi_dwt_lift_97(h, l, dn, sn, -1, 7233, mi_TRUE, width);
+			mi_dwt_lift_97(l, h, sn, dn, 0, 3633, mi_TRUE, width);
+			mi_dwt_scale_97(h, dn * width, 5038);	/*5038 */
+			mi_dwt_scale_97(l, sn * width, 6659);	/*6660 */
+		}
+	}
+}
+
+static mi_BOOL mi_dwt_workers_init(mi_dwt_workers_t* wk, mi_thread_pool_t* tp, size_t mem_size) {
+	mi_UINT32 k;
+
+	wk->group = 00;
+	wk->nb_jobs = 1;
+	if (tp && mi_thread_pool_get_thread_count(tp) > 1) {
+		wk->nb_jobs = (mi_UINT32)mi_thread_pool_get_thread_count(tp);
+		wk->group = mi_job_group_create(tp);
+	}
+	wk->jobs = (mi_dwt_pass_t*)mi_malloc(wk->nb_jobs * sizeof(mi_dwt_pass_t));
+	wk->mems = (void**)mi_calloc(wk->nb_jobs, sizeof(void*));
+	if (!wk->jobs || !wk->mems || (wk->nb_jobs > 1 && !wk->group)) {
+		mi_dwt_workers_clear(wk);
+		return mi_FALSE;
+	}
+	/* mem_size is equal to 0 when numresolutions == 1 but the buffers are */
+	/* not used in that case, so do not error out */
+	if (mem_size != 0) {
+		for (k = 0; k < wk->nb_jobs; ++k) {
+			wk->mems[k] = mi_aligned_malloc(mem_size);
+			if (!wk->mems[k]) {
+				mi_dwt_workers_clear(wk);
+				return mi_FALSE;
+			}
+		}
+	}
+	return mi_TRUE;
+}
+
+static void mi_dwt_workers_clear(mi_dwt_workers_t* wk) {
+	mi_UINT32 k;
+
+	if (wk->mems) {
+		for (k = 0; k < wk->nb_jobs; ++k) {
+			mi_aligned_free(wk->mems[k]);
+		}
+		mi_free(wk->mems);
+		wk->mems = 00;
+	}
+	mi_free(wk->jobs);
+	wk->jobs = 00;
+	mi_job_group_destroy(wk->group);
+	wk->group = 00;
+}
+
+static void mi_dwt_run_pass(mi_dwt_workers_t* wk, mi_job_fn fn, const mi_dwt_pass_t* pass, mi_UINT32 n) {
+	mi_UINT32 k, l_step;
+
+	/* whole strips of columns (and groups of 8 rows for the 9-7 inverse) per job, */
+	/* and not too few of them, the smallest levels being done by a single job     */
+	l_step = (n + wk->nb_jobs - 1) / wk->nb_jobs;
+	l_step = (mi_uint_max(l_step, 4 * mi_DWT_NB_COLS) + mi_DWT_NB_COLS - 1) & ~(mi_UINT32)(mi_DWT_NB_COLS - 1);
+
+	if (wk->nb_jobs == 1 || l_step >= n) {
+		wk->jobs[0] = *pass;
+		wk->jobs[0].mem = wk->mems[0];
+		wk->jobs[0].min_j = 0;
+		wk->jobs[0].max_j = n;
+		fn(&wk->jobs[0], 00);
+		return;
+	}
+
+	for (k = 0; k < wk->nb_jobs && k * l_step < n; ++k) {
+		mi_dwt_pass_t* l_job = &wk->jobs[k];
+		*l_job = *pass;
+		l_job->mem = wk->mems[k];
+		l_job->min_j = k * l_step;
+		l_job->max_j = mi_uint_min(n, (k + 1) * l_step);
+		if (!mi_job_group_submit_job(wk->group, fn, l_job)) {
+			/* the job is run here if it cannot be queued */
+			fn(l_job, 00);
 		}
 	}
+	mi_job_group_wait(wk->group);
+}
+
+static void mi_dwt_run_pass_range(mi_dwt_workers_t* wk, mi_job_fn fn, const mi_dwt_pass_t* pass, mi_UINT32 j0, mi_UINT32 j1, mi_UINT32 stride) {
+	mi_dwt_pass_t l_pass;
+
+	if (j1 <= j0) {
+		return;
+	}
+	l_pass = *pass;
+	l_pass.tiledp = (mi_INT32*)pass->tiledp + (size_t)j0 * stride;
+	l_pass.size = pass->size - j0 * stride;
+	mi_dwt_run_pass(wk, fn, &l_pass, j1 - j0);
+}
+
+static void mi_dwt_set_pass_window(mi_dwt_pass_t* pass, mi_UINT32 l0, mi_UINT32 l1, mi_UINT32 h0, mi_UINT32 h1, mi_UINT32 sn, mi_UINT32 cas) {
+	/* the low-pass element i is the sample 2*i+cas, the high-pass one i the sample 2*i+1-cas */
+	mi_UINT32 l_o0 = 2 * h0 + 1 - cas;
+
+	if (l1 > l0 && (h1 == h0 || 2 * l0 + cas < l_o0)) {
+		l_o0 = 2 * l0 + cas;
+	}
+	pass->sn = (mi_INT32)(l1 - l0);
+	pass->dn = (mi_INT32)(h1 - h0);
+	pass->cas = (mi_INT32)((l_o0 + cas) & 1);
+	pass->l0 = l0;
+	pass->h0 = sn + h0;
+	pass->o0 = l_o0;
+}
+
+static void mi_dwt_encode_h_processor(void* user_data, mi_tls_t* tls) {
+	mi_dwt_pass_t* p = (mi_dwt_pass_t*)user_data;
+	mi_INT32* bj = (mi_INT32*)p->mem;
+	mi_UINT32 j;
+	(void)tls;
+
+	for (j = p->min_j; j < p->max_j; ++j) {
+		mi_INT32* aj = (mi_INT32*)p->tiledp + j * p->w;
+		memcpy(bj, aj, p->rw * sizeof(mi_INT32));
+		mi_dwt_deinterleave_h(bj, aj, p->dn, p->sn, p->cas);
+		(*p->fn) (aj, p->dn, p->sn, p->cas, 1);
+	}
+}
+
+static void mi_dwt_encode_v_processor(void* user_data, mi_tls_t* tls) {
+	mi_dwt_pass_t* p = (mi_dwt_pass_t*)user_data;
+	mi_INT32* bj = (mi_INT32*)p->mem;
+	mi_UINT32 j, k;
+	(void)tls;
+
+	/* the columns are transformed by strips, so that each row of the tile is read and written by whole cache lines */
+	for (j = p->min_j; j < p->max_j; j += mi_DWT_NB_COLS) {
+		mi_UINT32 l_nb_cols = mi_uint_min(mi_DWT_NB_COLS, p->max_j - j);
+		mi_INT32* aj = (mi_INT32*)p->tiledp + j;
+		mi_dwt_deinterleave_v(aj, bj, p->dn, p->sn, (mi_INT32)p->w, p->cas, (mi_INT32)l_nb_cols);
+
+		(*p->fn) (bj, p->dn, p->sn, p->cas, mi_DWT_NB_COLS);
+
+		for (k = 0; k < p->rh; ++k) {
+			memcpy(aj + k * p->w, bj + k * mi_DWT_NB_COLS, l_nb_cols * sizeof(mi_INT32));
+		}
+	}
+}
+
+static void mi_dwt_decode_h_processor(void* user_data, mi_tls_t* tls) {
+	mi_dwt_pass_t* p = (mi_dwt_pass_t*)user_data;
+	mi_INT32* tiledp = (mi_INT32*)p->tiledp;
+	mi_dwt_t h;
+	mi_UINT32 j;
+	(void)tls;
+
+	h.mem = (mi_INT32*)p->mem;
+	h.dn = p->dn;
+	h.sn = p->sn;
+	h.cas = p->cas;
+
+	for(j = p->min_j; j < p->max_j; ++j) {
+		mi_INT32* aj = &tiledp[j * p->w];
+		memcpy(h.mem, aj + p->l0, (size_t)h.sn * sizeof(mi_INT32));
+		memcpy(h.mem + h.sn, aj + p->h0, (size_t)h.dn * sizeof(mi_INT32));
+		(*p->fn)(h.mem, h.dn, h.sn, h.cas, 1);
+		mi_dwt_interleave_h(&h, aj + p->o0);
+	}
+}
+
+static void mi_dwt_decode_v_processor(void* user_data, mi_tls_t* tls) {
+	mi_dwt_pass_t* p = (mi_dwt_pass_t*)user_data;
+	mi_INT32* tiledp = (mi_INT32*)p->tiledp;
+	mi_dwt_t v;
+	mi_UINT32 j;
+	(void)tls;
+
+	v.mem = (mi_INT32*)p->mem;
+	v.dn = p->dn;
+	v.sn = p->sn;
+	v.cas = p->cas;
+
+	/* the columns are transformed by strips, as in mi_dwt_encode_v_processor */
+	for(j = p->min_j; j < p->max_j; j += mi_DWT_NB_COLS){
+		mi_UINT32 k;
+		mi_UINT32 l_nb_cols = mi_uint_min(mi_DWT_NB_COLS, p->max_j - j);
+		for(k = 0; k < (mi_UINT32)(v.sn + v.dn); ++k) {
+			mi_UINT32 l_row = k < (mi_UINT32)v.sn ? p->l0 + k : p->h0 + k - (mi_UINT32)v.sn;
+			memcpy(&v.mem[k * mi_DWT_NB_COLS], &tiledp[l_row * p->w + j], l_nb_cols * sizeof(mi_INT32));
+			if (l_nb_cols < mi_DWT_NB_COLS) {
+				/* keep the unused columns of the last strip defined */
+				memset(&v.mem[k * mi_DWT_NB_COLS + l_nb_cols], 0, (mi_DWT_NB_COLS - l_nb_cols) * sizeof(mi_INT32));
+			}
+		}
+		(*p->fn)(v.mem, v.dn, v.sn, v.cas, mi_DWT_NB_COLS);
+		mi_dwt_interleave_v(&v, &tiledp[p->o0 * p->w + j], (mi_INT32)p->w, (mi_INT32)l_nb_cols);
+	}
 }
 
 static void mi_dwt_encode_stepsize(mi_INT32 stepsize, mi_INT32 numbps, mi_stepsize_t *bandno_stepsize) {
@@ -340,12 +849,9 @@ static void mi_dwt_encode_stepsize(mi_INT32 stepsize, mi_INT32 numbps, mi_stepsi
 /* <summary>                            */
 /* Forward wavelet transform in 2-D. άС任νʣ˵5/39/7 */
 /* </summary>                           */
-static INLINE mi_BOOL mi_dwt_encode_procedure(mi_tcd_tilecomp_t * tilec,void (*p_function)(mi_INT32 *, mi_INT32,mi_INT32,mi_INT32) )
+static INLINE mi_BOOL mi_dwt_encode_procedure(mi_thread_pool_t * tp, mi_tcd_tilecomp_t * tilec,void (*p_function)(mi_INT32 *, mi_INT32,mi_INT32,mi_INT32,mi_INT32) )
 {
-	mi_INT32 i, j, k;
-	mi_INT32 *a = 00;//Ƭԭʼ
-	mi_INT32 *aj = 00;
-	mi_INT32 *bj = 00;//ǰķֱʵһе
+	mi_INT32 i;
 	mi_INT32 w;//Ƭ
 	mi_INT32 l;//һСֽ
 
@@ -356,20 +862,26 @@ static INLINE mi_BOOL mi_dwt_encode_procedure(mi_tcd_tilecomp_t * tilec,void (*p
 	mi_tcd_resolution_t * l_cur_res = 0;//lӦǸֱʵϢǰֱͼ
 	mi_tcd_resolution_t * l_last_res = 0;//һֱʼͼϢһֱʣ
 
+	mi_dwt_workers_t l_workers;
+	mi_dwt_pass_t l_pass;
+
 	w = tilec->x1-tilec->x0;
 	l = (mi_INT32)tilec->numresolutions-1;
-	a = tilec->data;
 
 	l_cur_res = tilec->resolutions + l;
 	l_last_res = l_cur_res - 1;
 
-	l_data_size = mi_dwt_max_resolution( tilec->resolutions,tilec->numresolutions) * (mi_UINT32)sizeof(mi_INT32);
-	bj = (mi_INT32*)mi_malloc((size_t)l_data_size);
-	/* l_data_size is equal to 0 when numresolutions == 1 but bj is not used */
-	/* in that case, so do not error out */
-	if (l_data_size != 0 && ! bj) {
+	/* a strip of the vertical pass holds mi_DWT_NB_COLS values per element */
+	l_data_size = mi_dwt_max_resolution( tilec->resolutions,tilec->numresolutions) * (mi_UINT32)sizeof(mi_INT32) * mi_DWT_NB_COLS;
+	if (!mi_dwt_workers_init(&l_workers, tp, (size_t)l_data_size)) {
 		return mi_FALSE;
 	}
+
+	memset(&l_pass, 0, sizeof(l_pass));
+	l_pass.fn = p_function;
+	l_pass.tiledp = tilec->data;//Ƭԭʼ
+	l_pass.w = (mi_UINT32)w;
+
 	i = l;
 
 	while (i--) {
@@ -377,8 +889,6 @@ static INLINE mi_BOOL mi_dwt_encode_procedure(mi_tcd_tilecomp_t * tilec,void (*p
 		mi_INT32 rh1;		/* height of the resolution level once lower than computed one    һǸֱʵĸߣ                                     */
 		mi_INT32 cas_col;	/* 0 = non inversion on horizontal filtering 1 = inversion between low-pass and high-pass filtering */
 		mi_INT32 cas_row;	/* 0 = non inversion on vertical filtering 1 = inversion between low-pass and high-pass filtering   */
-		mi_INT32 dn; //ǰֱʵĸ/ȥһֱʵĸ/
-		mi_INT32 sn;//һֱʵĸ/
 
 		rw  = l_cur_res->x1 - l_cur_res->x0;
 		rh  = l_cur_res->y1 - l_cur_res->y0;
@@ -388,50 +898,42 @@ static INLINE mi_BOOL mi_dwt_encode_procedure(mi_tcd_tilecomp_t * tilec,void (*p
 		cas_row = l_cur_res->x0 & 1;
 		cas_col = l_cur_res->y0 & 1;
 
-		sn = rh1;
-		dn = rh - rh1;
-		for (j = 0; j < rw; ++j) {
-			aj = a + j;
-			for (k = 0; k < rh; ++k) {
-				bj[k] = aj[k*w];
-			}
+		l_pass.rw = (mi_UINT32)rw;
+		l_pass.rh = (mi_UINT32)rh;
 
-			(*p_function) (bj, dn, sn, cas_col);
+		/* the passes return once all their jobs are done, so the horizontal one */
+		/* sees the whole result of the vertical one                              */
+		l_pass.sn = rh1;//һֱʵĸ/
+		l_pass.dn = rh - rh1;//ǰֱʵĸ/ȥһֱʵĸ/
+		l_pass.cas = cas_col;
+		mi_dwt_run_pass(&l_workers, mi_dwt_encode_v_processor, &l_pass, (mi_UINT32)rw);
 
-			mi_dwt_deinterleave_v(bj, aj, dn, sn, w, cas_col);
-		}
-
-		sn = rw1;
-		dn = rw - rw1;
-
-		for (j = 0; j < rh; j++) {
-			aj = a + j * w;
-			for (k = 0; k < rw; k++)  bj[k] = aj[k];
-			(*p_function) (bj, dn, sn, cas_row);
-			mi_dwt_deinterleave_h(bj, aj, dn, sn, cas_row);
-		}
+		l_pass.sn = rw1;
+		l_pass.dn = rw - rw1;
+		l_pass.cas = cas_row;
+		mi_dwt_run_pass(&l_workers, mi_dwt_encode_h_processor, &l_pass, (mi_UINT32)rh);
 
 		l_cur_res = l_last_res;
 
 		--l_last_res;
 	}
 
-	mi_free(bj);
+	mi_dwt_workers_clear(&l_workers);
 	return mi_TRUE;
 }
 
 /* Forward 5-3 wavelet transform in 2-D. */
 /* </summary>                           */
-mi_BOOL mi_dwt_encode(mi_tcd_tilecomp_t * tilec)
+mi_BOOL mi_dwt_encode(mi_thread_pool_t * tp, mi_tcd_tilecomp_t * tilec)
 {
-	return mi_dwt_encode_procedure(tilec,mi_dwt_encode_1);
+	return mi_dwt_encode_procedure(tp,tilec,mi_dwt_encode_1);
 }
 
 /* <summary>                            */
 /* Inverse 5-3 wavelet transform in 2-D. */
 /* </summary>                           */
-mi_BOOL mi_dwt_decode(mi_tcd_tilecomp_t* tilec, mi_UINT32 numres) {
-	return mi_dwt_decode_tile(tilec, numres, &mi_dwt_decode_1);
+mi_BOOL mi_dwt_decode(mi_thread_pool_t* tp, mi_tcd_tilecomp_t* tilec, mi_UINT32 numres) {
+	return mi_dwt_decode_tile(tp, tilec, numres, &mi_dwt_decode_1);
 }
 
 
@@ -456,9 +958,9 @@ mi_FLOAT64 mi_dwt_getnorm(mi_UINT32 level, mi_UINT32 orient) {
 /* <summary>                             */
 /* Forward 9-7 wavelet transform in 2-D. */
 /* </summary>                            */
-mi_BOOL mi_dwt_encode_real(mi_tcd_tilecomp_t * tilec)
+mi_BOOL mi_dwt_encode_real(mi_thread_pool_t * tp, mi_tcd_tilecomp_t * tilec)
 {
-	return mi_dwt_encode_procedure(tilec,mi_dwt_encode_1_real);
+	return mi_dwt_encode_procedure(tp,tilec,mi_dwt_encode_1_real);
 }
 
 /* <summary>                          */
@@ -516,70 +1018,74 @@ static mi_UINT32 mi_dwt_max_resolution(mi_tcd_resolution_t* restrict r, mi_UINT3
 /* <summary>                            */
 /* Inverse wavelet transform in 2-D.     */
 /* </summary>                           */
-static mi_BOOL mi_dwt_decode_tile(mi_tcd_tilecomp_t* tilec, mi_UINT32 numres, DWT1DFN dwt_1D) {
-	mi_dwt_t h;
-	mi_dwt_t v;
+static mi_BOOL mi_dwt_decode_tile(mi_thread_pool_t* tp, mi_tcd_tilecomp_t* tilec, mi_UINT32 numres, DWT1DFN dwt_1D) {
+	mi_dwt_workers_t l_workers;
+	mi_dwt_pass_t l_pass;
 
 	mi_tcd_resolution_t* tr = tilec->resolutions;
 
 	mi_UINT32 rw = (mi_UINT32)(tr->x1 - tr->x0);	/* width of the resolution level computed */
 	mi_UINT32 rh = (mi_UINT32)(tr->y1 - tr->y0);	/* height of the resolution level computed */
 
-	mi_UINT32 w = (mi_UINT32)(tilec->x1 - tilec->x0);
-	
 	if (numres == 1U) {
 		return mi_TRUE;
 	}
-	h.mem = (mi_INT32*)mi_aligned_malloc(mi_dwt_max_resolution(tr, numres) * sizeof(mi_INT32));
-	if (! h.mem){
+	/* a strip of the vertical pass holds mi_DWT_NB_COLS values per element */
+	if (!mi_dwt_workers_init(&l_workers, tp, mi_dwt_max_resolution(tr, numres) * sizeof(mi_INT32) * mi_DWT_NB_COLS)) {
 		/* FIXME event manager error callback */
 		return mi_FALSE;
 	}
 
-	v.mem = h.mem;
+	memset(&l_pass, 0, sizeof(l_pass));
+	l_pass.fn = dwt_1D;
+	l_pass.tiledp = tilec->data;
+	l_pass.w = (mi_UINT32)(tilec->x1 - tilec->x0);
 
 	while( --numres) {
-		mi_INT32 * restrict tiledp = tilec->data;
-		mi_UINT32 j;
+		mi_UINT32 h_sn = rw;
+		mi_UINT32 v_sn = rh;
+		mi_tcd_resolution_t* lr = tr;	/* resolution level below */
 
 		++tr;
-		h.sn = (mi_INT32)rw;
-		v.sn = (mi_INT32)rh;
 
 		rw = (mi_UINT32)(tr->x1 - tr->x0);
 		rh = (mi_UINT32)(tr->y1 - tr->y0);
 
-		h.dn = (mi_INT32)(rw - (mi_UINT32)h.sn);
-		h.cas = tr->x0 % 2;
+		l_pass.rw = rw;
+		l_pass.rh = rh;
 
-		for(j = 0; j < rh; ++j) {
-			mi_dwt_interleave_h(&h, &tiledp[j*w]);
-			(dwt_1D)(&h);
-			memcpy(&tiledp[j*w], h.mem, rw * sizeof(mi_INT32));
+		/* the rows of the windows of the low-pass and high-pass subbands (bands[1] is LH) */
+		mi_dwt_set_pass_window(&l_pass, lr->win_x0, lr->win_x1, tr->bands[0].win_x0, tr->bands[0].win_x1, h_sn, (mi_UINT32)tr->x0 & 1);
+		if (lr->win_y1 == v_sn + tr->bands[1].win_y0) {
+			mi_dwt_run_pass_range(&l_workers, mi_dwt_decode_h_processor, &l_pass, lr->win_y0, v_sn + tr->bands[1].win_y1, l_pass.w);
+		} else {
+			mi_dwt_run_pass_range(&l_workers, mi_dwt_decode_h_processor, &l_pass, lr->win_y0, lr->win_y1, l_pass.w);
+			mi_dwt_run_pass_range(&l_workers, mi_dwt_decode_h_processor, &l_pass, v_sn + tr->bands[1].win_y0, v_sn + tr->bands[1].win_y1, l_pass.w);
 		}
 
-		v.dn = (mi_INT32)(rh - (mi_UINT32)v.sn);
-		v.cas = tr->y0 % 2;
-
-		for(j = 0; j < rw; ++j){
-			mi_UINT32 k;
-			mi_dwt_interleave_v(&v, &tiledp[j], (mi_INT32)w);
-			(dwt_1D)(&v);
-			for(k = 0; k < rh; ++k) {
-				tiledp[k * w + j] = v.mem[k];
-			}
-		}
+		/* the columns of the window */
+		mi_dwt_set_pass_window(&l_pass, lr->win_y0, lr->win_y1, tr->bands[1].win_y0, tr->bands[1].win_y1, v_sn, (mi_UINT32)tr->y0 & 1);
+		mi_dwt_run_pass_range(&l_workers, mi_dwt_decode_v_processor, &l_pass, tr->win_x0, tr->win_x1, 1);
 	}
-	mi_aligned_free(h.mem);
+	mi_dwt_workers_clear(&l_workers);
 	return mi_TRUE;
 }
 
-static void mi_v4dwt_interleave_h(mi_v4dwt_t* restrict w, mi_FLOAT32* restrict a, mi_INT32 x, mi_INT32 size){
+static void mi_v4dwt_interleave_h(mi_v4dwt_t* restrict w, mi_FLOAT32* restrict a, mi_INT32 x, mi_INT32 size, mi_INT32 h_off){
 	mi_FLOAT32* restrict bi = (mi_FLOAT32*) (w->wavelet + w->cas);
 	mi_INT32 count = w->sn;
 	mi_INT32 i, k;
+#ifdef mi_HAVE_SSE2
+	mi_BOOL l_sse2 = (mi_cpu_get_features() & mi_CPU_SSE2) != 0;
+#endif
 
 	for(k = 0; k < 2; ++k){
+#ifdef mi_HAVE_SSE2
+		if ( l_sse2 && count + 3 * x < size ) {
+			mi_v4dwt_interleave_h_sse2(bi, a, x, count);
+		}
+		else
+#endif
 		if ( count + 3 * x < size && ((size_t) a & 0x0f) == 0 && ((size_t) bi & 0x0f) == 0 && (x & 0x0f) == 0 ) {
 			/* Fast code path */
 			for(i = 0; i < count; ++i){
@@ -611,13 +1117,13 @@ static void mi_v4dwt_interleave_h(mi_v4dwt_t* restrict w, mi_FLOAT32* restrict a
 		}
 
 		bi = (mi_FLOAT32*) (w->wavelet + 1 - w->cas);
-		a += w->sn;
-		size -= w->sn;
+		a += h_off;
+		size -= h_off;
 		count = w->dn;
 	}
 }
 
-static void mi_v4dwt_interleave_v(mi_v4dwt_t* restrict v , mi_FLOAT32* restrict a , mi_INT32 x, mi_INT32 nb_elts_read){
+static void mi_v4dwt_interleave_v(mi_v4dwt_t* restrict v , mi_FLOAT32* restrict a , mi_INT32 x, mi_INT32 h_off, mi_INT32 nb_elts_read){
 	mi_v4_t* restrict bi = v->wavelet + v->cas;
 	mi_INT32 i;
 
@@ -625,7 +1131,7 @@ static void mi_v4dwt_interleave_v(mi_v4dwt_t* restrict v , mi_FLOAT32* restrict
 		memcpy(&bi[i*2], &a[i*x], (size_t)nb_elts_read * sizeof(mi_FLOAT32));
 	}
 
-	a += v->sn * x;
+	a += h_off * x;
 	bi = v->wavelet + 1 - v->cas;
 
 	for(i = 0; i < v->dn; ++i){
@@ -700,12 +1206,190 @@ static void mi_v4dwt_decode_step2(mi_v4_t* l, mi_v4_t* w, mi_INT32 k, mi_INT32 m
 }
 
 
+#ifdef mi_HAVE_SSE2
+static void mi_v4dwt_interleave_h_sse2(mi_FLOAT32* restrict bi, const mi_FLOAT32* restrict a, mi_INT32 x, mi_INT32 count)
+{
+	mi_INT32 i;
+
+	/* 4 samples of the 4 rows give 4 interleaved elements */
+	for(i = 0; i + 4 <= count; i += 4){
+		__m128 r0 = _mm_loadu_ps(a + i);
+		__m128 r1 = _mm_loadu_ps(a + i + x);
+		__m128 r2 = _mm_loadu_ps(a + i + 2 * x);
+		__m128 r3 = _mm_loadu_ps(a + i + 3 * x);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_store_ps(bi + i*8     , r0);
+		_mm_store_ps(bi + i*8 +  8, r1);
+		_mm_store_ps(bi + i*8 + 16, r2);
+		_mm_store_ps(bi + i*8 + 24, r3);
+	}
+	for(; i < count; ++i){
+		bi[i*8    ] = a[i];
+		bi[i*8 + 1] = a[i + x];
+		bi[i*8 + 2] = a[i + 2 * x];
+		bi[i*8 + 3] = a[i + 3 * x];
+	}
+}
+
+/* The SSE2 and AVX2 steps do the operations of the scalar ones in the same order
+   (and without FMA), so that their results are bit-exact. */
+static void mi_v4dwt_decode_step1_sse2(mi_v4_t* w, mi_INT32 count, const mi_FLOAT32 c)
+{
+	__m128* restrict vw = (__m128*) w;
+	__m128 vc = _mm_set1_ps(c);
+	mi_INT32 i;
+	for(i = 0; i < count; ++i){
+		vw[i*2] = _mm_mul_ps(vw[i*2], vc);
+	}
+}
+
+static void mi_v4dwt_decode_step2_sse2(mi_v4_t* l, mi_v4_t* w, mi_INT32 k, mi_INT32 m, mi_FLOAT32 c)
+{
+	__m128* restrict vw = (__m128*) w;
+	__m128 vc = _mm_set1_ps(c);
+	__m128 tmp1 = *(__m128*) l;
+	mi_INT32 i;
+	for(i = 0; i < m; ++i){
+		__m128 tmp3 = vw[0];
+		vw[-1] = _mm_add_ps(vw[-1], _mm_mul_ps(_mm_add_ps(tmp1, tmp3), vc));
+		tmp1 = tmp3;
+		vw += 2;
+	}
+	if(m < k){
+		vc = _mm_mul_ps(tmp1, _mm_add_ps(vc, vc));
+		for(; m < k; ++m){
+			vw[-1] = _mm_add_ps(vw[-1], vc);
+			vw += 2;
+		}
+	}
+}
+#endif
+
+#ifdef mi_HAVE_AVX2
+static mi_TARGET_AVX2 void mi_v8dwt_interleave_h_avx2(mi_v8dwt_t* restrict w, const mi_FLOAT32* restrict a, mi_INT32 x, mi_INT32 h_off)
+{
+	mi_FLOAT32* restrict bi = (mi_FLOAT32*) (w->wavelet + w->cas);
+	mi_INT32 count = w->sn;
+	mi_INT32 i, k;
+
+	for(k = 0; k < 2; ++k){
+		/* 4 samples of the 8 rows give 4 interleaved elements */
+		for(i = 0; i + 4 <= count; i += 4){
+			__m128 r0 = _mm_loadu_ps(a + i);
+			__m128 r1 = _mm_loadu_ps(a + i + x);
+			__m128 r2 = _mm_loadu_ps(a + i + 2 * x);
+			__m128 r3 = _mm_loadu_ps(a + i + 3 * x);
+			__m128 r4 = _mm_loadu_ps(a + i + 4 * x);
+			__m128 r5 = _mm_loadu_ps(a + i + 5 * x);
+			__m128 r6 = _mm_loadu_ps(a + i + 6 * x);
+			__m128 r7 = _mm_loadu_ps(a + i + 7 * x);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_MM_TRANSPOSE4_PS(r4, r5, r6, r7);
+			_mm256_storeu_ps(bi + i*16     , _mm256_insertf128_ps(_mm256_castps128_ps256(r0), r4, 1));
+			_mm256_storeu_ps(bi + i*16 + 16, _mm256_insertf128_ps(_mm256_castps128_ps256(r1), r5, 1));
+			_mm256_storeu_ps(bi + i*16 + 32, _mm256_insertf128_ps(_mm256_castps128_ps256(r2), r6, 1));
+			_mm256_storeu_ps(bi + i*16 + 48, _mm256_insertf128_ps(_mm256_castps128_ps256(r3), r7, 1));
+		}
+		for(; i < count; ++i){
+			mi_INT32 r;
+			for(r = 0; r < 8; ++r){
+				bi[i*16 + r] = a[i + r * x];
+			}
+		}
+
+		bi = (mi_FLOAT32*) (w->wavelet + 1 - w->cas);
+		a += h_off;
+		count = w->dn;
+	}
+}
+
+static mi_TARGET_AVX2 void mi_v8dwt_interleave_v_avx2(mi_v8dwt_t* restrict v, const mi_FLOAT32* restrict a, mi_INT32 x, mi_INT32 h_off)
+{
+	mi_v8_t* restrict bi = v->wavelet + v->cas;
+	mi_INT32 i;
+
+	for(i = 0; i < v->sn; ++i){
+		_mm256_storeu_ps(bi[i*2].f, _mm256_loadu_ps(&a[i*x]));
+	}
+
+	a += h_off * x;
+	bi = v->wavelet + 1 - v->cas;
+
+	for(i = 0; i < v->dn; ++i){
+		_mm256_storeu_ps(bi[i*2].f, _mm256_loadu_ps(&a[i*x]));
+	}
+}
+
+static mi_TARGET_AVX2 void mi_v8dwt_decode_step1_avx2(mi_v8_t* w, mi_INT32 count, const mi_FLOAT32 c)
+{
+	__m256 vc = _mm256_set1_ps(c);
+	mi_INT32 i;
+	for(i = 0; i < count; ++i){
+		mi_FLOAT32* fw = w[i*2].f;
+		_mm256_storeu_ps(fw, _mm256_mul_ps(_mm256_loadu_ps(fw), vc));
+	}
+}
+
+static mi_TARGET_AVX2 void mi_v8dwt_decode_step2_avx2(mi_v8_t* l, mi_v8_t* w, mi_INT32 k, mi_INT32 m, mi_FLOAT32 c)
+{
+	mi_FLOAT32* fw = w->f;
+	__m256 vc = _mm256_set1_ps(c);
+	__m256 tmp1 = _mm256_loadu_ps(l->f);
+	mi_INT32 i;
+	for(i = 0; i < m; ++i){
+		__m256 tmp3 = _mm256_loadu_ps(fw);
+		_mm256_storeu_ps(fw - 8, _mm256_add_ps(_mm256_loadu_ps(fw - 8), _mm256_mul_ps(_mm256_add_ps(tmp1, tmp3), vc)));
+		tmp1 = tmp3;
+		fw += 16;
+	}
+	if(m < k){
+		vc = _mm256_mul_ps(tmp1, _mm256_add_ps(vc, vc));
+		for(; m < k; ++m){
+			_mm256_storeu_ps(fw - 8, _mm256_add_ps(_mm256_loadu_ps(fw - 8), vc));
+			fw += 16;
+		}
+	}
+}
+
+static mi_TARGET_AVX2 void mi_v8dwt_decode_avx2(mi_v8dwt_t* restrict dwt)
+{
+	mi_INT32 a, b;
+	if(dwt->cas == 0) {
+		if(!((dwt->dn > 0) || (dwt->sn > 1))){
+			return;
+		}
+		a = 0;
+		b = 1;
+	}else{
+		if(!((dwt->sn > 0) || (dwt->dn > 1))) {
+			return;
+		}
+		a = 1;
+		b = 0;
+	}
+	mi_v8dwt_decode_step1_avx2(dwt->wavelet+a, dwt->sn, mi_K);
+	mi_v8dwt_decode_step1_avx2(dwt->wavelet+b, dwt->dn, mi_c13318);
+	mi_v8dwt_decode_step2_avx2(dwt->wavelet+b, dwt->wavelet+a+1, dwt->sn, mi_int_min(dwt->sn, dwt->dn-a), mi_dwt_delta);
+	mi_v8dwt_decode_step2_avx2(dwt->wavelet+a, dwt->wavelet+b+1, dwt->dn, mi_int_min(dwt->dn, dwt->sn-b), mi_dwt_gamma);
+	mi_v8dwt_decode_step2_avx2(dwt->wavelet+b, dwt->wavelet+a+1, dwt->sn, mi_int_min(dwt->sn, dwt->dn-a), mi_dwt_beta);
+	mi_v8dwt_decode_step2_avx2(dwt->wavelet+a, dwt->wavelet+b+1, dwt->dn, mi_int_min(dwt->dn, dwt->sn-b), mi_dwt_alpha);
+}
+#endif
+
 /* <summary>                             */
 /* Inverse 9-7 wavelet transform in 1-D. */
 /* </summary>                            */
 static void mi_v4dwt_decode(mi_v4dwt_t* restrict dwt)
 {
 	mi_INT32 a, b;
+	void (*l_step1)(mi_v4_t*, mi_INT32, const mi_FLOAT32) = mi_v4dwt_decode_step1;
+	void (*l_step2)(mi_v4_t*, mi_v4_t*, mi_INT32, mi_INT32, mi_FLOAT32) = mi_v4dwt_decode_step2;
+#ifdef mi_HAVE_SSE2
+	if (mi_cpu_get_features() & mi_CPU_SSE2) {
+		l_step1 = mi_v4dwt_decode_step1_sse2;
+		l_step2 = mi_v4dwt_decode_step2_sse2;
+	}
+#endif
 	if(dwt->cas == 0) {
 		if(!((dwt->dn > 0) || (dwt->sn > 1))){
 			return;
@@ -719,113 +1403,214 @@ static void mi_v4dwt_decode(mi_v4dwt_t* restrict dwt)
 		a = 1;
 		b = 0;
 	}
-	mi_v4dwt_decode_step1(dwt->wavelet+a, dwt->sn, mi_K);
-	mi_v4dwt_decode_step1(dwt->wavelet+b, dwt->dn, mi_c13318);
-	mi_v4dwt_decode_step2(dwt->wavelet+b, dwt->wavelet+a+1, dwt->sn, mi_int_min(dwt->sn, dwt->dn-a), mi_dwt_delta);
-	mi_v4dwt_decode_step2(dwt->wavelet+a, dwt->wavelet+b+1, dwt->dn, mi_int_min(dwt->dn, dwt->sn-b), mi_dwt_gamma);
-	mi_v4dwt_decode_step2(dwt->wavelet+b, dwt->wavelet+a+1, dwt->sn, mi_int_min(dwt->sn, dwt->dn-a), mi_dwt_beta);
-	mi_v4dwt_decode_step2(dwt->wavelet+a, dwt->wavelet+b+1, dwt->dn, mi_int_min(dwt->dn, dwt->sn-b), mi_dwt_alpha);
+	l_step1(dwt->wavelet+a, dwt->sn, mi_K);
+	l_step1(dwt->wavelet+b, dwt->dn, mi_c13318);
+	l_step2(dwt->wavelet+b, dwt->wavelet+a+1, dwt->sn, mi_int_min(dwt->sn, dwt->dn-a), mi_dwt_delta);
+	l_step2(dwt->wavelet+a, dwt->wavelet+b+1, dwt->dn, mi_int_min(dwt->dn, dwt->sn-b), mi_dwt_gamma);
+	l_step2(dwt->wavelet+b, dwt->wavelet+a+1, dwt->sn, mi_int_min(dwt->sn, dwt->dn-a), mi_dwt_beta);
+	l_step2(dwt->wavelet+a, dwt->wavelet+b+1, dwt->dn, mi_int_min(dwt->dn, dwt->sn-b), mi_dwt_alpha);
 }
 
 
-/* <summary>                             */
-/* Inverse 9-7 wavelet transform in 2-D. */
-/* </summary>                            */
-mi_BOOL mi_dwt_decode_real(mi_tcd_tilecomp_t* restrict tilec, mi_UINT32 numres)
+static void mi_dwt_decode_h_real_processor(void* user_data, mi_tls_t* tls)
 {
+	mi_dwt_pass_t* p = (mi_dwt_pass_t*)user_data;
+	mi_FLOAT32 * restrict aj = (mi_FLOAT32*) p->tiledp + p->min_j * p->w;
+	mi_UINT32 bufsize = p->size - p->min_j * p->w;
+	mi_UINT32 w = p->w;
+	mi_INT32 nb = p->sn + p->dn;	/* number of samples written per row */
+	mi_INT32 l0 = (mi_INT32)p->l0;
+	mi_INT32 h_off = (mi_INT32)(p->h0 - p->l0);
+	mi_INT32 j = (mi_INT32)(p->max_j - p->min_j);
 	mi_v4dwt_t h;
-	mi_v4dwt_t v;
-
-	mi_tcd_resolution_t* res = tilec->resolutions;
+#ifdef mi_HAVE_AVX2
+	mi_v8dwt_t h8;
+#endif
+	(void)tls;
+
+	h.wavelet = (mi_v4_t*) p->mem;
+	h.dn = p->dn;
+	h.sn = p->sn;
+	h.cas = p->cas;
+
+#ifdef mi_HAVE_AVX2
+	if (mi_cpu_get_features() & mi_CPU_AVX2) {
+		/* the 8-wide elements share the buffer of the 4-wide ones */
+		h8.wavelet = (mi_v8_t*) p->mem;
+		h8.sn = h.sn;
+		h8.dn = h.dn;
+		h8.cas = h.cas;
+		for(; j > 7; j -= 8) {
+			mi_INT32 k, r;
+			mi_FLOAT32* restrict ao = aj + p->o0;
+			mi_v8dwt_interleave_h_avx2(&h8, aj + l0, (mi_INT32)w, h_off);
+			mi_v8dwt_decode_avx2(&h8);
+
+			for(k = nb; --k >= 0;){
+				for(r = 0; r < 8; ++r){
+					ao[k+(mi_INT32)w*r] = h8.wavelet[k].f[r];
+				}
+			}
 
-	mi_UINT32 rw = (mi_UINT32)(res->x1 - res->x0);	/* width of the resolution level computed */
-	mi_UINT32 rh = (mi_UINT32)(res->y1 - res->y0);	/* height of the resolution level computed */
+			aj += w*8;
+			bufsize -= w*8;
+		}
+	}
+#endif
+	for(; j > 3; j -= 4) {
+		mi_FLOAT32* restrict ao = aj + p->o0;
+		mi_INT32 k;
+		mi_v4dwt_interleave_h(&h, aj + l0, (mi_INT32)w, (mi_INT32)bufsize - l0, h_off);
+		mi_v4dwt_decode(&h);
+
+		for(k = nb; --k >= 0;){
+			ao[k               ] = h.wavelet[k].f[0];
+			ao[k+(mi_INT32)w  ] = h.wavelet[k].f[1];
+			ao[k+(mi_INT32)w*2] = h.wavelet[k].f[2];
+			ao[k+(mi_INT32)w*3] = h.wavelet[k].f[3];
+		}
 
-	mi_UINT32 w = (mi_UINT32)(tilec->x1 - tilec->x0);
+		aj += w*4;
+		bufsize -= w*4;
+	}
 
-	h.wavelet = (mi_v4_t*) mi_aligned_malloc((mi_dwt_max_resolution(res, numres)+5) * sizeof(mi_v4_t));
-	if (!h.wavelet) {
-		/* FIXME event manager error callback */
-		return mi_FALSE;
+	/* only the last job of a pass has rows left here */
+	if (j > 0) {
+		mi_FLOAT32* restrict ao = aj + p->o0;
+		mi_INT32 k;
+		mi_v4dwt_interleave_h(&h, aj + l0, (mi_INT32)w, (mi_INT32)bufsize - l0, h_off);
+		mi_v4dwt_decode(&h);
+		for(k = nb; --k >= 0;){
+			switch(j) {
+				case 3: ao[k+(mi_INT32)w*2] = h.wavelet[k].f[2];
+				case 2: ao[k+(mi_INT32)w  ] = h.wavelet[k].f[1];
+				case 1: ao[k               ] = h.wavelet[k].f[0];
+			}
+		}
 	}
-	v.wavelet = h.wavelet;
+}
 
-	while( --numres) {
-		mi_FLOAT32 * restrict aj = (mi_FLOAT32*) tilec->data;
-		mi_UINT32 bufsize = (mi_UINT32)((tilec->x1 - tilec->x0) * (tilec->y1 - tilec->y0));
-		mi_INT32 j;
+static void mi_dwt_decode_v_real_processor(void* user_data, mi_tls_t* tls)
+{
+	mi_dwt_pass_t* p = (mi_dwt_pass_t*)user_data;
+	mi_FLOAT32 * restrict aj = (mi_FLOAT32*) p->tiledp + p->min_j;
+	mi_UINT32 w = p->w;
+	mi_UINT32 nb = (mi_UINT32)(p->sn + p->dn);	/* number of samples written per column */
+	mi_UINT32 l0 = p->l0 * w;
+	mi_UINT32 o0 = p->o0 * w;
+	mi_INT32 h_off = (mi_INT32)(p->h0 - p->l0);
+	mi_INT32 j = (mi_INT32)(p->max_j - p->min_j);
+	mi_v4dwt_t v;
+#ifdef mi_HAVE_AVX2
+	mi_v8dwt_t v8;
+#endif
+	(void)tls;
+
+	v.wavelet = (mi_v4_t*) p->mem;
+	v.dn = p->dn;
+	v.sn = p->sn;
+	v.cas = p->cas;
+
+#ifdef mi_HAVE_AVX2
+	if (mi_cpu_get_features() & mi_CPU_AVX2) {
+		v8.wavelet = (mi_v8_t*) p->mem;
+		v8.sn = v.sn;
+		v8.dn = v.dn;
+		v8.cas = v.cas;
+		for(; j > 7; j -= 8){
+			mi_UINT32 k;
 
-		h.sn = (mi_INT32)rw;
-		v.sn = (mi_INT32)rh;
+			mi_v8dwt_interleave_v_avx2(&v8, aj + l0, (mi_INT32)w, h_off);
+			mi_v8dwt_decode_avx2(&v8);
 
-		++res;
+			for(k = 0; k < nb; ++k){
+				memcpy(&aj[o0 + k*w], &v8.wavelet[k], 8 * sizeof(mi_FLOAT32));
+			}
+			aj += 8;
+		}
+	}
+#endif
+	for(; j > 3; j -= 4){
+		mi_UINT32 k;
 
-		rw = (mi_UINT32)(res->x1 - res->x0);	/* width of the resolution level computed */
-		rh = (mi_UINT32)(res->y1 - res->y0);	/* height of the resolution level computed */
+		mi_v4dwt_interleave_v(&v, aj + l0, (mi_INT32)w, h_off, 4);
+		mi_v4dwt_decode(&v);
 
-		h.dn = (mi_INT32)(rw - (mi_UINT32)h.sn);
-		h.cas = res->x0 % 2;
+		for(k = 0; k < nb; ++k){
+			memcpy(&aj[o0 + k*w], &v.wavelet[k], 4 * sizeof(mi_FLOAT32));
+		}
+		aj += 4;
+	}
 
-		for(j = (mi_INT32)rh; j > 3; j -= 4) {
-			mi_INT32 k;
-			mi_v4dwt_interleave_h(&h, aj, (mi_INT32)w, (mi_INT32)bufsize);
-			mi_v4dwt_decode(&h);
+	if (j > 0){
+		mi_UINT32 k;
 
-			for(k = (mi_INT32)rw; --k >= 0;){
-				aj[k               ] = h.wavelet[k].f[0];
-				aj[k+(mi_INT32)w  ] = h.wavelet[k].f[1];
-				aj[k+(mi_INT32)w*2] = h.wavelet[k].f[2];
-				aj[k+(mi_INT32)w*3] = h.wavelet[k].f[3];
-			}
+		mi_v4dwt_interleave_v(&v, aj + l0, (mi_INT32)w, h_off, j);
+		mi_v4dwt_decode(&v);
 
-			aj += w*4;
-			bufsize -= w*4;
+		for(k = 0; k < nb; ++k){
+			memcpy(&aj[o0 + k*w], &v.wavelet[k], (size_t)j * sizeof(mi_FLOAT32));
 		}
+	}
+}
 
-		if (rh & 0x03) {
-			mi_INT32 k;
-			j = rh & 0x03;
-			mi_v4dwt_interleave_h(&h, aj, (mi_INT32)w, (mi_INT32)bufsize);
-			mi_v4dwt_decode(&h);
-			for(k = (mi_INT32)rw; --k >= 0;){
-				switch(j) {
-					case 3: aj[k+(mi_INT32)w*2] = h.wavelet[k].f[2];
-					case 2: aj[k+(mi_INT32)w  ] = h.wavelet[k].f[1];
-					case 1: aj[k               ] = h.wavelet[k].f[0];
-				}
-			}
-		}
+/* <summary>                             */
+/* Inverse 9-7 wavelet transform in 2-D. */
+/* </summary>                            */
+mi_BOOL mi_dwt_decode_real(mi_thread_pool_t* tp, mi_tcd_tilecomp_t* restrict tilec, mi_UINT32 numres)
+{
+	mi_dwt_workers_t l_workers;
+	mi_dwt_pass_t l_pass;
+	size_t l_data_size;
 
-		v.dn = (mi_INT32)(rh - (mi_UINT32)v.sn);
-		v.cas = res->y0 % 2;
+	mi_tcd_resolution_t* res = tilec->resolutions;
 
-		aj = (mi_FLOAT32*) tilec->data;
-		for(j = (mi_INT32)rw; j > 3; j -= 4){
-			mi_UINT32 k;
+	mi_UINT32 rw = (mi_UINT32)(res->x1 - res->x0);	/* width of the resolution level computed */
+	mi_UINT32 rh = (mi_UINT32)(res->y1 - res->y0);	/* height of the resolution level computed */
 
-			mi_v4dwt_interleave_v(&v, aj, (mi_INT32)w, 4);
-			mi_v4dwt_decode(&v);
+	l_data_size = (size_t)(mi_dwt_max_resolution(res, numres)+5) * sizeof(mi_v4_t);
+#ifdef mi_HAVE_AVX2
+	if (mi_cpu_get_features() & mi_CPU_AVX2) {
+		/* room for the 8-wide elements */
+		l_data_size *= 2;
+	}
+#endif
+	if (!mi_dwt_workers_init(&l_workers, tp, l_data_size)) {
+		/* FIXME event manager error callback */
+		return mi_FALSE;
+	}
 
-			for(k = 0; k < rh; ++k){
-				memcpy(&aj[k*w], &v.wavelet[k], 4 * sizeof(mi_FLOAT32));
-			}
-			aj += 4;
-		}
+	memset(&l_pass, 0, sizeof(l_pass));
+	l_pass.tiledp = tilec->data;
+	l_pass.w = (mi_UINT32)(tilec->x1 - tilec->x0);
+	l_pass.size = (mi_UINT32)((tilec->x1 - tilec->x0) * (tilec->y1 - tilec->y0));
 
-		if (rw & 0x03){
-			mi_UINT32 k;
+	while( --numres) {
+		mi_UINT32 h_sn = rw;
+		mi_UINT32 v_sn = rh;
+		mi_tcd_resolution_t* lr = res;	/* resolution level below */
 
-			j = rw & 0x03;
+		++res;
 
-			mi_v4dwt_interleave_v(&v, aj, (mi_INT32)w, j);
-			mi_v4dwt_decode(&v);
+		rw = (mi_UINT32)(res->x1 - res->x0);	/* width of the resolution level computed */
+		rh = (mi_UINT32)(res->y1 - res->y0);	/* height of the resolution level computed */
 
-			for(k = 0; k < rh; ++k){
-				memcpy(&aj[k*w], &v.wavelet[k], (size_t)j * sizeof(mi_FLOAT32));
-			}
+		l_pass.rw = rw;
+		l_pass.rh = rh;
+
+		/* as in mi_dwt_decode_tile */
+		mi_dwt_set_pass_window(&l_pass, lr->win_x0, lr->win_x1, res->bands[0].win_x0, res->bands[0].win_x1, h_sn, (mi_UINT32)res->x0 & 1);
+		if (lr->win_y1 == v_sn + res->bands[1].win_y0) {
+			mi_dwt_run_pass_range(&l_workers, mi_dwt_decode_h_real_processor, &l_pass, lr->win_y0, v_sn + res->bands[1].win_y1, l_pass.w);
+		} else {
+			mi_dwt_run_pass_range(&l_workers, mi_dwt_decode_h_real_processor, &l_pass, lr->win_y0, lr->win_y1, l_pass.w);
+			mi_dwt_run_pass_range(&l_workers, mi_dwt_decode_h_real_processor, &l_pass, v_sn + res->bands[1].win_y0, v_sn + res->bands[1].win_y1, l_pass.w);
 		}
+
+		mi_dwt_set_pass_window(&l_pass, lr->win_y0, lr->win_y1, res->bands[1].win_y0, res->bands[1].win_y1, v_sn, (mi_UINT32)res->y0 & 1);
+		mi_dwt_run_pass_range(&l_workers, mi_dwt_decode_v_real_processor, &l_pass, res->win_x0, res->win_x1, 1);
 	}
 
-	mi_aligned_free(h.wavelet);
+	mi_dwt_workers_clear(&l_workers);
 	return mi_TRUE;
 }
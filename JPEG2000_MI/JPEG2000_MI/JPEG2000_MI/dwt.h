@@ -24,17 +24,20 @@ DWT.C are used by some function in TCD.C.
 /**
 Forward 5-3 wavelet transform in 2-D.
 Apply a reversible DWT transform to a component of an image.
+@param tp Thread pool the rows and columns of each level are split on (may be 00)
 @param tilec Tile component information (current tile)
 */
-mi_BOOL mi_dwt_encode(mi_tcd_tilecomp_t * tilec);
+mi_BOOL mi_dwt_encode(mi_thread_pool_t * tp, mi_tcd_tilecomp_t * tilec);
 
 /**
 Inverse 5-3 wavelet transform in 2-D.
 Apply a reversible inverse DWT transform to a component of an image.
+Only the samples in the windows of the resolutions are computed (see mi_tcd_set_decode_area).
+@param tp Thread pool the rows and columns of each level are split on (may be 00)
 @param tilec Tile component information (current tile)
 @param numres Number of resolution levels to decode
 */
-mi_BOOL mi_dwt_decode(mi_tcd_tilecomp_t* tilec, mi_UINT32 numres);
+mi_BOOL mi_dwt_decode(mi_thread_pool_t* tp, mi_tcd_tilecomp_t* tilec, mi_UINT32 numres);
 
 /**
 Get the gain of a subband for the reversible 5-3 DWT.
@@ -52,16 +55,19 @@ mi_FLOAT64 mi_dwt_getnorm(mi_UINT32 level, mi_UINT32 orient);
 /**
 Forward 9-7 wavelet transform in 2-D. 
 Apply an irreversible DWT transform to a component of an image.
+@param tp Thread pool the rows and columns of each level are split on (may be 00)
 @param tilec Tile component information (current tile)
 */
-mi_BOOL mi_dwt_encode_real(mi_tcd_tilecomp_t * tilec);
+mi_BOOL mi_dwt_encode_real(mi_thread_pool_t * tp, mi_tcd_tilecomp_t * tilec);
 /**
 Inverse 9-7 wavelet transform in 2-D. 
 Apply an irreversible inverse DWT transform to a component of an image.
+Only the samples in the windows of the resolutions are computed (see mi_tcd_set_decode_area).
+@param tp Thread pool the rows and columns of each level are split on (may be 00)
 @param tilec Tile component information (current tile)
 @param numres Number of resolution levels to decode
 */
-mi_BOOL mi_dwt_decode_real(mi_tcd_tilecomp_t* restrict tilec, mi_UINT32 numres);
+mi_BOOL mi_dwt_decode_real(mi_thread_pool_t* tp, mi_tcd_tilecomp_t* restrict tilec, mi_UINT32 numres);
 
 /**
 Get the gain of a subband for the irreversible 9-7 DWT.
@@ -273,6 +273,52 @@ static mi_BOOL mi_j2k_write_SQcd_SQcc(mi_j2k_t *p_j2k,
                                                                             mi_UINT32 * p_header_size,
                                                                             mi_event_mgr_t * p_manager);
 
+/**
+ * Compares the coding styles (SPCod/SPCoc elements) of two tile components.
+ *
+ * @param       p_tccp0         the first tile component.
+ * @param       p_tccp1         the second tile component.
+ *
+ * @return mi_TRUE if the SPCod/SPCoc elements are equal.
+ */
+static mi_BOOL mi_j2k_compare_tccp_SPCod_SPCoc(const mi_tccp_t *p_tccp0, const mi_tccp_t *p_tccp1);
+
+/**
+ * Writes the SPCod or SPCoc element of a tile component.
+ *
+ * @param       p_tccp          the tile component.
+ * @param       p_data          the data buffer.
+ * @param       p_header_size   pointer to the size of the data buffer, it is changed by the function.
+ * @param       p_manager       the user event manager.
+ */
+static mi_BOOL mi_j2k_write_tccp_SPCod_SPCoc(const mi_tccp_t *p_tccp,
+                                               mi_BYTE * p_data,
+                                               mi_UINT32 * p_header_size,
+                                               mi_event_mgr_t * p_manager );
+
+/**
+ * Compares the quantization values (SQcd/SQcc elements) of two tile components.
+ *
+ * @param       p_tccp0         the first tile component.
+ * @param       p_tccp1         the second tile component.
+ *
+ * @return mi_TRUE if the SQcd/SQcc elements are equal.
+ */
+static mi_BOOL mi_j2k_compare_tccp_SQcd_SQcc(const mi_tccp_t *p_tccp0, const mi_tccp_t *p_tccp1);
+
+/**
+ * Writes the SQcd or SQcc element of a tile component.
+ *
+ * @param       p_tccp          the tile component.
+ * @param       p_data          the data buffer.
+ * @param       p_header_size   pointer to the size of the data buffer, it is changed by the function.
+ * @param       p_manager       the user event manager.
+ */
+static mi_BOOL mi_j2k_write_tccp_SQcd_SQcc(const mi_tccp_t *p_tccp,
+                                             mi_BYTE * p_data,
+                                             mi_UINT32 * p_header_size,
+                                             mi_event_mgr_t * p_manager );
+
 /**
  * Updates the Tile Length Marker.
  */
@@ -315,6 +361,167 @@ static mi_BOOL mi_j2k_decode_tiles (  mi_j2k_t *p_j2k,
                                         mi_stream_private_t *p_stream,
                                         mi_event_mgr_t * p_manager);
 
+/**
+ * Tile decoded by a job of the thread pool during a tile-parallel decoding.
+ */
+typedef struct mi_j2k_decode_tile_job
+{
+        /** tile decoder of the job, its tier-1 runs on the synchronous pool m_tp */
+        mi_tcd_t * m_tcd;
+        mi_thread_pool_t * m_tp;
+        /** image header of the tile decoder, the decoded resolutions being set per tile */
+        mi_image_t * m_image;
+        /** compressed data of the tile, taken over from its tcp */
+        mi_BYTE * m_src;
+        mi_UINT32 m_src_size;
+        /** the compressed data is borrowed from the stream, as m_data_borrowed of the tcp */
+        mi_BOOL m_src_borrowed;
+        mi_stream_private_t * m_stream;
+        /** decoded tile samples, as given by mi_tcd_update_tile_data */
+        mi_BYTE * m_tile_data;
+        mi_UINT32 m_tile_data_size;
+        mi_UINT32 m_max_tile_data_size;
+        mi_UINT32 m_tile_no;
+        mi_codestream_index_t * m_cstr_index;
+        mi_event_mgr_t * m_manager;
+        mi_BOOL m_ret;
+} mi_j2k_decode_tile_job_t;
+
+/**
+ * Reads the tiles several at a time and decodes them concurrently, each on its
+ * own tile decoder, then updates the output image in tile order.
+ *
+ * @param       p_j2k           the jpeg2000 codec.
+ * @param       p_stream        the stream to read data from.
+ * @param       p_manager       the user event manager.
+ */
+static mi_BOOL mi_j2k_decode_tiles_parallel ( mi_j2k_t *p_j2k,
+                                                mi_stream_private_t *p_stream,
+                                                mi_event_mgr_t * p_manager );
+
+/**
+ * Job decoding a tile (see mi_tcd_decode_tile) into the tile samples of the job.
+ */
+static void mi_j2k_decode_tile_processor(void* user_data, mi_tls_t* tls);
+
+/**
+ * Ends the decoding of the current tile and reads the marker following its data.
+ *
+ * @param       p_j2k           the jpeg2000 codec.
+ * @param       p_stream        the stream to read data from.
+ * @param       p_manager       the user event manager.
+ */
+static mi_BOOL mi_j2k_end_tile_decoding ( mi_j2k_t * p_j2k,
+                                            mi_stream_private_t *p_stream,
+                                            mi_event_mgr_t * p_manager );
+
+/**
+ * State of a transcoding (see mi_j2k_transcode).
+ */
+typedef struct mi_j2k_transcoder
+{
+        const mi_transcode_parameters_t * m_parameters;
+        /** reference grid and tiling of the output, sharing the components and the tcps of the codec */
+        mi_image_t m_image;
+        mi_cp_t m_cp;
+        /** lengths of the packets of the current tile, in the order of the input */
+        mi_UINT32 * m_lengths;
+        mi_UINT32 m_max_nb_lengths;
+        /** tile-part being written */
+        mi_BYTE * m_data;
+        mi_UINT32 m_max_data_size;
+        /** tells the tiles already written */
+        mi_BYTE * m_tile_written;
+        /** TLM markers of the output, written in the main header then again once the tile-parts are known */
+        mi_BYTE * m_tlm_data;
+        mi_UINT32 m_tlm_size;
+        mi_OFF_T m_tlm_start;
+        mi_UINT32 m_nb_tile_parts;
+} mi_j2k_transcoder_t;
+
+/**
+ * Checks the codestream can be transcoded with the parameters of the transcoder and sets the
+ * reference grid and the tiling of the output.
+ *
+ * @param       p_j2k           the jpeg2000 codec, its main header read.
+ * @param       p_transcoder    the transcoder.
+ * @param       p_manager       the user event manager.
+ */
+static mi_BOOL mi_j2k_transcode_init( mi_j2k_t *p_j2k,
+                                        mi_j2k_transcoder_t *p_transcoder,
+                                        mi_event_mgr_t * p_manager );
+
+/**
+ * Applies the transcoding parameters to the coding parameters of a tile, or to the default ones.
+ *
+ * @param       p_tcp           the coding parameters.
+ * @param       p_nb_comps      the number of components.
+ * @param       p_parameters    the transcoding parameters.
+ * @param       p_manager       the user event manager.
+ *
+ * @return mi_FALSE if the parameters cannot be applied.
+ */
+static mi_BOOL mi_j2k_transcode_tcp(  mi_tcp_t *p_tcp,
+                                        mi_UINT32 p_nb_comps,
+                                        const mi_transcode_parameters_t *p_parameters,
+                                        mi_event_mgr_t * p_manager );
+
+/**
+ * Writes the COD, COC, QCD, QCC and RGN markers of the coding parameters of the main header or of a tile.
+ *
+ * @param       p_tcp           the coding parameters to write.
+ * @param       p_main_tcp      the coding parameters of the main header when writing the ones of a tile,
+ *                              only the markers changing them being written, 00 for the main header.
+ * @param       p_nb_comps      the number of components.
+ * @param       p_data          the buffer to write to.
+ * @param       p_max_size      the size of the buffer, at least (p_nb_comps + 1) * 256 bytes.
+ * @param       p_data_written  receives the number of bytes written.
+ * @param       p_manager       the user event manager.
+ */
+static mi_BOOL mi_j2k_transcode_write_coding_markers( const mi_tcp_t *p_tcp,
+                                                        const mi_tcp_t *p_main_tcp,
+                                                        mi_UINT32 p_nb_comps,
+                                                        mi_BYTE * p_data,
+                                                        mi_UINT32 p_max_size,
+                                                        mi_UINT32 * p_data_written,
+                                                        mi_event_mgr_t * p_manager );
+
+/**
+ * Writes the main header of the output: SOC, SIZ, the coding markers and the TLM markers, updated at the end.
+ *
+ * @param       p_j2k           the jpeg2000 codec.
+ * @param       p_transcoder    the transcoder.
+ * @param       p_out_stream    the stream to write data to.
+ * @param       p_manager       the user event manager.
+ */
+static mi_BOOL mi_j2k_transcode_write_main_header(    mi_j2k_t *p_j2k,
+                                                        mi_j2k_transcoder_t *p_transcoder,
+                                                        mi_stream_private_t *p_out_stream,
+                                                        mi_event_mgr_t * p_manager );
+
+/**
+ * Writes the packets of the tile whose header has just been read as one tile-part of the output,
+ * in the order of the output.
+ *
+ * @param       p_j2k           the jpeg2000 codec.
+ * @param       p_transcoder    the transcoder.
+ * @param       p_tile_no       the index of the tile.
+ * @param       p_out_stream    the stream to write data to.
+ * @param       p_manager       the user event manager.
+ */
+static mi_BOOL mi_j2k_transcode_tile( mi_j2k_t *p_j2k,
+                                        mi_j2k_transcoder_t *p_transcoder,
+                                        mi_UINT32 p_tile_no,
+                                        mi_stream_private_t *p_out_stream,
+                                        mi_event_mgr_t * p_manager );
+
+/**
+ * Grows the tile-part buffer of a transcoder to the given size.
+ */
+static mi_BOOL mi_j2k_transcode_reserve(      mi_j2k_transcoder_t *p_transcoder,
+                                                mi_UINT32 p_size,
+                                                mi_event_mgr_t * p_manager );
+
 static mi_BOOL mi_j2k_pre_write_tile ( mi_j2k_t * p_j2k,
                                                                              mi_UINT32 p_tile_index,
                                                                              mi_stream_private_t *p_stream,
@@ -322,6 +529,15 @@ static mi_BOOL mi_j2k_pre_write_tile ( mi_j2k_t * p_j2k,
 
 static mi_BOOL mi_j2k_update_image_data (mi_tcd_t * p_tcd, mi_BYTE * p_data, mi_image_t* p_output_image);
 
+/**
+ * Gives to a tile decoder the buffer of the caller receiving the decoded samples,
+ * if any (see mi_j2k_decode_to_buffer).
+ *
+ * @param       p_j2k           J2K codec.
+ * @param       p_tcd           the tile decoder.
+ */
+static void mi_j2k_set_tcd_output (mi_j2k_t *p_j2k, mi_tcd_t *p_tcd);
+
 static void mi_get_tile_dimensions(mi_image_t * l_image,
 																		mi_tcd_tilecomp_t * l_tilec,
 																		mi_image_comp_t * l_img_comp,
@@ -334,12 +550,51 @@ static void mi_get_tile_dimensions(mi_image_t * l_image,
 																		mi_UINT32* l_stride,
 																		mi_UINT32* l_tile_offset);
 
-static void mi_j2k_get_tile_data (mi_tcd_t * p_tcd, mi_BYTE * p_data);
+/**
+ * Copies the samples of the current tile from the image components to the
+ * tile components, in one pass.
+ *
+ * @param       p_tcd           the tile coder, its tile component data being allocated.
+ */
+static void mi_j2k_copy_tile_data (mi_tcd_t * p_tcd);
 
 static mi_BOOL mi_j2k_post_write_tile (mi_j2k_t * p_j2k,
                                                                              mi_stream_private_t *p_stream,
                                                                              mi_event_mgr_t * p_manager );
 
+/**
+ * Tile coded by a job of the thread pool during a tile-parallel encoding.
+ */
+typedef struct mi_j2k_encode_tile_job
+{
+        /** tile coder of the job, its tier-1 runs on the synchronous pool m_tp */
+        mi_tcd_t * m_tcd;
+        mi_thread_pool_t * m_tp;
+        /** scratch buffer of the rate allocation */
+        mi_BYTE * m_scratch;
+        /** maximum size of the first tile-part data, as in mi_j2k_write_sod */
+        mi_UINT32 m_max_length;
+        mi_UINT32 m_tile_no;
+        mi_BOOL m_ret;
+} mi_j2k_encode_tile_job_t;
+
+/**
+ * Encodes the tiles several at a time, each on its own tile coder, and writes
+ * the tile-parts to the stream in tile order.
+ *
+ * @param       p_j2k           the jpeg2000 codec.
+ * @param       p_stream        the stream to write data to.
+ * @param       p_manager       the user event manager.
+ */
+static mi_BOOL mi_j2k_encode_tiles_parallel ( mi_j2k_t * p_j2k,
+                                                mi_stream_private_t *p_stream,
+                                                mi_event_mgr_t * p_manager );
+
+/**
+ * Job running the tile level coding of a tile (see mi_tcd_pre_encode_tile).
+ */
+static void mi_j2k_encode_tile_processor(void* user_data, mi_tls_t* tls);
+
 /**
  * Sets up the procedures to do on writing header.
  * Developers wanting to extend the library can add their own writing procedures.
@@ -717,6 +972,58 @@ static mi_BOOL mi_j2k_read_plt (  mi_j2k_t *p_j2k,
                                     mi_UINT32 p_header_size,
                                     mi_event_mgr_t * p_manager );
 
+/**
+ * Adds packets to the packet index of the current tile, for their lengths to be set.
+ *
+ * @param       p_j2k                   the jpeg2000 codec.
+ * @param       p_nb_packets            the number of packets to add.
+ * @param       p_manager               the user event manager.
+ *
+ * @return      the first packet added, or 00 if there is not enough memory.
+*/
+static mi_packet_info_t * mi_j2k_add_packet_lengths(  mi_j2k_t *p_j2k,
+                                                        mi_UINT32 p_nb_packets,
+                                                        mi_event_mgr_t * p_manager );
+
+/**
+ * Sets the tile-parts of the codestream index from the TLM markers read in the main header.
+ * The TLM markers are not used if the tile-parts they give do not end with the codestream.
+ *
+ * @param       p_j2k                   the jpeg2000 codec.
+ * @param       p_stream                the stream to read data from, just after the main header.
+ * @param       p_manager               the user event manager.
+ *
+ * @return      true if the function was successful, false else.
+*/
+static mi_BOOL mi_j2k_index_tlm_tile_parts(   mi_j2k_t *p_j2k,
+                                                mi_stream_private_t *p_stream,
+                                                mi_event_mgr_t * p_manager );
+
+/**
+ * Gets, thanks to the TLM markers, the tile-part which starts at a given position.
+ *
+ * @param       p_j2k                   the jpeg2000 codec.
+ * @param       p_pos                   the position of the SOT marker of the tile-part.
+ *
+ * @return      the index of the tile-part in the codestream order, (mi_UINT32)-1 if it is not known.
+*/
+static mi_UINT32 mi_j2k_get_tlm_tile_part(    mi_j2k_t *p_j2k,
+                                                mi_OFF_T p_pos );
+
+/**
+ * Moves, thanks to the TLM markers, to the next tile-part of a tile to decode, before its SOT marker is read.
+ * Nothing is done if the position of the tile-parts is not known.
+ *
+ * @param       p_j2k                   the jpeg2000 codec.
+ * @param       p_stream                the stream to read data from.
+ * @param       p_manager               the user event manager.
+ *
+ * @return      true if the function was successful, false else.
+*/
+static mi_BOOL mi_j2k_seek_next_tile_part(    mi_j2k_t *p_j2k,
+                                                mi_stream_private_t *p_stream,
+                                                mi_event_mgr_t * p_manager );
+
 /**
  * Reads a PPM marker (Packed headers, main header)
  *
@@ -840,6 +1147,21 @@ static mi_BOOL mi_j2k_write_sod(      mi_j2k_t *p_j2k,
                                                                         const mi_stream_private_t *p_stream,
                                                                         mi_event_mgr_t * p_manager );
 
+/**
+ * Writes the PLT markers (Packet Length, tile-part header) of the current tile-part in memory.
+ *
+ * @param       p_j2k                   J2K codec.
+ * @param       p_marker_info           the lengths of the packets of the tile-part.
+ * @param       p_data                  the buffer to write the markers into.
+ * @param       p_data_written          the number of bytes written.
+ * @param       p_manager               the user event manager.
+*/
+static mi_BOOL mi_j2k_write_plt_in_memory(    mi_j2k_t *p_j2k,
+                                                                        mi_tcd_marker_info_t * p_marker_info,
+                                                                        mi_BYTE * p_data,
+                                                                        mi_UINT32 * p_data_written,
+                                                                        mi_event_mgr_t * p_manager );
+
 /**
  * Reads a SOD marker (Start Of Data)
  *
@@ -851,6 +1173,39 @@ static mi_BOOL mi_j2k_read_sod(   mi_j2k_t *p_j2k,
                                     mi_stream_private_t *p_stream,
                                     mi_event_mgr_t * p_manager );
 
+/**
+ * Reads the packets of the current tile-part at the end of the data of the tile. When the lengths of
+ * its packets are known (PLT, PLM), the packets which are not decoded are skipped in the stream instead
+ * of being read. When the stream is read in place, the data of a tile made of one tile-part is not copied.
+ *
+ * @param       p_j2k                   the jpeg2000 codec.
+ * @param       p_stream                the stream to read data from.
+ * @param       p_read_size             the number of bytes of the tile-part read or skipped.
+ * @param       p_data_size             the number of bytes added to the data of the tile.
+ * @param       p_manager               the user event manager.
+ *
+ * @return      true if the function was successful, false else.
+*/
+static mi_BOOL mi_j2k_read_sod_packets(   mi_j2k_t *p_j2k,
+                                            mi_stream_private_t *p_stream,
+                                            mi_SIZE_T * p_read_size,
+                                            mi_UINT32 * p_data_size,
+                                            mi_event_mgr_t * p_manager );
+
+/**
+ * Makes room for more bytes at the end of the data of a tile, the data borrowed from the stream
+ * being copied first.
+ *
+ * @param       p_tcp                   the tile coding parameters holding the data.
+ * @param       p_size                  the number of bytes to add.
+ * @param       p_manager               the user event manager.
+ *
+ * @return      true if the function was successful, false else.
+*/
+static mi_BOOL mi_j2k_grow_tile_data( mi_tcp_t * p_tcp,
+                                        mi_UINT32 p_size,
+                                        mi_event_mgr_t * p_manager );
+
 static void mi_j2k_update_tlm (mi_j2k_t * p_j2k, mi_UINT32 p_tile_part_size )
 {
         mi_write_bytes(p_j2k->m_specific_param.m_encoder.m_tlm_sot_offsets_current,p_j2k->m_current_tile_number,1);            /* PSOT */
@@ -3066,6 +3421,12 @@ static mi_BOOL mi_j2k_read_poc (  mi_j2k_t *p_j2k,
         l_old_poc_nb = l_tcp->POC ? l_tcp->numpocs + 1 : 0;
         l_current_poc_nb += l_old_poc_nb;
 
+        /* the packets left out of the previous tile-parts were chosen with the former progression */
+        if (l_tcp->m_nb_packets_left_out) {
+                mi_event_msg(p_manager, EVT_ERROR, "POC marker after tile-parts whose packets were skipped with their lengths (PLT, PLM)\n");
+                return mi_FALSE;
+        }
+
         if(l_current_poc_nb >= 32)
           {
           mi_event_msg(p_manager, EVT_ERROR, "Too many POCs %d\n", l_current_poc_nb);
@@ -3076,6 +3437,10 @@ static mi_BOOL mi_j2k_read_poc (  mi_j2k_t *p_j2k,
         /* now poc is in use.*/
         l_tcp->POC = 1;
 
+        /* the packets of the tile are listed again with the new progressions */
+        mi_pi_destroy_schedule(l_tcp->m_packet_schedule);
+        l_tcp->m_packet_schedule = 00;
+
         l_current_poc = &l_tcp->pocs[l_old_poc_nb];
         for     (i = l_old_poc_nb; i < l_current_poc_nb; ++i) {
                 mi_read_bytes(p_header_data,&(l_current_poc->resno0),1);                               /* RSpoc_i */
@@ -3156,7 +3521,10 @@ static mi_BOOL mi_j2k_read_tlm (  mi_j2k_t *p_j2k,
                                     mi_event_mgr_t * p_manager
                                     )
 {
-        mi_UINT32 l_Ztlm, l_Stlm, l_ST, l_SP, l_tot_num_tp_remaining, l_quotient, l_Ptlm_size;
+        mi_UINT32 l_Ztlm, l_Stlm, l_ST, l_SP, l_tot_num_tp, l_tot_num_tp_remaining, l_quotient, l_Ptlm_size;
+        mi_UINT32 l_Ttlm_i, l_Ptlm_i, l_nb_tps, i;
+        mi_UINT32 * l_new_tileno = 00;
+        mi_OFF_T * l_new_pos = 00;
         /* preconditions */
         assert(p_header_data != 00);
         assert(p_j2k != 00);
@@ -3185,16 +3553,53 @@ static mi_BOOL mi_j2k_read_tlm (  mi_j2k_t *p_j2k,
                 mi_event_msg(p_manager, EVT_ERROR, "Error reading TLM marker\n");
                 return mi_FALSE;
         }
-        /* FIXME Do not care of this at the moment since only local variables are set here */
-        /*
-        for
-                (i = 0; i < l_tot_num_tp; ++i)
-        {
-                mi_read_bytes(p_header_data,&l_Ttlm_i,l_ST);                           // Ttlm_i
-                p_header_data += l_ST;
-                mi_read_bytes(p_header_data,&l_Ptlm_i,l_Ptlm_size);            // Ptlm_i
+        l_tot_num_tp = p_header_size / l_quotient;
+
+        /* Keep the tile-part lengths, they give the position of every tile-part (see mi_j2k_index_tlm_tile_parts).
+         * The TLM markers are assumed to come in the order of Ztlm. */
+        if (l_ST == 3 || p_j2k->m_specific_param.m_decoder.m_tlm_unusable) {
+                p_j2k->m_specific_param.m_decoder.m_tlm_unusable = 1;
+                return mi_TRUE;
+        }
+
+        l_nb_tps = p_j2k->m_specific_param.m_decoder.m_nb_tlm_tps;
+        l_new_tileno = (mi_UINT32 *) mi_realloc(p_j2k->m_specific_param.m_decoder.m_tlm_tileno, (l_nb_tps + l_tot_num_tp) * sizeof(mi_UINT32));
+        if (! l_new_tileno) {
+                mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to read TLM marker\n");
+                return mi_FALSE;
+        }
+        p_j2k->m_specific_param.m_decoder.m_tlm_tileno = l_new_tileno;
+        /* one more element for the end of the last tile-part */
+        l_new_pos = (mi_OFF_T *) mi_realloc(p_j2k->m_specific_param.m_decoder.m_tlm_pos, (l_nb_tps + l_tot_num_tp + 1) * sizeof(mi_OFF_T));
+        if (! l_new_pos) {
+                mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to read TLM marker\n");
+                return mi_FALSE;
+        }
+        p_j2k->m_specific_param.m_decoder.m_tlm_pos = l_new_pos;
+
+        for (i = 0; i < l_tot_num_tp; ++i) {
+                if (l_ST) {
+                        mi_read_bytes(p_header_data,&l_Ttlm_i,l_ST);                   /* Ttlm_i */
+                        p_header_data += l_ST;
+                }
+                else {
+                        /* one tile-part per tile, in the order of the tiles */
+                        l_Ttlm_i = l_nb_tps;
+                }
+                mi_read_bytes(p_header_data,&l_Ptlm_i,l_Ptlm_size);                    /* Ptlm_i */
                 p_header_data += l_Ptlm_size;
-        }*/
+
+                if ((l_Ttlm_i >= p_j2k->m_cp.tw * p_j2k->m_cp.th) || (l_Ptlm_i < 14)) {
+                        mi_event_msg(p_manager, EVT_WARNING, "Invalid tile-part length in TLM marker, the TLM markers are not used\n");
+                        p_j2k->m_specific_param.m_decoder.m_tlm_unusable = 1;
+                        return mi_TRUE;
+                }
+                p_j2k->m_specific_param.m_decoder.m_tlm_tileno[l_nb_tps] = l_Ttlm_i;
+                p_j2k->m_specific_param.m_decoder.m_tlm_pos[l_nb_tps] = (mi_OFF_T)l_Ptlm_i;
+                ++l_nb_tps;
+        }
+        p_j2k->m_specific_param.m_decoder.m_nb_tlm_tps = l_nb_tps;
+
         return mi_TRUE;
 }
 
@@ -3212,6 +3617,10 @@ static mi_BOOL mi_j2k_read_plm (  mi_j2k_t *p_j2k,
                                     mi_event_mgr_t * p_manager
                                     )
 {
+        mi_UINT32 l_Zplm, l_Nplm, l_tmp, l_packet_len = 0, l_nb_lengths, i;
+        mi_UINT32 * l_new_first = 00;
+        mi_UINT32 * l_new_lengths = 00;
+
         /* preconditions */
         assert(p_header_data != 00);
         assert(p_j2k != 00);
@@ -3221,50 +3630,66 @@ static mi_BOOL mi_j2k_read_plm (  mi_j2k_t *p_j2k,
                 mi_event_msg(p_manager, EVT_ERROR, "Error reading PLM marker\n");
                 return mi_FALSE;
         }
-        /* Do not care of this at the moment since only local variables are set here */
-        /*
-        mi_read_bytes(p_header_data,&l_Zplm,1);                                        // Zplm
+
+        mi_read_bytes(p_header_data,&l_Zplm,1);                                        /* Zplm */
         ++p_header_data;
         --p_header_size;
 
-        while
-                (p_header_size > 0)
-        {
-                mi_read_bytes(p_header_data,&l_Nplm,1);                                // Nplm
+        /* Each Nplm gives the lengths of the packets of one tile-part, in the order of the codestream
+         * (the PLM markers are assumed to come in the order of Zplm) */
+        while (p_header_size > 0) {
+                mi_read_bytes(p_header_data,&l_Nplm,1);                                /* Nplm */
                 ++p_header_data;
-                p_header_size -= (1+l_Nplm);
-                if
-                        (p_header_size < 0)
-                {
+                --p_header_size;
+                if (l_Nplm > p_header_size) {
                         mi_event_msg(p_manager, EVT_ERROR, "Error reading PLM marker\n");
-                        return false;
+                        return mi_FALSE;
                 }
-                for
-                        (i = 0; i < l_Nplm; ++i)
-                {
-                        mi_read_bytes(p_header_data,&l_tmp,1);                         // Iplm_ij
+
+                l_new_first = (mi_UINT32 *) mi_realloc(p_j2k->m_specific_param.m_decoder.m_plm_first, (p_j2k->m_specific_param.m_decoder.m_nb_plm_tps + 2) * sizeof(mi_UINT32));
+                if (! l_new_first) {
+                        mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to read PLM marker\n");
+                        return mi_FALSE;
+                }
+                p_j2k->m_specific_param.m_decoder.m_plm_first = l_new_first;
+                if (! p_j2k->m_specific_param.m_decoder.m_nb_plm_tps) {
+                        p_j2k->m_specific_param.m_decoder.m_plm_first[0] = 0;
+                }
+                l_nb_lengths = p_j2k->m_specific_param.m_decoder.m_plm_first[p_j2k->m_specific_param.m_decoder.m_nb_plm_tps];
+
+                /* at most one length per byte */
+                l_new_lengths = (mi_UINT32 *) mi_realloc(p_j2k->m_specific_param.m_decoder.m_plm_lengths, (l_nb_lengths + l_Nplm + 1) * sizeof(mi_UINT32));
+                if (! l_new_lengths) {
+                        mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to read PLM marker\n");
+                        return mi_FALSE;
+                }
+                p_j2k->m_specific_param.m_decoder.m_plm_lengths = l_new_lengths;
+
+                for (i = 0; i < l_Nplm; ++i) {
+                        mi_read_bytes(p_header_data,&l_tmp,1);                         /* Iplm_ij */
                         ++p_header_data;
-                        // take only the last seven bytes
+                        /* take only the last seven bytes */
                         l_packet_len |= (l_tmp & 0x7f);
-                        if
-                                (l_tmp & 0x80)
-                        {
+                        if (l_tmp & 0x80) {
                                 l_packet_len <<= 7;
                         }
-                        else
-                        {
-                // store packet length and proceed to next packet
+                        else {
+                                /* store packet length and proceed to next packet */
+                                p_j2k->m_specific_param.m_decoder.m_plm_lengths[l_nb_lengths++] = l_packet_len;
                                 l_packet_len = 0;
                         }
                 }
-                if
-                        (l_packet_len != 0)
-                {
+                p_header_size -= l_Nplm;
+
+                if (l_packet_len != 0) {
                         mi_event_msg(p_manager, EVT_ERROR, "Error reading PLM marker\n");
-                        return false;
+                        return mi_FALSE;
                 }
+
+                ++p_j2k->m_specific_param.m_decoder.m_nb_plm_tps;
+                p_j2k->m_specific_param.m_decoder.m_plm_first[p_j2k->m_specific_param.m_decoder.m_nb_plm_tps] = l_nb_lengths;
         }
-        */
+
         return mi_TRUE;
 }
 
@@ -3282,7 +3707,9 @@ static mi_BOOL mi_j2k_read_plt (  mi_j2k_t *p_j2k,
                                     mi_event_mgr_t * p_manager
                                     )
 {
-        mi_UINT32 l_Zplt, l_tmp, l_packet_len = 0, i;
+        mi_UINT32 l_Zplt, l_tmp, l_packet_len = 0, l_nb_packets = 0, i;
+        mi_tcp_t * l_tcp = 00;
+        mi_packet_info_t * l_packet_info = 00;
 
         /* preconditions */
         assert(p_header_data != 00);
@@ -3309,6 +3736,7 @@ static mi_BOOL mi_j2k_read_plt (  mi_j2k_t *p_j2k,
                 else {
             /* store packet length and proceed to next packet */
                         l_packet_len = 0;
+                        ++l_nb_packets;
                 }
         }
 
@@ -3317,30 +3745,220 @@ static mi_BOOL mi_j2k_read_plt (  mi_j2k_t *p_j2k,
                 return mi_FALSE;
         }
 
+        /* Keep the packet lengths in the codestream index (the PLT markers are assumed to come in the order of Zplt),
+         * unless the lengths of the packets of the tile-part cannot be used or are given by the PLM markers */
+        l_tcp = &(p_j2k->m_cp.tcps[p_j2k->m_current_tile_number]);
+        if ((! p_j2k->cstr_index) || (! l_nb_packets) || l_tcp->m_packet_lengths_lost
+                        || p_j2k->m_specific_param.m_decoder.m_tp_has_plm_lengths) {
+                return mi_TRUE;
+        }
+
+        l_packet_info = mi_j2k_add_packet_lengths(p_j2k, l_nb_packets, p_manager);
+        if (! l_packet_info) {
+                return mi_FALSE;
+        }
+
+        p_header_data -= p_header_size;
+        for (i = 0; i < p_header_size; ++i) {
+                mi_read_bytes(p_header_data,&l_tmp,1);         /* Iplt_ij */
+                ++p_header_data;
+                l_packet_len |= (l_tmp & 0x7f);
+                if (l_tmp & 0x80) {
+                        l_packet_len <<= 7;
+                }
+                else {
+                        /* the position of the packet is set in mi_j2k_read_sod */
+                        l_packet_info->end_pos = (mi_OFF_T)l_packet_len;
+                        ++l_packet_info;
+                        l_packet_len = 0;
+                }
+        }
+
         return mi_TRUE;
 }
 
-/**
- * Reads a PPM marker (Packed packet headers, main header)
- *
- * @param       p_header_data   the data contained in the POC box.
- * @param       p_j2k                   the jpeg2000 codec.
- * @param       p_header_size   the size of the data contained in the POC marker.
- * @param       p_manager               the user event manager.
- */
-
-static mi_BOOL mi_j2k_read_ppm (
-																	mi_j2k_t *p_j2k,
-																	mi_BYTE * p_header_data,
-																	mi_UINT32 p_header_size,
-																	mi_event_mgr_t * p_manager )
+static mi_packet_info_t * mi_j2k_add_packet_lengths(  mi_j2k_t *p_j2k,
+                                                        mi_UINT32 p_nb_packets,
+                                                        mi_event_mgr_t * p_manager )
 {
-	mi_cp_t *l_cp = 00;
-	mi_UINT32 l_Z_ppm;
-	
-	/* preconditions */
-	assert(p_header_data != 00);
-	assert(p_j2k != 00);
+        mi_tile_index_t * l_tile_index = &(p_j2k->cstr_index->tile_index[p_j2k->m_current_tile_number]);
+        mi_packet_info_t * l_new_packet_index = 00;
+
+        l_new_packet_index = (mi_packet_info_t *) mi_realloc(l_tile_index->packet_index,
+                        (l_tile_index->nb_packet + p_nb_packets) * sizeof(mi_packet_info_t));
+        if (! l_new_packet_index) {
+                mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to keep the packet lengths\n");
+                return 00;
+        }
+        l_tile_index->packet_index = l_new_packet_index;
+
+        /* until the tile-part data is reached, start_pos is 0 and end_pos is the length of the packet */
+        l_new_packet_index += l_tile_index->nb_packet;
+        memset(l_new_packet_index, 0, p_nb_packets * sizeof(mi_packet_info_t));
+        l_tile_index->nb_packet += p_nb_packets;
+
+        return l_new_packet_index;
+}
+
+static mi_BOOL mi_j2k_index_tlm_tile_parts(   mi_j2k_t *p_j2k,
+                                                mi_stream_private_t *p_stream,
+                                                mi_event_mgr_t * p_manager )
+{
+        mi_codestream_index_t * l_cstr_index = p_j2k->cstr_index;
+        mi_tile_index_t * l_tile_index = 00;
+        mi_UINT32 l_nb_tps, l_tile_no, i;
+        mi_OFF_T l_pos, l_length, l_stream_end;
+
+        /* the next tile-part read is the first one of the codestream */
+        p_j2k->m_specific_param.m_decoder.m_tp_seq = 0;
+
+        if (p_j2k->m_specific_param.m_decoder.m_tlm_unusable) {
+                p_j2k->m_specific_param.m_decoder.m_nb_tlm_tps = 0;
+        }
+        l_nb_tps = p_j2k->m_specific_param.m_decoder.m_nb_tlm_tps;
+        if (! l_nb_tps) {
+                return mi_TRUE;
+        }
+
+        /* the lengths become positions, the first tile-part starting at the end of the main header */
+        l_pos = l_cstr_index->main_head_end;
+        for (i = 0; i < l_nb_tps; ++i) {
+                l_length = p_j2k->m_specific_param.m_decoder.m_tlm_pos[i];
+                p_j2k->m_specific_param.m_decoder.m_tlm_pos[i] = l_pos;
+                l_pos += l_length;
+        }
+        p_j2k->m_specific_param.m_decoder.m_tlm_pos[l_nb_tps] = l_pos;
+
+        /* the last tile-part is followed by the EOC marker, if any */
+        l_stream_end = mi_stream_tell(p_stream) + mi_stream_get_number_byte_left(p_stream);
+        if ((l_pos != l_stream_end) && (l_pos + 2 != l_stream_end)) {
+                mi_event_msg(p_manager, EVT_WARNING, "TLM markers inconsistent with the stream length, they are not used\n");
+                p_j2k->m_specific_param.m_decoder.m_nb_tlm_tps = 0;
+                return mi_TRUE;
+        }
+
+        /* tile-parts of each tile */
+        for (i = 0; i < l_nb_tps; ++i) {
+                ++l_cstr_index->tile_index[p_j2k->m_specific_param.m_decoder.m_tlm_tileno[i]].current_nb_tps;
+        }
+        for (l_tile_no = 0; l_tile_no < l_cstr_index->nb_of_tiles; ++l_tile_no) {
+                l_tile_index = &(l_cstr_index->tile_index[l_tile_no]);
+                if (l_tile_index->current_nb_tps) {
+                        l_tile_index->tp_index = (mi_tp_index_t *) mi_calloc(l_tile_index->current_nb_tps, sizeof(mi_tp_index_t));
+                        if (! l_tile_index->tp_index) {
+                                l_tile_index->current_nb_tps = 0;
+                                mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to index the tile-parts\n");
+                                return mi_FALSE;
+                        }
+                }
+        }
+        for (i = 0; i < l_nb_tps; ++i) {
+                l_tile_index = &(l_cstr_index->tile_index[p_j2k->m_specific_param.m_decoder.m_tlm_tileno[i]]);
+                l_tile_index->tp_index[l_tile_index->nb_tps].start_pos = p_j2k->m_specific_param.m_decoder.m_tlm_pos[i];
+                l_tile_index->tp_index[l_tile_index->nb_tps].end_pos = p_j2k->m_specific_param.m_decoder.m_tlm_pos[i + 1];
+                ++l_tile_index->nb_tps;
+        }
+
+        return mi_TRUE;
+}
+
+static mi_UINT32 mi_j2k_get_tlm_tile_part(    mi_j2k_t *p_j2k,
+                                                mi_OFF_T p_pos )
+{
+        mi_UINT32 l_low = 0;
+        mi_UINT32 l_high = p_j2k->m_specific_param.m_decoder.m_nb_tlm_tps;
+
+        /* binary search in the positions, which are increasing */
+        while (l_low < l_high) {
+                mi_UINT32 l_mid = l_low + (l_high - l_low) / 2;
+                if (p_j2k->m_specific_param.m_decoder.m_tlm_pos[l_mid] < p_pos) {
+                        l_low = l_mid + 1;
+                }
+                else {
+                        l_high = l_mid;
+                }
+        }
+
+        if ((l_low < p_j2k->m_specific_param.m_decoder.m_nb_tlm_tps) && (p_j2k->m_specific_param.m_decoder.m_tlm_pos[l_low] == p_pos)) {
+                return l_low;
+        }
+        return (mi_UINT32)-1;
+}
+
+static mi_BOOL mi_j2k_seek_next_tile_part(    mi_j2k_t *p_j2k,
+                                                mi_stream_private_t *p_stream,
+                                                mi_event_mgr_t * p_manager )
+{
+        mi_UINT32 l_tp_seq = p_j2k->m_specific_param.m_decoder.m_tp_seq;
+        mi_UINT32 l_tile_no, l_tile_x, l_tile_y;
+        mi_OFF_T l_current_pos, l_skip;
+
+        if ((l_tp_seq == (mi_UINT32)-1) || (l_tp_seq >= p_j2k->m_specific_param.m_decoder.m_nb_tlm_tps)) {
+                return mi_TRUE;
+        }
+
+        l_current_pos = mi_stream_tell(p_stream);
+        if (l_current_pos != p_j2k->m_specific_param.m_decoder.m_tlm_pos[l_tp_seq]) {
+                mi_event_msg(p_manager, EVT_WARNING, "TLM markers inconsistent with the codestream, they are not used\n");
+                p_j2k->m_specific_param.m_decoder.m_nb_tlm_tps = 0;
+                return mi_TRUE;
+        }
+
+        /* first tile-part, from the current one, of a tile to decode */
+        for (; l_tp_seq < p_j2k->m_specific_param.m_decoder.m_nb_tlm_tps; ++l_tp_seq) {
+                l_tile_no = p_j2k->m_specific_param.m_decoder.m_tlm_tileno[l_tp_seq];
+                if (p_j2k->m_specific_param.m_decoder.m_tile_ind_to_dec == -1) {
+                        l_tile_x = l_tile_no % p_j2k->m_cp.tw;
+                        l_tile_y = l_tile_no / p_j2k->m_cp.tw;
+                        if ((l_tile_x >= p_j2k->m_specific_param.m_decoder.m_start_tile_x) && (l_tile_x < p_j2k->m_specific_param.m_decoder.m_end_tile_x)
+                                        && (l_tile_y >= p_j2k->m_specific_param.m_decoder.m_start_tile_y) && (l_tile_y < p_j2k->m_specific_param.m_decoder.m_end_tile_y)) {
+                                break;
+                        }
+                }
+                else if (l_tile_no == (mi_UINT32)p_j2k->m_specific_param.m_decoder.m_tile_ind_to_dec) {
+                        break;
+                }
+        }
+
+        /* if no more tile-part is needed, go to the end of the last one */
+        l_skip = p_j2k->m_specific_param.m_decoder.m_tlm_pos[l_tp_seq] - l_current_pos;
+        if (l_skip) {
+                if (l_skip > mi_stream_get_number_byte_left(p_stream)) {
+                        mi_event_msg(p_manager, EVT_WARNING, "TLM markers inconsistent with the stream length, they are not used\n");
+                        p_j2k->m_specific_param.m_decoder.m_nb_tlm_tps = 0;
+                        return mi_TRUE;
+                }
+                if (mi_stream_skip(p_stream, l_skip, p_manager) != l_skip) {
+                        mi_event_msg(p_manager, EVT_ERROR, "Stream too short\n");
+                        return mi_FALSE;
+                }
+                p_j2k->m_specific_param.m_decoder.m_tp_seq = l_tp_seq;
+        }
+
+        return mi_TRUE;
+}
+
+/**
+ * Reads a PPM marker (Packed packet headers, main header)
+ *
+ * @param       p_header_data   the data contained in the POC box.
+ * @param       p_j2k                   the jpeg2000 codec.
+ * @param       p_header_size   the size of the data contained in the POC marker.
+ * @param       p_manager               the user event manager.
+ */
+
+static mi_BOOL mi_j2k_read_ppm (
+																	mi_j2k_t *p_j2k,
+																	mi_BYTE * p_header_data,
+																	mi_UINT32 p_header_size,
+																	mi_event_mgr_t * p_manager )
+{
+	mi_cp_t *l_cp = 00;
+	mi_UINT32 l_Z_ppm;
+	
+	/* preconditions */
+	assert(p_header_data != 00);
+	assert(p_j2k != 00);
 	assert(p_manager != 00);
 	
 	/* We need to have the Z_ppm element + 1 byte of Nppm/Ippm at minimum */
@@ -3798,6 +4416,7 @@ static mi_BOOL mi_j2k_read_sot ( mi_j2k_t *p_j2k,
         mi_UINT32 l_tot_len, l_num_parts = 0;
         mi_UINT32 l_current_part;
         mi_UINT32 l_tile_x,l_tile_y;
+        mi_UINT32 l_tp_seq;
 
         /* preconditions */
 	
@@ -3967,6 +4586,49 @@ static mi_BOOL mi_j2k_read_sot ( mi_j2k_t *p_j2k,
 
                 }
 
+                /* Packet lengths (PLT, PLM) of the tile, in the codestream index */
+                p_j2k->m_specific_param.m_decoder.m_tp_has_plm_lengths = 0;
+                if (p_j2k->cstr_index) {
+                        mi_tile_index_t * l_tile_index = &(p_j2k->cstr_index->tile_index[p_j2k->m_current_tile_number]);
+                        if (l_current_part == 0) {
+                                l_tile_index->nb_packet = 0;
+                                l_tcp->m_nb_packets_left_out = 0;
+                                l_tcp->m_packet_lengths_lost = 0;
+                        }
+                        p_j2k->m_specific_param.m_decoder.m_tp_first_packet = l_tile_index->nb_packet;
+                }
+
+                /* Tile-part in the codestream order, if known, to check the TLM markers and to get the PLM lengths */
+                l_tp_seq = p_j2k->m_specific_param.m_decoder.m_tp_seq;
+                if (l_tp_seq != (mi_UINT32)-1) {
+                        p_j2k->m_specific_param.m_decoder.m_tp_seq = l_tp_seq + 1;
+
+                        if ((l_tp_seq < p_j2k->m_specific_param.m_decoder.m_nb_tlm_tps)
+                                        && ((p_j2k->m_specific_param.m_decoder.m_tlm_tileno[l_tp_seq] != p_j2k->m_current_tile_number)
+                                        || (l_tot_len && (p_j2k->m_specific_param.m_decoder.m_tlm_pos[l_tp_seq + 1] - p_j2k->m_specific_param.m_decoder.m_tlm_pos[l_tp_seq] != (mi_OFF_T)l_tot_len)))) {
+                                mi_event_msg(p_manager, EVT_WARNING, "TLM markers inconsistent with the codestream, they are not used\n");
+                                p_j2k->m_specific_param.m_decoder.m_nb_tlm_tps = 0;
+                        }
+
+                        if ((l_tp_seq < p_j2k->m_specific_param.m_decoder.m_nb_plm_tps) && p_j2k->cstr_index
+                                        && (! p_j2k->m_specific_param.m_decoder.m_skip_data) && (! l_tcp->m_packet_lengths_lost)) {
+                                mi_UINT32 l_first = p_j2k->m_specific_param.m_decoder.m_plm_first[l_tp_seq];
+                                mi_UINT32 l_nb_packets = p_j2k->m_specific_param.m_decoder.m_plm_first[l_tp_seq + 1] - l_first;
+                                mi_UINT32 i;
+
+                                if (l_nb_packets) {
+                                        mi_packet_info_t * l_packet_info = mi_j2k_add_packet_lengths(p_j2k, l_nb_packets, p_manager);
+                                        if (! l_packet_info) {
+                                                return mi_FALSE;
+                                        }
+                                        for (i = 0; i < l_nb_packets; ++i) {
+                                                l_packet_info[i].end_pos = (mi_OFF_T)p_j2k->m_specific_param.m_decoder.m_plm_lengths[l_first + i];
+                                        }
+                                        p_j2k->m_specific_param.m_decoder.m_tp_has_plm_lengths = 1;
+                                }
+                        }
+                }
+
                 /* FIXME move this onto a separate method to call before reading any SOT, remove part about main_end header, use a index struct inside p_j2k */
                 /* if (p_j2k->cstr_info) {
                    if (l_tcp->first) {
@@ -4008,17 +4670,22 @@ static mi_BOOL mi_j2k_write_sod(     mi_j2k_t *p_j2k,
 {
         mi_codestream_info_t *l_cstr_info = 00;
         mi_UINT32 l_remaining_data;
+        mi_tcd_marker_info_t * l_marker_info = 00;
+        mi_UINT32 l_reserved_bytes = p_j2k->m_specific_param.m_encoder.m_reserved_bytes_for_PLT;
 
         /* preconditions */
         assert(p_j2k != 00);
         assert(p_manager != 00);
         assert(p_stream != 00);
 
-        mi_write_bytes(p_data,J2K_MS_SOD,2);                                   /* SOD */
-        p_data += 2;
+        /* make room for the EOF marker and the PLT markers */
+        if (p_total_data_size < 4 + l_reserved_bytes) {
+                mi_event_msg(p_manager, EVT_ERROR, "Not enough bytes in output buffer to write SOD marker\n");
+                return mi_FALSE;
+        }
+        l_remaining_data =  p_total_data_size - 4 - l_reserved_bytes;
 
-        /* make room for the EOF marker */
-        l_remaining_data =  p_total_data_size - 4;
+        mi_write_bytes(p_data,J2K_MS_SOD,2);                                   /* SOD */
 
         /* update tile coder */
         p_tile_coder->tp_num = p_j2k->m_specific_param.m_encoder.m_current_poc_tile_part_number ;
@@ -4051,15 +4718,121 @@ static mi_BOOL mi_j2k_write_sod(     mi_j2k_t *p_j2k,
                 }
         }
 
+        if (p_j2k->m_cp.m_specific_param.m_enc.m_plt_on) {
+                l_marker_info = mi_tcd_marker_info_create(p_tile_coder, mi_TRUE);
+                if (! l_marker_info) {
+                        mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to store the packet lengths of the tile-part\n");
+                        return mi_FALSE;
+                }
+        }
+
         *p_data_written = 0;
 
-        if (! mi_tcd_encode_tile(p_tile_coder, p_j2k->m_current_tile_number, p_data, p_data_written, l_remaining_data , l_cstr_info)) {
+        if (! mi_tcd_encode_tile(p_tile_coder, p_j2k->m_current_tile_number, p_data + 2, p_data_written, l_remaining_data , l_cstr_info, l_marker_info)) {
                 mi_event_msg(p_manager, EVT_ERROR, "Cannot encode tile\n");
+                mi_tcd_marker_info_destroy(l_marker_info);
                 return mi_FALSE;
         }
 
         *p_data_written += 2;
 
+        if (l_marker_info) {
+                /* the PLT markers go before SOD, at the end of the tile-part header */
+                mi_UINT32 l_plt_size = 0;
+                mi_BYTE * l_plt_data = (mi_BYTE *) mi_malloc(l_reserved_bytes);
+                if (! l_plt_data) {
+                        mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to write PLT marker\n");
+                        mi_tcd_marker_info_destroy(l_marker_info);
+                        return mi_FALSE;
+                }
+                if (! mi_j2k_write_plt_in_memory(p_j2k, l_marker_info, l_plt_data, &l_plt_size, p_manager)) {
+                        mi_free(l_plt_data);
+                        mi_tcd_marker_info_destroy(l_marker_info);
+                        return mi_FALSE;
+                }
+                assert(l_plt_size <= l_reserved_bytes);
+
+                memmove(p_data + l_plt_size, p_data, *p_data_written);
+                memcpy(p_data, l_plt_data, l_plt_size);
+                *p_data_written += l_plt_size;
+
+                mi_free(l_plt_data);
+                mi_tcd_marker_info_destroy(l_marker_info);
+        }
+
+        return mi_TRUE;
+}
+
+static mi_BOOL mi_j2k_write_plt_in_memory(    mi_j2k_t *p_j2k,
+                                                                        mi_tcd_marker_info_t * p_marker_info,
+                                                                        mi_BYTE * p_data,
+                                                                        mi_UINT32 * p_data_written,
+                                                                        mi_event_mgr_t * p_manager )
+{
+        mi_BYTE * l_begin_data = p_data;
+        mi_BYTE * l_Lplt_data;
+        mi_UINT32 l_Zplt = 0;
+        mi_UINT32 l_Lplt = 3;
+        mi_UINT32 i;
+
+        /* preconditions */
+        assert(p_j2k != 00);
+        assert(p_manager != 00);
+
+        mi_write_bytes(p_data,J2K_MS_PLT,2);                                   /* PLT */
+        p_data += 2;
+
+        l_Lplt_data = p_data;                                                   /* Lplt, written at the end */
+        p_data += 2;
+
+        mi_write_bytes(p_data,l_Zplt,1);                                       /* Zplt */
+        ++p_data;
+
+        for (i = 0; i < p_marker_info->packet_count; ++i) {
+                mi_BYTE l_bytes[5];
+                mi_UINT32 l_nb_bytes = 0;
+                mi_UINT32 l_packet_len = p_marker_info->p_packet_size[i];
+
+                /* 7 bits per byte, the last byte of a length has its upper bit cleared */
+                l_bytes[l_nb_bytes++] = (mi_BYTE)(l_packet_len & 0x7f);
+                l_packet_len >>= 7;
+                while (l_packet_len) {
+                        l_bytes[l_nb_bytes++] = (mi_BYTE)((l_packet_len & 0x7f) | 0x80);
+                        l_packet_len >>= 7;
+                }
+
+                /* a length is never split between two markers */
+                if (l_Lplt + l_nb_bytes > 65535) {
+                        if (l_Zplt == 255) {
+                                mi_event_msg(p_manager, EVT_ERROR, "More than 256 PLT markers would be needed for the tile-part\n");
+                                return mi_FALSE;
+                        }
+                        mi_write_bytes(l_Lplt_data,l_Lplt,2);
+
+                        mi_write_bytes(p_data,J2K_MS_PLT,2);                   /* PLT */
+                        p_data += 2;
+
+                        l_Lplt_data = p_data;                                   /* Lplt */
+                        p_data += 2;
+
+                        ++l_Zplt;
+                        mi_write_bytes(p_data,l_Zplt,1);                       /* Zplt */
+                        ++p_data;
+
+                        l_Lplt = 3;
+                }
+
+                l_Lplt += l_nb_bytes;
+                while (l_nb_bytes) {
+                        mi_write_bytes(p_data,l_bytes[--l_nb_bytes],1);        /* Iplt_ij */
+                        ++p_data;
+                }
+        }
+
+        mi_write_bytes(l_Lplt_data,l_Lplt,2);
+
+        *p_data_written = (mi_UINT32)(p_data - l_begin_data);
+
         return mi_TRUE;
 }
 
@@ -4070,9 +4843,8 @@ static mi_BOOL mi_j2k_read_sod (mi_j2k_t *p_j2k,
 {
         mi_SIZE_T l_current_read_size;
         mi_codestream_index_t * l_cstr_index = 00;
-        mi_BYTE ** l_current_data = 00;
         mi_tcp_t * l_tcp = 00;
-        mi_UINT32 * l_tile_len = 00;
+        mi_UINT32 l_data_size = 0;
         mi_BOOL l_sot_length_pb_detected = mi_FALSE;
 
         /* preconditions */
@@ -4098,39 +4870,14 @@ static mi_BOOL mi_j2k_read_sod (mi_j2k_t *p_j2k,
             }
         }
 
-        l_current_data = &(l_tcp->m_data);
-        l_tile_len = &l_tcp->m_data_size;
-
         /* Patch to support new PHR data */
         if (p_j2k->m_specific_param.m_decoder.m_sot_length) {
-            /* If we are here, we'll try to read the data after allocation */
+            /* If we are here, we'll try to read the data, the room for it being made by mi_j2k_read_sod_packets */
             /* Check enough bytes left in stream before allocation */
             if ((mi_OFF_T)p_j2k->m_specific_param.m_decoder.m_sot_length > mi_stream_get_number_byte_left(p_stream)) {
                 mi_event_msg(p_manager, EVT_ERROR, "Tile part length size inconsistent with stream length\n");
                 return mi_FALSE;
             }
-            if (! *l_current_data) {
-                /* LH: oddly enough, in this path, l_tile_len!=0.
-                 * TODO: If this was consistent, we could simplify the code to only use realloc(), as realloc(0,...) default to malloc(0,...).
-                 */
-                *l_current_data = (mi_BYTE*) mi_malloc(p_j2k->m_specific_param.m_decoder.m_sot_length);
-            }
-            else {
-                mi_BYTE *l_new_current_data = (mi_BYTE *) mi_realloc(*l_current_data, *l_tile_len + p_j2k->m_specific_param.m_decoder.m_sot_length);
-                if (! l_new_current_data) {
-                        mi_free(*l_current_data);
-                        /*nothing more is done as l_current_data will be set to null, and just
-                          afterward we enter in the error path
-                          and the actual tile_len is updated (committed) at the end of the
-                          function. */
-                }
-                *l_current_data = l_new_current_data;
-            }
-            
-            if (*l_current_data == 00) {
-                mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to decode tile\n");
-                return mi_FALSE;
-            }
         }
         else {
             l_sot_length_pb_detected = mi_TRUE;
@@ -4161,11 +4908,9 @@ static mi_BOOL mi_j2k_read_sod (mi_j2k_t *p_j2k,
 
         /* Patch to support new PHR data */
         if (!l_sot_length_pb_detected) {
-            l_current_read_size = mi_stream_read_data(
-                        p_stream,
-                        *l_current_data + *l_tile_len,
-                        p_j2k->m_specific_param.m_decoder.m_sot_length,
-                        p_manager);
+            if (! mi_j2k_read_sod_packets(p_j2k, p_stream, &l_current_read_size, &l_data_size, p_manager)) {
+                return mi_FALSE;
+            }
         }
         else
         {
@@ -4179,8 +4924,167 @@ static mi_BOOL mi_j2k_read_sod (mi_j2k_t *p_j2k,
                 p_j2k->m_specific_param.m_decoder.m_state = J2K_STATE_TPHSOT;
         }
 
-        *l_tile_len += (mi_UINT32)l_current_read_size;
+        l_tcp->m_data_size += l_data_size;
+
+        return mi_TRUE;
+}
+
+static mi_BOOL mi_j2k_grow_tile_data( mi_tcp_t * p_tcp,
+                                        mi_UINT32 p_size,
+                                        mi_event_mgr_t * p_manager )
+{
+        mi_BYTE * l_new_data = 00;
+        /* a tile is found from its data, which is kept even when no byte of the tile is decoded */
+        mi_SIZE_T l_new_size = (mi_SIZE_T)p_tcp->m_data_size + p_size;
+        if (! l_new_size) {
+                l_new_size = 1;
+        }
+
+        if (p_tcp->m_data_borrowed) {
+                /* the data of the previous tile-parts is in the stream, the tile-parts are gathered in a copy */
+                l_new_data = (mi_BYTE *) mi_malloc(l_new_size);
+                if (l_new_data) {
+                        memcpy(l_new_data, p_tcp->m_data, p_tcp->m_data_size);
+                }
+                p_tcp->m_data_borrowed = 0;
+        }
+        else {
+                l_new_data = (mi_BYTE *) mi_realloc(p_tcp->m_data, l_new_size);
+                if (! l_new_data) {
+                        mi_free(p_tcp->m_data);
+                }
+        }
+
+        p_tcp->m_data = l_new_data;
+        if (! l_new_data) {
+                p_tcp->m_data_size = 0;
+                mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to decode tile\n");
+                return mi_FALSE;
+        }
+
+        return mi_TRUE;
+}
+
+static mi_BOOL mi_j2k_read_sod_packets(   mi_j2k_t *p_j2k,
+                                            mi_stream_private_t *p_stream,
+                                            mi_SIZE_T * p_read_size,
+                                            mi_UINT32 * p_data_size,
+                                            mi_event_mgr_t * p_manager )
+{
+        mi_UINT32 l_sot_length = p_j2k->m_specific_param.m_decoder.m_sot_length;
+        mi_UINT32 l_first = p_j2k->m_specific_param.m_decoder.m_tp_first_packet;
+        mi_UINT32 l_nb_packets = 0, i, j;
+        mi_tcp_t * l_tcp = &(p_j2k->m_cp.tcps[p_j2k->m_current_tile_number]);
+        mi_tile_index_t * l_tile_index = 00;
+        mi_packet_info_t * l_packet_index = 00;
+        mi_BYTE * l_needed = 00;
+        mi_t2_t * l_t2 = 00;
+        mi_BOOL l_use_lengths = mi_FALSE;
+        mi_BOOL l_in_place;
+        mi_OFF_T l_total = 0, l_needed_size = 0, l_pos, l_run, l_length, l_skipped;
+        mi_SIZE_T l_read;
+        mi_BYTE * l_data;
+
+        if (p_j2k->cstr_index && p_j2k->cstr_index->tile_index) {
+                l_tile_index = &(p_j2k->cstr_index->tile_index[p_j2k->m_current_tile_number]);
+                l_nb_packets = l_tile_index->nb_packet - l_first;
+        }
+
+        /* the lengths must match the tile-part (they are not used with packed packet headers) */
+        if (l_nb_packets && (! l_tcp->m_packet_lengths_lost) && (! p_j2k->m_cp.ppm) && (! l_tcp->ppt)) {
+                l_packet_index = l_tile_index->packet_index + l_first;
+                for (i = 0; i < l_nb_packets; ++i) {
+                        l_total += l_packet_index[i].end_pos - l_packet_index[i].start_pos;
+                }
+                l_use_lengths = (l_total == (mi_OFF_T)l_sot_length);
+        }
+
+        if (l_use_lengths) {
+                l_needed = (mi_BYTE *) mi_malloc(l_nb_packets);
+                l_t2 = mi_t2_create(p_j2k->m_private_image, &(p_j2k->m_cp));
+                l_use_lengths = l_needed && l_t2
+                        && mi_t2_get_needed_packets(l_t2, p_j2k->m_current_tile_number, l_first, l_nb_packets, l_needed);
+                if (l_t2) {
+                        mi_t2_destroy(l_t2);
+                }
+        }
+
+        if (! l_use_lengths) {
+                mi_free(l_needed);
+                /* all the packets of the tile-part are read: the packets are not known any more from the lengths */
+                if (l_tile_index) {
+                        l_tile_index->nb_packet = l_first;
+                }
+                l_tcp->m_packet_lengths_lost = 1;
+
+                if (mi_stream_reads_in_place(p_stream) && ! l_tcp->m_data) {
+                        /* the data of the tile is the one of the stream as long as there is no other tile-part */
+                        l_tcp->m_data = mi_stream_read_in_place(p_stream, l_sot_length, p_read_size);
+                        l_tcp->m_data_borrowed = 1;
+                }
+                else {
+                        if (! mi_j2k_grow_tile_data(l_tcp, l_sot_length, p_manager)) {
+                                return mi_FALSE;
+                        }
+                        *p_read_size = mi_stream_read_data(p_stream, l_tcp->m_data + l_tcp->m_data_size, l_sot_length, p_manager);
+                }
+                *p_data_size = (mi_UINT32)*p_read_size;
+                return mi_TRUE;
+        }
+
+        /* only the packets to decode are kept */
+        for (i = 0; i < l_nb_packets; ++i) {
+                if (l_needed[i]) {
+                        l_needed_size += l_packet_index[i].end_pos - l_packet_index[i].start_pos;
+                }
+        }
+        l_in_place = mi_stream_reads_in_place(p_stream) && (! l_tcp->m_data) && (l_needed_size == l_total);
+        if ((! l_in_place) && ! mi_j2k_grow_tile_data(l_tcp, (mi_UINT32)l_needed_size, p_manager)) {
+                mi_free(l_needed);
+                return mi_FALSE;
+        }
+
+        /* read the runs of packets to decode, skip the others */
+        *p_read_size = 0;
+        *p_data_size = 0;
+        l_pos = mi_stream_tell(p_stream);
+        for (i = 0; i < l_nb_packets; i = j) {
+                l_run = 0;
+                for (j = i; (j < l_nb_packets) && (l_needed[j] == l_needed[i]); ++j) {
+                        l_length = l_packet_index[j].end_pos - l_packet_index[j].start_pos;
+                        l_packet_index[j].start_pos = l_pos;
+                        l_packet_index[j].end_pos = l_pos + l_length - 1;
+                        l_pos += l_length;
+                        l_run += l_length;
+                }
+
+                if (l_needed[i]) {
+                        if (l_in_place) {
+                                /* all the packets are decoded: they are a single run, read as in the stream */
+                                l_data = mi_stream_read_in_place(p_stream, (mi_SIZE_T)l_run, &l_read);
+                                l_tcp->m_data = l_data;
+                                l_tcp->m_data_borrowed = 1;
+                        }
+                        else {
+                                l_read = mi_stream_read_data(p_stream, l_tcp->m_data + l_tcp->m_data_size + *p_data_size, (mi_SIZE_T)l_run, p_manager);
+                        }
+                        *p_read_size += l_read;
+                        *p_data_size += (mi_UINT32)l_read;
+                        if (l_read != (mi_SIZE_T)l_run) {
+                                break;
+                        }
+                }
+                else {
+                        l_skipped = mi_stream_skip(p_stream, l_run, p_manager);
+                        if (l_skipped != l_run) {
+                                break;
+                        }
+                        *p_read_size += (mi_SIZE_T)l_run;
+                        l_tcp->m_nb_packets_left_out += j - i;
+                }
+        }
 
+        mi_free(l_needed);
         return mi_TRUE;
 }
 
@@ -4480,6 +5384,31 @@ static mi_BOOL mi_j2k_update_rates(  mi_j2k_t *p_j2k,
 
         l_tile_size += mi_j2k_get_specific_header_sizes(p_j2k);
 
+        p_j2k->m_specific_param.m_encoder.m_reserved_bytes_for_PLT = 0;
+        if (l_cp->m_specific_param.m_enc.m_plt_on) {
+                mi_UINT32 l_max_packet_count = 0;
+                mi_UINT32 l_max_nb_tp = 0;
+
+                l_tcp = l_cp->tcps;
+                for (i = 0; i < l_cp->th * l_cp->tw; ++i) {
+                        mi_UINT32 l_nb_tp = 0;
+                        for (k = 0; k <= l_tcp->numpocs; ++k) {
+                                l_nb_tp += mi_j2k_get_num_tp(l_cp, k, i);
+                        }
+                        l_max_packet_count = mi_uint_max(l_max_packet_count, mi_pi_get_encoding_packet_count(l_image, l_cp, i));
+                        l_max_nb_tp = mi_uint_max(l_max_nb_tp, l_nb_tp);
+                        ++l_tcp;
+                }
+
+                /* at most 5 bytes per packet length, hence at least 13106 lengths in each
+                   marker besides its 5 bytes of PLT, Lplt and Zplt */
+                p_j2k->m_specific_param.m_encoder.m_reserved_bytes_for_PLT =
+                        5 * l_max_packet_count + 5 * mi_uint_ceildiv(l_max_packet_count + 1, 13106);
+
+                /* every tile-part keeps the whole room before writing its markers */
+                l_tile_size += (l_max_nb_tp + 1) * p_j2k->m_specific_param.m_encoder.m_reserved_bytes_for_PLT;
+        }
+
         p_j2k->m_specific_param.m_encoder.m_encoded_tile_size = l_tile_size;
         p_j2k->m_specific_param.m_encoder.m_encoded_tile_data =
                         (mi_BYTE *) mi_malloc(p_j2k->m_specific_param.m_encoder.m_encoded_tile_size);
@@ -5541,12 +6470,23 @@ static mi_BOOL mi_j2k_read_cbd (      mi_j2k_t *p_j2k,
 /* J2K / JPT decoder interface                                             */
 /* ----------------------------------------------------------------------- */
 
-void mi_j2k_setup_decoder(mi_j2k_t *j2k, mi_dparameters_t *parameters)
+mi_BOOL mi_j2k_setup_decoder(mi_j2k_t *j2k, mi_dparameters_t *parameters, mi_event_mgr_t * p_manager)
 {
         if(j2k && parameters) {
                 j2k->m_cp.m_specific_param.m_dec.m_layer = parameters->cp_layer;
                 j2k->m_cp.m_specific_param.m_dec.m_reduce = parameters->cp_reduce;
+
+                if (parameters->num_threads > 0) {
+                        if (!mi_has_thread_support()) {
+                                mi_event_msg(p_manager, EVT_WARNING, "Library built without thread support: num_threads ignored\n");
+                        }
+                        else if (! mi_j2k_set_threads(j2k, (mi_UINT32)parameters->num_threads)) {
+                                mi_event_msg(p_manager, EVT_ERROR, "Cannot create a thread pool of %d threads\n", parameters->num_threads);
+                                return mi_FALSE;
+                        }
+                }
         }
+        return mi_TRUE;
 }
 
 /* ----------------------------------------------------------------------- */
@@ -5579,6 +6519,13 @@ mi_j2k_t* mi_j2k_create_compress(void)
                 return NULL;
         }
 
+        /* synchronous thread pool, replaced at setup if threads are requested */
+        l_j2k->m_tp = mi_thread_pool_create(0);
+        if (! l_j2k->m_tp) {
+                mi_j2k_destroy(l_j2k);
+                return NULL;
+        }
+
         /* execution list creation*/
         l_j2k->m_procedure_list = mi_procedure_list_create();
         if (! l_j2k->m_procedure_list) {
@@ -5823,6 +6770,16 @@ mi_BOOL mi_j2k_setup_encoder(     mi_j2k_t *p_j2k,
             return mi_FALSE;
         }
 
+        if (parameters->num_threads > 0) {
+            if (!mi_has_thread_support()) {
+                mi_event_msg(p_manager, EVT_WARNING, "Library built without thread support: num_threads ignored\n");
+            }
+            else if (! mi_j2k_set_threads(p_j2k, (mi_UINT32)parameters->num_threads)) {
+                mi_event_msg(p_manager, EVT_ERROR, "Cannot create a thread pool of %d threads\n", parameters->num_threads);
+                return mi_FALSE;
+            }
+        }
+
         /* keep a link to cp so that we can destroy it later in j2k_destroy_compress */
         cp = &(p_j2k->m_cp);
 
@@ -6017,6 +6974,10 @@ mi_BOOL mi_j2k_setup_encoder(     mi_j2k_t *p_j2k,
                 cp->m_specific_param.m_enc.m_tp_flag = (mi_BYTE)parameters->tp_flag;
                 cp->m_specific_param.m_enc.m_tp_on = 1;
         }
+
+        if (parameters->plt_on) {
+                cp->m_specific_param.m_enc.m_plt_on = 1;
+        }
 #pragma endregion
 
 #pragma region ص㣨Ƭã
@@ -6396,8 +7357,13 @@ mi_BOOL mi_j2k_read_header(   mi_stream_private_t *p_stream,
                 return mi_FALSE;
         }
 
-        return mi_TRUE;
-}
+        /* Position of the tile-parts given by the TLM markers */
+        if (! mi_j2k_index_tlm_tile_parts(p_j2k, p_stream, p_manager)) {
+                return mi_FALSE;
+        }
+
+        return mi_TRUE;
+}
 
 static mi_BOOL mi_j2k_setup_header_reading (mi_j2k_t *p_j2k, mi_event_mgr_t * p_manager)
 {
@@ -7035,7 +8001,7 @@ static mi_BOOL mi_j2k_copy_default_tcp_and_create_tcd (       mi_j2k_t * p_j2k,
                 return mi_FALSE;
         }
 
-        if ( !mi_tcd_init(p_j2k->m_tcd, l_image, &(p_j2k->m_cp)) ) {
+        if ( !mi_tcd_init(p_j2k->m_tcd, l_image, &(p_j2k->m_cp), p_j2k->m_tp) ) {
                 mi_tcd_destroy(p_j2k->m_tcd);
                 p_j2k->m_tcd = 00;
                 mi_event_msg(p_manager, EVT_ERROR, "Cannot decode tile, memory error\n");
@@ -7075,6 +8041,17 @@ void mi_j2k_destroy (mi_j2k_t *p_j2k)
                         p_j2k->m_specific_param.m_decoder.m_header_data = 00;
                         p_j2k->m_specific_param.m_decoder.m_header_data_size = 0;
                 }
+
+                mi_free(p_j2k->m_specific_param.m_decoder.m_tlm_tileno);
+                p_j2k->m_specific_param.m_decoder.m_tlm_tileno = 00;
+                mi_free(p_j2k->m_specific_param.m_decoder.m_tlm_pos);
+                p_j2k->m_specific_param.m_decoder.m_tlm_pos = 00;
+                p_j2k->m_specific_param.m_decoder.m_nb_tlm_tps = 0;
+                mi_free(p_j2k->m_specific_param.m_decoder.m_plm_first);
+                p_j2k->m_specific_param.m_decoder.m_plm_first = 00;
+                mi_free(p_j2k->m_specific_param.m_decoder.m_plm_lengths);
+                p_j2k->m_specific_param.m_decoder.m_plm_lengths = 00;
+                p_j2k->m_specific_param.m_decoder.m_nb_plm_tps = 0;
         }
         else {
 
@@ -7098,6 +8075,9 @@ void mi_j2k_destroy (mi_j2k_t *p_j2k)
 
         mi_tcd_destroy(p_j2k->m_tcd);
 
+        mi_thread_pool_destroy(p_j2k->m_tp);
+        p_j2k->m_tp = 00;
+
         mi_j2k_cp_destroy(&(p_j2k->m_cp));
         memset(&(p_j2k->m_cp),0,sizeof(mi_cp_t));
 
@@ -7232,10 +8212,16 @@ static void mi_j2k_tcp_destroy (mi_tcp_t *p_tcp)
 static void mi_j2k_tcp_data_destroy (mi_tcp_t *p_tcp)
 {
         if (p_tcp->m_data) {
-                mi_free(p_tcp->m_data);
+                /* data borrowed from a stream read in place belongs to the stream */
+                if (! p_tcp->m_data_borrowed) {
+                        mi_free(p_tcp->m_data);
+                }
                 p_tcp->m_data = NULL;
                 p_tcp->m_data_size = 0;
+                p_tcp->m_data_borrowed = 0;
         }
+        mi_pi_destroy_schedule(p_tcp->m_packet_schedule);
+        p_tcp->m_packet_schedule = 00;
 }
 
 static void mi_j2k_cp_destroy (mi_cp_t *p_cp)
@@ -7575,6 +8561,11 @@ mi_BOOL mi_j2k_read_tile_header(      mi_j2k_t * p_j2k,
                                 }
                         }
                         if (! p_j2k->m_specific_param.m_decoder.m_can_decode){
+                                /* Go directly to the next tile-part to decode if the TLM markers tell where it is */
+                                if (! mi_j2k_seek_next_tile_part(p_j2k, p_stream, p_manager)) {
+                                        return mi_FALSE;
+                                }
+
                                 /* Try to read 2 bytes (the next marker ID) from stream and copy them into the buffer */
                                 if (mi_stream_read_data(p_stream,p_j2k->m_specific_param.m_decoder.m_header_data,2,p_manager) != 2) {
                                         mi_event_msg(p_manager, EVT_ERROR, "Stream too short\n");
@@ -7591,6 +8582,11 @@ mi_BOOL mi_j2k_read_tile_header(      mi_j2k_t * p_j2k,
                         p_j2k->m_specific_param.m_decoder.m_can_decode = 0;
                         p_j2k->m_specific_param.m_decoder.m_state = J2K_STATE_TPHSOT;
 
+                        /* Go directly to the next tile-part to decode if the TLM markers tell where it is */
+                        if (! mi_j2k_seek_next_tile_part(p_j2k, p_stream, p_manager)) {
+                                return mi_FALSE;
+                        }
+
                         /* Try to read 2 bytes (the next marker ID) from stream and copy them into the buffer */
                         if (mi_stream_read_data(p_stream,p_j2k->m_specific_param.m_decoder.m_header_data,2,p_manager) != 2) {
                                 mi_event_msg(p_manager, EVT_ERROR, "Stream too short\n");
@@ -7660,8 +8656,6 @@ mi_BOOL mi_j2k_decode_tile (  mi_j2k_t * p_j2k,
                                                         mi_stream_private_t *p_stream,
                                                         mi_event_mgr_t * p_manager )
 {
-        mi_UINT32 l_current_marker;
-        mi_BYTE l_data [2];
         mi_tcp_t * l_tcp;
 
         /* preconditions */
@@ -7691,7 +8685,13 @@ mi_BOOL mi_j2k_decode_tile (  mi_j2k_t * p_j2k,
                 return mi_FALSE;
         }
 
-        if (! mi_tcd_update_tile_data(p_j2k->m_tcd,p_data,p_data_size)) {
+        if (l_tcp->m_data_borrowed) {
+                /* the compressed data is not read any more, its memory is given back to the stream */
+                mi_stream_release_in_place(p_stream, l_tcp->m_data, l_tcp->m_data_size);
+        }
+
+        /* with a buffer of the caller, the samples are already there */
+        if (! p_j2k->m_tcd->m_output && ! mi_tcd_update_tile_data(p_j2k->m_tcd,p_data,p_data_size)) {
                 return mi_FALSE;
         }
 
@@ -7701,6 +8701,16 @@ mi_BOOL mi_j2k_decode_tile (  mi_j2k_t * p_j2k,
         p_j2k->m_tcd->tcp = 0;*/
         mi_j2k_tcp_data_destroy(l_tcp);
 
+        return mi_j2k_end_tile_decoding(p_j2k, p_stream, p_manager);
+}
+
+static mi_BOOL mi_j2k_end_tile_decoding ( mi_j2k_t * p_j2k,
+                                            mi_stream_private_t *p_stream,
+                                            mi_event_mgr_t * p_manager )
+{
+        mi_UINT32 l_current_marker;
+        mi_BYTE l_data [2];
+
         p_j2k->m_specific_param.m_decoder.m_can_decode = 0;
         p_j2k->m_specific_param.m_decoder.m_state &= (~ (0x0080u));/* FIXME J2K_DEC_STATE_DATA);*/
 
@@ -7710,6 +8720,9 @@ mi_BOOL mi_j2k_decode_tile (  mi_j2k_t * p_j2k,
         }
 
         if (p_j2k->m_specific_param.m_decoder.m_state != 0x0100){ /*FIXME J2K_DEC_STATE_EOC)*/
+                if (! mi_j2k_seek_next_tile_part(p_j2k, p_stream, p_manager)) {
+                        return mi_FALSE;
+                }
                 if (mi_stream_read_data(p_stream,l_data,2,p_manager) != 2) {
                         mi_event_msg(p_manager, EVT_ERROR, "Stream too short\n");
                         return mi_FALSE;
@@ -8207,6 +9220,12 @@ mi_j2k_t* mi_j2k_create_decompress(void)
                 return 00;
         }
 
+        l_j2k->m_tp = mi_thread_pool_create(0);
+        if (! l_j2k->m_tp) {
+                mi_j2k_destroy(l_j2k);
+                return 00;
+        }
+
         return l_j2k;
 }
 
@@ -8260,44 +9279,46 @@ static mi_UINT32 mi_j2k_get_SPCod_SPCoc_size (       mi_j2k_t *p_j2k,
 
 static mi_BOOL mi_j2k_compare_SPCod_SPCoc(mi_j2k_t *p_j2k, mi_UINT32 p_tile_no, mi_UINT32 p_first_comp_no, mi_UINT32 p_second_comp_no)
 {
-	mi_UINT32 i;
 	mi_cp_t *l_cp = NULL;
 	mi_tcp_t *l_tcp = NULL;
-	mi_tccp_t *l_tccp0 = NULL;
-	mi_tccp_t *l_tccp1 = NULL;
-	
+
 	/* preconditions */
 	assert(p_j2k != 00);
-	
+
 	l_cp = &(p_j2k->m_cp);
 	l_tcp = &l_cp->tcps[p_tile_no];
-	l_tccp0 = &l_tcp->tccps[p_first_comp_no];
-	l_tccp1 = &l_tcp->tccps[p_second_comp_no];
-	
-	if (l_tccp0->numresolutions != l_tccp1->numresolutions) {
+
+	return mi_j2k_compare_tccp_SPCod_SPCoc(&l_tcp->tccps[p_first_comp_no], &l_tcp->tccps[p_second_comp_no]);
+}
+
+static mi_BOOL mi_j2k_compare_tccp_SPCod_SPCoc(const mi_tccp_t *p_tccp0, const mi_tccp_t *p_tccp1)
+{
+	mi_UINT32 i;
+
+	if (p_tccp0->numresolutions != p_tccp1->numresolutions) {
 		return mi_FALSE;
 	}
-	if (l_tccp0->cblkw != l_tccp1->cblkw) {
+	if (p_tccp0->cblkw != p_tccp1->cblkw) {
 		return mi_FALSE;
 	}
-	if (l_tccp0->cblkh != l_tccp1->cblkh) {
+	if (p_tccp0->cblkh != p_tccp1->cblkh) {
 		return mi_FALSE;
 	}
-	if (l_tccp0->cblksty != l_tccp1->cblksty) {
+	if (p_tccp0->cblksty != p_tccp1->cblksty) {
 		return mi_FALSE;
 	}
-	if (l_tccp0->qmfbid != l_tccp1->qmfbid) {
+	if (p_tccp0->qmfbid != p_tccp1->qmfbid) {
 		return mi_FALSE;
 	}
-	if ((l_tccp0->csty & J2K_CCP_CSTY_PRT) != (l_tccp1->csty & J2K_CCP_CSTY_PRT)) {
+	if ((p_tccp0->csty & J2K_CCP_CSTY_PRT) != (p_tccp1->csty & J2K_CCP_CSTY_PRT)) {
 		return mi_FALSE;
 	}
 	
-	for (i = 0U; i < l_tccp0->numresolutions; ++i) {
-		if (l_tccp0->prcw[i] != l_tccp1->prcw[i]) {
+	for (i = 0U; i < p_tccp0->numresolutions; ++i) {
+		if (p_tccp0->prcw[i] != p_tccp1->prcw[i]) {
 			return mi_FALSE;
 		}
-		if (l_tccp0->prch[i] != l_tccp1->prch[i]) {
+		if (p_tccp0->prch[i] != p_tccp1->prch[i]) {
 			return mi_FALSE;
 		}
 	}
@@ -8311,60 +9332,69 @@ static mi_BOOL mi_j2k_write_SPCod_SPCoc(     mi_j2k_t *p_j2k,
                                                                     mi_UINT32 * p_header_size,
                                                                     struct mi_event_mgr * p_manager )
 {
-        mi_UINT32 i;
         mi_cp_t *l_cp = 00;
         mi_tcp_t *l_tcp = 00;
-        mi_tccp_t *l_tccp = 00;
 
         /* preconditions */
         assert(p_j2k != 00);
-        assert(p_header_size != 00);
-        assert(p_manager != 00);
-        assert(p_data != 00);
 
         l_cp = &(p_j2k->m_cp);
         l_tcp = &l_cp->tcps[p_tile_no];
-        l_tccp = &l_tcp->tccps[p_comp_no];
 
         /* preconditions again */
         assert(p_tile_no < (l_cp->tw * l_cp->th));
         assert(p_comp_no <(p_j2k->m_private_image->numcomps));
 
+        return mi_j2k_write_tccp_SPCod_SPCoc(&l_tcp->tccps[p_comp_no],p_data,p_header_size,p_manager);
+}
+
+static mi_BOOL mi_j2k_write_tccp_SPCod_SPCoc(const mi_tccp_t *p_tccp,
+                                               mi_BYTE * p_data,
+                                               mi_UINT32 * p_header_size,
+                                               struct mi_event_mgr * p_manager )
+{
+        mi_UINT32 i;
+
+        /* preconditions */
+        assert(p_header_size != 00);
+        assert(p_manager != 00);
+        assert(p_data != 00);
+
         if (*p_header_size < 5) {
                 mi_event_msg(p_manager, EVT_ERROR, "Error writing SPCod SPCoc element\n");
                 return mi_FALSE;
         }
 
-        mi_write_bytes(p_data,l_tccp->numresolutions - 1, 1);  /* SPcoc (D) */
+        mi_write_bytes(p_data,p_tccp->numresolutions - 1, 1);  /* SPcoc (D) */
         ++p_data;
 
-        mi_write_bytes(p_data,l_tccp->cblkw - 2, 1);                   /* SPcoc (E) */
+        mi_write_bytes(p_data,p_tccp->cblkw - 2, 1);                   /* SPcoc (E) */
         ++p_data;
 
-        mi_write_bytes(p_data,l_tccp->cblkh - 2, 1);                   /* SPcoc (F) */
+        mi_write_bytes(p_data,p_tccp->cblkh - 2, 1);                   /* SPcoc (F) */
         ++p_data;
 
-        mi_write_bytes(p_data,l_tccp->cblksty, 1);                             /* SPcoc (G) */
+        mi_write_bytes(p_data,p_tccp->cblksty, 1);                             /* SPcoc (G) */
         ++p_data;
 
-        mi_write_bytes(p_data,l_tccp->qmfbid, 1);                              /* SPcoc (H) */
+        mi_write_bytes(p_data,p_tccp->qmfbid, 1);                              /* SPcoc (H) */
         ++p_data;
 
         *p_header_size = *p_header_size - 5;
 
-        if (l_tccp->csty & J2K_CCP_CSTY_PRT) {
+        if (p_tccp->csty & J2K_CCP_CSTY_PRT) {
 
-                if (*p_header_size < l_tccp->numresolutions) {
+                if (*p_header_size < p_tccp->numresolutions) {
                         mi_event_msg(p_manager, EVT_ERROR, "Error writing SPCod SPCoc element\n");
                         return mi_FALSE;
                 }
 
-                for (i = 0; i < l_tccp->numresolutions; ++i) {
-                        mi_write_bytes(p_data,l_tccp->prcw[i] + (l_tccp->prch[i] << 4), 1);    /* SPcoc (I_i) */
+                for (i = 0; i < p_tccp->numresolutions; ++i) {
+                        mi_write_bytes(p_data,p_tccp->prcw[i] + (p_tccp->prch[i] << 4), 1);    /* SPcoc (I_i) */
                         ++p_data;
                 }
 
-                *p_header_size = *p_header_size - l_tccp->numresolutions;
+                *p_header_size = *p_header_size - p_tccp->numresolutions;
         }
 
         return mi_TRUE;
@@ -8548,42 +9578,44 @@ static mi_BOOL mi_j2k_compare_SQcd_SQcc(mi_j2k_t *p_j2k, mi_UINT32 p_tile_no, mi
 {
 	mi_cp_t *l_cp = NULL;
 	mi_tcp_t *l_tcp = NULL;
-	mi_tccp_t *l_tccp0 = NULL;
-	mi_tccp_t *l_tccp1 = NULL;
-	mi_UINT32 l_band_no, l_num_bands;
-	
+
 	/* preconditions */
 	assert(p_j2k != 00);
-	
+
 	l_cp = &(p_j2k->m_cp);
 	l_tcp = &l_cp->tcps[p_tile_no];
-	l_tccp0 = &l_tcp->tccps[p_first_comp_no];
-	l_tccp1 = &l_tcp->tccps[p_second_comp_no];
-	
-	if (l_tccp0->qntsty != l_tccp1->qntsty ) {
+
+	return mi_j2k_compare_tccp_SQcd_SQcc(&l_tcp->tccps[p_first_comp_no], &l_tcp->tccps[p_second_comp_no]);
+}
+
+static mi_BOOL mi_j2k_compare_tccp_SQcd_SQcc(const mi_tccp_t *p_tccp0, const mi_tccp_t *p_tccp1)
+{
+	mi_UINT32 l_band_no, l_num_bands;
+
+	if (p_tccp0->qntsty != p_tccp1->qntsty ) {
 		return mi_FALSE;
 	}
-	if (l_tccp0->numgbits != l_tccp1->numgbits ) {
+	if (p_tccp0->numgbits != p_tccp1->numgbits ) {
 		return mi_FALSE;
 	}
-	if (l_tccp0->qntsty == J2K_CCP_QNTSTY_SIQNT) {
+	if (p_tccp0->qntsty == J2K_CCP_QNTSTY_SIQNT) {
 		l_num_bands = 1U;
 	} else {
-		l_num_bands = l_tccp0->numresolutions * 3U - 2U;
-		if (l_num_bands != (l_tccp1->numresolutions * 3U - 2U)) {
+		l_num_bands = p_tccp0->numresolutions * 3U - 2U;
+		if (l_num_bands != (p_tccp1->numresolutions * 3U - 2U)) {
 			return mi_FALSE;
 		}
 	}
 	
 	for (l_band_no = 0; l_band_no < l_num_bands; ++l_band_no) {
-		if (l_tccp0->stepsizes[l_band_no].expn != l_tccp1->stepsizes[l_band_no].expn ) {
+		if (p_tccp0->stepsizes[l_band_no].expn != p_tccp1->stepsizes[l_band_no].expn ) {
 			return mi_FALSE;
 		}
 	}
-	if (l_tccp0->qntsty != J2K_CCP_QNTSTY_NOQNT)
+	if (p_tccp0->qntsty != J2K_CCP_QNTSTY_NOQNT)
 	{
 		for (l_band_no = 0; l_band_no < l_num_bands; ++l_band_no) {
-			if (l_tccp0->stepsizes[l_band_no].mant != l_tccp1->stepsizes[l_band_no].mant ) {
+			if (p_tccp0->stepsizes[l_band_no].mant != p_tccp1->stepsizes[l_band_no].mant ) {
 				return mi_FALSE;
 			}
 		}
@@ -8599,31 +9631,39 @@ static mi_BOOL mi_j2k_write_SQcd_SQcc(       mi_j2k_t *p_j2k,
                                                                 mi_UINT32 * p_header_size,
                                                                 struct mi_event_mgr * p_manager )
 {
-        mi_UINT32 l_header_size;
-        mi_UINT32 l_band_no, l_num_bands;
-        mi_UINT32 l_expn,l_mant;
-
         mi_cp_t *l_cp = 00;
         mi_tcp_t *l_tcp = 00;
-        mi_tccp_t *l_tccp = 00;
 
         /* preconditions */
         assert(p_j2k != 00);
-        assert(p_header_size != 00);
-        assert(p_manager != 00);
-        assert(p_data != 00);
 
         l_cp = &(p_j2k->m_cp);
         l_tcp = &l_cp->tcps[p_tile_no];
-        l_tccp = &l_tcp->tccps[p_comp_no];
 
         /* preconditions again */
         assert(p_tile_no < l_cp->tw * l_cp->th);
         assert(p_comp_no <p_j2k->m_private_image->numcomps);
 
-        l_num_bands = (l_tccp->qntsty == J2K_CCP_QNTSTY_SIQNT) ? 1 : (l_tccp->numresolutions * 3 - 2);
+        return mi_j2k_write_tccp_SQcd_SQcc(&l_tcp->tccps[p_comp_no],p_data,p_header_size,p_manager);
+}
 
-        if (l_tccp->qntsty == J2K_CCP_QNTSTY_NOQNT)  {
+static mi_BOOL mi_j2k_write_tccp_SQcd_SQcc(const mi_tccp_t *p_tccp,
+                                             mi_BYTE * p_data,
+                                             mi_UINT32 * p_header_size,
+                                             struct mi_event_mgr * p_manager )
+{
+        mi_UINT32 l_header_size;
+        mi_UINT32 l_band_no, l_num_bands;
+        mi_UINT32 l_expn,l_mant;
+
+        /* preconditions */
+        assert(p_header_size != 00);
+        assert(p_manager != 00);
+        assert(p_data != 00);
+
+        l_num_bands = (p_tccp->qntsty == J2K_CCP_QNTSTY_SIQNT) ? 1 : (p_tccp->numresolutions * 3 - 2);
+
+        if (p_tccp->qntsty == J2K_CCP_QNTSTY_NOQNT)  {
                 l_header_size = 1 + l_num_bands;
 
                 if (*p_header_size < l_header_size) {
@@ -8631,11 +9671,11 @@ static mi_BOOL mi_j2k_write_SQcd_SQcc(       mi_j2k_t *p_j2k,
                         return mi_FALSE;
                 }
 
-                mi_write_bytes(p_data,l_tccp->qntsty + (l_tccp->numgbits << 5), 1);    /* Sqcx */
+                mi_write_bytes(p_data,p_tccp->qntsty + (p_tccp->numgbits << 5), 1);    /* Sqcx */
                 ++p_data;
 
                 for (l_band_no = 0; l_band_no < l_num_bands; ++l_band_no) {
-                        l_expn = (mi_UINT32)l_tccp->stepsizes[l_band_no].expn;
+                        l_expn = (mi_UINT32)p_tccp->stepsizes[l_band_no].expn;
                         mi_write_bytes(p_data, l_expn << 3, 1);        /* SPqcx_i */
                         ++p_data;
                 }
@@ -8648,12 +9688,12 @@ static mi_BOOL mi_j2k_write_SQcd_SQcc(       mi_j2k_t *p_j2k,
                         return mi_FALSE;
                 }
 
-                mi_write_bytes(p_data,l_tccp->qntsty + (l_tccp->numgbits << 5), 1);    /* Sqcx */
+                mi_write_bytes(p_data,p_tccp->qntsty + (p_tccp->numgbits << 5), 1);    /* Sqcx */
                 ++p_data;
 
                 for (l_band_no = 0; l_band_no < l_num_bands; ++l_band_no) {
-                        l_expn = (mi_UINT32)l_tccp->stepsizes[l_band_no].expn;
-                        l_mant = (mi_UINT32)l_tccp->stepsizes[l_band_no].mant;
+                        l_expn = (mi_UINT32)p_tccp->stepsizes[l_band_no].expn;
+                        l_mant = (mi_UINT32)p_tccp->stepsizes[l_band_no].mant;
 
                         mi_write_bytes(p_data, (l_expn << 11) + l_mant, 2);    /* SPqcx_i */
                         p_data += 2;
@@ -8931,6 +9971,11 @@ static void mi_j2k_dump_MH_index(mi_j2k_t* p_j2k, FILE* out_stream)
 
                             fprintf(out_stream, "\t\t nb of tile-part in tile [%d]=%d\n", it_tile, nb_of_tile_part);
 
+                            if (cstr_index->tile_index[it_tile].nb_packet){
+                                    fprintf(out_stream, "\t\t nb of packet with known length in tile [%d]=%d\n",
+                                                    it_tile, cstr_index->tile_index[it_tile].nb_packet);
+                            }
+
                             if (cstr_index->tile_index[it_tile].tp_index){
                                     for (it_tile_part =0; it_tile_part < nb_of_tile_part; it_tile_part++){
                                             fprintf(out_stream, "\t\t\t tile-part[%d]: star_pos=%" PRIi64 ", end_header=%" PRIi64 ", end_pos=%" PRIi64 ".\n",
@@ -9171,6 +10216,7 @@ mi_codestream_index_t* j2k_get_cstr_index(mi_j2k_t* p_j2k)
                                 for (it_tile_free=0; it_tile_free < it_tile; it_tile_free++){
                                         mi_free(l_cstr_index->tile_index[it_tile_free].marker);
                                         mi_free(l_cstr_index->tile_index[it_tile_free].tp_index);
+                                        mi_free(l_cstr_index->tile_index[it_tile_free].packet_index);
                                 }
 
                                 mi_free( l_cstr_index->tile_index);
@@ -9189,9 +10235,19 @@ mi_codestream_index_t* j2k_get_cstr_index(mi_j2k_t* p_j2k)
                                 l_cstr_index->tile_index[it_tile].tp_index = NULL;
                         }
 
-                        /* Packet index (NOT USED)*/
+                        /* Packet index (from the PLT and PLM markers) */
                         l_cstr_index->tile_index[it_tile].nb_packet = 0;
                         l_cstr_index->tile_index[it_tile].packet_index = NULL;
+                        if (p_j2k->cstr_index->tile_index[it_tile].nb_packet) {
+                                l_cstr_index->tile_index[it_tile].packet_index = (mi_packet_info_t*)
+                                        mi_malloc(p_j2k->cstr_index->tile_index[it_tile].nb_packet * sizeof(mi_packet_info_t));
+                                if (l_cstr_index->tile_index[it_tile].packet_index) {
+                                        l_cstr_index->tile_index[it_tile].nb_packet = p_j2k->cstr_index->tile_index[it_tile].nb_packet;
+                                        memcpy( l_cstr_index->tile_index[it_tile].packet_index,
+                                                        p_j2k->cstr_index->tile_index[it_tile].packet_index,
+                                                        l_cstr_index->tile_index[it_tile].nb_packet * sizeof(mi_packet_info_t) );
+                                }
+                        }
 
                 }
         }
@@ -9232,6 +10288,12 @@ static mi_BOOL mi_j2k_decode_tiles ( mi_j2k_t *p_j2k,
         mi_BYTE * l_current_data;
         mi_UINT32 nr_tiles = 0;
 
+        /* the PPM packet headers are consumed in tile order, they keep the serial path */
+        if (p_j2k->m_cp.th * p_j2k->m_cp.tw > 1 && ! p_j2k->m_cp.ppm
+            && mi_thread_pool_get_thread_count(p_j2k->m_tp) > 0) {
+                return mi_j2k_decode_tiles_parallel(p_j2k, p_stream, p_manager);
+        }
+
         l_current_data = (mi_BYTE*)mi_malloc(1000);
         if (! l_current_data) {
                 mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to decode tiles\n");
@@ -9257,7 +10319,12 @@ static mi_BOOL mi_j2k_decode_tiles ( mi_j2k_t *p_j2k,
                         break;
                 }
 
-                if (l_data_size > l_max_data_size) {
+                /* the samples of the tile out of the decoded area are not needed */
+                mi_tcd_set_decode_area(p_j2k->m_tcd, p_j2k->m_output_image->x0, p_j2k->m_output_image->y0,
+                                       p_j2k->m_output_image->x1, p_j2k->m_output_image->y1);
+                mi_j2k_set_tcd_output(p_j2k, p_j2k->m_tcd);
+
+                if (l_data_size > l_max_data_size && ! p_j2k->m_tcd->m_output) {
                         mi_BYTE *l_new_current_data = (mi_BYTE *) mi_realloc(l_current_data, l_data_size);
                         if (! l_new_current_data) {
                                 mi_free(l_current_data);
@@ -9275,11 +10342,13 @@ static mi_BOOL mi_j2k_decode_tiles ( mi_j2k_t *p_j2k,
                 }
                 mi_event_msg(p_manager, EVT_INFO, "Tile %d/%d has been decoded.\n", l_current_tile_no +1, p_j2k->m_cp.th * p_j2k->m_cp.tw);
 
-                if (! mi_j2k_update_image_data(p_j2k->m_tcd,l_current_data, p_j2k->m_output_image)) {
-                        mi_free(l_current_data);
-                        return mi_FALSE;
+                if (! p_j2k->m_tcd->m_output) {
+                        if (! mi_j2k_update_image_data(p_j2k->m_tcd,l_current_data, p_j2k->m_output_image)) {
+                                mi_free(l_current_data);
+                                return mi_FALSE;
+                        }
+                        mi_event_msg(p_manager, EVT_INFO, "Image data has been updated with tile %d.\n\n", l_current_tile_no + 1);
                 }
-                mi_event_msg(p_manager, EVT_INFO, "Image data has been updated with tile %d.\n\n", l_current_tile_no + 1);
                 
                 if(mi_stream_get_number_byte_left(p_stream) == 0  
                     && p_j2k->m_specific_param.m_decoder.m_state == J2K_STATE_NEOC)
@@ -9293,6 +10362,221 @@ static mi_BOOL mi_j2k_decode_tiles ( mi_j2k_t *p_j2k,
         return mi_TRUE;
 }
 
+static void mi_j2k_decode_tile_processor(void* user_data, mi_tls_t* tls)
+{
+        mi_j2k_decode_tile_job_t * l_job = (mi_j2k_decode_tile_job_t *) user_data;
+        (void)tls;
+
+        l_job->m_ret = mi_tcd_decode_tile(l_job->m_tcd, l_job->m_src, l_job->m_src_size,
+                                          l_job->m_tile_no, l_job->m_cstr_index, l_job->m_manager);
+
+        /* as mi_j2k_tcp_data_destroy in mi_j2k_decode_tile */
+        if (l_job->m_src_borrowed) {
+                mi_stream_release_in_place(l_job->m_stream, l_job->m_src, l_job->m_src_size);
+        }
+        else {
+                mi_free(l_job->m_src);
+        }
+        l_job->m_src = 00;
+        l_job->m_src_size = 0;
+        mi_pi_destroy_schedule(l_job->m_tcd->cp->tcps[l_job->m_tile_no].m_packet_schedule);
+        l_job->m_tcd->cp->tcps[l_job->m_tile_no].m_packet_schedule = 00;
+
+        if (! l_job->m_tcd->m_output) {
+                l_job->m_ret = l_job->m_ret && mi_tcd_update_tile_data(l_job->m_tcd, l_job->m_tile_data, l_job->m_tile_data_size);
+        }
+}
+
+static mi_BOOL mi_j2k_decode_tiles_parallel ( mi_j2k_t *p_j2k,
+                                                mi_stream_private_t *p_stream,
+                                                mi_event_mgr_t * p_manager )
+{
+        mi_BOOL l_go_on = mi_TRUE;
+        mi_UINT32 l_current_tile_no;
+        mi_UINT32 l_data_size;
+        mi_INT32 l_tile_x0,l_tile_y0,l_tile_x1,l_tile_y1;
+        mi_UINT32 l_nb_comps;
+        mi_UINT32 k, l_nb_batch;
+        mi_UINT32 nr_tiles = 0;
+        mi_UINT32 l_nb_tiles = p_j2k->m_cp.th * p_j2k->m_cp.tw;
+        mi_UINT32 l_nb_jobs = (mi_UINT32)mi_thread_pool_get_thread_count(p_j2k->m_tp);
+        mi_j2k_decode_tile_job_t * l_jobs = 00;
+        mi_job_group_t * l_group = 00;
+        mi_tcd_t * l_main_tcd = p_j2k->m_tcd;
+        mi_BOOL l_ret = mi_TRUE;
+
+        if (l_nb_jobs > l_nb_tiles) {
+                l_nb_jobs = l_nb_tiles;
+        }
+
+        l_jobs = (mi_j2k_decode_tile_job_t *) mi_calloc(l_nb_jobs, sizeof(mi_j2k_decode_tile_job_t));
+        if (! l_jobs) {
+                mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to decode tiles\n");
+                return mi_FALSE;
+        }
+
+        l_group = mi_job_group_create(p_j2k->m_tp);
+        if (! l_group) {
+                mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to decode tiles\n");
+                l_ret = mi_FALSE;
+                goto cleanup;
+        }
+
+        for (k=0;k<l_nb_jobs;++k) {
+                mi_j2k_decode_tile_job_t * l_job = l_jobs + k;
+                l_job->m_tp = mi_thread_pool_create(0);
+                l_job->m_tcd = mi_tcd_create(mi_TRUE);
+                l_job->m_image = mi_image_create0();
+                if (l_job->m_image) {
+                        mi_copy_image_header(p_j2k->m_private_image, l_job->m_image);
+                }
+                if (! l_job->m_tp || ! l_job->m_tcd || ! l_job->m_image || ! l_job->m_image->comps ||
+                    ! mi_tcd_init(l_job->m_tcd, l_job->m_image, &p_j2k->m_cp, l_job->m_tp)) {
+                        mi_event_msg(p_manager, EVT_ERROR, "Cannot decode tile, memory error\n");
+                        l_ret = mi_FALSE;
+                        goto cleanup;
+                }
+                l_job->m_cstr_index = p_j2k->cstr_index;
+                l_job->m_manager = p_manager;
+                l_job->m_stream = p_stream;
+        }
+
+        for (;;) {
+                /* read the next tiles in this thread, each one being decoded on the pool
+                   as soon as its data is complete */
+                for (l_nb_batch=0;l_nb_batch<l_nb_jobs;) {
+                        mi_j2k_decode_tile_job_t * l_job = l_jobs + l_nb_batch;
+                        mi_tcp_t * l_tcp;
+
+                        p_j2k->m_tcd = l_job->m_tcd;
+                        l_ret = mi_j2k_read_tile_header( p_j2k,
+                                                &l_current_tile_no,
+                                                &l_data_size,
+                                                &l_tile_x0, &l_tile_y0,
+                                                &l_tile_x1, &l_tile_y1,
+                                                &l_nb_comps,
+                                                &l_go_on,
+                                                p_stream,
+                                                p_manager);
+                        p_j2k->m_tcd = l_main_tcd;
+                        if (! l_ret || ! l_go_on) {
+                                break;
+                        }
+                        mi_tcd_set_decode_area(l_job->m_tcd, p_j2k->m_output_image->x0, p_j2k->m_output_image->y0,
+                                               p_j2k->m_output_image->x1, p_j2k->m_output_image->y1);
+                        mi_j2k_set_tcd_output(p_j2k, l_job->m_tcd);
+
+                        l_tcp = p_j2k->m_cp.tcps + l_current_tile_no;
+                        if (! l_tcp->m_data) {
+                                mi_j2k_tcp_destroy(l_tcp);
+                                mi_event_msg(p_manager, EVT_ERROR, "Failed to decode tile %d/%d\n", l_current_tile_no +1, l_nb_tiles);
+                                l_ret = mi_FALSE;
+                                break;
+                        }
+
+                        if (l_data_size > l_job->m_max_tile_data_size && ! l_job->m_tcd->m_output) {
+                                mi_BYTE *l_new_data = (mi_BYTE *) mi_realloc(l_job->m_tile_data, l_data_size);
+                                if (! l_new_data) {
+                                        mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to decode tile %d/%d\n", l_current_tile_no +1, l_nb_tiles);
+                                        l_ret = mi_FALSE;
+                                        break;
+                                }
+                                l_job->m_tile_data = l_new_data;
+                                l_job->m_max_tile_data_size = l_data_size;
+                        }
+                        l_job->m_tile_data_size = l_data_size;
+                        l_job->m_tile_no = l_current_tile_no;
+                        l_job->m_ret = mi_TRUE;
+
+                        /* the job owns the tile data from now on, so that the tile is not found
+                           again by mi_j2k_read_tile_header while being decoded */
+                        l_job->m_src = l_tcp->m_data;
+                        l_job->m_src_size = l_tcp->m_data_size;
+                        l_job->m_src_borrowed = l_tcp->m_data_borrowed;
+                        l_tcp->m_data = 00;
+                        l_tcp->m_data_size = 0;
+                        l_tcp->m_data_borrowed = 0;
+
+                        if (! mi_job_group_submit_job(l_group, mi_j2k_decode_tile_processor, l_job)) {
+                                if (! l_job->m_src_borrowed) {
+                                        mi_free(l_job->m_src);
+                                }
+                                l_job->m_src = 00;
+                                l_ret = mi_FALSE;
+                                break;
+                        }
+                        ++l_nb_batch;
+
+                        if (! mi_j2k_end_tile_decoding(p_j2k, p_stream, p_manager)) {
+                                l_ret = mi_FALSE;
+                                break;
+                        }
+                        /* read ahead only while another tile-part follows */
+                        if (p_j2k->m_specific_param.m_decoder.m_state != J2K_STATE_TPHSOT
+                            || mi_stream_get_number_byte_left(p_stream) == 0
+                            || nr_tiles + l_nb_batch == l_nb_tiles) {
+                                break;
+                        }
+                }
+                mi_job_group_wait(l_group);
+
+                /* tiles cover disjoint areas of the output image, which is still
+                   updated in tile order */
+                for (k=0;k<l_nb_batch;++k) {
+                        mi_j2k_decode_tile_job_t * l_job = l_jobs + k;
+
+                        if (! l_ret) {
+                                break;
+                        }
+                        if (! l_job->m_ret) {
+                                mi_j2k_tcp_destroy(p_j2k->m_cp.tcps + l_job->m_tile_no);
+                                p_j2k->m_specific_param.m_decoder.m_state |= 0x8000;/*FIXME J2K_DEC_STATE_ERR;*/
+                                mi_event_msg(p_manager, EVT_ERROR, "Failed to decode.\n");
+                                mi_event_msg(p_manager, EVT_ERROR, "Failed to decode tile %d/%d\n", l_job->m_tile_no +1, l_nb_tiles);
+                                l_ret = mi_FALSE;
+                                break;
+                        }
+                        mi_event_msg(p_manager, EVT_INFO, "Tile %d/%d has been decoded.\n", l_job->m_tile_no +1, l_nb_tiles);
+
+                        if (l_job->m_tcd->m_output) {
+                                continue;
+                        }
+                        if (! mi_j2k_update_image_data(l_job->m_tcd,l_job->m_tile_data, p_j2k->m_output_image)) {
+                                l_ret = mi_FALSE;
+                                break;
+                        }
+                        mi_event_msg(p_manager, EVT_INFO, "Image data has been updated with tile %d.\n\n", l_job->m_tile_no + 1);
+                }
+                if (! l_ret || ! l_go_on) {
+                        break;
+                }
+
+                nr_tiles += l_nb_batch;
+                if(mi_stream_get_number_byte_left(p_stream) == 0
+                    && p_j2k->m_specific_param.m_decoder.m_state == J2K_STATE_NEOC)
+                    break;
+                if(nr_tiles == l_nb_tiles)
+                    break;
+        }
+
+cleanup:
+        mi_job_group_destroy(l_group);
+        for (k=0;k<l_nb_jobs;++k) {
+                mi_j2k_decode_tile_job_t * l_job = l_jobs + k;
+                mi_tcd_destroy(l_job->m_tcd);
+                mi_thread_pool_destroy(l_job->m_tp);
+                if (l_job->m_image) {
+                        mi_image_destroy(l_job->m_image);
+                }
+                if (l_job->m_tile_data) {
+                        mi_free(l_job->m_tile_data);
+                }
+        }
+        mi_free(l_jobs);
+
+        return l_ret;
+}
+
 /**
  * Sets up the procedures to do on decoding data. Developpers wanting to extend the library can add their own reading procedures.
  */
@@ -9348,18 +10632,22 @@ static mi_BOOL mi_j2k_decode_one_tile (       mi_j2k_t *p_j2k,
                         if ( ! p_j2k->cstr_index->tile_index[l_tile_no_to_dec].nb_tps) {
                                 /* the index for this tile has not been built,
                                  *  so move to the last SOT read */
-                                if ( !(mi_stream_read_seek(p_stream, p_j2k->m_specific_param.m_decoder.m_last_sot_read_pos+2, p_manager)) ){
+                                if ( !(mi_stream_seek(p_stream, p_j2k->m_specific_param.m_decoder.m_last_sot_read_pos+2, p_manager)) ){
                                         mi_event_msg(p_manager, EVT_ERROR, "Problem with seek function\n");
                                         mi_free(l_current_data);
                                         return mi_FALSE;
                                 }
+                                p_j2k->m_specific_param.m_decoder.m_tp_seq =
+                                        mi_j2k_get_tlm_tile_part(p_j2k, p_j2k->m_specific_param.m_decoder.m_last_sot_read_pos);
                         }
                         else{
-                                if ( !(mi_stream_read_seek(p_stream, p_j2k->cstr_index->tile_index[l_tile_no_to_dec].tp_index[0].start_pos+2, p_manager)) ) {
+                                if ( !(mi_stream_seek(p_stream, p_j2k->cstr_index->tile_index[l_tile_no_to_dec].tp_index[0].start_pos+2, p_manager)) ) {
                                         mi_event_msg(p_manager, EVT_ERROR, "Problem with seek function\n");
                                         mi_free(l_current_data);
                                         return mi_FALSE;
                                 }
+                                p_j2k->m_specific_param.m_decoder.m_tp_seq =
+                                        mi_j2k_get_tlm_tile_part(p_j2k, p_j2k->cstr_index->tile_index[l_tile_no_to_dec].tp_index[0].start_pos);
                         }
                         /* Special case if we have previously read the EOC marker (if the previous tile getted is the last ) */
                         if(p_j2k->m_specific_param.m_decoder.m_state == J2K_STATE_EOC)
@@ -9411,11 +10699,12 @@ static mi_BOOL mi_j2k_decode_one_tile (       mi_j2k_t *p_j2k,
                 if(l_current_tile_no == l_tile_no_to_dec)
                 {
                         /* move into the codestream to the first SOT (FIXME or not move?)*/
-                        if (!(mi_stream_read_seek(p_stream, p_j2k->cstr_index->main_head_end + 2, p_manager) ) ) {
+                        if (!(mi_stream_seek(p_stream, p_j2k->cstr_index->main_head_end + 2, p_manager) ) ) {
                                 mi_event_msg(p_manager, EVT_ERROR, "Problem with seek function\n");
                                 mi_free(l_current_data);
                                 return mi_FALSE;
                         }
+                        p_j2k->m_specific_param.m_decoder.m_tp_seq = 0;
                         break;
                 }
                 else {
@@ -9482,69 +10771,841 @@ mi_BOOL mi_j2k_decode(mi_j2k_t * p_j2k,
         return mi_TRUE;
 }
 
-mi_BOOL mi_j2k_get_tile(      mi_j2k_t *p_j2k,
-                                                    mi_stream_private_t *p_stream,
-                                                    mi_image_t* p_image,
-                                                    mi_event_mgr_t * p_manager,
-                                                    mi_UINT32 tile_index )
+mi_BOOL mi_j2k_decode_to_buffer(mi_j2k_t * p_j2k,
+                                  mi_stream_private_t * p_stream,
+                                  mi_image_t * p_image,
+                                  const mi_decode_buffer_t * p_buffer,
+                                  mi_event_mgr_t * p_manager)
 {
-        mi_UINT32 compno;
-        mi_UINT32 l_tile_x, l_tile_y;
-        mi_image_comp_t* l_img_comp;
+        mi_image_comp_t * l_img_comp0;
+        mi_UINT32 c;
+        mi_BOOL l_ret;
 
-        if (!p_image) {
-                mi_event_msg(p_manager, EVT_ERROR, "We need an image previously created.\n");
+        if (!p_image)
                 return mi_FALSE;
-        }
 
-        if ( /*(tile_index < 0) &&*/ (tile_index >= p_j2k->m_cp.tw * p_j2k->m_cp.th) ){
-                mi_event_msg(p_manager, EVT_ERROR, "Tile index provided by the user is incorrect %d (max = %d) \n", tile_index, (p_j2k->m_cp.tw * p_j2k->m_cp.th) - 1);
+        if ((p_buffer->sample_size != 1 && p_buffer->sample_size != 2) ||
+            ! p_buffer->nb_channels || ! p_buffer->comp_map || ! p_buffer->data) {
+                mi_event_msg(p_manager, EVT_ERROR, "Invalid layout of the decode buffer\n");
                 return mi_FALSE;
         }
 
-        /* Compute the dimension of the desired tile*/
-        l_tile_x = tile_index % p_j2k->m_cp.tw;
-        l_tile_y = tile_index / p_j2k->m_cp.tw;
+        /* the samples of a tile are written at the same place for all the channels */
+        l_img_comp0 = p_image->comps + mi_uint_min(p_buffer->comp_map[0], p_image->numcomps - 1);
+        for (c = 0; c < p_buffer->nb_channels; ++c) {
+                mi_image_comp_t * l_img_comp;
 
-        p_image->x0 = l_tile_x * p_j2k->m_cp.tdx + p_j2k->m_cp.tx0;
-        if (p_image->x0 < p_j2k->m_private_image->x0)
-                p_image->x0 = p_j2k->m_private_image->x0;
-        p_image->x1 = (l_tile_x + 1) * p_j2k->m_cp.tdx + p_j2k->m_cp.tx0;
-        if (p_image->x1 > p_j2k->m_private_image->x1)
-                p_image->x1 = p_j2k->m_private_image->x1;
+                if (p_buffer->comp_map[c] >= p_image->numcomps) {
+                        mi_event_msg(p_manager, EVT_ERROR, "Channel %d of the decode buffer maps the component %d of an image of %d components\n",
+                                     c, p_buffer->comp_map[c], p_image->numcomps);
+                        return mi_FALSE;
+                }
+                l_img_comp = p_image->comps + p_buffer->comp_map[c];
+                if (l_img_comp->prec > 8 * p_buffer->sample_size) {
+                        mi_event_msg(p_manager, EVT_ERROR, "Component %d has %d bits, more than the samples of the decode buffer\n",
+                                     p_buffer->comp_map[c], l_img_comp->prec);
+                        return mi_FALSE;
+                }
+                if (l_img_comp->w != l_img_comp0->w || l_img_comp->h != l_img_comp0->h ||
+                    l_img_comp->x0 != l_img_comp0->x0 || l_img_comp->y0 != l_img_comp0->y0 ||
+                    l_img_comp->dx != l_img_comp0->dx || l_img_comp->dy != l_img_comp0->dy ||
+                    l_img_comp->factor != l_img_comp0->factor) {
+                        mi_event_msg(p_manager, EVT_ERROR, "The components of the decode buffer do not have the same size\n");
+                        return mi_FALSE;
+                }
+        }
 
-        p_image->y0 = l_tile_y * p_j2k->m_cp.tdy + p_j2k->m_cp.ty0;
-        if (p_image->y0 < p_j2k->m_private_image->y0)
-                p_image->y0 = p_j2k->m_private_image->y0;
-        p_image->y1 = (l_tile_y + 1) * p_j2k->m_cp.tdy + p_j2k->m_cp.ty0;
-        if (p_image->y1 > p_j2k->m_private_image->y1)
-                p_image->y1 = p_j2k->m_private_image->y1;
+        p_j2k->m_specific_param.m_decoder.m_output_buffer = p_buffer;
+        l_ret = mi_j2k_decode(p_j2k, p_stream, p_image, p_manager);
+        p_j2k->m_specific_param.m_decoder.m_output_buffer = 00;
+        if (p_j2k->m_tcd) {
+                mi_tcd_set_output(p_j2k->m_tcd, 00, 0, 0, 0, 0);
+        }
 
-        l_img_comp = p_image->comps;
-        for (compno=0; compno < p_image->numcomps; ++compno)
-        {
-                mi_INT32 l_comp_x1, l_comp_y1;
+        return l_ret;
+}
 
-                l_img_comp->factor = p_j2k->m_private_image->comps[compno].factor;
+static void mi_j2k_set_tcd_output (mi_j2k_t *p_j2k, mi_tcd_t *p_tcd)
+{
+        const mi_decode_buffer_t * l_output = p_j2k->m_specific_param.m_decoder.m_output_buffer;
+        mi_image_comp_t * l_img_comp;
+        mi_UINT32 l_x0, l_y0;
 
-                l_img_comp->x0 = (mi_UINT32)mi_int_ceildiv((mi_INT32)p_image->x0, (mi_INT32)l_img_comp->dx);
-                l_img_comp->y0 = (mi_UINT32)mi_int_ceildiv((mi_INT32)p_image->y0, (mi_INT32)l_img_comp->dy);
-                l_comp_x1 = mi_int_ceildiv((mi_INT32)p_image->x1, (mi_INT32)l_img_comp->dx);
-                l_comp_y1 = mi_int_ceildiv((mi_INT32)p_image->y1, (mi_INT32)l_img_comp->dy);
+        if (! l_output) {
+                mi_tcd_set_output(p_tcd, 00, 0, 0, 0, 0);
+                return;
+        }
 
-                l_img_comp->w = (mi_UINT32)(mi_int_ceildivpow2(l_comp_x1, (mi_INT32)l_img_comp->factor) - mi_int_ceildivpow2((mi_INT32)l_img_comp->x0, (mi_INT32)l_img_comp->factor));
-                l_img_comp->h = (mi_UINT32)(mi_int_ceildivpow2(l_comp_y1, (mi_INT32)l_img_comp->factor) - mi_int_ceildivpow2((mi_INT32)l_img_comp->y0, (mi_INT32)l_img_comp->factor));
+        /* the buffer covers the decoded area, at the decoded resolution (as in mi_j2k_update_image_data) */
+        l_img_comp = p_j2k->m_output_image->comps + l_output->comp_map[0];
+        l_x0 = mi_uint_ceildivpow2(l_img_comp->x0, l_img_comp->factor);
+        l_y0 = mi_uint_ceildivpow2(l_img_comp->y0, l_img_comp->factor);
+        mi_tcd_set_output(p_tcd, l_output, l_x0, l_y0, l_x0 + l_img_comp->w, l_y0 + l_img_comp->h);
+}
 
-                l_img_comp++;
-        }
+mi_BOOL mi_j2k_transcode(mi_j2k_t * p_j2k,
+                          mi_stream_private_t * p_stream,
+                          mi_stream_private_t * p_out_stream,
+                          const mi_transcode_parameters_t * p_parameters,
+                          mi_event_mgr_t * p_manager)
+{
+        mi_j2k_transcoder_t l_transcoder;
+        mi_image_t * l_image = 00;
+        mi_BOOL l_go_on = mi_TRUE;
+        mi_UINT32 l_current_tile_no;
+        mi_UINT32 l_data_size;
+        mi_INT32 l_tile_x0,l_tile_y0,l_tile_x1,l_tile_y1;
+        mi_UINT32 l_nb_comps;
+        mi_UINT32 l_nb_tiles;
+        mi_UINT32 nr_tiles = 0;
+        mi_BYTE l_data [2];
+        mi_BOOL l_ret = mi_FALSE;
 
-        /* Destroy the previous output image*/
-        if (p_j2k->m_output_image)
-                mi_image_destroy(p_j2k->m_output_image);
+        /* preconditions */
+        assert(p_j2k != 00);
+        assert(p_stream != 00);
+        assert(p_out_stream != 00);
+        assert(p_manager != 00);
 
-        /* Create the ouput image from the information previously computed*/
-        p_j2k->m_output_image = mi_image_create0();
-        if (! (p_j2k->m_output_image)) {
+        memset(&l_transcoder, 0, sizeof(mi_j2k_transcoder_t));
+        l_transcoder.m_parameters = p_parameters;
+
+        if (! mi_j2k_read_header(p_stream, p_j2k, &l_image, p_manager)) {
+                if (l_image) {
+                        mi_image_destroy(l_image);
+                }
+                return mi_FALSE;
+        }
+        /* the samples are not decoded */
+        mi_image_destroy(l_image);
+
+        l_nb_tiles = p_j2k->m_cp.tw * p_j2k->m_cp.th;
+        if (! mi_j2k_transcode_init(p_j2k, &l_transcoder, p_manager) ||
+            ! mi_j2k_transcode_write_main_header(p_j2k, &l_transcoder, p_out_stream, p_manager)) {
+                goto cleanup;
+        }
+
+        for (;;) {
+                mi_tcp_t * l_tcp;
+
+                if (! mi_j2k_read_tile_header( p_j2k,
+                                        &l_current_tile_no,
+                                        &l_data_size,
+                                        &l_tile_x0, &l_tile_y0,
+                                        &l_tile_x1, &l_tile_y1,
+                                        &l_nb_comps,
+                                        &l_go_on,
+                                        p_stream,
+                                        p_manager)) {
+                        goto cleanup;
+                }
+
+                if (! l_go_on) {
+                        break;
+                }
+
+                if (! mi_j2k_transcode_tile(p_j2k, &l_transcoder, l_current_tile_no, p_out_stream, p_manager)) {
+                        mi_event_msg(p_manager, EVT_ERROR, "Failed to transcode tile %d/%d\n", l_current_tile_no + 1, l_nb_tiles);
+                        goto cleanup;
+                }
+                mi_event_msg(p_manager, EVT_INFO, "Tile %d/%d has been transcoded.\n", l_current_tile_no + 1, l_nb_tiles);
+
+                /* as in mi_j2k_decode_tile */
+                l_tcp = &(p_j2k->m_cp.tcps[l_current_tile_no]);
+                if (l_tcp->m_data_borrowed) {
+                        mi_stream_release_in_place(p_stream, l_tcp->m_data, l_tcp->m_data_size);
+                }
+                mi_j2k_tcp_data_destroy(l_tcp);
+                if (! mi_j2k_end_tile_decoding(p_j2k, p_stream, p_manager)) {
+                        goto cleanup;
+                }
+
+                if(mi_stream_get_number_byte_left(p_stream) == 0
+                    && p_j2k->m_specific_param.m_decoder.m_state == J2K_STATE_NEOC)
+                    break;
+                if(++nr_tiles == l_nb_tiles)
+                    break;
+        }
+
+        if (l_transcoder.m_tlm_data) {
+                mi_OFF_T l_current_position = mi_stream_tell(p_out_stream);
+
+                if (l_transcoder.m_nb_tile_parts != l_nb_tiles) {
+                        mi_event_msg(p_manager, EVT_ERROR, "Only %d tiles of %d are in the codestream, the TLM markers cannot be written\n",
+                                     l_transcoder.m_nb_tile_parts, l_nb_tiles);
+                        goto cleanup;
+                }
+                if (! mi_stream_seek(p_out_stream, l_transcoder.m_tlm_start, p_manager) ||
+                    mi_stream_write_data(p_out_stream, l_transcoder.m_tlm_data, l_transcoder.m_tlm_size, p_manager) != l_transcoder.m_tlm_size ||
+                    ! mi_stream_seek(p_out_stream, l_current_position, p_manager)) {
+                        goto cleanup;
+                }
+        }
+
+        mi_write_bytes(l_data,J2K_MS_EOC,2);                                   /* EOC */
+        if (mi_stream_write_data(p_out_stream,l_data,2,p_manager) != 2 ||
+            ! mi_stream_flush(p_out_stream,p_manager)) {
+                goto cleanup;
+        }
+
+        l_ret = mi_TRUE;
+
+cleanup:
+        mi_free(l_transcoder.m_lengths);
+        mi_free(l_transcoder.m_data);
+        mi_free(l_transcoder.m_tile_written);
+        mi_free(l_transcoder.m_tlm_data);
+
+        return l_ret;
+}
+
+static mi_BOOL mi_j2k_transcode_init( mi_j2k_t *p_j2k,
+                                        mi_j2k_transcoder_t *p_transcoder,
+                                        mi_event_mgr_t * p_manager )
+{
+        const mi_transcode_parameters_t * l_parameters = p_transcoder->m_parameters;
+        mi_image_t * l_image = p_j2k->m_private_image;
+        mi_cp_t * l_cp = &(p_j2k->m_cp);
+        mi_image_t * l_out_image = &(p_transcoder->m_image);
+        mi_cp_t * l_out_cp = &(p_transcoder->m_cp);
+        mi_UINT32 l_reduce = l_parameters->reduce;
+        mi_UINT32 l_nb_tiles = l_cp->tw * l_cp->th;
+        mi_UINT64 l_mask;
+
+        if (l_parameters->prog_order != mi_PROG_UNKNOWN &&
+            (l_parameters->prog_order < mi_LRCP || l_parameters->prog_order > mi_CPRL)) {
+                mi_event_msg(p_manager, EVT_ERROR, "Unknown progression order %d\n", (mi_INT32)l_parameters->prog_order);
+                return mi_FALSE;
+        }
+        if (l_cp->ppm) {
+                mi_event_msg(p_manager, EVT_ERROR, "The packet headers are in PPM markers, the packets cannot be transcoded\n");
+                return mi_FALSE;
+        }
+        if (! mi_j2k_transcode_tcp(p_j2k->m_specific_param.m_decoder.m_default_tcp, l_image->numcomps, l_parameters, p_manager)) {
+                return mi_FALSE;
+        }
+
+        /* the reference grid of the output is the one of the image decoded without the removed
+           resolution levels, each resolution level kept keeping its precincts and code-blocks */
+        *l_out_image = *l_image;
+        l_out_image->x0 = mi_uint_ceildivpow2(l_image->x0, l_reduce);
+        l_out_image->y0 = mi_uint_ceildivpow2(l_image->y0, l_reduce);
+        l_out_image->x1 = mi_uint_ceildivpow2(l_image->x1, l_reduce);
+        l_out_image->y1 = mi_uint_ceildivpow2(l_image->y1, l_reduce);
+
+        /* the tiles keep their index: the tile size is divided exactly when there are several tiles */
+        *l_out_cp = *l_cp;
+        l_out_cp->tx0 = mi_uint_ceildivpow2(l_cp->tx0, l_reduce);
+        l_out_cp->ty0 = mi_uint_ceildivpow2(l_cp->ty0, l_reduce);
+        l_mask = ((mi_UINT64)1 << l_reduce) - 1;
+        if (l_cp->tw > 1) {
+                if (l_cp->tdx & l_mask) {
+                        mi_event_msg(p_manager, EVT_ERROR, "The tile width %d is not a multiple of 2^%d, the resolution levels cannot be removed\n",
+                                     l_cp->tdx, l_reduce);
+                        return mi_FALSE;
+                }
+                l_out_cp->tdx = (mi_UINT32)((mi_UINT64)l_cp->tdx >> l_reduce);
+        }
+        else {
+                l_out_cp->tdx = (mi_UINT32)((((mi_UINT64)l_cp->tx0 + l_cp->tdx + l_mask) >> l_reduce) - l_out_cp->tx0);
+        }
+        if (l_cp->th > 1) {
+                if (l_cp->tdy & l_mask) {
+                        mi_event_msg(p_manager, EVT_ERROR, "The tile height %d is not a multiple of 2^%d, the resolution levels cannot be removed\n",
+                                     l_cp->tdy, l_reduce);
+                        return mi_FALSE;
+                }
+                l_out_cp->tdy = (mi_UINT32)((mi_UINT64)l_cp->tdy >> l_reduce);
+        }
+        else {
+                l_out_cp->tdy = (mi_UINT32)((((mi_UINT64)l_cp->ty0 + l_cp->tdy + l_mask) >> l_reduce) - l_out_cp->ty0);
+        }
+        if (! l_out_cp->tdx || ! l_out_cp->tdy ||
+            (mi_UINT64)l_out_cp->tx0 + l_out_cp->tdx <= l_out_image->x0 ||
+            (mi_UINT64)l_out_cp->ty0 + l_out_cp->tdy <= l_out_image->y0 ||
+            ((mi_UINT64)l_out_image->x1 - l_out_cp->tx0 + l_out_cp->tdx - 1) / l_out_cp->tdx != l_cp->tw ||
+            ((mi_UINT64)l_out_image->y1 - l_out_cp->ty0 + l_out_cp->tdy - 1) / l_out_cp->tdy != l_cp->th) {
+                mi_event_msg(p_manager, EVT_ERROR, "Some tiles have no samples once %d resolution levels are removed\n", l_reduce);
+                return mi_FALSE;
+        }
+
+        p_transcoder->m_tile_written = (mi_BYTE *) mi_calloc(l_nb_tiles, sizeof(mi_BYTE));
+        if (! p_transcoder->m_tile_written) {
+                mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to transcode the codestream\n");
+                return mi_FALSE;
+        }
+
+        if (l_parameters->tlm) {
+                /* Ttlm on 16 bits and Ptlm on 32 bits, the entries of a marker fitting in its 16 bits length */
+                const mi_UINT32 l_max_entries = (65535 - 4) / 6;
+                mi_UINT32 l_nb_markers = (l_nb_tiles + l_max_entries - 1) / l_max_entries;
+                mi_BYTE * l_current_data;
+                mi_UINT32 i;
+
+                p_transcoder->m_tlm_size = 6 * (l_nb_markers + l_nb_tiles);
+                p_transcoder->m_tlm_data = (mi_BYTE *) mi_calloc(p_transcoder->m_tlm_size, sizeof(mi_BYTE));
+                if (! p_transcoder->m_tlm_data) {
+                        mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to write the TLM markers\n");
+                        return mi_FALSE;
+                }
+
+                l_current_data = p_transcoder->m_tlm_data;
+                for (i = 0; i < l_nb_markers; ++i) {
+                        mi_UINT32 l_nb_entries = mi_uint_min(l_max_entries, l_nb_tiles - i * l_max_entries);
+
+                        mi_write_bytes(l_current_data,J2K_MS_TLM,2);                   /* TLM */
+                        mi_write_bytes(l_current_data + 2,4 + 6 * l_nb_entries,2);     /* Ltlm */
+                        mi_write_bytes(l_current_data + 4,i,1);                        /* Ztlm */
+                        mi_write_bytes(l_current_data + 5,0x60,1);                     /* Stlm ST=2 SP=1 */
+                        l_current_data += 6 + 6 * l_nb_entries;
+                }
+        }
+
+        return mi_TRUE;
+}
+
+static mi_BOOL mi_j2k_transcode_tcp(  mi_tcp_t *p_tcp,
+                                        mi_UINT32 p_nb_comps,
+                                        const mi_transcode_parameters_t *p_parameters,
+                                        mi_event_mgr_t * p_manager )
+{
+        mi_UINT32 compno;
+
+        if (p_tcp->mct == 2) {
+                mi_event_msg(p_manager, EVT_ERROR, "Custom multiple component transforms are not supported by the transcoding\n");
+                return mi_FALSE;
+        }
+        for (compno = 0; compno < p_nb_comps; ++compno) {
+                if (p_tcp->tccps[compno].numresolutions <= p_parameters->reduce) {
+                        mi_event_msg(p_manager, EVT_ERROR, "Component %d has %d resolution levels, %d of them cannot be removed\n",
+                                     compno, p_tcp->tccps[compno].numresolutions, p_parameters->reduce);
+                        return mi_FALSE;
+                }
+        }
+
+        /* the POC markers are not written, the packets follow the progression of the COD marker */
+        if (p_parameters->prog_order != mi_PROG_UNKNOWN) {
+                p_tcp->prg = p_parameters->prog_order;
+        }
+        if (p_parameters->max_layers && p_parameters->max_layers < p_tcp->numlayers) {
+                p_tcp->numlayers = p_parameters->max_layers;
+        }
+        p_tcp->numpocs = 0;
+        p_tcp->POC = 0;
+
+        /* the removed levels are the highest ones, the sub-bands kept are the first ones */
+        for (compno = 0; compno < p_nb_comps; ++compno) {
+                p_tcp->tccps[compno].numresolutions -= p_parameters->reduce;
+        }
+
+        return mi_TRUE;
+}
+
+static mi_BOOL mi_j2k_transcode_write_coding_markers( const mi_tcp_t *p_tcp,
+                                                        const mi_tcp_t *p_main_tcp,
+                                                        mi_UINT32 p_nb_comps,
+                                                        mi_BYTE * p_data,
+                                                        mi_UINT32 p_max_size,
+                                                        mi_UINT32 * p_data_written,
+                                                        mi_event_mgr_t * p_manager )
+{
+        const mi_tccp_t * l_tccp0 = p_tcp->tccps;
+        mi_BYTE * l_current_data = p_data;
+        mi_BYTE * l_marker_data;
+        mi_UINT32 l_remaining_size = p_max_size;
+        mi_UINT32 l_comp_room = (p_nb_comps <= 256) ? 1 : 2;
+        mi_UINT32 l_size;
+        mi_UINT32 compno;
+        mi_BOOL l_write_cod, l_write_qcd;
+
+        /* preconditions */
+        assert(p_max_size >= (p_nb_comps + 1) * 256);
+
+        /* the COD and QCD markers of a tile set all its components, the COC and QCC markers of the
+           main header included */
+        l_write_cod = (p_main_tcp == 00) ||
+                      ((p_tcp->csty ^ p_main_tcp->csty) & (J2K_CP_CSTY_SOP | J2K_CP_CSTY_EPH)) ||
+                      p_tcp->prg != p_main_tcp->prg ||
+                      p_tcp->numlayers != p_main_tcp->numlayers ||
+                      p_tcp->mct != p_main_tcp->mct ||
+                      ! mi_j2k_compare_tccp_SPCod_SPCoc(l_tccp0, p_main_tcp->tccps);
+        l_write_qcd = (p_main_tcp == 00) ||
+                      ! mi_j2k_compare_tccp_SQcd_SQcc(l_tccp0, p_main_tcp->tccps);
+
+        if (l_write_cod) {
+                l_marker_data = l_current_data;
+                mi_write_bytes(l_current_data,J2K_MS_COD,2);                           /* COD */
+                l_current_data += 4;                                                    /* Lcod, written below */
+                mi_write_bytes(l_current_data,(p_tcp->csty & ~(mi_UINT32)J2K_CP_CSTY_PRT) | (l_tccp0->csty & J2K_CCP_CSTY_PRT),1); /* Scod */
+                ++l_current_data;
+                mi_write_bytes(l_current_data,(mi_UINT32)p_tcp->prg,1);                /* SGcod (A) */
+                ++l_current_data;
+                mi_write_bytes(l_current_data,p_tcp->numlayers,2);                     /* SGcod (B) */
+                l_current_data += 2;
+                mi_write_bytes(l_current_data,p_tcp->mct,1);                           /* SGcod (C) */
+                ++l_current_data;
+                l_remaining_size -= 9;
+                l_size = l_remaining_size;
+                if (! mi_j2k_write_tccp_SPCod_SPCoc(l_tccp0,l_current_data,&l_remaining_size,p_manager)) {
+                        return mi_FALSE;
+                }
+                l_current_data += l_size - l_remaining_size;
+                mi_write_bytes(l_marker_data + 2,(mi_UINT32)(l_current_data - l_marker_data - 2),2);
+        }
+
+        for (compno = 0; compno < p_nb_comps; ++compno) {
+                const mi_tccp_t * l_tccp = p_tcp->tccps + compno;
+                const mi_tccp_t * l_ref_tccp = l_write_cod ? l_tccp0 : p_main_tcp->tccps + compno;
+
+                if (mi_j2k_compare_tccp_SPCod_SPCoc(l_tccp, l_ref_tccp)) {
+                        continue;
+                }
+                l_marker_data = l_current_data;
+                mi_write_bytes(l_current_data,J2K_MS_COC,2);                           /* COC */
+                l_current_data += 4;                                                    /* Lcoc, written below */
+                mi_write_bytes(l_current_data,compno,l_comp_room);                     /* Ccoc */
+                l_current_data += l_comp_room;
+                mi_write_bytes(l_current_data,l_tccp->csty & J2K_CCP_CSTY_PRT,1);      /* Scoc */
+                ++l_current_data;
+                l_remaining_size -= 5 + l_comp_room;
+                l_size = l_remaining_size;
+                if (! mi_j2k_write_tccp_SPCod_SPCoc(l_tccp,l_current_data,&l_remaining_size,p_manager)) {
+                        return mi_FALSE;
+                }
+                l_current_data += l_size - l_remaining_size;
+                mi_write_bytes(l_marker_data + 2,(mi_UINT32)(l_current_data - l_marker_data - 2),2);
+        }
+
+        if (l_write_qcd) {
+                l_marker_data = l_current_data;
+                mi_write_bytes(l_current_data,J2K_MS_QCD,2);                           /* QCD */
+                l_current_data += 4;                                                    /* Lqcd, written below */
+                l_remaining_size -= 4;
+                l_size = l_remaining_size;
+                if (! mi_j2k_write_tccp_SQcd_SQcc(l_tccp0,l_current_data,&l_remaining_size,p_manager)) {
+                        return mi_FALSE;
+                }
+                l_current_data += l_size - l_remaining_size;
+                mi_write_bytes(l_marker_data + 2,(mi_UINT32)(l_current_data - l_marker_data - 2),2);
+        }
+
+        for (compno = 0; compno < p_nb_comps; ++compno) {
+                const mi_tccp_t * l_tccp = p_tcp->tccps + compno;
+                const mi_tccp_t * l_ref_tccp = l_write_qcd ? l_tccp0 : p_main_tcp->tccps + compno;
+
+                if (mi_j2k_compare_tccp_SQcd_SQcc(l_tccp, l_ref_tccp)) {
+                        continue;
+                }
+                l_marker_data = l_current_data;
+                mi_write_bytes(l_current_data,J2K_MS_QCC,2);                           /* QCC */
+                l_current_data += 4;                                                    /* Lqcc, written below */
+                mi_write_bytes(l_current_data,compno,l_comp_room);                     /* Cqcc */
+                l_current_data += l_comp_room;
+                l_remaining_size -= 4 + l_comp_room;
+                l_size = l_remaining_size;
+                if (! mi_j2k_write_tccp_SQcd_SQcc(l_tccp,l_current_data,&l_remaining_size,p_manager)) {
+                        return mi_FALSE;
+                }
+                l_current_data += l_size - l_remaining_size;
+                mi_write_bytes(l_marker_data + 2,(mi_UINT32)(l_current_data - l_marker_data - 2),2);
+        }
+
+        for (compno = 0; compno < p_nb_comps; ++compno) {
+                mi_INT32 l_roishift = p_tcp->tccps[compno].roishift;
+
+                if (l_roishift == (p_main_tcp ? p_main_tcp->tccps[compno].roishift : 0)) {
+                        continue;
+                }
+                mi_write_bytes(l_current_data,J2K_MS_RGN,2);                           /* RGN */
+                l_current_data += 2;
+                mi_write_bytes(l_current_data,4 + l_comp_room,2);                      /* Lrgn */
+                l_current_data += 2;
+                mi_write_bytes(l_current_data,compno,l_comp_room);                     /* Crgn */
+                l_current_data += l_comp_room;
+                mi_write_bytes(l_current_data,0,1);                                    /* Srgn */
+                ++l_current_data;
+                mi_write_bytes(l_current_data,(mi_UINT32)l_roishift,1);                /* SPrgn */
+                ++l_current_data;
+                l_remaining_size -= 6 + l_comp_room;
+        }
+
+        *p_data_written = (mi_UINT32)(l_current_data - p_data);
+
+        return mi_TRUE;
+}
+
+static mi_BOOL mi_j2k_transcode_write_main_header(    mi_j2k_t *p_j2k,
+                                                        mi_j2k_transcoder_t *p_transcoder,
+                                                        mi_stream_private_t *p_out_stream,
+                                                        mi_event_mgr_t * p_manager )
+{
+        const mi_image_t * l_image = &(p_transcoder->m_image);
+        const mi_cp_t * l_cp = &(p_transcoder->m_cp);
+        mi_UINT32 l_nb_comps = l_image->numcomps;
+        mi_UINT32 l_size_siz = 38 + 3 * l_nb_comps;
+        mi_UINT32 l_markers_size = (l_nb_comps + 1) * 256;
+        mi_UINT32 l_written;
+        mi_BYTE * l_current_data;
+        mi_UINT32 compno;
+
+        if (! mi_j2k_transcode_reserve(p_transcoder, 4 + l_size_siz + l_markers_size, p_manager)) {
+                return mi_FALSE;
+        }
+        l_current_data = p_transcoder->m_data;
+
+        mi_write_bytes(l_current_data,J2K_MS_SOC,2);                                   /* SOC */
+        l_current_data += 2;
+
+        mi_write_bytes(l_current_data,J2K_MS_SIZ,2);                                   /* SIZ */
+        l_current_data += 2;
+        mi_write_bytes(l_current_data,l_size_siz,2);                                   /* L_SIZ */
+        l_current_data += 2;
+        mi_write_bytes(l_current_data,l_cp->rsiz,2);                                   /* Rsiz (capabilities) */
+        l_current_data += 2;
+        mi_write_bytes(l_current_data,l_image->x1,4);                                  /* Xsiz */
+        l_current_data += 4;
+        mi_write_bytes(l_current_data,l_image->y1,4);                                  /* Ysiz */
+        l_current_data += 4;
+        mi_write_bytes(l_current_data,l_image->x0,4);                                  /* X0siz */
+        l_current_data += 4;
+        mi_write_bytes(l_current_data,l_image->y0,4);                                  /* Y0siz */
+        l_current_data += 4;
+        mi_write_bytes(l_current_data,l_cp->tdx,4);                                    /* XTsiz */
+        l_current_data += 4;
+        mi_write_bytes(l_current_data,l_cp->tdy,4);                                    /* YTsiz */
+        l_current_data += 4;
+        mi_write_bytes(l_current_data,l_cp->tx0,4);                                    /* XT0siz */
+        l_current_data += 4;
+        mi_write_bytes(l_current_data,l_cp->ty0,4);                                    /* YT0siz */
+        l_current_data += 4;
+        mi_write_bytes(l_current_data,l_nb_comps,2);                                   /* Csiz */
+        l_current_data += 2;
+        for (compno = 0; compno < l_nb_comps; ++compno) {
+                const mi_image_comp_t * l_img_comp = l_image->comps + compno;
+
+                mi_write_bytes(l_current_data,l_img_comp->prec - 1 + (l_img_comp->sgnd << 7),1);  /* Ssiz_i */
+                ++l_current_data;
+                mi_write_bytes(l_current_data,l_img_comp->dx,1);                       /* XRsiz_i */
+                ++l_current_data;
+                mi_write_bytes(l_current_data,l_img_comp->dy,1);                       /* YRsiz_i */
+                ++l_current_data;
+        }
+
+        if (! mi_j2k_transcode_write_coding_markers(p_j2k->m_specific_param.m_decoder.m_default_tcp, 00, l_nb_comps,
+                                                     l_current_data, l_markers_size, &l_written, p_manager)) {
+                return mi_FALSE;
+        }
+        l_current_data += l_written;
+
+        l_written = (mi_UINT32)(l_current_data - p_transcoder->m_data);
+        if (mi_stream_write_data(p_out_stream,p_transcoder->m_data,l_written,p_manager) != l_written) {
+                return mi_FALSE;
+        }
+
+        /* the TLM markers are written again with the tile-part lengths at the end */
+        if (p_transcoder->m_tlm_data) {
+                p_transcoder->m_tlm_start = mi_stream_tell(p_out_stream);
+                if (mi_stream_write_data(p_out_stream,p_transcoder->m_tlm_data,p_transcoder->m_tlm_size,p_manager) != p_transcoder->m_tlm_size) {
+                        return mi_FALSE;
+                }
+        }
+
+        return mi_TRUE;
+}
+
+static mi_BOOL mi_j2k_transcode_tile( mi_j2k_t *p_j2k,
+                                        mi_j2k_transcoder_t *p_transcoder,
+                                        mi_UINT32 p_tile_no,
+                                        mi_stream_private_t *p_out_stream,
+                                        mi_event_mgr_t * p_manager )
+{
+        const mi_transcode_parameters_t * l_parameters = p_transcoder->m_parameters;
+        mi_tcp_t * l_tcp = &(p_j2k->m_cp.tcps[p_tile_no]);
+        mi_tcd_tile_t * l_tile = p_j2k->m_tcd->tcd_image->tiles;
+        mi_UINT32 l_nb_comps = p_j2k->m_private_image->numcomps;
+        mi_UINT32 l_nb_layers = l_tcp->numlayers;
+        mi_UINT32 l_markers_size = (l_nb_comps + 1) * 256;
+        mi_pi_schedule_t * l_schedule;
+        mi_pi_schedule_t * l_out_schedule = 00;
+        mi_UINT32 * l_first_precinct = 00;
+        mi_UINT32 * l_packet_of_slot = 00;
+        mi_UINT32 * l_packet_start = 00;
+        mi_UINT32 * l_out_lengths = 00;
+        mi_UINT64 l_nb_slots = 0;
+        mi_UINT64 l_size;
+        mi_UINT32 l_data_size = 0;
+        mi_UINT32 l_written;
+        mi_BYTE * l_current_data;
+        mi_BYTE * l_psot_data;
+        mi_UINT32 compno, resno, i;
+        mi_BOOL l_ret = mi_FALSE;
+
+        if (p_transcoder->m_tile_written[p_tile_no]) {
+                mi_event_msg(p_manager, EVT_ERROR, "The tile-parts of tile %d are not read together, the tile cannot be transcoded\n", p_tile_no);
+                return mi_FALSE;
+        }
+        if (l_tcp->ppt) {
+                mi_event_msg(p_manager, EVT_ERROR, "The packet headers of tile %d are in PPT markers, its packets cannot be transcoded\n", p_tile_no);
+                return mi_FALSE;
+        }
+        if (! l_tcp->m_data) {
+                mi_event_msg(p_manager, EVT_ERROR, "Tile %d has no data\n", p_tile_no);
+                return mi_FALSE;
+        }
+
+        /* only the packet headers are read, to find where each packet is */
+        if (! mi_tcd_get_packet_lengths(p_j2k->m_tcd, l_tcp->m_data, l_tcp->m_data_size, p_tile_no,
+                                        &p_transcoder->m_lengths, &p_transcoder->m_max_nb_lengths, p_manager)) {
+                return mi_FALSE;
+        }
+        l_schedule = l_tcp->m_packet_schedule;
+
+        /* the packets are numbered by precinct, the precincts of the tile being numbered one
+           resolution of one component after the other, then by layer */
+        l_first_precinct = (mi_UINT32 *) mi_malloc(l_nb_comps * mi_J2K_MAXRLVLS * sizeof(mi_UINT32));
+        if (! l_first_precinct) {
+                mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to transcode tile %d\n", p_tile_no);
+                goto cleanup;
+        }
+        for (compno = 0; compno < l_nb_comps; ++compno) {
+                const mi_tcd_tilecomp_t * l_tilec = l_tile->comps + compno;
+
+                for (resno = 0; resno < l_tilec->numresolutions; ++resno) {
+                        const mi_tcd_resolution_t * l_res = l_tilec->resolutions + resno;
+
+                        l_first_precinct[compno * mi_J2K_MAXRLVLS + resno] = (mi_UINT32)l_nb_slots;
+                        l_nb_slots += (mi_UINT64)l_res->pw * l_res->ph;
+                }
+        }
+        l_nb_slots *= l_nb_layers;
+        if (l_nb_slots > ((mi_UINT32)-1) / sizeof(mi_UINT32)) {
+                mi_event_msg(p_manager, EVT_ERROR, "Tile %d has too many packets to be transcoded\n", p_tile_no);
+                goto cleanup;
+        }
+
+        l_packet_of_slot = (mi_UINT32 *) mi_calloc((mi_SIZE_T)l_nb_slots + 1, sizeof(mi_UINT32));
+        l_packet_start = (mi_UINT32 *) mi_malloc((l_schedule->nb_packets + 1) * sizeof(mi_UINT32));
+        if (! l_packet_of_slot || ! l_packet_start) {
+                mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to transcode tile %d\n", p_tile_no);
+                goto cleanup;
+        }
+        for (i = 0; i < l_schedule->nb_packets; ++i) {
+                const mi_pi_packet_t * l_packet = l_schedule->packets + i;
+
+                if (! p_transcoder->m_lengths[i]) {
+                        mi_event_msg(p_manager, EVT_ERROR, "The packets of tile %d are truncated\n", p_tile_no);
+                        goto cleanup;
+                }
+                l_packet_start[i] = l_data_size;
+                l_data_size += p_transcoder->m_lengths[i];
+                l_packet_of_slot[(l_first_precinct[l_packet->compno * mi_J2K_MAXRLVLS + l_packet->resno] + l_packet->precno)
+                                 * l_nb_layers + l_packet->layno] = i + 1;
+        }
+
+        /* the resolution levels kept have the same precincts at the reduced resolution */
+        if (! mi_j2k_transcode_tcp(l_tcp, l_nb_comps, l_parameters, p_manager)) {
+                goto cleanup;
+        }
+        l_out_schedule = mi_pi_create_decode_schedule(&(p_transcoder->m_image), &(p_transcoder->m_cp), p_tile_no);
+        l_out_lengths = (mi_UINT32 *) mi_malloc(((l_out_schedule ? l_out_schedule->nb_packets : 0) + 1) * sizeof(mi_UINT32));
+        if (! l_out_schedule || ! l_out_lengths) {
+                mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to transcode tile %d\n", p_tile_no);
+                goto cleanup;
+        }
+
+        l_size = 0;
+        for (i = 0; i < l_out_schedule->nb_packets; ++i) {
+                const mi_pi_packet_t * l_packet = l_out_schedule->packets + i;
+                mi_UINT32 l_packet_no = l_packet_of_slot[(l_first_precinct[l_packet->compno * mi_J2K_MAXRLVLS + l_packet->resno] + l_packet->precno)
+                                                         * l_nb_layers + l_packet->layno];
+
+                if (! l_packet_no) {
+                        mi_event_msg(p_manager, EVT_ERROR, "Packet of layer %d, resolution %d, component %d, precinct %d of tile %d is missing\n",
+                                     l_packet->layno, l_packet->resno, l_packet->compno, l_packet->precno, p_tile_no);
+                        goto cleanup;
+                }
+                l_out_lengths[i] = p_transcoder->m_lengths[l_packet_no - 1];
+                l_size += l_out_lengths[i];
+        }
+
+        /* SOT, coding markers, PLT (at most 5 bytes a length, 5 bytes a marker), SOD and packets */
+        l_size += 12 + l_markers_size + 2;
+        if (l_parameters->plt) {
+                l_size += 5 * (mi_UINT64)l_out_schedule->nb_packets;
+                l_size += 5 * (5 * (mi_UINT64)l_out_schedule->nb_packets / 65530 + 1);
+        }
+        if (l_size > 0xffffffff) {
+                mi_event_msg(p_manager, EVT_ERROR, "Tile %d is too large to be written in one tile-part\n", p_tile_no);
+                goto cleanup;
+        }
+        if (! mi_j2k_transcode_reserve(p_transcoder, (mi_UINT32)l_size, p_manager)) {
+                goto cleanup;
+        }
+        l_current_data = p_transcoder->m_data;
+
+        mi_write_bytes(l_current_data,J2K_MS_SOT,2);                                   /* SOT */
+        l_current_data += 2;
+        mi_write_bytes(l_current_data,10,2);                                           /* Lsot */
+        l_current_data += 2;
+        mi_write_bytes(l_current_data,p_tile_no,2);                                    /* Isot */
+        l_current_data += 2;
+        l_psot_data = l_current_data;                                                   /* Psot, written below */
+        l_current_data += 4;
+        mi_write_bytes(l_current_data,0,1);                                            /* TPsot */
+        ++l_current_data;
+        mi_write_bytes(l_current_data,1,1);                                            /* TNsot */
+        ++l_current_data;
+
+        if (! mi_j2k_transcode_write_coding_markers(l_tcp, p_j2k->m_specific_param.m_decoder.m_default_tcp, l_nb_comps,
+                                                     l_current_data, l_markers_size, &l_written, p_manager)) {
+                goto cleanup;
+        }
+        l_current_data += l_written;
+
+        if (l_parameters->plt) {
+                mi_tcd_marker_info_t l_marker_info;
+
+                l_marker_info.need_PLT = mi_TRUE;
+                l_marker_info.packet_count = l_out_schedule->nb_packets;
+                l_marker_info.p_packet_size = l_out_lengths;
+                if (! mi_j2k_write_plt_in_memory(p_j2k, &l_marker_info, l_current_data, &l_written, p_manager)) {
+                        goto cleanup;
+                }
+                l_current_data += l_written;
+        }
+
+        mi_write_bytes(l_current_data,J2K_MS_SOD,2);                                   /* SOD */
+        l_current_data += 2;
+
+        for (i = 0; i < l_out_schedule->nb_packets; ++i) {
+                const mi_pi_packet_t * l_packet = l_out_schedule->packets + i;
+                mi_UINT32 l_packet_no = l_packet_of_slot[(l_first_precinct[l_packet->compno * mi_J2K_MAXRLVLS + l_packet->resno] + l_packet->precno)
+                                                         * l_nb_layers + l_packet->layno] - 1;
+
+                memcpy(l_current_data, l_tcp->m_data + l_packet_start[l_packet_no], l_out_lengths[i]);
+
+                /* the SOP markers are numbered in the order of the packets */
+                if ((l_tcp->csty & J2K_CP_CSTY_SOP) && l_out_lengths[i] >= 6 &&
+                    l_current_data[0] == 0xff && l_current_data[1] == 0x91) {
+                        mi_write_bytes(l_current_data + 4,i & 0xffff,2);               /* Nsop */
+                }
+                l_current_data += l_out_lengths[i];
+        }
+
+        l_written = (mi_UINT32)(l_current_data - p_transcoder->m_data);
+        mi_write_bytes(l_psot_data,l_written,4);                                       /* Psot */
+        if (mi_stream_write_data(p_out_stream,p_transcoder->m_data,l_written,p_manager) != l_written) {
+                goto cleanup;
+        }
+
+        if (p_transcoder->m_tlm_data) {
+                /* Ttlm and Ptlm of the tile-part, after the header of its TLM marker */
+                const mi_UINT32 l_max_entries = (65535 - 4) / 6;
+                mi_BYTE * l_entry = p_transcoder->m_tlm_data + 6 * (p_transcoder->m_nb_tile_parts / l_max_entries + 1)
+                                    + 6 * p_transcoder->m_nb_tile_parts;
+
+                mi_write_bytes(l_entry,p_tile_no,2);                                   /* Ttlm_i */
+                mi_write_bytes(l_entry + 2,l_written,4);                               /* Ptlm_i */
+        }
+        ++p_transcoder->m_nb_tile_parts;
+        p_transcoder->m_tile_written[p_tile_no] = 1;
+
+        l_ret = mi_TRUE;
+
+cleanup:
+        mi_pi_destroy_schedule(l_out_schedule);
+        mi_free(l_first_precinct);
+        mi_free(l_packet_of_slot);
+        mi_free(l_packet_start);
+        mi_free(l_out_lengths);
+
+        return l_ret;
+}
+
+static mi_BOOL mi_j2k_transcode_reserve(      mi_j2k_transcoder_t *p_transcoder,
+                                                mi_UINT32 p_size,
+                                                mi_event_mgr_t * p_manager )
+{
+        mi_BYTE * l_new_data;
+
+        if (p_size <= p_transcoder->m_max_data_size) {
+                return mi_TRUE;
+        }
+
+        l_new_data = (mi_BYTE *) mi_realloc(p_transcoder->m_data, p_size);
+        if (! l_new_data) {
+                mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to write the transcoded codestream\n");
+                return mi_FALSE;
+        }
+        p_transcoder->m_data = l_new_data;
+        p_transcoder->m_max_data_size = p_size;
+
+        return mi_TRUE;
+}
+
+mi_BOOL mi_j2k_get_tile(      mi_j2k_t *p_j2k,
+                                                    mi_stream_private_t *p_stream,
+                                                    mi_image_t* p_image,
+                                                    mi_event_mgr_t * p_manager,
+                                                    mi_UINT32 tile_index )
+{
+        mi_UINT32 compno;
+        mi_UINT32 l_tile_x, l_tile_y;
+        mi_image_comp_t* l_img_comp;
+
+        if (!p_image) {
+                mi_event_msg(p_manager, EVT_ERROR, "We need an image previously created.\n");
+                return mi_FALSE;
+        }
+
+        if ( /*(tile_index < 0) &&*/ (tile_index >= p_j2k->m_cp.tw * p_j2k->m_cp.th) ){
+                mi_event_msg(p_manager, EVT_ERROR, "Tile index provided by the user is incorrect %d (max = %d) \n", tile_index, (p_j2k->m_cp.tw * p_j2k->m_cp.th) - 1);
+                return mi_FALSE;
+        }
+
+        /* Compute the dimension of the desired tile*/
+        l_tile_x = tile_index % p_j2k->m_cp.tw;
+        l_tile_y = tile_index / p_j2k->m_cp.tw;
+
+        p_image->x0 = l_tile_x * p_j2k->m_cp.tdx + p_j2k->m_cp.tx0;
+        if (p_image->x0 < p_j2k->m_private_image->x0)
+                p_image->x0 = p_j2k->m_private_image->x0;
+        p_image->x1 = (l_tile_x + 1) * p_j2k->m_cp.tdx + p_j2k->m_cp.tx0;
+        if (p_image->x1 > p_j2k->m_private_image->x1)
+                p_image->x1 = p_j2k->m_private_image->x1;
+
+        p_image->y0 = l_tile_y * p_j2k->m_cp.tdy + p_j2k->m_cp.ty0;
+        if (p_image->y0 < p_j2k->m_private_image->y0)
+                p_image->y0 = p_j2k->m_private_image->y0;
+        p_image->y1 = (l_tile_y + 1) * p_j2k->m_cp.tdy + p_j2k->m_cp.ty0;
+        if (p_image->y1 > p_j2k->m_private_image->y1)
+                p_image->y1 = p_j2k->m_private_image->y1;
+
+        l_img_comp = p_image->comps;
+        for (compno=0; compno < p_image->numcomps; ++compno)
+        {
+                mi_INT32 l_comp_x1, l_comp_y1;
+
+                l_img_comp->factor = p_j2k->m_private_image->comps[compno].factor;
+
+                l_img_comp->x0 = (mi_UINT32)mi_int_ceildiv((mi_INT32)p_image->x0, (mi_INT32)l_img_comp->dx);
+                l_img_comp->y0 = (mi_UINT32)mi_int_ceildiv((mi_INT32)p_image->y0, (mi_INT32)l_img_comp->dy);
+                l_comp_x1 = mi_int_ceildiv((mi_INT32)p_image->x1, (mi_INT32)l_img_comp->dx);
+                l_comp_y1 = mi_int_ceildiv((mi_INT32)p_image->y1, (mi_INT32)l_img_comp->dy);
+
+                l_img_comp->w = (mi_UINT32)(mi_int_ceildivpow2(l_comp_x1, (mi_INT32)l_img_comp->factor) - mi_int_ceildivpow2((mi_INT32)l_img_comp->x0, (mi_INT32)l_img_comp->factor));
+                l_img_comp->h = (mi_UINT32)(mi_int_ceildivpow2(l_comp_y1, (mi_INT32)l_img_comp->factor) - mi_int_ceildivpow2((mi_INT32)l_img_comp->y0, (mi_INT32)l_img_comp->factor));
+
+                l_img_comp++;
+        }
+
+        /* Destroy the previous output image*/
+        if (p_j2k->m_output_image)
+                mi_image_destroy(p_j2k->m_output_image);
+
+        /* Create the ouput image from the information previously computed*/
+        p_j2k->m_output_image = mi_image_create0();
+        if (! (p_j2k->m_output_image)) {
                 return mi_FALSE;
         }
         mi_copy_image_header(p_image, p_j2k->m_output_image);
@@ -9605,14 +11666,36 @@ mi_BOOL mi_j2k_set_decoded_resolution_factor(mi_j2k_t *p_j2k,
         return mi_FALSE;
 }
 
+mi_BOOL mi_j2k_set_threads(mi_j2k_t *p_j2k, mi_UINT32 num_threads)
+{
+        mi_thread_pool_t* l_tp;
+
+        if (num_threads > 0 && ! mi_has_thread_support()) {
+                return mi_FALSE;
+        }
+
+        l_tp = mi_thread_pool_create((int)num_threads);
+        if (! l_tp) {
+                return mi_FALSE;
+        }
+
+        mi_thread_pool_destroy(p_j2k->m_tp);
+        p_j2k->m_tp = l_tp;
+
+        /* the tile coder may already exist, once the main header has been read or written */
+        if (p_j2k->m_tcd) {
+                p_j2k->m_tcd->thread_pool = l_tp;
+        }
+
+        return mi_TRUE;
+}
+
 mi_BOOL mi_j2k_encode(mi_j2k_t * p_j2k,
                         mi_stream_private_t *p_stream,
                         mi_event_mgr_t * p_manager )
 {
         mi_UINT32 i, j;
         mi_UINT32 l_nb_tiles;
-        mi_UINT32 l_max_tile_size = 0, l_current_tile_size;
-        mi_BYTE * l_current_data = 00;
         mi_BOOL l_reuse_data = mi_FALSE;
         mi_tcd_t* p_tcd = 00;
 
@@ -9627,11 +11710,24 @@ mi_BOOL mi_j2k_encode(mi_j2k_t * p_j2k,
         if (l_nb_tiles == 1) {
                 l_reuse_data = mi_TRUE;
         }
+        else if (mi_thread_pool_get_thread_count(p_j2k->m_tp) > 0) {
+                /* the tile POC markers are written (and the POCs clamped) just before
+                   the tile coding, which the parallel path runs ahead of time */
+                mi_BOOL l_tile_pocs = mi_FALSE;
+                if (!mi_IS_CINEMA(p_j2k->m_cp.rsiz)) {
+                        for (i=0;i<l_nb_tiles;++i) {
+                                if (p_j2k->m_cp.tcps[i].numpocs) {
+                                        l_tile_pocs = mi_TRUE;
+                                        break;
+                                }
+                        }
+                }
+                if (!l_tile_pocs) {
+                        return mi_j2k_encode_tiles_parallel(p_j2k, p_stream, p_manager);
+                }
+        }
         for (i=0;i<l_nb_tiles;++i) {
                 if (! mi_j2k_pre_write_tile(p_j2k,i,p_stream,p_manager)) {
-                        if (l_current_data) {
-                                mi_free(l_current_data);
-                        }
                         return mi_FALSE;
                 }
 
@@ -9646,53 +11742,166 @@ mi_BOOL mi_j2k_encode(mi_j2k_t * p_j2k,
                         } else {
 												        if(! mi_alloc_tile_component_data(l_tilec)) {
 												                mi_event_msg(p_manager, EVT_ERROR, "Error allocating tile component data." );
-												                if (l_current_data) {
-												                        mi_free(l_current_data);
-												                }
 												                return mi_FALSE;
 												        }
                         }
                 }
-                l_current_tile_size = mi_tcd_get_encoded_tile_size(p_j2k->m_tcd);
                 if (!l_reuse_data) {
-                        if (l_current_tile_size > l_max_tile_size) {
-												        mi_BYTE *l_new_current_data = (mi_BYTE *) mi_realloc(l_current_data, l_current_tile_size);
-												        if (! l_new_current_data) {
-												                if (l_current_data) {
-												                        mi_free(l_current_data);
-												                }
-												                mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to encode all tiles\n");
-												                return mi_FALSE;
-																}
-																l_current_data = l_new_current_data;
-																l_max_tile_size = l_current_tile_size;
-                        }
+                        /* copy the image data (32 bit) of the tile to the tile components */
+                        mi_j2k_copy_tile_data(p_j2k->m_tcd);
+                }
+
+                if (! mi_j2k_post_write_tile (p_j2k,p_stream,p_manager)) {
+                        return mi_FALSE;
+                }
+        }
+
+        return mi_TRUE;
+}
 
-                        /* copy image data (32 bit) to l_current_data as contiguous, all-component, zero offset buffer */
-                        /* 32 bit components @ 8 bit precision get converted to 8 bit */
-                        /* 32 bit components @ 16 bit precision get converted to 16 bit */
-                        mi_j2k_get_tile_data(p_j2k->m_tcd,l_current_data);
+static void mi_j2k_encode_tile_processor(void* user_data, mi_tls_t* tls)
+{
+        mi_j2k_encode_tile_job_t * l_job = (mi_j2k_encode_tile_job_t *) user_data;
+        mi_tcd_t * l_tcd = l_job->m_tcd;
+        (void)tls;
+
+        /* copy the image data (32 bit) of the tile to the tile components */
+        mi_j2k_copy_tile_data(l_tcd);
+
+        /* same coder state as mi_j2k_write_first_tile_part / mi_j2k_write_sod */
+        l_tcd->cur_pino = 0;
+        l_tcd->tp_num = 0;
+        l_tcd->cur_tp_num = 0;
+
+        l_job->m_ret = mi_tcd_pre_encode_tile(l_tcd, l_job->m_tile_no, l_job->m_scratch, l_job->m_max_length, 00);
+}
+
+static mi_BOOL mi_j2k_encode_tiles_parallel ( mi_j2k_t * p_j2k,
+                                                mi_stream_private_t *p_stream,
+                                                mi_event_mgr_t * p_manager )
+{
+        mi_UINT32 i, j, k;
+        mi_UINT32 l_nb_tiles = p_j2k->m_cp.th * p_j2k->m_cp.tw;
+        mi_UINT32 l_nb_jobs = (mi_UINT32)mi_thread_pool_get_thread_count(p_j2k->m_tp);
+        mi_UINT32 l_encoded_tile_size = p_j2k->m_specific_param.m_encoder.m_encoded_tile_size;
+        mi_j2k_encode_tile_job_t * l_jobs = 00;
+        mi_job_group_t * l_group = 00;
+        mi_tcd_t * l_main_tcd = p_j2k->m_tcd;
+        mi_BOOL l_ret = mi_TRUE;
+
+        if (l_nb_jobs > l_nb_tiles) {
+                l_nb_jobs = l_nb_tiles;
+        }
+
+        l_jobs = (mi_j2k_encode_tile_job_t *) mi_calloc(l_nb_jobs, sizeof(mi_j2k_encode_tile_job_t));
+        if (! l_jobs) {
+                mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to encode all tiles\n");
+                return mi_FALSE;
+        }
+
+        l_group = mi_job_group_create(p_j2k->m_tp);
+        if (! l_group) {
+                mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to encode all tiles\n");
+                l_ret = mi_FALSE;
+                goto cleanup;
+        }
+
+        for (k=0;k<l_nb_jobs;++k) {
+                mi_j2k_encode_tile_job_t * l_job = l_jobs + k;
+                l_job->m_tp = mi_thread_pool_create(0);
+                l_job->m_tcd = mi_tcd_create(mi_FALSE);
+                l_job->m_scratch = (mi_BYTE *) mi_malloc(l_encoded_tile_size);
+                if (! l_job->m_tp || ! l_job->m_tcd || ! l_job->m_scratch ||
+                    ! mi_tcd_init(l_job->m_tcd, p_j2k->m_private_image, &p_j2k->m_cp, l_job->m_tp)) {
+                        mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to create Tile Coder\n");
+                        l_ret = mi_FALSE;
+                        goto cleanup;
+                }
+                /* room left by SOT (12), SOD (2) and the EOC marker (2) */
+                l_job->m_max_length = l_encoded_tile_size - 16;
+        }
+
+        for (i=0;i<l_nb_tiles;i+=l_nb_jobs) {
+                mi_UINT32 l_nb_batch = mi_uint_min(l_nb_jobs, l_nb_tiles - i);
+
+                /* set up the tile coders in this thread, then code the tiles on the pool */
+                for (k=0;k<l_nb_batch;++k) {
+                        mi_j2k_encode_tile_job_t * l_job = l_jobs + k;
+
+                        l_job->m_tile_no = i + k;
+                        l_job->m_ret = mi_TRUE;
+                        l_job->m_tcd->cur_totnum_tp = p_j2k->m_cp.tcps[l_job->m_tile_no].m_nb_tile_parts;
+                        if (! mi_tcd_init_encode_tile(l_job->m_tcd, l_job->m_tile_no, p_manager)) {
+                                l_ret = mi_FALSE;
+                                break;
+                        }
+                        for (j=0;j<p_j2k->m_private_image->numcomps;++j) {
+                                if (! mi_alloc_tile_component_data(l_job->m_tcd->tcd_image->tiles->comps + j)) {
+                                        mi_event_msg(p_manager, EVT_ERROR, "Error allocating tile component data." );
+                                        l_ret = mi_FALSE;
+                                        break;
+                                }
+                        }
+                        if (! l_ret) {
+                                break;
+                        }
 
-                        /* now copy this data into the tile component */
-                        if (! mi_tcd_copy_tile_data(p_j2k->m_tcd,l_current_data,l_current_tile_size)) {
-																mi_event_msg(p_manager, EVT_ERROR, "Size mismatch between tile data and sent data." );
-																mi_free(l_current_data);
-																return mi_FALSE;
+                        if (! mi_job_group_submit_job(l_group, mi_j2k_encode_tile_processor, l_job)) {
+                                l_ret = mi_FALSE;
+                                break;
                         }
                 }
+                mi_job_group_wait(l_group);
+                if (! l_ret) {
+                        break;
+                }
 
-                if (! mi_j2k_post_write_tile (p_j2k,p_stream,p_manager)) {
-                        if (l_current_data) {
-                                mi_free(l_current_data);
+                /* write the coded tiles in order, the tier-2 coding of each tile-part
+                   and the TLM update being done by the usual serial writers */
+                for (k=0;k<l_nb_batch;++k) {
+                        mi_j2k_encode_tile_job_t * l_job = l_jobs + k;
+
+                        if (! l_job->m_ret) {
+                                mi_event_msg(p_manager, EVT_ERROR, "Cannot encode tile\n");
+                                l_ret = mi_FALSE;
+                                break;
+                        }
+                        if (l_job->m_tile_no != p_j2k->m_current_tile_number) {
+                                mi_event_msg(p_manager, EVT_ERROR, "The given tile index does not match." );
+                                l_ret = mi_FALSE;
+                                break;
+                        }
+
+                        mi_event_msg(p_manager, EVT_INFO, "tile number %d / %d\n", p_j2k->m_current_tile_number + 1, l_nb_tiles);
+
+                        p_j2k->m_specific_param.m_encoder.m_current_tile_part_number = 0;
+                        p_j2k->m_specific_param.m_encoder.m_current_poc_tile_part_number = 0;
+
+                        p_j2k->m_tcd = l_job->m_tcd;
+                        l_ret = mi_j2k_post_write_tile(p_j2k,p_stream,p_manager);
+                        p_j2k->m_tcd = l_main_tcd;
+                        if (! l_ret) {
+                                break;
                         }
-                        return mi_FALSE;
+                }
+                if (! l_ret) {
+                        break;
                 }
         }
 
-        if (l_current_data) {
-                mi_free(l_current_data);
+cleanup:
+        mi_job_group_destroy(l_group);
+        for (k=0;k<l_nb_jobs;++k) {
+                mi_j2k_encode_tile_job_t * l_job = l_jobs + k;
+                mi_tcd_destroy(l_job->m_tcd);
+                mi_thread_pool_destroy(l_job->m_tp);
+                if (l_job->m_scratch) {
+                        mi_free(l_job->m_scratch);
+                }
         }
-        return mi_TRUE;
+        mi_free(l_jobs);
+
+        return l_ret;
 }
 
 mi_BOOL mi_j2k_end_compress(  mi_j2k_t *p_j2k,
@@ -9820,7 +12029,7 @@ static void mi_get_tile_dimensions(mi_image_t * l_image,
 	*l_tile_offset = ((mi_UINT32)l_tilec->x0 - *l_offset_x) + ((mi_UINT32)l_tilec->y0 - *l_offset_y) * *l_image_width;
 }
 
-static void mi_j2k_get_tile_data (mi_tcd_t * p_tcd, mi_BYTE * p_data)
+static void mi_j2k_copy_tile_data (mi_tcd_t * p_tcd)
 {
         mi_UINT32 i,j,k = 0;
 
@@ -9829,6 +12038,7 @@ static void mi_j2k_get_tile_data (mi_tcd_t * p_tcd, mi_BYTE * p_data)
                 mi_INT32 * l_src_ptr;
                 mi_tcd_tilecomp_t * l_tilec = p_tcd->tcd_image->tiles->comps + i;
                 mi_image_comp_t * l_img_comp = l_image->comps + i;
+                mi_INT32 * l_dest_ptr = l_tilec->data;
                 mi_UINT32 l_size_comp,l_width,l_height,l_offset_x,l_offset_y, l_image_width,l_stride,l_tile_offset;
 
                 mi_get_tile_dimensions(l_image,
@@ -9845,68 +12055,50 @@ static void mi_j2k_get_tile_data (mi_tcd_t * p_tcd, mi_BYTE * p_data)
 
                 l_src_ptr = l_img_comp->data + l_tile_offset;
 
+                /* the samples are wrapped to the precision of the component as they
+                   were by the 8/16 bit tile buffer given to mi_tcd_copy_tile_data */
                 switch (l_size_comp) {
                         case 1:
-                                {
-                                        mi_CHAR * l_dest_ptr = (mi_CHAR*) p_data;
-                                        if (l_img_comp->sgnd) {
-                                                for     (j=0;j<l_height;++j) {
-                                                        for (k=0;k<l_width;++k) {
-                                                                *(l_dest_ptr) = (mi_CHAR) (*l_src_ptr);
-                                                                ++l_dest_ptr;
-                                                                ++l_src_ptr;
-                                                        }
-                                                        l_src_ptr += l_stride;
+                                if (l_img_comp->sgnd) {
+                                        for (j=0;j<l_height;++j) {
+                                                for (k=0;k<l_width;++k) {
+                                                        *(l_dest_ptr++) = (mi_INT32) (mi_CHAR) (*(l_src_ptr++));
                                                 }
+                                                l_src_ptr += l_stride;
                                         }
-                                        else {
-                                                for (j=0;j<l_height;++j) {
-                                                        for (k=0;k<l_width;++k) {
-                                                                *(l_dest_ptr) = (mi_CHAR)((*l_src_ptr)&0xff);
-                                                                ++l_dest_ptr;
-                                                                ++l_src_ptr;
-                                                        }
-                                                        l_src_ptr += l_stride;
+                                }
+                                else {
+                                        for (j=0;j<l_height;++j) {
+                                                for (k=0;k<l_width;++k) {
+                                                        *(l_dest_ptr++) = (*(l_src_ptr++)) & 0xff;
                                                 }
+                                                l_src_ptr += l_stride;
                                         }
-
-                                        p_data = (mi_BYTE*) l_dest_ptr;
                                 }
                                 break;
                         case 2:
-                                {
-                                        mi_INT16 * l_dest_ptr = (mi_INT16 *) p_data;
-                                        if (l_img_comp->sgnd) {
-                                                for (j=0;j<l_height;++j) {
-                                                        for (k=0;k<l_width;++k) {
-                                                                *(l_dest_ptr++) = (mi_INT16) (*(l_src_ptr++));
-                                                        }
-                                                        l_src_ptr += l_stride;
-                                                }
-                                        }
-                                        else {
-                                                for (j=0;j<l_height;++j) {
-                                                        for (k=0;k<l_width;++k) {
-                                                                *(l_dest_ptr++) = (mi_INT16)((*(l_src_ptr++)) & 0xffff);
-                                                        }
-                                                        l_src_ptr += l_stride;
+                                if (l_img_comp->sgnd) {
+                                        for (j=0;j<l_height;++j) {
+                                                for (k=0;k<l_width;++k) {
+                                                        *(l_dest_ptr++) = (mi_INT32) (mi_INT16) (*(l_src_ptr++));
                                                 }
+                                                l_src_ptr += l_stride;
                                         }
-
-                                        p_data = (mi_BYTE*) l_dest_ptr;
                                 }
-                                break;
-                        case 4:
-                                {
-                                        mi_INT32 * l_dest_ptr = (mi_INT32 *) p_data;
+                                else {
                                         for (j=0;j<l_height;++j) {
                                                 for (k=0;k<l_width;++k) {
-                                                        *(l_dest_ptr++) = *(l_src_ptr++);
+                                                        *(l_dest_ptr++) = (*(l_src_ptr++)) & 0xffff;
                                                 }
                                                 l_src_ptr += l_stride;
                                         }
-
-                                        p_data = (mi_BYTE*) l_dest_ptr;
+                                }
+                                break;
+                        case 4:
+                                for (j=0;j<l_height;++j) {
+                                        memcpy(l_dest_ptr, l_src_ptr, (mi_SIZE_T)l_width * sizeof(mi_INT32));
+                                        l_dest_ptr += l_width;
+                                        l_src_ptr += l_width + l_stride;
                                 }
                                 break;
                 }
@@ -10414,7 +12606,7 @@ static mi_BOOL mi_j2k_create_tcd(     mi_j2k_t *p_j2k,
                 return mi_FALSE;
         }
 
-        if (!mi_tcd_init(p_j2k->m_tcd,p_j2k->m_private_image,&p_j2k->m_cp)) {
+        if (!mi_tcd_init(p_j2k->m_tcd,p_j2k->m_private_image,&p_j2k->m_cp,p_j2k->m_tp)) {
                 mi_tcd_destroy(p_j2k->m_tcd);
                 p_j2k->m_tcd = 00;
                 return mi_FALSE;
@@ -248,6 +248,10 @@ typedef struct mi_tcp
 	mi_UINT32 m_nb_mcc_records;
 	/** the max number of mct records. */
 	mi_UINT32 m_nb_max_mcc_records;
+	/** number of packets left out of m_data because they are not decoded (their lengths are known) */
+	mi_UINT32 m_nb_packets_left_out;
+	/** schedule of the packets of the tile, listed once for the decoding of the tile (see mi_t2_decode_packets) */
+	struct mi_pi_schedule * m_packet_schedule;
 
 
 	/***** FLAGS *******/
@@ -257,6 +261,10 @@ typedef struct mi_tcp
 	mi_UINT32 ppt : 1;
 	/** indicates if a POC marker has been used O:NO, 1:YES */
 	mi_UINT32 POC : 1;
+	/** a tile-part of the tile came without usable packet lengths: the lengths of the next ones are not used */
+	mi_UINT32 m_packet_lengths_lost : 1;
+	/** m_data points into a stream read in place and is not freed with the tcp */
+	mi_UINT32 m_data_borrowed : 1;
 } mi_tcp_t;
 
 
@@ -280,6 +288,8 @@ typedef struct mi_encoding_param
 	mi_UINT32 m_fixed_quality : 1;
 	/** Enabling Tile part generation*/
 	mi_UINT32 m_tp_on : 1;
+	/** Writing of PLT markers in the tile-part headers */
+	mi_UINT32 m_plt_on : 1;
 }mi_encoding_param_t;
 
 typedef struct mi_decoding_param
@@ -388,6 +398,26 @@ typedef struct mi_j2k_dec
 	/** Position of the last SOT marker read */
 	mi_OFF_T m_last_sot_read_pos;
 
+	/** number of tile-parts listed by the TLM markers (0 if they cannot be used) */
+	mi_UINT32 m_nb_tlm_tps;
+	/** tile of each tile-part listed by the TLM markers, in codestream order */
+	mi_UINT32 * m_tlm_tileno;
+	/** length of each tile-part listed by the TLM markers, then, once the main header is read,
+	 * its position (with the end of the last one as an extra element) */
+	mi_OFF_T * m_tlm_pos;
+	/** number of tile-parts whose packet lengths are listed by the PLM markers */
+	mi_UINT32 m_nb_plm_tps;
+	/** index in m_plm_lengths of the first packet of each of these tile-parts (with an extra element) */
+	mi_UINT32 * m_plm_first;
+	/** packet lengths listed by the PLM markers */
+	mi_UINT32 * m_plm_lengths;
+	/** index, in codestream order, of the next tile-part to read ((mi_UINT32)-1 if unknown) */
+	mi_UINT32 m_tp_seq;
+	/** index, in the packets of the tile, of the first packet of the current tile-part */
+	mi_UINT32 m_tp_first_packet;
+	/** buffer of the caller receiving the decoded samples (see mi_j2k_decode_to_buffer), 00 otherwise */
+	const mi_decode_buffer_t * m_output_buffer;
+
 	/**
 	 * Indicate that the current tile-part is assume as the last tile part of the codestream.
 	 * It is useful in the case of PSot is equal to zero. The sot length will be compute in the
@@ -401,6 +431,10 @@ typedef struct mi_j2k_dec
 	/** TNsot correction : see issue 254 **/
 	mi_UINT32 m_nb_tile_parts_correction_checked : 1;
 	mi_UINT32 m_nb_tile_parts_correction : 1;
+	/** a TLM marker could not be read: the TLM markers are not used */
+	mi_UINT32 m_tlm_unusable : 1;
+	/** the packet lengths of the current tile-part come from the PLM markers */
+	mi_UINT32 m_tp_has_plm_lengths : 1;
 
 } mi_j2k_dec_t;
 
@@ -442,6 +476,8 @@ typedef struct mi_j2k_enc
 	/* size of the encoded_data */
 	mi_UINT32 m_header_tile_data_size;
 
+	/** room kept in each tile-part for its PLT markers */
+	mi_UINT32 m_reserved_bytes_for_PLT;
 
 } mi_j2k_enc_t;
 
@@ -487,6 +523,9 @@ typedef struct mi_j2k
 
 	/** the current tile coder/decoder **/
 	struct mi_tcd *	m_tcd;
+
+	/** thread pool used by the tile coder/decoder */
+	mi_thread_pool_t* m_tp;
 }mi_j2k_t;
 
 
@@ -501,8 +540,10 @@ Setup the decoder decoding parameters using user parameters.
 Decoding parameters are returned in j2k->cp. 
 @param j2k J2K decompressor handle
 @param parameters decompression parameters
+@param p_manager the user event manager
+@return mi_FALSE if the thread pool asked for cannot be created
 */
-void mi_j2k_setup_decoder(mi_j2k_t *j2k, mi_dparameters_t *parameters);
+mi_BOOL mi_j2k_setup_decoder(mi_j2k_t *j2k, mi_dparameters_t *parameters, mi_event_mgr_t * p_manager);
 
 /**
  * Creates a J2K compression structure
@@ -696,6 +737,37 @@ mi_BOOL mi_j2k_decode(mi_j2k_t *j2k,
                         mi_image_t *p_image,
                         mi_event_mgr_t *p_manager);
 
+/**
+ * Decode an image from a JPEG-2000 codestream into a buffer of the caller
+ * (see mi_decode_to_buffer). The component data of p_image is not allocated.
+ * @param j2k J2K decompressor handle
+ * @param p_stream  the stream to read the codestream from
+ * @param p_image   the image header, restricted to the decoded area
+ * @param p_buffer  the buffer receiving the decoded area
+ * @param p_manager the event manager
+ * @return true if the image is decoded
+*/
+mi_BOOL mi_j2k_decode_to_buffer(mi_j2k_t *j2k,
+                                  mi_stream_private_t *p_stream,
+                                  mi_image_t *p_image,
+                                  const mi_decode_buffer_t *p_buffer,
+                                  mi_event_mgr_t *p_manager);
+
+/**
+ * Rewrites a JPEG-2000 codestream, its packets being copied without being decoded
+ * (see mi_transcode). The main header is read by the function.
+ * @param j2k           J2K decompressor handle
+ * @param p_stream      the stream to read the codestream from
+ * @param p_out_stream  the stream to write the new codestream to
+ * @param p_parameters  the transcoding parameters
+ * @param p_manager     the event manager
+ * @return true if the codestream is written
+*/
+mi_BOOL mi_j2k_transcode(mi_j2k_t *j2k,
+                          mi_stream_private_t *p_stream,
+                          mi_stream_private_t *p_out_stream,
+                          const mi_transcode_parameters_t *p_parameters,
+                          mi_event_mgr_t *p_manager);
 
 mi_BOOL mi_j2k_get_tile(	mi_j2k_t *p_j2k,
 			    			mi_stream_private_t *p_stream,
@@ -707,6 +779,17 @@ mi_BOOL mi_j2k_set_decoded_resolution_factor(mi_j2k_t *p_j2k,
                                                mi_UINT32 res_factor,
                                                mi_event_mgr_t * p_manager);
 
+/**
+ * Sets the number of threads of the thread pool shared by the parallel stages
+ * (tier-1, tiles) of the codec.
+ *
+ * @param	p_j2k		the jpeg2000 codec.
+ * @param	num_threads	number of worker threads, 0 to run everything in the calling thread.
+ *
+ * @return mi_FALSE if the library has no thread support or the pool cannot be created.
+ */
+mi_BOOL mi_j2k_set_threads(mi_j2k_t *p_j2k, mi_UINT32 num_threads);
+
 
 /**
  * Writes a tile.
@@ -202,6 +202,16 @@ static void mi_jp2_apply_pclr(mi_image_t *image, mi_jp2_color_t *color);
 
 static void mi_jp2_free_pclr(mi_jp2_color_t *color);
 
+/**
+Set the color space of the decoded image from the colour specification box
+*/
+static void mi_jp2_set_color_space(mi_jp2_t *jp2, mi_image_t *p_image);
+
+/**
+Give the ICC profile read in the colour specification box to the decoded image
+*/
+static void mi_jp2_set_icc_profile(mi_jp2_t *jp2, mi_image_t *p_image);
+
 /**
  * Collect palette data
  *
@@ -1405,19 +1415,7 @@ mi_BOOL mi_jp2_decode(mi_jp2_t *jp2,
             return mi_FALSE;
         }
 
-        /* Set Image Color Space */
-        if (jp2->enumcs == 16)
-            p_image->color_space = mi_CLRSPC_SRGB;
-        else if (jp2->enumcs == 17)
-            p_image->color_space = mi_CLRSPC_GRAY;
-        else if (jp2->enumcs == 18)
-            p_image->color_space = mi_CLRSPC_SYCC;
-        else if (jp2->enumcs == 24)
-            p_image->color_space = mi_CLRSPC_EYCC;
-        else if (jp2->enumcs == 12)
-            p_image->color_space = mi_CLRSPC_CMYK;
-        else
-            p_image->color_space = mi_CLRSPC_UNKNOWN;
+        mi_jp2_set_color_space(jp2, p_image);
 
         if(jp2->color.jp2_pclr) {
             /* Part 1, I.5.3.4: Either both or none : */
@@ -1432,16 +1430,66 @@ mi_BOOL mi_jp2_decode(mi_jp2_t *jp2,
             mi_jp2_apply_cdef(p_image, &(jp2->color), p_manager);
         }
 
-        if(jp2->color.icc_profile_buf) {
-            p_image->icc_profile_buf = jp2->color.icc_profile_buf;
-            p_image->icc_profile_len = jp2->color.icc_profile_len;
-            jp2->color.icc_profile_buf = NULL;
-        }
+        mi_jp2_set_icc_profile(jp2, p_image);
+    }
+
+    return mi_TRUE;
+}
+
+mi_BOOL mi_jp2_decode_to_buffer(mi_jp2_t *jp2,
+                                  mi_stream_private_t *p_stream,
+                                  mi_image_t* p_image,
+                                  const mi_decode_buffer_t *p_buffer,
+                                  mi_event_mgr_t * p_manager)
+{
+    if (!p_image)
+        return mi_FALSE;
+
+    /* the samples of the buffer are the ones of the codestream */
+    if (!jp2->ignore_pclr_cmap_cdef && jp2->color.jp2_pclr && jp2->color.jp2_pclr->cmap) {
+        mi_event_msg(p_manager, EVT_ERROR, "The palette of the JP2 file cannot be applied to a decode buffer\n");
+        return mi_FALSE;
+    }
+
+    /* J2K decoding */
+    if( ! mi_j2k_decode_to_buffer(jp2->j2k, p_stream, p_image, p_buffer, p_manager) ) {
+        mi_event_msg(p_manager, EVT_ERROR, "Failed to decode the codestream in the JP2 file\n");
+        return mi_FALSE;
+    }
+
+    if (!jp2->ignore_pclr_cmap_cdef){
+        mi_jp2_set_color_space(jp2, p_image);
+        mi_jp2_set_icc_profile(jp2, p_image);
     }
 
     return mi_TRUE;
 }
 
+static void mi_jp2_set_color_space(mi_jp2_t *jp2, mi_image_t *p_image)
+{
+    if (jp2->enumcs == 16)
+        p_image->color_space = mi_CLRSPC_SRGB;
+    else if (jp2->enumcs == 17)
+        p_image->color_space = mi_CLRSPC_GRAY;
+    else if (jp2->enumcs == 18)
+        p_image->color_space = mi_CLRSPC_SYCC;
+    else if (jp2->enumcs == 24)
+        p_image->color_space = mi_CLRSPC_EYCC;
+    else if (jp2->enumcs == 12)
+        p_image->color_space = mi_CLRSPC_CMYK;
+    else
+        p_image->color_space = mi_CLRSPC_UNKNOWN;
+}
+
+static void mi_jp2_set_icc_profile(mi_jp2_t *jp2, mi_image_t *p_image)
+{
+    if(jp2->color.icc_profile_buf) {
+        p_image->icc_profile_buf = jp2->color.icc_profile_buf;
+        p_image->icc_profile_len = jp2->color.icc_profile_len;
+        jp2->color.icc_profile_buf = NULL;
+    }
+}
+
 static mi_BOOL mi_jp2_write_jp2h(mi_jp2_t *jp2,
                             mi_stream_private_t *stream,
                             mi_event_mgr_t * p_manager
@@ -1663,14 +1711,18 @@ static mi_BOOL mi_jp2_write_jp(	mi_jp2_t *jp2,
 /* JP2 decoder interface                                             */
 /* ----------------------------------------------------------------------- */
 
-void mi_jp2_setup_decoder(mi_jp2_t *jp2, mi_dparameters_t *parameters)
+mi_BOOL mi_jp2_setup_decoder(mi_jp2_t *jp2, mi_dparameters_t *parameters, mi_event_mgr_t * p_manager)
 {
     /* setup the J2K codec */
-    mi_j2k_setup_decoder(jp2->j2k, parameters);
+    if (! mi_j2k_setup_decoder(jp2->j2k, parameters, p_manager)) {
+        return mi_FALSE;
+    }
 
     /* further JP2 initializations go here */
     jp2->color.jp2_has_colr = 0;
     jp2->ignore_pclr_cmap_cdef = parameters->flags & mi_DPARAMETERS_IGNORE_PCLR_CMAP_CDEF_FLAG;
+
+    return mi_TRUE;
 }
 
 /* ----------------------------------------------------------------------- */
@@ -2874,5 +2926,10 @@ mi_BOOL mi_jp2_set_decoded_resolution_factor(mi_jp2_t *p_jp2,
     return mi_j2k_set_decoded_resolution_factor(p_jp2->j2k, res_factor, p_manager);
 }
 
+mi_BOOL mi_jp2_set_threads(mi_jp2_t *p_jp2, mi_UINT32 num_threads)
+{
+    return mi_j2k_set_threads(p_jp2->j2k, num_threads);
+}
+
 /* JPIP specific */
 
@@ -210,8 +210,10 @@ Setup the decoder decoding parameters using user parameters.
 Decoding parameters are returned in jp2->j2k->cp.
 @param jp2 JP2 decompressor handle
 @param parameters decompression parameters
+@param p_manager the user event manager
+@return mi_FALSE if the thread pool asked for cannot be created
 */
-void mi_jp2_setup_decoder(mi_jp2_t *jp2, mi_dparameters_t *parameters);
+mi_BOOL mi_jp2_setup_decoder(mi_jp2_t *jp2, mi_dparameters_t *parameters, mi_event_mgr_t * p_manager);
 
 /**
  * Decode an image from a JPEG-2000 file stream
@@ -227,6 +229,23 @@ mi_BOOL mi_jp2_decode(mi_jp2_t *jp2,
             mi_image_t* p_image,
             mi_event_mgr_t * p_manager);
 
+/**
+ * Decode an image from a JPEG-2000 file stream into a buffer of the caller
+ * (see mi_j2k_decode_to_buffer). The palette and channel definitions are not applied.
+ * @param jp2 JP2 decompressor handle
+ * @param p_stream  the stream to read the file from
+ * @param p_image   the image header, restricted to the decoded area
+ * @param p_buffer  the buffer receiving the decoded area
+ * @param p_manager the event manager
+ *
+ * @return true if the image is decoded
+*/
+mi_BOOL mi_jp2_decode_to_buffer(mi_jp2_t *jp2,
+                                  mi_stream_private_t *p_stream,
+                                  mi_image_t* p_image,
+                                  const mi_decode_buffer_t *p_buffer,
+                                  mi_event_mgr_t * p_manager);
+
 /**
  * Setup the encoder parameters using the current image and using user parameters. 
  * Coding parameters are returned in jp2->j2k->cp. 
@@ -414,6 +433,11 @@ mi_BOOL mi_jp2_set_decoded_resolution_factor(mi_jp2_t *p_jp2,
                                                mi_UINT32 res_factor, 
                                                mi_event_mgr_t * p_manager);
 
+/**
+ * Sets the number of threads of the codestream codec (see mi_j2k_set_threads).
+ */
+mi_BOOL mi_jp2_set_threads(mi_jp2_t *p_jp2, mi_UINT32 num_threads);
+
 
 /* TODO MSD: clean these 3 functions */
 /**
@@ -21,6 +21,56 @@ const mi_FLOAT64 * mi_mct_get_mct_norms_real ()
 	return mi_mct_norms_real;
 }
 
+/* Bounds of mi_INT32: clamping to them leaves the samples unchanged */
+#define mi_MCT_INT32_MIN	(-0x7FFFFFFF - 1)
+#define mi_MCT_INT32_MAX	0x7FFFFFFF
+
+/**
+Forward irreversible MCT of the samples shifted by the DC level and scaled.
+@param c0 Samples for red component
+@param c1 Samples for green component
+@param c2 Samples blue component
+@param n Number of samples for each component
+@param p_dc_shift DC level subtracted from each component (3 values)
+@param p_scale_bits the shifted samples are multiplied by 2^p_scale_bits
+*/
+static void mi_mct_encode_real_scaled(
+		mi_INT32* restrict c0,
+		mi_INT32* restrict c1,
+		mi_INT32* restrict c2,
+		mi_UINT32 n,
+		const mi_INT32 * p_dc_shift,
+		mi_UINT32 p_scale_bits);
+
+/*
+The SIMD kernels process the samples by groups of 4 (SSE2) or 8 (AVX2) and
+return the number of samples done, the caller finishing the last ones.
+They compute exactly what the scalar loops compute.
+*/
+#ifdef mi_HAVE_SSE2
+static mi_UINT32 mi_mct_encode_sse2(mi_INT32* restrict c0, mi_INT32* restrict c1, mi_INT32* restrict c2, mi_UINT32 n,
+                                     const mi_INT32 * p_dc_shift);
+static mi_UINT32 mi_mct_decode_sse2(mi_INT32* restrict c0, mi_INT32* restrict c1, mi_INT32* restrict c2, mi_UINT32 n,
+                                     const mi_INT32 * p_dc_shift, const mi_INT32 * p_min, const mi_INT32 * p_max);
+static mi_UINT32 mi_mct_encode_real_sse2(mi_INT32* restrict c0, mi_INT32* restrict c1, mi_INT32* restrict c2, mi_UINT32 n,
+                                          const mi_INT32 * p_dc_shift, mi_UINT32 p_scale_bits);
+static mi_UINT32 mi_mct_decode_real_sse2(mi_FLOAT32* restrict c0, mi_FLOAT32* restrict c1, mi_FLOAT32* restrict c2, mi_UINT32 n);
+static mi_UINT32 mi_mct_decode_real_dc_shift_sse2(mi_INT32* restrict c0, mi_INT32* restrict c1, mi_INT32* restrict c2, mi_UINT32 n,
+                                                   const mi_INT32 * p_dc_shift, const mi_INT32 * p_min, const mi_INT32 * p_max);
+#endif
+
+#ifdef mi_HAVE_AVX2
+static mi_UINT32 mi_mct_encode_avx2(mi_INT32* restrict c0, mi_INT32* restrict c1, mi_INT32* restrict c2, mi_UINT32 n,
+                                     const mi_INT32 * p_dc_shift);
+static mi_UINT32 mi_mct_decode_avx2(mi_INT32* restrict c0, mi_INT32* restrict c1, mi_INT32* restrict c2, mi_UINT32 n,
+                                     const mi_INT32 * p_dc_shift, const mi_INT32 * p_min, const mi_INT32 * p_max);
+static mi_UINT32 mi_mct_encode_real_avx2(mi_INT32* restrict c0, mi_INT32* restrict c1, mi_INT32* restrict c2, mi_UINT32 n,
+                                          const mi_INT32 * p_dc_shift, mi_UINT32 p_scale_bits);
+static mi_UINT32 mi_mct_decode_real_avx2(mi_FLOAT32* restrict c0, mi_FLOAT32* restrict c1, mi_FLOAT32* restrict c2, mi_UINT32 n);
+static mi_UINT32 mi_mct_decode_real_dc_shift_avx2(mi_INT32* restrict c0, mi_INT32* restrict c1, mi_INT32* restrict c2, mi_UINT32 n,
+                                                   const mi_INT32 * p_dc_shift, const mi_INT32 * p_min, const mi_INT32 * p_max);
+#endif
+
 /* <summary> */
 /* Forward reversible MCT. */
 /* </summary> */
@@ -31,13 +81,40 @@ void mi_mct_encode(
 		mi_INT32* restrict c2,
 		mi_UINT32 n)
 {
-	mi_SIZE_T i;
-	const mi_SIZE_T len = n;
-	
-	for(i = 0; i < len; ++i) {
-		mi_INT32 r = c0[i];
-		mi_INT32 g = c1[i];
-		mi_INT32 b = c2[i];
+	static const mi_INT32 l_no_shift[3] = { 0, 0, 0 };
+
+	mi_mct_encode_dc_shift(c0, c1, c2, n, l_no_shift);
+}
+
+/* <summary> */
+/* Forward reversible MCT of the samples shifted by the DC level. */
+/* </summary> */
+void mi_mct_encode_dc_shift(
+		mi_INT32* restrict c0,
+		mi_INT32* restrict c1,
+		mi_INT32* restrict c2,
+		mi_UINT32 n,
+		const mi_INT32 * p_dc_shift)
+{
+	mi_UINT32 i = 0;
+	mi_UINT32 l_features = mi_cpu_get_features();
+
+#ifdef mi_HAVE_AVX2
+	if (l_features & mi_CPU_AVX2) {
+		i = mi_mct_encode_avx2(c0, c1, c2, n, p_dc_shift);
+	}
+#endif
+#ifdef mi_HAVE_SSE2
+	if (l_features & mi_CPU_SSE2) {
+		i += mi_mct_encode_sse2(c0 + i, c1 + i, c2 + i, n - i, p_dc_shift);
+	}
+#endif
+	(void)l_features;
+
+	for (; i < n; ++i) {
+		mi_INT32 r = c0[i] - p_dc_shift[0];
+		mi_INT32 g = c1[i] - p_dc_shift[1];
+		mi_INT32 b = c2[i] - p_dc_shift[2];
 		mi_INT32 y = (r + (g * 2) + b) >> 2;
 		mi_INT32 u = b - g;
 		mi_INT32 v = r - g;
@@ -56,17 +133,50 @@ void mi_mct_decode(
 		mi_INT32* restrict c2, 
 		mi_UINT32 n)
 {
-	mi_UINT32 i;
-	for (i = 0; i < n; ++i) {
+	static const mi_INT32 l_no_shift[3] = { 0, 0, 0 };
+	static const mi_INT32 l_min[3] = { mi_MCT_INT32_MIN, mi_MCT_INT32_MIN, mi_MCT_INT32_MIN };
+	static const mi_INT32 l_max[3] = { mi_MCT_INT32_MAX, mi_MCT_INT32_MAX, mi_MCT_INT32_MAX };
+
+	mi_mct_decode_dc_shift(c0, c1, c2, n, l_no_shift, l_min, l_max);
+}
+
+/* <summary> */
+/* Inverse reversible MCT followed by the DC level shift and the clamping. */
+/* </summary> */
+void mi_mct_decode_dc_shift(
+		mi_INT32* restrict c0,
+		mi_INT32* restrict c1,
+		mi_INT32* restrict c2,
+		mi_UINT32 n,
+		const mi_INT32 * p_dc_shift,
+		const mi_INT32 * p_min,
+		const mi_INT32 * p_max)
+{
+	mi_UINT32 i = 0;
+	mi_UINT32 l_features = mi_cpu_get_features();
+
+#ifdef mi_HAVE_AVX2
+	if (l_features & mi_CPU_AVX2) {
+		i = mi_mct_decode_avx2(c0, c1, c2, n, p_dc_shift, p_min, p_max);
+	}
+#endif
+#ifdef mi_HAVE_SSE2
+	if (l_features & mi_CPU_SSE2) {
+		i += mi_mct_decode_sse2(c0 + i, c1 + i, c2 + i, n - i, p_dc_shift, p_min, p_max);
+	}
+#endif
+	(void)l_features;
+
+	for (; i < n; ++i) {
 		mi_INT32 y = c0[i];
 		mi_INT32 u = c1[i];
 		mi_INT32 v = c2[i];
 		mi_INT32 g = y - ((u + v) >> 2);
 		mi_INT32 r = v + g;
 		mi_INT32 b = u + g;
-		c0[i] = r;
-		c1[i] = g;
-		c2[i] = b;
+		c0[i] = mi_int_clamp(r + p_dc_shift[0], p_min[0], p_max[0]);
+		c1[i] = mi_int_clamp(g + p_dc_shift[1], p_min[1], p_max[1]);
+		c2[i] = mi_int_clamp(b + p_dc_shift[2], p_min[2], p_max[2]);
 	}
 }
 
@@ -87,11 +197,52 @@ void mi_mct_encode_real(
 		mi_INT32* restrict c2,
 		mi_UINT32 n)
 {
-	mi_UINT32 i;
-	for(i = 0; i < n; ++i) {
-		mi_INT32 r = c0[i];
-		mi_INT32 g = c1[i];
-		mi_INT32 b = c2[i];
+	static const mi_INT32 l_no_shift[3] = { 0, 0, 0 };
+
+	mi_mct_encode_real_scaled(c0, c1, c2, n, l_no_shift, 0);
+}
+
+/* <summary> */
+/* Forward irreversible MCT of the samples shifted by the DC level. */
+/* </summary> */
+void mi_mct_encode_real_dc_shift(
+		mi_INT32* restrict c0,
+		mi_INT32* restrict c1,
+		mi_INT32* restrict c2,
+		mi_UINT32 n,
+		const mi_INT32 * p_dc_shift)
+{
+	/* the shifted samples get the 11 fractional bits of the 9-7 DWT input */
+	mi_mct_encode_real_scaled(c0, c1, c2, n, p_dc_shift, 11);
+}
+
+static void mi_mct_encode_real_scaled(
+		mi_INT32* restrict c0,
+		mi_INT32* restrict c1,
+		mi_INT32* restrict c2,
+		mi_UINT32 n,
+		const mi_INT32 * p_dc_shift,
+		mi_UINT32 p_scale_bits)
+{
+	mi_UINT32 i = 0;
+	mi_UINT32 l_features = mi_cpu_get_features();
+
+#ifdef mi_HAVE_AVX2
+	if (l_features & mi_CPU_AVX2) {
+		i = mi_mct_encode_real_avx2(c0, c1, c2, n, p_dc_shift, p_scale_bits);
+	}
+#endif
+#ifdef mi_HAVE_SSE2
+	if (l_features & mi_CPU_SSE2) {
+		i += mi_mct_encode_real_sse2(c0 + i, c1 + i, c2 + i, n - i, p_dc_shift, p_scale_bits);
+	}
+#endif
+	(void)l_features;
+
+	for(; i < n; ++i) {
+		mi_INT32 r = (c0[i] - p_dc_shift[0]) * (1 << p_scale_bits);
+		mi_INT32 g = (c1[i] - p_dc_shift[1]) * (1 << p_scale_bits);
+		mi_INT32 b = (c2[i] - p_dc_shift[2]) * (1 << p_scale_bits);
 		mi_INT32 y =  mi_int_fix_mul(r, 2449) + mi_int_fix_mul(g, 4809) + mi_int_fix_mul(b, 934);
 		mi_INT32 u = -mi_int_fix_mul(r, 1382) - mi_int_fix_mul(g, 2714) + mi_int_fix_mul(b, 4096);
 		mi_INT32 v =  mi_int_fix_mul(r, 4096) - mi_int_fix_mul(g, 3430) - mi_int_fix_mul(b, 666);
@@ -110,8 +261,22 @@ void mi_mct_decode_real(
 		mi_FLOAT32* restrict c2,
 		mi_UINT32 n)
 {
-	mi_UINT32 i;
-	for(i = 0; i < n; ++i) {
+	mi_UINT32 i = 0;
+	mi_UINT32 l_features = mi_cpu_get_features();
+
+#ifdef mi_HAVE_AVX2
+	if (l_features & mi_CPU_AVX2) {
+		i = mi_mct_decode_real_avx2(c0, c1, c2, n);
+	}
+#endif
+#ifdef mi_HAVE_SSE2
+	if (l_features & mi_CPU_SSE2) {
+		i += mi_mct_decode_real_sse2(c0 + i, c1 + i, c2 + i, n - i);
+	}
+#endif
+	(void)l_features;
+
+	for(; i < n; ++i) {
 		mi_FLOAT32 y = c0[i];
 		mi_FLOAT32 u = c1[i];
 		mi_FLOAT32 v = c2[i];
@@ -124,6 +289,348 @@ void mi_mct_decode_real(
 	}
 }
 
+/* <summary> */
+/* Inverse irreversible MCT followed by the rounding, the DC level shift and the clamping. */
+/* </summary> */
+void mi_mct_decode_real_dc_shift(
+		mi_INT32* restrict c0,
+		mi_INT32* restrict c1,
+		mi_INT32* restrict c2,
+		mi_UINT32 n,
+		const mi_INT32 * p_dc_shift,
+		const mi_INT32 * p_min,
+		const mi_INT32 * p_max)
+{
+	mi_UINT32 i = 0;
+	mi_UINT32 l_features = mi_cpu_get_features();
+
+#ifdef mi_HAVE_AVX2
+	if (l_features & mi_CPU_AVX2) {
+		i = mi_mct_decode_real_dc_shift_avx2(c0, c1, c2, n, p_dc_shift, p_min, p_max);
+	}
+#endif
+#ifdef mi_HAVE_SSE2
+	if (l_features & mi_CPU_SSE2) {
+		i += mi_mct_decode_real_dc_shift_sse2(c0 + i, c1 + i, c2 + i, n - i, p_dc_shift, p_min, p_max);
+	}
+#endif
+	(void)l_features;
+
+	for(; i < n; ++i) {
+		mi_FLOAT32 y = ((mi_FLOAT32 *) c0)[i];
+		mi_FLOAT32 u = ((mi_FLOAT32 *) c1)[i];
+		mi_FLOAT32 v = ((mi_FLOAT32 *) c2)[i];
+		mi_FLOAT32 r = y + (v * 1.402f);
+		mi_FLOAT32 g = y - (u * 0.34413f) - (v * (0.71414f));
+		mi_FLOAT32 b = y + (u * 1.772f);
+		c0[i] = mi_int_clamp((mi_INT32)mi_lrintf(r) + p_dc_shift[0], p_min[0], p_max[0]);
+		c1[i] = mi_int_clamp((mi_INT32)mi_lrintf(g) + p_dc_shift[1], p_min[1], p_max[1]);
+		c2[i] = mi_int_clamp((mi_INT32)mi_lrintf(b) + p_dc_shift[2], p_min[2], p_max[2]);
+	}
+}
+
+#ifdef mi_HAVE_SSE2
+/**
+Clamp 4 samples (SSE2 has no 32-bit minimum and maximum).
+*/
+static INLINE __m128i mi_mct_clamp_sse2(__m128i x, __m128i p_min, __m128i p_max)
+{
+	__m128i l_mask = _mm_cmpgt_epi32(p_min, x);
+	x = _mm_or_si128(_mm_and_si128(l_mask, p_min), _mm_andnot_si128(l_mask, x));
+	l_mask = _mm_cmpgt_epi32(x, p_max);
+	return _mm_or_si128(_mm_and_si128(l_mask, p_max), _mm_andnot_si128(l_mask, x));
+}
+
+/**
+mi_int_fix_mul of 4 samples by a positive constant.
+SSE2 only has the unsigned 32x32->64 bit product: the product of a negative
+sample is corrected by subtracting k * 2^32.
+*/
+static INLINE __m128i mi_mct_fix_mul_sse2(__m128i a, __m128i k)
+{
+	const __m128i l_rnd = _mm_set_epi32(0, 4096, 0, 4096);
+	const __m128i l_low = _mm_set_epi32(0, -1, 0, -1);
+	__m128i l_odd = _mm_srli_epi64(a, 32);
+	__m128i l_even_prod = _mm_mul_epu32(a, k);
+	__m128i l_odd_prod = _mm_mul_epu32(l_odd, k);
+
+	l_even_prod = _mm_sub_epi64(l_even_prod, _mm_slli_epi64(_mm_and_si128(_mm_srai_epi32(a, 31), k), 32));
+	l_odd_prod = _mm_sub_epi64(l_odd_prod, _mm_slli_epi64(_mm_and_si128(_mm_srai_epi32(l_odd, 31), k), 32));
+	l_even_prod = _mm_srli_epi64(_mm_add_epi64(l_even_prod, l_rnd), 13);
+	l_odd_prod = _mm_slli_epi64(_mm_srli_epi64(_mm_add_epi64(l_odd_prod, l_rnd), 13), 32);
+	return _mm_or_si128(_mm_and_si128(l_even_prod, l_low), l_odd_prod);
+}
+
+static mi_UINT32 mi_mct_encode_sse2(mi_INT32* restrict c0, mi_INT32* restrict c1, mi_INT32* restrict c2, mi_UINT32 n,
+                                     const mi_INT32 * p_dc_shift)
+{
+	const __m128i l_s0 = _mm_set1_epi32(p_dc_shift[0]);
+	const __m128i l_s1 = _mm_set1_epi32(p_dc_shift[1]);
+	const __m128i l_s2 = _mm_set1_epi32(p_dc_shift[2]);
+	mi_UINT32 i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		__m128i r = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(c0 + i)), l_s0);
+		__m128i g = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(c1 + i)), l_s1);
+		__m128i b = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(c2 + i)), l_s2);
+		__m128i y = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(r, _mm_add_epi32(g, g)), b), 2);
+		_mm_storeu_si128((__m128i*)(c0 + i), y);
+		_mm_storeu_si128((__m128i*)(c1 + i), _mm_sub_epi32(b, g));
+		_mm_storeu_si128((__m128i*)(c2 + i), _mm_sub_epi32(r, g));
+	}
+	return i;
+}
+
+static mi_UINT32 mi_mct_decode_sse2(mi_INT32* restrict c0, mi_INT32* restrict c1, mi_INT32* restrict c2, mi_UINT32 n,
+                                     const mi_INT32 * p_dc_shift, const mi_INT32 * p_min, const mi_INT32 * p_max)
+{
+	const __m128i l_s0 = _mm_set1_epi32(p_dc_shift[0]);
+	const __m128i l_s1 = _mm_set1_epi32(p_dc_shift[1]);
+	const __m128i l_s2 = _mm_set1_epi32(p_dc_shift[2]);
+	const __m128i l_min0 = _mm_set1_epi32(p_min[0]), l_max0 = _mm_set1_epi32(p_max[0]);
+	const __m128i l_min1 = _mm_set1_epi32(p_min[1]), l_max1 = _mm_set1_epi32(p_max[1]);
+	const __m128i l_min2 = _mm_set1_epi32(p_min[2]), l_max2 = _mm_set1_epi32(p_max[2]);
+	mi_UINT32 i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		__m128i y = _mm_loadu_si128((const __m128i*)(c0 + i));
+		__m128i u = _mm_loadu_si128((const __m128i*)(c1 + i));
+		__m128i v = _mm_loadu_si128((const __m128i*)(c2 + i));
+		__m128i g = _mm_sub_epi32(y, _mm_srai_epi32(_mm_add_epi32(u, v), 2));
+		__m128i r = _mm_add_epi32(v, g);
+		__m128i b = _mm_add_epi32(u, g);
+		_mm_storeu_si128((__m128i*)(c0 + i), mi_mct_clamp_sse2(_mm_add_epi32(r, l_s0), l_min0, l_max0));
+		_mm_storeu_si128((__m128i*)(c1 + i), mi_mct_clamp_sse2(_mm_add_epi32(g, l_s1), l_min1, l_max1));
+		_mm_storeu_si128((__m128i*)(c2 + i), mi_mct_clamp_sse2(_mm_add_epi32(b, l_s2), l_min2, l_max2));
+	}
+	return i;
+}
+
+static mi_UINT32 mi_mct_encode_real_sse2(mi_INT32* restrict c0, mi_INT32* restrict c1, mi_INT32* restrict c2, mi_UINT32 n,
+                                          const mi_INT32 * p_dc_shift, mi_UINT32 p_scale_bits)
+{
+	const __m128i l_s0 = _mm_set1_epi32(p_dc_shift[0]);
+	const __m128i l_s1 = _mm_set1_epi32(p_dc_shift[1]);
+	const __m128i l_s2 = _mm_set1_epi32(p_dc_shift[2]);
+	const __m128i l_scale = _mm_cvtsi32_si128((int)p_scale_bits);
+	const __m128i k2449 = _mm_set1_epi32(2449), k4809 = _mm_set1_epi32(4809), k934 = _mm_set1_epi32(934);
+	const __m128i k1382 = _mm_set1_epi32(1382), k2714 = _mm_set1_epi32(2714), k4096 = _mm_set1_epi32(4096);
+	const __m128i k3430 = _mm_set1_epi32(3430), k666 = _mm_set1_epi32(666);
+	mi_UINT32 i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		__m128i r = _mm_sll_epi32(_mm_sub_epi32(_mm_loadu_si128((const __m128i*)(c0 + i)), l_s0), l_scale);
+		__m128i g = _mm_sll_epi32(_mm_sub_epi32(_mm_loadu_si128((const __m128i*)(c1 + i)), l_s1), l_scale);
+		__m128i b = _mm_sll_epi32(_mm_sub_epi32(_mm_loadu_si128((const __m128i*)(c2 + i)), l_s2), l_scale);
+		__m128i y = _mm_add_epi32(_mm_add_epi32(mi_mct_fix_mul_sse2(r, k2449), mi_mct_fix_mul_sse2(g, k4809)),
+		                          mi_mct_fix_mul_sse2(b, k934));
+		__m128i u = _mm_add_epi32(_mm_sub_epi32(_mm_sub_epi32(_mm_setzero_si128(), mi_mct_fix_mul_sse2(r, k1382)),
+		                                        mi_mct_fix_mul_sse2(g, k2714)),
+		                          mi_mct_fix_mul_sse2(b, k4096));
+		__m128i v = _mm_sub_epi32(_mm_sub_epi32(mi_mct_fix_mul_sse2(r, k4096), mi_mct_fix_mul_sse2(g, k3430)),
+		                          mi_mct_fix_mul_sse2(b, k666));
+		_mm_storeu_si128((__m128i*)(c0 + i), y);
+		_mm_storeu_si128((__m128i*)(c1 + i), u);
+		_mm_storeu_si128((__m128i*)(c2 + i), v);
+	}
+	return i;
+}
+
+static mi_UINT32 mi_mct_decode_real_sse2(mi_FLOAT32* restrict c0, mi_FLOAT32* restrict c1, mi_FLOAT32* restrict c2, mi_UINT32 n)
+{
+	const __m128 l_vr = _mm_set1_ps(1.402f);
+	const __m128 l_ug = _mm_set1_ps(0.34413f);
+	const __m128 l_vg = _mm_set1_ps(0.71414f);
+	const __m128 l_ub = _mm_set1_ps(1.772f);
+	mi_UINT32 i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		__m128 y = _mm_loadu_ps(c0 + i);
+		__m128 u = _mm_loadu_ps(c1 + i);
+		__m128 v = _mm_loadu_ps(c2 + i);
+		_mm_storeu_ps(c0 + i, _mm_add_ps(y, _mm_mul_ps(v, l_vr)));
+		_mm_storeu_ps(c1 + i, _mm_sub_ps(_mm_sub_ps(y, _mm_mul_ps(u, l_ug)), _mm_mul_ps(v, l_vg)));
+		_mm_storeu_ps(c2 + i, _mm_add_ps(y, _mm_mul_ps(u, l_ub)));
+	}
+	return i;
+}
+
+static mi_UINT32 mi_mct_decode_real_dc_shift_sse2(mi_INT32* restrict c0, mi_INT32* restrict c1, mi_INT32* restrict c2, mi_UINT32 n,
+                                                   const mi_INT32 * p_dc_shift, const mi_INT32 * p_min, const mi_INT32 * p_max)
+{
+	const __m128 l_vr = _mm_set1_ps(1.402f);
+	const __m128 l_ug = _mm_set1_ps(0.34413f);
+	const __m128 l_vg = _mm_set1_ps(0.71414f);
+	const __m128 l_ub = _mm_set1_ps(1.772f);
+	const __m128i l_s0 = _mm_set1_epi32(p_dc_shift[0]);
+	const __m128i l_s1 = _mm_set1_epi32(p_dc_shift[1]);
+	const __m128i l_s2 = _mm_set1_epi32(p_dc_shift[2]);
+	const __m128i l_min0 = _mm_set1_epi32(p_min[0]), l_max0 = _mm_set1_epi32(p_max[0]);
+	const __m128i l_min1 = _mm_set1_epi32(p_min[1]), l_max1 = _mm_set1_epi32(p_max[1]);
+	const __m128i l_min2 = _mm_set1_epi32(p_min[2]), l_max2 = _mm_set1_epi32(p_max[2]);
+	mi_UINT32 i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		__m128 y = _mm_loadu_ps((const mi_FLOAT32*)(c0 + i));
+		__m128 u = _mm_loadu_ps((const mi_FLOAT32*)(c1 + i));
+		__m128 v = _mm_loadu_ps((const mi_FLOAT32*)(c2 + i));
+		/* _mm_cvtps_epi32 rounds to nearest even, as mi_lrintf */
+		__m128i r = _mm_cvtps_epi32(_mm_add_ps(y, _mm_mul_ps(v, l_vr)));
+		__m128i g = _mm_cvtps_epi32(_mm_sub_ps(_mm_sub_ps(y, _mm_mul_ps(u, l_ug)), _mm_mul_ps(v, l_vg)));
+		__m128i b = _mm_cvtps_epi32(_mm_add_ps(y, _mm_mul_ps(u, l_ub)));
+		_mm_storeu_si128((__m128i*)(c0 + i), mi_mct_clamp_sse2(_mm_add_epi32(r, l_s0), l_min0, l_max0));
+		_mm_storeu_si128((__m128i*)(c1 + i), mi_mct_clamp_sse2(_mm_add_epi32(g, l_s1), l_min1, l_max1));
+		_mm_storeu_si128((__m128i*)(c2 + i), mi_mct_clamp_sse2(_mm_add_epi32(b, l_s2), l_min2, l_max2));
+	}
+	return i;
+}
+#endif /* mi_HAVE_SSE2 */
+
+#ifdef mi_HAVE_AVX2
+/**
+mi_int_fix_mul of 8 samples: the even and the odd samples get a 64-bit product each.
+*/
+static mi_TARGET_AVX2 INLINE __m256i mi_mct_fix_mul_avx2(__m256i a, __m256i k)
+{
+	const __m256i l_rnd = _mm256_set1_epi64x(4096);
+	__m256i l_even_prod = _mm256_mul_epi32(a, k);
+	__m256i l_odd_prod = _mm256_mul_epi32(_mm256_srli_epi64(a, 32), k);
+
+	l_even_prod = _mm256_srli_epi64(_mm256_add_epi64(l_even_prod, l_rnd), 13);
+	l_odd_prod = _mm256_slli_epi64(_mm256_srli_epi64(_mm256_add_epi64(l_odd_prod, l_rnd), 13), 32);
+	return _mm256_blend_epi32(l_even_prod, l_odd_prod, 0xAA);
+}
+
+static mi_TARGET_AVX2 mi_UINT32 mi_mct_encode_avx2(mi_INT32* restrict c0, mi_INT32* restrict c1, mi_INT32* restrict c2, mi_UINT32 n,
+                                                    const mi_INT32 * p_dc_shift)
+{
+	const __m256i l_s0 = _mm256_set1_epi32(p_dc_shift[0]);
+	const __m256i l_s1 = _mm256_set1_epi32(p_dc_shift[1]);
+	const __m256i l_s2 = _mm256_set1_epi32(p_dc_shift[2]);
+	mi_UINT32 i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		__m256i r = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(c0 + i)), l_s0);
+		__m256i g = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(c1 + i)), l_s1);
+		__m256i b = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(c2 + i)), l_s2);
+		__m256i y = _mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(r, _mm256_add_epi32(g, g)), b), 2);
+		_mm256_storeu_si256((__m256i*)(c0 + i), y);
+		_mm256_storeu_si256((__m256i*)(c1 + i), _mm256_sub_epi32(b, g));
+		_mm256_storeu_si256((__m256i*)(c2 + i), _mm256_sub_epi32(r, g));
+	}
+	return i;
+}
+
+static mi_TARGET_AVX2 mi_UINT32 mi_mct_decode_avx2(mi_INT32* restrict c0, mi_INT32* restrict c1, mi_INT32* restrict c2, mi_UINT32 n,
+                                                    const mi_INT32 * p_dc_shift, const mi_INT32 * p_min, const mi_INT32 * p_max)
+{
+	const __m256i l_s0 = _mm256_set1_epi32(p_dc_shift[0]);
+	const __m256i l_s1 = _mm256_set1_epi32(p_dc_shift[1]);
+	const __m256i l_s2 = _mm256_set1_epi32(p_dc_shift[2]);
+	const __m256i l_min0 = _mm256_set1_epi32(p_min[0]), l_max0 = _mm256_set1_epi32(p_max[0]);
+	const __m256i l_min1 = _mm256_set1_epi32(p_min[1]), l_max1 = _mm256_set1_epi32(p_max[1]);
+	const __m256i l_min2 = _mm256_set1_epi32(p_min[2]), l_max2 = _mm256_set1_epi32(p_max[2]);
+	mi_UINT32 i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		__m256i y = _mm256_loadu_si256((const __m256i*)(c0 + i));
+		__m256i u = _mm256_loadu_si256((const __m256i*)(c1 + i));
+		__m256i v = _mm256_loadu_si256((const __m256i*)(c2 + i));
+		__m256i g = _mm256_sub_epi32(y, _mm256_srai_epi32(_mm256_add_epi32(u, v), 2));
+		__m256i r = _mm256_add_epi32(v, g);
+		__m256i b = _mm256_add_epi32(u, g);
+		r = _mm256_max_epi32(l_min0, _mm256_min_epi32(_mm256_add_epi32(r, l_s0), l_max0));
+		g = _mm256_max_epi32(l_min1, _mm256_min_epi32(_mm256_add_epi32(g, l_s1), l_max1));
+		b = _mm256_max_epi32(l_min2, _mm256_min_epi32(_mm256_add_epi32(b, l_s2), l_max2));
+		_mm256_storeu_si256((__m256i*)(c0 + i), r);
+		_mm256_storeu_si256((__m256i*)(c1 + i), g);
+		_mm256_storeu_si256((__m256i*)(c2 + i), b);
+	}
+	return i;
+}
+
+static mi_TARGET_AVX2 mi_UINT32 mi_mct_encode_real_avx2(mi_INT32* restrict c0, mi_INT32* restrict c1, mi_INT32* restrict c2, mi_UINT32 n,
+                                                         const mi_INT32 * p_dc_shift, mi_UINT32 p_scale_bits)
+{
+	const __m256i l_s0 = _mm256_set1_epi32(p_dc_shift[0]);
+	const __m256i l_s1 = _mm256_set1_epi32(p_dc_shift[1]);
+	const __m256i l_s2 = _mm256_set1_epi32(p_dc_shift[2]);
+	const __m128i l_scale = _mm_cvtsi32_si128((int)p_scale_bits);
+	const __m256i k2449 = _mm256_set1_epi32(2449), k4809 = _mm256_set1_epi32(4809), k934 = _mm256_set1_epi32(934);
+	const __m256i k1382 = _mm256_set1_epi32(1382), k2714 = _mm256_set1_epi32(2714), k4096 = _mm256_set1_epi32(4096);
+	const __m256i k3430 = _mm256_set1_epi32(3430), k666 = _mm256_set1_epi32(666);
+	mi_UINT32 i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		__m256i r = _mm256_sll_epi32(_mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(c0 + i)), l_s0), l_scale);
+		__m256i g = _mm256_sll_epi32(_mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(c1 + i)), l_s1), l_scale);
+		__m256i b = _mm256_sll_epi32(_mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(c2 + i)), l_s2), l_scale);
+		__m256i y = _mm256_add_epi32(_mm256_add_epi32(mi_mct_fix_mul_avx2(r, k2449), mi_mct_fix_mul_avx2(g, k4809)),
+		                             mi_mct_fix_mul_avx2(b, k934));
+		__m256i u = _mm256_add_epi32(_mm256_sub_epi32(_mm256_sub_epi32(_mm256_setzero_si256(), mi_mct_fix_mul_avx2(r, k1382)),
+		                                              mi_mct_fix_mul_avx2(g, k2714)),
+		                             mi_mct_fix_mul_avx2(b, k4096));
+		__m256i v = _mm256_sub_epi32(_mm256_sub_epi32(mi_mct_fix_mul_avx2(r, k4096), mi_mct_fix_mul_avx2(g, k3430)),
+		                             mi_mct_fix_mul_avx2(b, k666));
+		_mm256_storeu_si256((__m256i*)(c0 + i), y);
+		_mm256_storeu_si256((__m256i*)(c1 + i), u);
+		_mm256_storeu_si256((__m256i*)(c2 + i), v);
+	}
+	return i;
+}
+
+static mi_TARGET_AVX2 mi_UINT32 mi_mct_decode_real_avx2(mi_FLOAT32* restrict c0, mi_FLOAT32* restrict c1, mi_FLOAT32* restrict c2, mi_UINT32 n)
+{
+	const __m256 l_vr = _mm256_set1_ps(1.402f);
+	const __m256 l_ug = _mm256_set1_ps(0.34413f);
+	const __m256 l_vg = _mm256_set1_ps(0.71414f);
+	const __m256 l_ub = _mm256_set1_ps(1.772f);
+	mi_UINT32 i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		__m256 y = _mm256_loadu_ps(c0 + i);
+		__m256 u = _mm256_loadu_ps(c1 + i);
+		__m256 v = _mm256_loadu_ps(c2 + i);
+		_mm256_storeu_ps(c0 + i, _mm256_add_ps(y, _mm256_mul_ps(v, l_vr)));
+		_mm256_storeu_ps(c1 + i, _mm256_sub_ps(_mm256_sub_ps(y, _mm256_mul_ps(u, l_ug)), _mm256_mul_ps(v, l_vg)));
+		_mm256_storeu_ps(c2 + i, _mm256_add_ps(y, _mm256_mul_ps(u, l_ub)));
+	}
+	return i;
+}
+
+static mi_TARGET_AVX2 mi_UINT32 mi_mct_decode_real_dc_shift_avx2(mi_INT32* restrict c0, mi_INT32* restrict c1, mi_INT32* restrict c2, mi_UINT32 n,
+                                                                  const mi_INT32 * p_dc_shift, const mi_INT32 * p_min, const mi_INT32 * p_max)
+{
+	const __m256 l_vr = _mm256_set1_ps(1.402f);
+	const __m256 l_ug = _mm256_set1_ps(0.34413f);
+	const __m256 l_vg = _mm256_set1_ps(0.71414f);
+	const __m256 l_ub = _mm256_set1_ps(1.772f);
+	const __m256i l_s0 = _mm256_set1_epi32(p_dc_shift[0]);
+	const __m256i l_s1 = _mm256_set1_epi32(p_dc_shift[1]);
+	const __m256i l_s2 = _mm256_set1_epi32(p_dc_shift[2]);
+	const __m256i l_min0 = _mm256_set1_epi32(p_min[0]), l_max0 = _mm256_set1_epi32(p_max[0]);
+	const __m256i l_min1 = _mm256_set1_epi32(p_min[1]), l_max1 = _mm256_set1_epi32(p_max[1]);
+	const __m256i l_min2 = _mm256_set1_epi32(p_min[2]), l_max2 = _mm256_set1_epi32(p_max[2]);
+	mi_UINT32 i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		__m256 y = _mm256_loadu_ps((const mi_FLOAT32*)(c0 + i));
+		__m256 u = _mm256_loadu_ps((const mi_FLOAT32*)(c1 + i));
+		__m256 v = _mm256_loadu_ps((const mi_FLOAT32*)(c2 + i));
+		__m256i r = _mm256_cvtps_epi32(_mm256_add_ps(y, _mm256_mul_ps(v, l_vr)));
+		__m256i g = _mm256_cvtps_epi32(_mm256_sub_ps(_mm256_sub_ps(y, _mm256_mul_ps(u, l_ug)), _mm256_mul_ps(v, l_vg)));
+		__m256i b = _mm256_cvtps_epi32(_mm256_add_ps(y, _mm256_mul_ps(u, l_ub)));
+		r = _mm256_max_epi32(l_min0, _mm256_min_epi32(_mm256_add_epi32(r, l_s0), l_max0));
+		g = _mm256_max_epi32(l_min1, _mm256_min_epi32(_mm256_add_epi32(g, l_s1), l_max1));
+		b = _mm256_max_epi32(l_min2, _mm256_min_epi32(_mm256_add_epi32(b, l_s2), l_max2));
+		_mm256_storeu_si256((__m256i*)(c0 + i), r);
+		_mm256_storeu_si256((__m256i*)(c1 + i), g);
+		_mm256_storeu_si256((__m256i*)(c2 + i), b);
+	}
+	return i;
+}
+#endif /* mi_HAVE_AVX2 */
+
 /* <summary> */
 /* Get norm of basis function of irreversible MCT. */
 /* </summary> */
@@ -25,6 +25,17 @@ Apply a reversible multi-component transform to an image
 */
 void mi_mct_encode(mi_INT32 *c0, mi_INT32 *c1, mi_INT32 *c2, mi_UINT32 n);
 /**
+Apply a reversible multi-component transform to an image, subtracting first
+the DC level of each component (the DC level shift and the transform are done
+in one pass over the samples)
+@param c0 Samples for red component
+@param c1 Samples for green component
+@param c2 Samples blue component
+@param n Number of samples for each component
+@param p_dc_shift DC level of each of the three components
+*/
+void mi_mct_encode_dc_shift(mi_INT32 *c0, mi_INT32 *c1, mi_INT32 *c2, mi_UINT32 n, const mi_INT32 *p_dc_shift);
+/**
 Apply a reversible multi-component inverse transform to an image
 @param c0 Samples for luminance component
 @param c1 Samples for red chrominance component
@@ -33,6 +44,19 @@ Apply a reversible multi-component inverse transform to an image
 */
 void mi_mct_decode(mi_INT32 *c0, mi_INT32 *c1, mi_INT32 *c2, mi_UINT32 n);
 /**
+Apply a reversible multi-component inverse transform to an image, then add the
+DC level of each component and clamp the samples to their range, in one pass
+@param c0 Samples for luminance component
+@param c1 Samples for red chrominance component
+@param c2 Samples for blue chrominance component
+@param n Number of samples for each component
+@param p_dc_shift DC level of each of the three components
+@param p_min Minimum sample value of each of the three components
+@param p_max Maximum sample value of each of the three components
+*/
+void mi_mct_decode_dc_shift(mi_INT32 *c0, mi_INT32 *c1, mi_INT32 *c2, mi_UINT32 n,
+                            const mi_INT32 *p_dc_shift, const mi_INT32 *p_min, const mi_INT32 *p_max);
+/**
 Get norm of the basis function used for the reversible multi-component transform
 @param compno Number of the component (0->Y, 1->U, 2->V)
 @return 
@@ -48,6 +72,17 @@ Apply an irreversible multi-component transform to an image
 */
 void mi_mct_encode_real(mi_INT32 *c0, mi_INT32 *c1, mi_INT32 *c2, mi_UINT32 n);
 /**
+Apply an irreversible multi-component transform to an image, subtracting first
+the DC level of each component and giving the samples the 11 fractional bits
+used by the irreversible DWT, in one pass over the samples
+@param c0 Samples for red component
+@param c1 Samples for green component
+@param c2 Samples blue component
+@param n Number of samples for each component
+@param p_dc_shift DC level of each of the three components
+*/
+void mi_mct_encode_real_dc_shift(mi_INT32 *c0, mi_INT32 *c1, mi_INT32 *c2, mi_UINT32 n, const mi_INT32 *p_dc_shift);
+/**
 Apply an irreversible multi-component inverse transform to an image
 @param c0 Samples for luminance component
 @param c1 Samples for red chrominance component
@@ -56,6 +91,20 @@ Apply an irreversible multi-component inverse transform to an image
 */
 void mi_mct_decode_real(mi_FLOAT32* c0, mi_FLOAT32* c1, mi_FLOAT32* c2, mi_UINT32 n);
 /**
+Apply an irreversible multi-component inverse transform to an image, then round
+the samples, add the DC level of each component and clamp the samples to their
+range, in one pass
+@param c0 Samples for luminance component, floats on input and integers on output
+@param c1 Samples for red chrominance component, floats on input and integers on output
+@param c2 Samples for blue chrominance component, floats on input and integers on output
+@param n Number of samples for each component
+@param p_dc_shift DC level of each of the three components
+@param p_min Minimum sample value of each of the three components
+@param p_max Maximum sample value of each of the three components
+*/
+void mi_mct_decode_real_dc_shift(mi_INT32 *c0, mi_INT32 *c1, mi_INT32 *c2, mi_UINT32 n,
+                                 const mi_INT32 *p_dc_shift, const mi_INT32 *p_min, const mi_INT32 *p_max);
+/**
 Get norm of the basis function used for the irreversible multi-component transform
 @param compno Number of the component (0->Y, 1->U, 2->V)
 @return 
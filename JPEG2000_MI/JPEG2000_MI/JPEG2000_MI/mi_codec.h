@@ -35,6 +35,20 @@ typedef struct mi_codec_private
                                      mi_image_t * p_image,
                                      struct mi_event_mgr * p_manager);
 
+            /** Decoding function writing the samples into a buffer of the caller */
+            mi_BOOL (*mi_decode_to_buffer) ( void * p_codec,
+                                               struct mi_stream_private * p_cio,
+                                               mi_image_t * p_image,
+                                               const mi_decode_buffer_t * p_buffer,
+                                               struct mi_event_mgr * p_manager);
+
+            /** Function rewriting the codestream without decoding it, NULL if the codec cannot */
+            mi_BOOL (*mi_transcode) ( void * p_codec,
+                                        struct mi_stream_private * p_cio,
+                                        struct mi_stream_private * p_out_cio,
+                                        const mi_transcode_parameters_t * p_parameters,
+                                        struct mi_event_mgr * p_manager);
+
             /** FIXME DOC */
             mi_BOOL (*mi_read_tile_header)( void * p_codec,
                                               mi_UINT32 * p_tile_index,
@@ -65,7 +79,9 @@ typedef struct mi_codec_private
             void (*mi_destroy) (void * p_codec);
 
             /** Setup decoder function handler */
-            void (*mi_setup_decoder) ( void * p_codec, mi_dparameters_t * p_param);
+            mi_BOOL (*mi_setup_decoder) ( void * p_codec,
+                                            mi_dparameters_t * p_param,
+                                            struct mi_event_mgr * p_manager);
 
             /** Set decode area function handler */
             mi_BOOL (*mi_set_decode_area) ( void * p_codec,
@@ -131,6 +147,8 @@ typedef struct mi_codec_private
     void (*mi_dump_codec) (void * p_codec, mi_INT32 info_flag, FILE* output_stream);
     mi_codestream_info_v2_t* (*mi_get_codec_info)(void* p_codec);
     mi_codestream_index_t* (*mi_get_codec_index)(void* p_codec);
+    /** Set the number of threads of the codec */
+    mi_BOOL (*mi_set_threads)(void * p_codec, mi_UINT32 num_threads);
 }mi_codec_private_t;
 
 
@@ -0,0 +1,131 @@
+
+#include "mi_includes.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define mi_CPUID_MSVC
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define mi_CPUID_GCC
+#endif
+
+#if defined(mi_CPUID_MSVC) || defined(mi_CPUID_GCC)
+/**
+Run the CPUID instruction.
+@param p_leaf     main leaf (EAX)
+@param p_subleaf  sub-leaf (ECX)
+@param p_regs     EAX, EBX, ECX and EDX on return
+*/
+static void mi_cpuid(mi_UINT32 p_leaf, mi_UINT32 p_subleaf, mi_UINT32 p_regs[4]);
+
+/**
+Read the extended control register XCR0 (states saved by the system).
+@return the low 32 bits of XCR0
+*/
+static mi_UINT32 mi_xgetbv0(void);
+#endif
+
+/**
+Detect the processor features.
+@return a combination of the mi_CPU_* flags
+*/
+static mi_UINT32 mi_cpu_detect(void);
+
+/** Features of the processor, -1 until detected */
+static volatile mi_INT32 mi_cpu_features = -1;
+
+/* The features are read and written by several threads: use atomic accesses */
+/* where the compiler has them (MSVC gives acquire/release semantics to the   */
+/* volatile accesses)                                                          */
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7))
+#define mi_CPU_LOAD(v)		__atomic_load_n(&(v), __ATOMIC_ACQUIRE)
+#define mi_CPU_STORE(v, x)	__atomic_store_n(&(v), (x), __ATOMIC_RELEASE)
+#else
+#define mi_CPU_LOAD(v)		(v)
+#define mi_CPU_STORE(v, x)	((v) = (x))
+#endif
+
+#if defined(mi_CPUID_MSVC) || defined(mi_CPUID_GCC)
+static void mi_cpuid(mi_UINT32 p_leaf, mi_UINT32 p_subleaf, mi_UINT32 p_regs[4])
+{
+#ifdef mi_CPUID_MSVC
+	int l_regs[4];
+	__cpuidex(l_regs, (int)p_leaf, (int)p_subleaf);
+	p_regs[0] = (mi_UINT32)l_regs[0];
+	p_regs[1] = (mi_UINT32)l_regs[1];
+	p_regs[2] = (mi_UINT32)l_regs[2];
+	p_regs[3] = (mi_UINT32)l_regs[3];
+#else
+	unsigned int a, b, c, d;
+	__cpuid_count(p_leaf, p_subleaf, a, b, c, d);
+	p_regs[0] = a;
+	p_regs[1] = b;
+	p_regs[2] = c;
+	p_regs[3] = d;
+#endif
+}
+
+static mi_UINT32 mi_xgetbv0(void)
+{
+#ifdef mi_CPUID_MSVC
+	return (mi_UINT32)_xgetbv(0);
+#else
+	unsigned int a, d;
+	/* xgetbv, written as bytes for the assemblers which do not know it */
+	__asm__ __volatile__ (".byte 0x0f, 0x01, 0xd0" : "=a" (a), "=d" (d) : "c" (0));
+	(void)d;
+	return a;
+#endif
+}
+#endif
+
+static mi_UINT32 mi_cpu_detect(void)
+{
+	mi_UINT32 l_features = 0;
+#if defined(mi_CPUID_MSVC) || defined(mi_CPUID_GCC)
+	mi_UINT32 l_regs[4];
+	mi_UINT32 l_max_leaf;
+
+	mi_cpuid(0, 0, l_regs);
+	l_max_leaf = l_regs[0];
+	if (l_max_leaf < 1) {
+		return 0;
+	}
+
+	mi_cpuid(1, 0, l_regs);
+#ifdef mi_HAVE_SSE2
+	if (l_regs[3] & (1U << 26)) {
+		l_features |= mi_CPU_SSE2;
+	}
+#endif
+#ifdef mi_HAVE_AVX2
+	/* AVX and OSXSAVE, then the XMM and YMM states saved by the system */
+	if ((l_regs[2] & (1U << 27)) && (l_regs[2] & (1U << 28)) &&
+	    (mi_xgetbv0() & 0x6) == 0x6 && l_max_leaf >= 7) {
+		mi_cpuid(7, 0, l_regs);
+		if (l_regs[1] & (1U << 5)) {
+			l_features |= mi_CPU_AVX2;
+		}
+	}
+#endif
+#endif
+	return l_features;
+}
+
+mi_UINT32 mi_cpu_get_features(void)
+{
+	mi_INT32 l_features = mi_CPU_LOAD(mi_cpu_features);
+	/* two threads doing the first call both run the (same) detection */
+	if (l_features < 0) {
+		l_features = (mi_INT32)mi_cpu_detect();
+		mi_CPU_STORE(mi_cpu_features, l_features);
+	}
+	return (mi_UINT32)l_features;
+}
+
+mi_UINT32 mi_cpu_set_features(mi_UINT32 p_features)
+{
+	mi_UINT32 l_previous = mi_cpu_get_features();
+	mi_CPU_STORE(mi_cpu_features, (mi_INT32)(mi_cpu_detect() & p_features));
+	return l_previous;
+}
@@ -0,0 +1,79 @@
+
+#ifndef __mi_CPU_H
+#define __mi_CPU_H
+/**
+@file mi_cpu.h
+@brief Internal functions for the detection of the processor features
+
+The functions in mi_CPU.C detect at run time the SIMD instruction sets supported
+by the processor and the operating system, so that the SIMD kernels compiled in
+the library are only used where they can run.
+*/
+
+/** @defgroup MISC MISC - Miscellaneous internal functions */
+/*@{*/
+
+/*
+SIMD kernels compiled in the library.
+SSE2 is part of every x86-64 processor. The AVX2 kernels are compiled in every
+x86 build, with the target attribute for GCC and clang, and are only called
+when the processor supports them.
+*/
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define mi_HAVE_SSE2
+#endif
+
+#if (defined(_MSC_VER) && _MSC_VER >= 1800 && (defined(_M_X64) || defined(_M_IX86))) || \
+    ((defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))) && \
+     (defined(__x86_64__) || defined(__i386__)))
+#define mi_HAVE_AVX2
+#endif
+
+/** Function attribute allowing the AVX2 instructions in a function */
+#if defined(mi_HAVE_AVX2) && defined(__GNUC__)
+#define mi_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define mi_TARGET_AVX2
+#endif
+
+/* The intrinsics headers use malloc and free, so they come before mi_malloc.h */
+#ifdef mi_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef mi_HAVE_AVX2
+#include <immintrin.h>
+#endif
+
+/** @name Processor features */
+/*@{*/
+#define mi_CPU_SSE2		0x0001	/**< SSE2 instructions */
+#define mi_CPU_AVX2		0x0002	/**< AVX2 instructions, with the YMM registers saved by the system */
+/*@}*/
+
+/** @name Exported functions */
+/*@{*/
+/* ----------------------------------------------------------------------- */
+
+/**
+Get the SIMD instruction sets which can be used on this machine.
+The detection is done on the first call only.
+@return a combination of the mi_CPU_* flags
+*/
+mi_UINT32 mi_cpu_get_features(void);
+
+/**
+Restrict the SIMD instruction sets used by the library.
+This lets the tests run the SIMD kernels and the scalar code on the same
+inputs. It must not be called while the library is coding.
+@param p_features a combination of the mi_CPU_* flags, the ones the machine
+                  does not support being ignored
+@return the features used before the call
+*/
+mi_UINT32 mi_cpu_set_features(mi_UINT32 p_features);
+
+/* ----------------------------------------------------------------------- */
+/*@}*/
+
+/*@}*/
+
+#endif /* __mi_CPU_H */
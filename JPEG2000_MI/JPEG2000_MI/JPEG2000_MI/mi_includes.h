@@ -145,9 +145,11 @@ static INLINE long mi_lrintf(float f) {
 
 #include "mi_inttypes.h"
 #include "mi_clock.h"
+#include "mi_cpu.h"
 #include "mi_malloc.h"
 #include "event.h"
 #include "function_list.h"
+#include "thread.h"
 #include "bio.h"
 #include "cio.h"
 
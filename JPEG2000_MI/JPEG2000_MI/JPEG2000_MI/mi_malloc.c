@@ -151,3 +151,104 @@ void mi_free(void *ptr)
 {
   free(ptr);
 }
+
+/**
+Block of an arena, followed by its memory
+*/
+struct mi_arena_block {
+  /** next block, used before this one */
+  struct mi_arena_block *next;
+  /** bytes of memory of the block */
+  size_t size;
+};
+
+/* the memory of a block starts at the first multiple of 16 after the header */
+#define mi_ARENA_ALIGN 16U
+#define mi_ARENA_HEADER_SIZE ((sizeof(mi_arena_block_t) + mi_ARENA_ALIGN - 1U) & ~(size_t)(mi_ARENA_ALIGN - 1U))
+
+static mi_arena_block_t * mi_arena_block_create(size_t size)
+{
+  mi_arena_block_t *l_block;
+
+  if (size > SIZE_MAX - mi_ARENA_HEADER_SIZE) {
+    return NULL;
+  }
+  l_block = (mi_arena_block_t *)malloc(mi_ARENA_HEADER_SIZE + size);
+  if (l_block != NULL) {
+    l_block->next = NULL;
+    l_block->size = size;
+  }
+  return l_block;
+}
+
+void mi_arena_init(mi_arena_t *arena, size_t block_size)
+{
+  arena->blocks = NULL;
+  arena->used = 0U;
+  arena->total = 0U;
+  arena->block_size = block_size;
+}
+
+void * mi_arena_alloc(mi_arena_t *arena, size_t size)
+{
+  size_t l_size;
+  void *l_ptr;
+
+  if (size == 0U || size > SIZE_MAX - (mi_ARENA_ALIGN - 1U)) {
+    return NULL;
+  }
+  l_size = (size + mi_ARENA_ALIGN - 1U) & ~(size_t)(mi_ARENA_ALIGN - 1U);
+
+  if (arena->blocks == NULL || arena->blocks->size - arena->used < l_size) {
+    /* the rest of the current block is left unused */
+    mi_arena_block_t *l_block = mi_arena_block_create(l_size > arena->block_size ? l_size : arena->block_size);
+    if (l_block == NULL) {
+      return NULL;
+    }
+    l_block->next = arena->blocks;
+    arena->blocks = l_block;
+    arena->used = 0U;
+    arena->total += l_block->size;
+  }
+
+  l_ptr = (mi_UINT8 *)arena->blocks + mi_ARENA_HEADER_SIZE + arena->used;
+  arena->used += l_size;
+  return l_ptr;
+}
+
+void * mi_arena_calloc(mi_arena_t *arena, size_t num, size_t size)
+{
+  void *l_ptr;
+
+  if (num == 0U || size == 0U || num > SIZE_MAX / size) {
+    return NULL;
+  }
+  l_ptr = mi_arena_alloc(arena, num * size);
+  if (l_ptr != NULL) {
+    memset(l_ptr, 0, num * size);
+  }
+  return l_ptr;
+}
+
+void mi_arena_reset(mi_arena_t *arena)
+{
+  if (arena->blocks != NULL && arena->blocks->next != NULL) {
+    /* one block large enough for the next use if it is like the previous one */
+    size_t l_total = arena->total;
+    mi_arena_destroy(arena);
+    arena->blocks = mi_arena_block_create(l_total);
+    arena->total = arena->blocks ? l_total : 0U;
+  }
+  arena->used = 0U;
+}
+
+void mi_arena_destroy(mi_arena_t *arena)
+{
+  while (arena->blocks != NULL) {
+    mi_arena_block_t *l_next = arena->blocks->next;
+    free(arena->blocks);
+    arena->blocks = l_next;
+  }
+  arena->used = 0U;
+  arena->total = 0U;
+}
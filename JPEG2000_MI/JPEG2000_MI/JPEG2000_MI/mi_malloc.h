@@ -13,6 +13,26 @@ The functions in mi_malloc.h are internal utilities used for memory management.
 /** @defgroup MISC MISC - Miscellaneous internal functions */
 /*@{*/
 
+/**
+Block of an arena
+*/
+typedef struct mi_arena_block mi_arena_block_t;
+
+/**
+Arena: memory taken from a few large blocks, by increasing an offset, and
+given back all at once by mi_arena_reset or mi_arena_destroy
+*/
+typedef struct mi_arena {
+	/** the blocks, the one being used first */
+	mi_arena_block_t *blocks;
+	/** bytes used in the first block */
+	size_t used;
+	/** bytes of all the blocks */
+	size_t total;
+	/** minimum size of a new block */
+	size_t block_size;
+} mi_arena_t;
+
 /** @name Exported functions */
 /*@{*/
 /* ----------------------------------------------------------------------- */
@@ -55,6 +75,44 @@ Deallocates or frees a memory block.
 */
 void mi_free(void * m);
 
+/**
+Initializes an empty arena
+@param arena Arena to initialize
+@param block_size Minimum size of the blocks the arena allocates
+*/
+void mi_arena_init(mi_arena_t *arena, size_t block_size);
+
+/**
+Takes an uninitialized memory block from an arena, aligned as the blocks of mi_malloc.
+The block is valid until the next mi_arena_reset or mi_arena_destroy.
+@param arena Arena to allocate from
+@param size Bytes to allocate
+@return Returns a void pointer to the allocated space, or NULL if there is insufficient memory available
+*/
+void * mi_arena_alloc(mi_arena_t *arena, size_t size);
+
+/**
+Takes a memory block with elements initialized to 0 from an arena
+@param arena Arena to allocate from
+@param num Blocks to allocate
+@param size Bytes per block to allocate
+@return Returns a void pointer to the allocated space, or NULL if there is insufficient memory available
+*/
+void * mi_arena_calloc(mi_arena_t *arena, size_t num, size_t size);
+
+/**
+Gives back all the memory taken from an arena, which keeps its blocks for the next
+allocations (several blocks are replaced by a single one of their total size)
+@param arena Arena to reset
+*/
+void mi_arena_reset(mi_arena_t *arena);
+
+/**
+Frees the blocks of an arena
+@param arena Arena to destroy
+*/
+void mi_arena_destroy(mi_arena_t *arena);
+
 #if defined(__GNUC__) && !defined(mi_SKIP_POISON)
 #pragma GCC poison malloc calloc realloc free
 #endif
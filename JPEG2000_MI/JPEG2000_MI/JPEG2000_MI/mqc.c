@@ -21,142 +21,123 @@ static void mi_mqc_renorme(mi_mqc_t *mqc);
 /**
 Encode the most probable symbol
 @param mqc MQC handle
+@param s State of the current context
 */
-static void mi_mqc_codemps(mi_mqc_t *mqc);
+static void mi_mqc_codemps(mi_mqc_t *mqc, mi_mqc_state_t s);
 /**
 Encode the most least symbol
 @param mqc MQC handle
+@param s State of the current context
 */
-static void mi_mqc_codelps(mi_mqc_t *mqc);
+static void mi_mqc_codelps(mi_mqc_t *mqc, mi_mqc_state_t s);
 /**
 Fill mqc->c with 1's for flushing
 @param mqc MQC handle
 */
 static void mi_mqc_setbits(mi_mqc_t *mqc);
-/**
-FIXME DOC
-@param mqc MQC handle
-@return 
-*/
-static INLINE mi_INT32 mi_mqc_mpsexchange(mi_mqc_t *const mqc);
-/**
-FIXME DOC
-@param mqc MQC handle
-@return 
-*/
-static INLINE mi_INT32 mi_mqc_lpsexchange(mi_mqc_t *const mqc);
-/**
-Input a byte
-@param mqc MQC handle
-*/
-static INLINE void mi_mqc_bytein(mi_mqc_t *const mqc);
-/**
-Renormalize mqc->a and mqc->c while decoding
-@param mqc MQC handle
-*/
-static INLINE void mi_mqc_renormd(mi_mqc_t *const mqc);
 /*@}*/
 
 /*@}*/
 
 /* <summary> */
 /* This array defines all the possible states for a context. */
+/* MQC_STATE(qeval, mps, index of the next MPS state, index of the next LPS state) */
 /* </summary> */
-static mi_mqc_state_t mqc_states[47 * 2] = {
-	{0x5601, 0, &mqc_states[2], &mqc_states[3]},
-	{0x5601, 1, &mqc_states[3], &mqc_states[2]},
-	{0x3401, 0, &mqc_states[4], &mqc_states[12]},
-	{0x3401, 1, &mqc_states[5], &mqc_states[13]},
-	{0x1801, 0, &mqc_states[6], &mqc_states[18]},
-	{0x1801, 1, &mqc_states[7], &mqc_states[19]},
-	{0x0ac1, 0, &mqc_states[8], &mqc_states[24]},
-	{0x0ac1, 1, &mqc_states[9], &mqc_states[25]},
-	{0x0521, 0, &mqc_states[10], &mqc_states[58]},
-	{0x0521, 1, &mqc_states[11], &mqc_states[59]},
-	{0x0221, 0, &mqc_states[76], &mqc_states[66]},
-	{0x0221, 1, &mqc_states[77], &mqc_states[67]},
-	{0x5601, 0, &mqc_states[14], &mqc_states[13]},
-	{0x5601, 1, &mqc_states[15], &mqc_states[12]},
-	{0x5401, 0, &mqc_states[16], &mqc_states[28]},
-	{0x5401, 1, &mqc_states[17], &mqc_states[29]},
-	{0x4801, 0, &mqc_states[18], &mqc_states[28]},
-	{0x4801, 1, &mqc_states[19], &mqc_states[29]},
-	{0x3801, 0, &mqc_states[20], &mqc_states[28]},
-	{0x3801, 1, &mqc_states[21], &mqc_states[29]},
-	{0x3001, 0, &mqc_states[22], &mqc_states[34]},
-	{0x3001, 1, &mqc_states[23], &mqc_states[35]},
-	{0x2401, 0, &mqc_states[24], &mqc_states[36]},
-	{0x2401, 1, &mqc_states[25], &mqc_states[37]},
-	{0x1c01, 0, &mqc_states[26], &mqc_states[40]},
-	{0x1c01, 1, &mqc_states[27], &mqc_states[41]},
-	{0x1601, 0, &mqc_states[58], &mqc_states[42]},
-	{0x1601, 1, &mqc_states[59], &mqc_states[43]},
-	{0x5601, 0, &mqc_states[30], &mqc_states[29]},
-	{0x5601, 1, &mqc_states[31], &mqc_states[28]},
-	{0x5401, 0, &mqc_states[32], &mqc_states[28]},
-	{0x5401, 1, &mqc_states[33], &mqc_states[29]},
-	{0x5101, 0, &mqc_states[34], &mqc_states[30]},
-	{0x5101, 1, &mqc_states[35], &mqc_states[31]},
-	{0x4801, 0, &mqc_states[36], &mqc_states[32]},
-	{0x4801, 1, &mqc_states[37], &mqc_states[33]},
-	{0x3801, 0, &mqc_states[38], &mqc_states[34]},
-	{0x3801, 1, &mqc_states[39], &mqc_states[35]},
-	{0x3401, 0, &mqc_states[40], &mqc_states[36]},
-	{0x3401, 1, &mqc_states[41], &mqc_states[37]},
-	{0x3001, 0, &mqc_states[42], &mqc_states[38]},
-	{0x3001, 1, &mqc_states[43], &mqc_states[39]},
-	{0x2801, 0, &mqc_states[44], &mqc_states[38]},
-	{0x2801, 1, &mqc_states[45], &mqc_states[39]},
-	{0x2401, 0, &mqc_states[46], &mqc_states[40]},
-	{0x2401, 1, &mqc_states[47], &mqc_states[41]},
-	{0x2201, 0, &mqc_states[48], &mqc_states[42]},
-	{0x2201, 1, &mqc_states[49], &mqc_states[43]},
-	{0x1c01, 0, &mqc_states[50], &mqc_states[44]},
-	{0x1c01, 1, &mqc_states[51], &mqc_states[45]},
-	{0x1801, 0, &mqc_states[52], &mqc_states[46]},
-	{0x1801, 1, &mqc_states[53], &mqc_states[47]},
-	{0x1601, 0, &mqc_states[54], &mqc_states[48]},
-	{0x1601, 1, &mqc_states[55], &mqc_states[49]},
-	{0x1401, 0, &mqc_states[56], &mqc_states[50]},
-	{0x1401, 1, &mqc_states[57], &mqc_states[51]},
-	{0x1201, 0, &mqc_states[58], &mqc_states[52]},
-	{0x1201, 1, &mqc_states[59], &mqc_states[53]},
-	{0x1101, 0, &mqc_states[60], &mqc_states[54]},
-	{0x1101, 1, &mqc_states[61], &mqc_states[55]},
-	{0x0ac1, 0, &mqc_states[62], &mqc_states[56]},
-	{0x0ac1, 1, &mqc_states[63], &mqc_states[57]},
-	{0x09c1, 0, &mqc_states[64], &mqc_states[58]},
-	{0x09c1, 1, &mqc_states[65], &mqc_states[59]},
-	{0x08a1, 0, &mqc_states[66], &mqc_states[60]},
-	{0x08a1, 1, &mqc_states[67], &mqc_states[61]},
-	{0x0521, 0, &mqc_states[68], &mqc_states[62]},
-	{0x0521, 1, &mqc_states[69], &mqc_states[63]},
-	{0x0441, 0, &mqc_states[70], &mqc_states[64]},
-	{0x0441, 1, &mqc_states[71], &mqc_states[65]},
-	{0x02a1, 0, &mqc_states[72], &mqc_states[66]},
-	{0x02a1, 1, &mqc_states[73], &mqc_states[67]},
-	{0x0221, 0, &mqc_states[74], &mqc_states[68]},
-	{0x0221, 1, &mqc_states[75], &mqc_states[69]},
-	{0x0141, 0, &mqc_states[76], &mqc_states[70]},
-	{0x0141, 1, &mqc_states[77], &mqc_states[71]},
-	{0x0111, 0, &mqc_states[78], &mqc_states[72]},
-	{0x0111, 1, &mqc_states[79], &mqc_states[73]},
-	{0x0085, 0, &mqc_states[80], &mqc_states[74]},
-	{0x0085, 1, &mqc_states[81], &mqc_states[75]},
-	{0x0049, 0, &mqc_states[82], &mqc_states[76]},
-	{0x0049, 1, &mqc_states[83], &mqc_states[77]},
-	{0x0025, 0, &mqc_states[84], &mqc_states[78]},
-	{0x0025, 1, &mqc_states[85], &mqc_states[79]},
-	{0x0015, 0, &mqc_states[86], &mqc_states[80]},
-	{0x0015, 1, &mqc_states[87], &mqc_states[81]},
-	{0x0009, 0, &mqc_states[88], &mqc_states[82]},
-	{0x0009, 1, &mqc_states[89], &mqc_states[83]},
-	{0x0005, 0, &mqc_states[90], &mqc_states[84]},
-	{0x0005, 1, &mqc_states[91], &mqc_states[85]},
-	{0x0001, 0, &mqc_states[90], &mqc_states[86]},
-	{0x0001, 1, &mqc_states[91], &mqc_states[87]},
-	{0x5601, 0, &mqc_states[92], &mqc_states[92]},
-	{0x5601, 1, &mqc_states[93], &mqc_states[93]},
+const mi_mqc_state_t mi_mqc_states[47 * 2] = {
+	MQC_STATE(0x5601, 0, 2, 3),
+	MQC_STATE(0x5601, 1, 3, 2),
+	MQC_STATE(0x3401, 0, 4, 12),
+	MQC_STATE(0x3401, 1, 5, 13),
+	MQC_STATE(0x1801, 0, 6, 18),
+	MQC_STATE(0x1801, 1, 7, 19),
+	MQC_STATE(0x0ac1, 0, 8, 24),
+	MQC_STATE(0x0ac1, 1, 9, 25),
+	MQC_STATE(0x0521, 0, 10, 58),
+	MQC_STATE(0x0521, 1, 11, 59),
+	MQC_STATE(0x0221, 0, 76, 66),
+	MQC_STATE(0x0221, 1, 77, 67),
+	MQC_STATE(0x5601, 0, 14, 13),
+	MQC_STATE(0x5601, 1, 15, 12),
+	MQC_STATE(0x5401, 0, 16, 28),
+	MQC_STATE(0x5401, 1, 17, 29),
+	MQC_STATE(0x4801, 0, 18, 28),
+	MQC_STATE(0x4801, 1, 19, 29),
+	MQC_STATE(0x3801, 0, 20, 28),
+	MQC_STATE(0x3801, 1, 21, 29),
+	MQC_STATE(0x3001, 0, 22, 34),
+	MQC_STATE(0x3001, 1, 23, 35),
+	MQC_STATE(0x2401, 0, 24, 36),
+	MQC_STATE(0x2401, 1, 25, 37),
+	MQC_STATE(0x1c01, 0, 26, 40),
+	MQC_STATE(0x1c01, 1, 27, 41),
+	MQC_STATE(0x1601, 0, 58, 42),
+	MQC_STATE(0x1601, 1, 59, 43),
+	MQC_STATE(0x5601, 0, 30, 29),
+	MQC_STATE(0x5601, 1, 31, 28),
+	MQC_STATE(0x5401, 0, 32, 28),
+	MQC_STATE(0x5401, 1, 33, 29),
+	MQC_STATE(0x5101, 0, 34, 30),
+	MQC_STATE(0x5101, 1, 35, 31),
+	MQC_STATE(0x4801, 0, 36, 32),
+	MQC_STATE(0x4801, 1, 37, 33),
+	MQC_STATE(0x3801, 0, 38, 34),
+	MQC_STATE(0x3801, 1, 39, 35),
+	MQC_STATE(0x3401, 0, 40, 36),
+	MQC_STATE(0x3401, 1, 41, 37),
+	MQC_STATE(0x3001, 0, 42, 38),
+	MQC_STATE(0x3001, 1, 43, 39),
+	MQC_STATE(0x2801, 0, 44, 38),
+	MQC_STATE(0x2801, 1, 45, 39),
+	MQC_STATE(0x2401, 0, 46, 40),
+	MQC_STATE(0x2401, 1, 47, 41),
+	MQC_STATE(0x2201, 0, 48, 42),
+	MQC_STATE(0x2201, 1, 49, 43),
+	MQC_STATE(0x1c01, 0, 50, 44),
+	MQC_STATE(0x1c01, 1, 51, 45),
+	MQC_STATE(0x1801, 0, 52, 46),
+	MQC_STATE(0x1801, 1, 53, 47),
+	MQC_STATE(0x1601, 0, 54, 48),
+	MQC_STATE(0x1601, 1, 55, 49),
+	MQC_STATE(0x1401, 0, 56, 50),
+	MQC_STATE(0x1401, 1, 57, 51),
+	MQC_STATE(0x1201, 0, 58, 52),
+	MQC_STATE(0x1201, 1, 59, 53),
+	MQC_STATE(0x1101, 0, 60, 54),
+	MQC_STATE(0x1101, 1, 61, 55),
+	MQC_STATE(0x0ac1, 0, 62, 56),
+	MQC_STATE(0x0ac1, 1, 63, 57),
+	MQC_STATE(0x09c1, 0, 64, 58),
+	MQC_STATE(0x09c1, 1, 65, 59),
+	MQC_STATE(0x08a1, 0, 66, 60),
+	MQC_STATE(0x08a1, 1, 67, 61),
+	MQC_STATE(0x0521, 0, 68, 62),
+	MQC_STATE(0x0521, 1, 69, 63),
+	MQC_STATE(0x0441, 0, 70, 64),
+	MQC_STATE(0x0441, 1, 71, 65),
+	MQC_STATE(0x02a1, 0, 72, 66),
+	MQC_STATE(0x02a1, 1, 73, 67),
+	MQC_STATE(0x0221, 0, 74, 68),
+	MQC_STATE(0x0221, 1, 75, 69),
+	MQC_STATE(0x0141, 0, 76, 70),
+	MQC_STATE(0x0141, 1, 77, 71),
+	MQC_STATE(0x0111, 0, 78, 72),
+	MQC_STATE(0x0111, 1, 79, 73),
+	MQC_STATE(0x0085, 0, 80, 74),
+	MQC_STATE(0x0085, 1, 81, 75),
+	MQC_STATE(0x0049, 0, 82, 76),
+	MQC_STATE(0x0049, 1, 83, 77),
+	MQC_STATE(0x0025, 0, 84, 78),
+	MQC_STATE(0x0025, 1, 85, 79),
+	MQC_STATE(0x0015, 0, 86, 80),
+	MQC_STATE(0x0015, 1, 87, 81),
+	MQC_STATE(0x0009, 0, 88, 82),
+	MQC_STATE(0x0009, 1, 89, 83),
+	MQC_STATE(0x0005, 0, 90, 84),
+	MQC_STATE(0x0005, 1, 91, 85),
+	MQC_STATE(0x0001, 0, 90, 86),
+	MQC_STATE(0x0001, 1, 91, 87),
+	MQC_STATE(0x5601, 0, 92, 92),
+	MQC_STATE(0x5601, 1, 93, 93),
 };
 
 /* 
@@ -213,29 +194,31 @@ static void mi_mqc_renorme(mi_mqc_t *mqc) {
 	} while ((mqc->a & 0x8000) == 0);
 }
 
-static void mi_mqc_codemps(mi_mqc_t *mqc) {
-	mqc->a -= (*mqc->curctx)->qeval;
+static void mi_mqc_codemps(mi_mqc_t *mqc, mi_mqc_state_t s) {
+	const mi_UINT32 qeval = MQC_STATE_QEVAL(s);
+	mqc->a -= qeval;
 	if ((mqc->a & 0x8000) == 0) {
-		if (mqc->a < (*mqc->curctx)->qeval) {
-			mqc->a = (*mqc->curctx)->qeval;
+		if (mqc->a < qeval) {
+			mqc->a = qeval;
 		} else {
-			mqc->c += (*mqc->curctx)->qeval;
+			mqc->c += qeval;
 		}
-		*mqc->curctx = (*mqc->curctx)->nmps;
+		*mqc->curctx = mi_mqc_states[MQC_STATE_NMPS(s)];
 		mi_mqc_renorme(mqc);
 	} else {
-		mqc->c += (*mqc->curctx)->qeval;
+		mqc->c += qeval;
 	}
 }
 
-static void mi_mqc_codelps(mi_mqc_t *mqc) {
-	mqc->a -= (*mqc->curctx)->qeval;
-	if (mqc->a < (*mqc->curctx)->qeval) {
-		mqc->c += (*mqc->curctx)->qeval;
+static void mi_mqc_codelps(mi_mqc_t *mqc, mi_mqc_state_t s) {
+	const mi_UINT32 qeval = MQC_STATE_QEVAL(s);
+	mqc->a -= qeval;
+	if (mqc->a < qeval) {
+		mqc->c += qeval;
 	} else {
-		mqc->a = (*mqc->curctx)->qeval;
+		mqc->a = qeval;
 	}
-	*mqc->curctx = (*mqc->curctx)->nlps;
+	*mqc->curctx = mi_mqc_states[MQC_STATE_NLPS(s)];
 	mi_mqc_renorme(mqc);
 }
 
@@ -247,73 +230,6 @@ static void mi_mqc_setbits(mi_mqc_t *mqc) {
 	}
 }
 
-static INLINE mi_INT32 mi_mqc_mpsexchange(mi_mqc_t *const mqc) {
-	mi_INT32 d;
-	if (mqc->a < (*mqc->curctx)->qeval) {
-		d = (mi_INT32)(1 - (*mqc->curctx)->mps);
-		*mqc->curctx = (*mqc->curctx)->nlps;
-	} else {
-		d = (mi_INT32)(*mqc->curctx)->mps;
-		*mqc->curctx = (*mqc->curctx)->nmps;
-	}
-	
-	return d;
-}
-
-static INLINE mi_INT32 mi_mqc_lpsexchange(mi_mqc_t *const mqc) {
-	mi_INT32 d;
-	if (mqc->a < (*mqc->curctx)->qeval) {
-		mqc->a = (*mqc->curctx)->qeval;
-		d = (mi_INT32)(*mqc->curctx)->mps;
-		*mqc->curctx = (*mqc->curctx)->nmps;
-	} else {
-		mqc->a = (*mqc->curctx)->qeval;
-		d = (mi_INT32)(1 - (*mqc->curctx)->mps);
-		*mqc->curctx = (*mqc->curctx)->nlps;
-	}
-	
-	return d;
-}
-
-static void mi_mqc_bytein(mi_mqc_t *const mqc) {
-	if (mqc->bp != mqc->end) {
-		mi_UINT32 c;
-		if (mqc->bp + 1 != mqc->end) {
-			c = *(mqc->bp + 1);
-		} else {
-			c = 0xff;
-		}
-		if (*mqc->bp == 0xff) {
-			if (c > 0x8f) {
-				mqc->c += 0xff00;
-				mqc->ct = 8;
-			} else {
-				mqc->bp++;
-				mqc->c += c << 9;
-				mqc->ct = 7;
-			}
-		} else {
-			mqc->bp++;
-			mqc->c += c << 8;
-			mqc->ct = 8;
-		}
-	} else {
-		mqc->c += 0xff00;
-		mqc->ct = 8;
-	}
-}
-
-static INLINE void mi_mqc_renormd(mi_mqc_t *const mqc) {
-	do {
-		if (mqc->ct == 0) {
-			mi_mqc_bytein(mqc);
-		}
-		mqc->a <<= 1;
-		mqc->c <<= 1;
-		mqc->ct--;
-	} while (mqc->a < 0x8000);
-}
-
 /* 
 ==========================================================
    MQ-Coder interface
@@ -347,10 +263,11 @@ void mi_mqc_init_enc(mi_mqc_t *mqc, mi_BYTE *bp) {
 }
 
 void mi_mqc_encode(mi_mqc_t *mqc, mi_UINT32 d) {
-	if ((*mqc->curctx)->mps == d) {//ǰڵǰλƽֵǷΪ1
-		mi_mqc_codemps(mqc);
+	const mi_mqc_state_t s = *mqc->curctx;
+	if (MQC_STATE_MPS(s) == d) {//ǰڵǰλƽֵǷΪ1
+		mi_mqc_codemps(mqc, s);
 	} else {
-		mi_mqc_codelps(mqc);
+		mi_mqc_codelps(mqc, s);
 	}
 }
 
@@ -472,30 +389,28 @@ mi_BOOL mi_mqc_init_dec(mi_mqc_t *mqc, mi_BYTE *bp, mi_UINT32 len) {
 	mqc->start = bp;
 	mqc->end = bp + len;
 	mqc->bp = bp;
-	if (len==0) mqc->c = 0xff << 16;
-	else mqc->c = (mi_UINT32)(*mqc->bp << 16);
-	mi_mqc_bytein(mqc);
+	/* end marker: the decoder stops on it and reads 1's from then on */
+	memcpy(mqc->backup, mqc->end, MQC_SENTINEL_SIZE);
+	mqc->end[0] = 0xff;
+	mqc->end[1] = 0xff;
+	mqc->c = (mi_UINT32)(*mqc->bp << 16);
+	mi_mqc_bytein_macro(mqc, mqc->c, mqc->ct);
 	mqc->c <<= 7;
 	mqc->ct -= 7;
 	mqc->a = 0x8000;
         return mi_TRUE;
 }
 
+void mi_mqc_finish_dec(mi_mqc_t *mqc) {
+	memcpy(mqc->end, mqc->backup, MQC_SENTINEL_SIZE);
+}
+
 mi_INT32 mi_mqc_decode(mi_mqc_t *const mqc) {
 	mi_INT32 d;
-	mqc->a -= (*mqc->curctx)->qeval;
-	if ((mqc->c >> 16) < (*mqc->curctx)->qeval) {
-		d = mi_mqc_lpsexchange(mqc);
-		mi_mqc_renormd(mqc);
-	} else {
-		mqc->c -= (*mqc->curctx)->qeval << 16;
-		if ((mqc->a & 0x8000) == 0) {
-			d = mi_mqc_mpsexchange(mqc);
-			mi_mqc_renormd(mqc);
-		} else {
-			d = (mi_INT32)(*mqc->curctx)->mps;
-		}
-	}
+	mi_mqc_dec_load(mqc, curctx, a, c, ct);
+
+	mi_mqc_decode_macro(d, mqc, curctx, a, c, ct);
+	mi_mqc_dec_store(mqc, curctx, a, c, ct);
 
 	return d;
 }
@@ -503,14 +418,14 @@ mi_INT32 mi_mqc_decode(mi_mqc_t *const mqc) {
 void mi_mqc_resetstates(mi_mqc_t *mqc) {
 	mi_UINT32 i;
 	for (i = 0; i < MQC_NUMCTXS; i++) {
-		mqc->ctxs[i] = mqc_states;
+		mqc->ctxs[i] = mi_mqc_states[0];
 	}
 }
 /*һMQ״̬
 MQֵsymbol77ֵ
 77ڡJPEG2000 Standard for Image CompressionConcepts Algorithms and VLSI Architectures186ҳ*/
 void mi_mqc_setstate(mi_mqc_t *mqc, mi_UINT32 ctxno, mi_UINT32 msb, mi_INT32 prob) {
-	mqc->ctxs[ctxno] = &mqc_states[msb + (mi_UINT32)(prob << 1)];
+	mqc->ctxs[ctxno] = mi_mqc_states[msb + (mi_UINT32)(prob << 1)];
 }
 
 
@@ -14,22 +14,43 @@ in MQC.C are used by some function in T1.C.
 /*@{*/
 
 /**
-This struct defines the state of a context.
-MQ״̬
-*/
-typedef struct mi_mqc_state {
-	/** the probability of the Least Probable Symbol (0.75->0x8000, 1.5->0xffff) */
-	mi_UINT32 qeval;
-	/** the Most Probable Symbol (0 or 1) */
-	mi_UINT32 mps;
-	/** next state if the next encoded symbol is the MPS */
-	struct mi_mqc_state *nmps;
-	/** next state if the next encoded symbol is the LPS */
-	struct mi_mqc_state *nlps;
-} mi_mqc_state_t;
+This type defines the state of a context, packed in 32 bits
+MQ״̬:
+<ul>
+<li>bits 0 to 15: the probability of the Least Probable Symbol (0.75->0x8000, 1.5->0xffff)
+<li>bit 16: the Most Probable Symbol (0 or 1)
+<li>bits 17 to 23: index of the next state if the next encoded symbol is the MPS
+<li>bits 24 to 30: index of the next state if the next encoded symbol is the LPS
+</ul>
+Each context holds a copy of its current state, so that coding a symbol only
+reads the state of the context; the next state is read from mi_mqc_states.
+*/
+typedef mi_UINT32 mi_mqc_state_t;
+
+/** Build a state from its fields */
+#define MQC_STATE(qeval, mps, nmps, nlps) \
+	((mi_UINT32)(qeval) | ((mi_UINT32)(mps) << 16) | ((mi_UINT32)(nmps) << 17) | ((mi_UINT32)(nlps) << 24))
+/** Probability of the LPS of a state */
+#define MQC_STATE_QEVAL(s)	((s) & 0xffffU)
+/** MPS of a state */
+#define MQC_STATE_MPS(s)	(((s) >> 16) & 1U)
+/** Index of the next state after a MPS */
+#define MQC_STATE_NMPS(s)	(((s) >> 17) & 0x7fU)
+/** Index of the next state after a LPS */
+#define MQC_STATE_NLPS(s)	((s) >> 24)
+
+/** The 47 * 2 possible states of a context */
+extern const mi_mqc_state_t mi_mqc_states[47 * 2];
 
 #define MQC_NUMCTXS 19
 
+/**
+Number of bytes written by mi_mqc_init_dec after the end of the data to decode
+(a 0xFFFF marker which stops the decoder): the buffers given to the decoder must
+have them allocated
+*/
+#define MQC_SENTINEL_SIZE 2
+
 /**
 MQ coder
 */
@@ -40,11 +61,10 @@ typedef struct mi_mqc {
 	mi_BYTE *bp;//ǰλõǰһλ
 	mi_BYTE *start;//뿪ʼλ
 	mi_BYTE *end;//ֹλ
-	mi_mqc_state_t *ctxs[MQC_NUMCTXS];//CXMQ״̬
-	mi_mqc_state_t **curctx;//һάı״̬
-#ifdef MQC_PERF_OPT
-	unsigned char *buffer;
-#endif
+	mi_mqc_state_t ctxs[MQC_NUMCTXS];//CXMQ״̬
+	mi_mqc_state_t *curctx;//ǰĵ״̬
+	/** bytes overwritten by the end marker of the decoder, restored by mi_mqc_finish_dec */
+	mi_BYTE backup[MQC_SENTINEL_SIZE];
 } mi_mqc_t;
 
 /** @name Exported functions */
@@ -152,13 +172,21 @@ SEGMARK mode switch (SEGSYM)
 */
 void mi_mqc_segmark_enc(mi_mqc_t *mqc);
 /**
-Initialize the decoder
+Initialize the decoder.
+A 0xFFFF marker is written after the end of the data, so that the decoder reads
+1's past it without checking the end of the buffer: bp[len] and bp[len + 1] must
+be allocated (see MQC_SENTINEL_SIZE), and are restored by mi_mqc_finish_dec.
 @param mqc MQC handle
 @param bp Pointer to the start of the buffer from which the bytes will be read
 @param len Length of the input buffer
 */
 mi_BOOL mi_mqc_init_dec(mi_mqc_t *mqc, mi_BYTE *bp, mi_UINT32 len);
 /**
+End the decoding of a buffer: restore the bytes overwritten by mi_mqc_init_dec
+@param mqc MQC handle
+*/
+void mi_mqc_finish_dec(mi_mqc_t *mqc);
+/**
 Decode a symbol
 @param mqc MQC handle
 @return Returns the decoded symbol (0 or 1)
@@ -167,6 +195,136 @@ mi_INT32 mi_mqc_decode(mi_mqc_t * const mqc);
 /* ----------------------------------------------------------------------- */
 /*@}*/
 
+/** @name Inline decoder */
+/*@{*/
+/* ----------------------------------------------------------------------- */
+/*
+The decoding passes of the tier-1 keep the state of the decoder in local
+variables for the whole pass: mi_mqc_dec_load declares them (it must be
+placed at the end of the declarations of a block), the symbols are decoded
+with mi_mqc_decode_macro, and mi_mqc_dec_store writes the state back to the
+handle before it is used by any of the functions above.
+Only mqc->bp is kept in the handle, as it changes once per byte.
+*/
+/**
+Declare the local variables of the decoder and load them from the handle
+*/
+#define mi_mqc_dec_load(mqc, curctx, a, c, ct) \
+	mi_mqc_state_t *curctx = (mqc)->curctx; \
+	mi_UINT32 a = (mqc)->a; \
+	mi_UINT32 c = (mqc)->c; \
+	mi_UINT32 ct = (mqc)->ct
+
+/**
+Write the local variables of the decoder back to the handle
+*/
+#define mi_mqc_dec_store(mqc, curctx, a, c, ct) \
+	{ \
+		(mqc)->curctx = curctx; \
+		(mqc)->a = a; \
+		(mqc)->c = c; \
+		(mqc)->ct = ct; \
+	}
+
+/**
+Set the current context of the local decoder
+*/
+#define mi_mqc_dec_setcurctx(mqc, curctx, ctxno) \
+	curctx = &(mqc)->ctxs[(mi_UINT32)(ctxno)]
+
+/**
+Input a byte. The 0xFFFF marker after the data is never passed, which
+feeds the decoder with 1's once the data is exhausted.
+*/
+#define mi_mqc_bytein_macro(mqc, c, ct) \
+	{ \
+		mi_UINT32 l_c = *((mqc)->bp + 1); \
+		if (*(mqc)->bp == 0xff) { \
+			if (l_c > 0x8f) { \
+				c += 0xff00; \
+				ct = 8; \
+			} else { \
+				(mqc)->bp++; \
+				c += l_c << 9; \
+				ct = 7; \
+			} \
+		} else { \
+			(mqc)->bp++; \
+			c += l_c << 8; \
+			ct = 8; \
+		} \
+	}
+
+/**
+Renormalize a and c while decoding
+*/
+#define mi_mqc_renormd_macro(mqc, a, c, ct) \
+	{ \
+		do { \
+			if (ct == 0) { \
+				mi_mqc_bytein_macro(mqc, c, ct); \
+			} \
+			a <<= 1; \
+			c <<= 1; \
+			ct--; \
+		} while (a < 0x8000); \
+	}
+
+/**
+Conditional exchange of the MPS path (a has fallen below 0x8000),
+s being the state of the current context and qeval its probability
+*/
+#define mi_mqc_mpsexchange_macro(d, curctx, a, s, qeval) \
+	{ \
+		if (a < qeval) { \
+			d = (mi_INT32)(1 - MQC_STATE_MPS(s)); \
+			*curctx = mi_mqc_states[MQC_STATE_NLPS(s)]; \
+		} else { \
+			d = (mi_INT32)MQC_STATE_MPS(s); \
+			*curctx = mi_mqc_states[MQC_STATE_NMPS(s)]; \
+		} \
+	}
+
+/**
+Conditional exchange of the LPS path
+*/
+#define mi_mqc_lpsexchange_macro(d, curctx, a, s, qeval) \
+	{ \
+		if (a < qeval) { \
+			a = qeval; \
+			d = (mi_INT32)MQC_STATE_MPS(s); \
+			*curctx = mi_mqc_states[MQC_STATE_NMPS(s)]; \
+		} else { \
+			a = qeval; \
+			d = (mi_INT32)(1 - MQC_STATE_MPS(s)); \
+			*curctx = mi_mqc_states[MQC_STATE_NLPS(s)]; \
+		} \
+	}
+
+/**
+Decode a symbol in d with the local decoder
+*/
+#define mi_mqc_decode_macro(d, mqc, curctx, a, c, ct) \
+	{ \
+		const mi_mqc_state_t l_s = *curctx; \
+		const mi_UINT32 l_qeval = MQC_STATE_QEVAL(l_s); \
+		a -= l_qeval; \
+		if ((c >> 16) < l_qeval) { \
+			mi_mqc_lpsexchange_macro(d, curctx, a, l_s, l_qeval); \
+			mi_mqc_renormd_macro(mqc, a, c, ct); \
+		} else { \
+			c -= l_qeval << 16; \
+			if ((a & 0x8000) == 0) { \
+				mi_mqc_mpsexchange_macro(d, curctx, a, l_s, l_qeval); \
+				mi_mqc_renormd_macro(mqc, a, c, ct); \
+			} else { \
+				d = (mi_INT32)MQC_STATE_MPS(l_s); \
+			} \
+		} \
+	}
+/* ----------------------------------------------------------------------- */
+/*@}*/
+
 /*@}*/
 
 #endif /* __MQC_H */
@@ -1,6 +1,12 @@
 
 #ifdef _WIN32
 #include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif /* _WIN32 */
 
 #include "mi_includes.h"
@@ -54,6 +60,17 @@ mi_BOOL mi_CALLCONV mi_set_error_handler(mi_codec_t * p_codec,
 	return mi_TRUE;
 }
 
+mi_BOOL mi_CALLCONV mi_codec_set_threads(mi_codec_t *p_codec,
+											int num_threads)
+{
+	mi_codec_private_t * l_codec = (mi_codec_private_t *) p_codec;
+	if (! l_codec || num_threads < 0) {
+		return mi_FALSE;
+	}
+
+	return l_codec->mi_set_threads(l_codec->m_codec, (mi_UINT32)num_threads);
+}
+
 /* ---------------------------------------------------------------------- */
 
 static mi_SIZE_T mi_read_from_file (void * p_buffer, mi_SIZE_T p_nb_bytes, FILE * p_file)
@@ -97,8 +114,118 @@ static mi_BOOL mi_seek_from_file (mi_OFF_T p_nb_bytes, FILE * p_user_data)
 }
 
 /* ---------------------------------------------------------------------- */
+
+/** a file mapped in memory, the user data of the streams of mi_stream_create_mmap_stream */
+typedef struct mi_mapped_file
+{
+	mi_BYTE * m_data;
+	mi_SIZE_T m_size;
 #ifdef _WIN32
+	HANDLE m_file;
+	HANDLE m_mapping;
 #endif /* _WIN32 */
+} mi_mapped_file_t;
+
+static void mi_unmap_file (mi_mapped_file_t * p_file)
+{
+	if (! p_file) {
+		return;
+	}
+#ifdef _WIN32
+	if (p_file->m_data) {
+		UnmapViewOfFile(p_file->m_data);
+	}
+	if (p_file->m_mapping) {
+		CloseHandle(p_file->m_mapping);
+	}
+	if (p_file->m_file != INVALID_HANDLE_VALUE) {
+		CloseHandle(p_file->m_file);
+	}
+#else
+	if (p_file->m_data) {
+		munmap(p_file->m_data, p_file->m_size);
+	}
+#endif /* _WIN32 */
+	mi_free(p_file);
+}
+
+static void mi_release_mapped_file (const mi_BYTE * p_data, mi_SIZE_T p_size, mi_mapped_file_t * p_file)
+{
+#ifdef _WIN32
+	mi_ARG_NOT_USED(p_data);
+	mi_ARG_NOT_USED(p_size);
+	mi_ARG_NOT_USED(p_file);
+#else
+	/* only the pages entirely in the bytes are dropped, they are read again from the file if needed */
+	mi_SIZE_T l_page_size = (mi_SIZE_T)sysconf(_SC_PAGESIZE);
+	mi_SIZE_T l_start = (mi_SIZE_T)(p_data - p_file->m_data);
+	mi_SIZE_T l_end = l_start + p_size;
+
+	l_start = (l_start + l_page_size - 1) / l_page_size * l_page_size;
+	l_end = l_end / l_page_size * l_page_size;
+	if (l_start < l_end) {
+		madvise(p_file->m_data + l_start, l_end - l_start, MADV_DONTNEED);
+	}
+#endif /* _WIN32 */
+}
+
+static mi_mapped_file_t * mi_map_file (const char * fname)
+{
+	mi_mapped_file_t * l_file = (mi_mapped_file_t *) mi_calloc(1, sizeof(mi_mapped_file_t));
+#ifdef _WIN32
+	LARGE_INTEGER l_size;
+#else
+	struct stat l_stat;
+	void * l_data;
+	int l_fd;
+#endif /* _WIN32 */
+
+	if (! l_file) {
+		return 00;
+	}
+
+#ifdef _WIN32
+	l_file->m_file = CreateFileA(fname, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if ((l_file->m_file == INVALID_HANDLE_VALUE) || ! GetFileSizeEx(l_file->m_file, &l_size)
+		|| (l_size.QuadPart <= 0) || ((mi_UINT64)l_size.QuadPart > (mi_UINT64)(mi_SIZE_T)-1)) {
+		mi_unmap_file(l_file);
+		return 00;
+	}
+	l_file->m_mapping = CreateFileMappingA(l_file->m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (! l_file->m_mapping) {
+		mi_unmap_file(l_file);
+		return 00;
+	}
+	l_file->m_data = (mi_BYTE *) MapViewOfFile(l_file->m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (! l_file->m_data) {
+		mi_unmap_file(l_file);
+		return 00;
+	}
+	l_file->m_size = (mi_SIZE_T)l_size.QuadPart;
+#else
+	l_fd = open(fname, O_RDONLY);
+	if (l_fd < 0) {
+		mi_free(l_file);
+		return 00;
+	}
+	if (fstat(l_fd, &l_stat) || (l_stat.st_size <= 0) || ((mi_UINT64)l_stat.st_size > (mi_UINT64)(mi_SIZE_T)-1)) {
+		close(l_fd);
+		mi_free(l_file);
+		return 00;
+	}
+	/* the mapping stays valid once the file is closed */
+	l_data = mmap(NULL, (size_t)l_stat.st_size, PROT_READ, MAP_PRIVATE, l_fd, 0);
+	close(l_fd);
+	if (l_data == MAP_FAILED) {
+		mi_free(l_file);
+		return 00;
+	}
+	l_file->m_data = (mi_BYTE *) l_data;
+	l_file->m_size = (mi_SIZE_T)l_stat.st_size;
+#endif /* _WIN32 */
+
+	return l_file;
+}
 
 /* ---------------------------------------------------------------------- */
 
@@ -133,6 +260,20 @@ mi_codec_t* mi_CALLCONV mi_create_decompress(mi_CODEC_FORMAT p_format)
 									struct mi_stream_private *,
 									mi_image_t*, struct mi_event_mgr * )) mi_j2k_decode;
 
+			l_codec->m_codec_data.m_decompression.mi_decode_to_buffer =
+					(mi_BOOL (*) (	void *,
+									struct mi_stream_private *,
+									mi_image_t*,
+									const mi_decode_buffer_t*,
+									struct mi_event_mgr * )) mi_j2k_decode_to_buffer;
+
+			l_codec->m_codec_data.m_decompression.mi_transcode =
+					(mi_BOOL (*) (	void *,
+									struct mi_stream_private *,
+									struct mi_stream_private *,
+									const mi_transcode_parameters_t*,
+									struct mi_event_mgr * )) mi_j2k_transcode;
+
 			l_codec->m_codec_data.m_decompression.mi_end_decompress =
 					(mi_BOOL (*) (	void *,
 									struct mi_stream_private *,
@@ -148,7 +289,7 @@ mi_codec_t* mi_CALLCONV mi_create_decompress(mi_CODEC_FORMAT p_format)
 					(void (*) (void *))mi_j2k_destroy;
 
 			l_codec->m_codec_data.m_decompression.mi_setup_decoder =
-					(void (*) (void * , mi_dparameters_t * )) mi_j2k_setup_decoder;
+					(mi_BOOL (*) (void * , mi_dparameters_t *, struct mi_event_mgr * )) mi_j2k_setup_decoder;
 
 			l_codec->m_codec_data.m_decompression.mi_read_tile_header =
 					(mi_BOOL (*) (	void *,
@@ -187,6 +328,10 @@ mi_codec_t* mi_CALLCONV mi_create_decompress(mi_CODEC_FORMAT p_format)
 									mi_UINT32 res_factor,
 									struct mi_event_mgr * p_manager)) mi_j2k_set_decoded_resolution_factor;
 
+			l_codec->mi_set_threads =
+                    (mi_BOOL (*) ( void * p_codec,
+									mi_UINT32 num_threads )) mi_j2k_set_threads;
+
 			l_codec->m_codec = mi_j2k_create_decompress();
 
 			if (! l_codec->m_codec) {
@@ -210,6 +355,13 @@ mi_codec_t* mi_CALLCONV mi_create_decompress(mi_CODEC_FORMAT p_format)
 									mi_image_t*,
 									struct mi_event_mgr * )) mi_jp2_decode;
 
+			l_codec->m_codec_data.m_decompression.mi_decode_to_buffer =
+					(mi_BOOL (*) (	void *,
+									struct mi_stream_private *,
+									mi_image_t*,
+									const mi_decode_buffer_t*,
+									struct mi_event_mgr * )) mi_jp2_decode_to_buffer;
+
 			l_codec->m_codec_data.m_decompression.mi_end_decompress =  
                     (mi_BOOL (*) ( void *,
                                     struct mi_stream_private *,
@@ -243,7 +395,7 @@ mi_codec_t* mi_CALLCONV mi_create_decompress(mi_CODEC_FORMAT p_format)
 			l_codec->m_codec_data.m_decompression.mi_destroy = (void (*) (void *))mi_jp2_destroy;
 
 			l_codec->m_codec_data.m_decompression.mi_setup_decoder = 
-                    (void (*) (void * ,mi_dparameters_t * )) mi_jp2_setup_decoder;
+                    (mi_BOOL (*) (void * ,mi_dparameters_t *, struct mi_event_mgr * )) mi_jp2_setup_decoder;
 
 			l_codec->m_codec_data.m_decompression.mi_set_decode_area = 
                     (mi_BOOL (*) ( void *,
@@ -263,6 +415,10 @@ mi_codec_t* mi_CALLCONV mi_create_decompress(mi_CODEC_FORMAT p_format)
 						    		mi_UINT32 res_factor,
 							    	mi_event_mgr_t * p_manager)) mi_jp2_set_decoded_resolution_factor;
 
+			l_codec->mi_set_threads =
+                    (mi_BOOL (*) ( void * p_codec,
+									mi_UINT32 num_threads )) mi_jp2_set_threads;
+
 			l_codec->m_codec = mi_jp2_create(mi_TRUE);
 
 			if (! l_codec->m_codec) {
@@ -309,9 +465,9 @@ mi_BOOL mi_CALLCONV mi_setup_decoder(mi_codec_t *p_codec,
 			return mi_FALSE;
 		}
 
-		l_codec->m_codec_data.m_decompression.mi_setup_decoder(l_codec->m_codec,
-																parameters);
-		return mi_TRUE;
+		return l_codec->m_codec_data.m_decompression.mi_setup_decoder(l_codec->m_codec,
+																	parameters,
+																	&(l_codec->m_event_mgr));
 	}
 	return mi_FALSE;
 }
@@ -360,6 +516,65 @@ mi_BOOL mi_CALLCONV mi_decode(   mi_codec_t *p_codec,
 	return mi_FALSE;
 }
 
+mi_BOOL mi_CALLCONV mi_decode_to_buffer(   mi_codec_t *p_codec,
+                                              mi_stream_t *p_stream,
+                                              mi_image_t* p_image,
+                                              const mi_decode_buffer_t *p_buffer)
+{
+	if (p_codec && p_stream && p_buffer) {
+		mi_codec_private_t * l_codec = (mi_codec_private_t *) p_codec;
+		mi_stream_private_t * l_stream = (mi_stream_private_t *) p_stream;
+
+		if (! l_codec->is_decompressor) {
+			return mi_FALSE;
+		}
+
+		return l_codec->m_codec_data.m_decompression.mi_decode_to_buffer(l_codec->m_codec,
+																l_stream,
+																p_image,
+																p_buffer,
+																&(l_codec->m_event_mgr) );
+	}
+
+	return mi_FALSE;
+}
+
+void mi_CALLCONV mi_set_default_transcode_parameters(mi_transcode_parameters_t *parameters) {
+	if(parameters) {
+		memset(parameters, 0, sizeof(mi_transcode_parameters_t));
+		/* the progression order, layers and resolutions are kept */
+		parameters->prog_order = mi_PROG_UNKNOWN;
+		parameters->max_layers = 0;
+		parameters->reduce = 0;
+	}
+}
+
+mi_BOOL mi_CALLCONV mi_transcode(   mi_codec_t *p_codec,
+                                      mi_stream_t *p_stream,
+                                      mi_stream_t *p_out_stream,
+                                      const mi_transcode_parameters_t *parameters)
+{
+	if (p_codec && p_stream && p_out_stream && parameters) {
+		mi_codec_private_t * l_codec = (mi_codec_private_t *) p_codec;
+		mi_stream_private_t * l_stream = (mi_stream_private_t *) p_stream;
+		mi_stream_private_t * l_out_stream = (mi_stream_private_t *) p_out_stream;
+
+		if (! l_codec->is_decompressor || ! l_codec->m_codec_data.m_decompression.mi_transcode) {
+			mi_event_msg(&(l_codec->m_event_mgr), EVT_ERROR,
+                "Codec provided to the mi_transcode function is not a J2K decompressor handler.\n");
+			return mi_FALSE;
+		}
+
+		return l_codec->m_codec_data.m_decompression.mi_transcode(l_codec->m_codec,
+																l_stream,
+																l_out_stream,
+																parameters,
+																&(l_codec->m_event_mgr) );
+	}
+
+	return mi_FALSE;
+}
+
 mi_BOOL mi_CALLCONV mi_set_decode_area(	mi_codec_t *p_codec,
 											mi_image_t* p_image,
 											mi_INT32 p_start_x, mi_INT32 p_start_y,
@@ -517,6 +732,9 @@ mi_codec_t* mi_CALLCONV mi_create_compress(mi_CODEC_FORMAT p_format)
 																				struct mi_image *,
 																				struct mi_event_mgr * )) mi_j2k_setup_encoder;
 
+			l_codec->mi_set_threads = (mi_BOOL (*) (	void *,
+																	mi_UINT32 )) mi_j2k_set_threads;
+
 			l_codec->m_codec = mi_j2k_create_compress();
 			if (! l_codec->m_codec) {
 				mi_free(l_codec);
@@ -554,6 +772,9 @@ mi_codec_t* mi_CALLCONV mi_create_compress(mi_CODEC_FORMAT p_format)
 																				struct mi_image *,
 																				struct mi_event_mgr * )) mi_jp2_setup_encoder;
 
+			l_codec->mi_set_threads = (mi_BOOL (*) (	void *,
+																	mi_UINT32 )) mi_jp2_set_threads;
+
 			l_codec->m_codec = mi_jp2_create(mi_FALSE);
 			if (! l_codec->m_codec) {
 				mi_free(l_codec);
@@ -869,3 +1090,29 @@ mi_stream_t* mi_CALLCONV mi_stream_create_file_stream (
 
     return l_stream;
 }
+
+mi_stream_t* mi_CALLCONV mi_stream_create_mmap_stream (const char *fname)
+{
+    mi_stream_t* l_stream = 00;
+    mi_mapped_file_t * l_file = 00;
+
+    if (! fname) {
+        return NULL;
+    }
+
+    l_file = mi_map_file(fname);
+    if (! l_file) {
+        return NULL;
+    }
+
+    l_stream = (mi_stream_t *) mi_stream_create_mapped_input(l_file->m_data, l_file->m_size,
+                                                          (mi_stream_release_fn) mi_release_mapped_file);
+    if (! l_stream) {
+        mi_unmap_file(l_file);
+        return NULL;
+    }
+
+    mi_stream_set_user_data(l_stream, l_file, (mi_stream_free_user_data_fn) mi_unmap_file);
+
+    return l_stream;
+}
@@ -460,6 +460,12 @@ typedef struct mi_cparameters {
 	/** RSIZ value
 		To be used to combine mi_PROFILE_*, mi_EXTENSION_* and (sub)levels values. */
 	mi_UINT16 rsiz;
+	/** number of worker threads of the codec thread pool (tier-1 code-blocks, tiles).
+		If == 0 (default), everything is encoded in the calling thread.
+		See also mi_codec_set_threads. */
+	int num_threads;
+	/** Write PLT markers (lengths of the packets) in the tile-part headers */
+	mi_BOOL plt_on;
 } mi_cparameters_t;  
 
 #define mi_DPARAMETERS_IGNORE_PCLR_CMAP_CDEF_FLAG	0x0001
@@ -527,6 +533,11 @@ typedef struct mi_dparameters {
 
 	unsigned int flags;
 
+	/** number of worker threads of the codec thread pool (tier-1 code-blocks, tiles).
+		If == 0 (default), everything is decoded in the calling thread.
+		See also mi_codec_set_threads. */
+	int num_threads;
+
 } mi_dparameters_t;
 
 
@@ -666,6 +677,47 @@ typedef struct mi_image_comptparm {
 	mi_UINT32 sgnd;
 } mi_image_cmptparm_t;
 
+/**
+ * Caller-owned buffer receiving the decoded samples (see mi_decode_to_buffer).
+ * The sample of channel c at (x, y) of the decoded area is stored at
+ * data + c * channel_stride + y * row_stride + x * pixel_stride, e.g. for
+ * 8-bit RGB of width w:
+ *  - interleaved: pixel_stride 3, row_stride 3 * w, channel_stride 1
+ *  - planar:      pixel_stride 1, row_stride w, channel_stride w * h
+ * */
+typedef struct mi_decode_buffer {
+	/** first sample of the first channel */
+	mi_BYTE *data;
+	/** size of a sample: 1 (8 bits) or 2 (16 bits, in the byte order of the host) */
+	mi_UINT32 sample_size;
+	/** number of channels */
+	mi_UINT32 nb_channels;
+	/** image component written to each channel (nb_channels entries) */
+	const mi_UINT32 *comp_map;
+	/** bytes from a sample to the next one of the same row and channel */
+	mi_SIZE_T pixel_stride;
+	/** bytes from a row to the next one */
+	mi_SIZE_T row_stride;
+	/** bytes from a channel to the next one */
+	mi_SIZE_T channel_stride;
+} mi_decode_buffer_t;
+
+/**
+ * Transcoding parameters (see mi_transcode)
+ * */
+typedef struct mi_transcode_parameters {
+	/** progression order of the output, mi_PROG_UNKNOWN to keep the one of each tile */
+	mi_PROG_ORDER prog_order;
+	/** number of quality layers kept, 0 to keep them all */
+	mi_UINT32 max_layers;
+	/** number of highest resolution levels removed */
+	mi_UINT32 reduce;
+	/** write a TLM marker giving the length of each tile-part */
+	mi_BOOL tlm;
+	/** write PLT markers giving the length of each packet */
+	mi_BOOL plt;
+} mi_transcode_parameters_t;
+
 
 /* 
 ==========================================================
@@ -1142,6 +1194,39 @@ extern "C" {
 /*mi_API*/ mi_stream_t* mi_CALLCONV mi_stream_create_file_stream (const char *fname,
 																	 mi_SIZE_T p_buffer_size,
 																	 mi_BOOL p_is_read_stream);
+
+/** Create a read stream over a file identified with its filename, the file being mapped in memory.
+ * The data is read in place from the mapping instead of being copied through a buffer, and the
+ * compressed data of the tiles is decoded from the mapping without being copied. The file must
+ * not be modified as long as the stream is not destroyed.
+ * @param fname             the filename of the file to stream
+ * @return the stream, or NULL if the file could not be mapped
+*/
+/*mi_API*/ mi_stream_t* mi_CALLCONV mi_stream_create_mmap_stream (const char *fname);
+
+/** Create a stream over a memory buffer of the caller.
+ * A read stream reads the bytes of the buffer in place, without copying them through the buffer of the stream,
+ * and the compressed data of the tiles is decoded from the buffer without being copied.
+ * A write stream writes the bytes in place in the buffer, in which the headers are completed by seeking back.
+ * @param p_buffer          for a read stream, the bytes to read. For a write stream, the buffer receiving the bytes
+ *                          written, or NULL for a buffer owned by the stream and growing as needed.
+ *                          A buffer of the caller must be kept as long as the stream is not destroyed.
+ * @param p_size            the number of bytes of p_buffer, or the initial size of the growing buffer (0 for a default size)
+ * @param p_is_read_stream  whether the stream is a read stream (true) or not (false)
+ * @return the stream, or NULL if there is not enough memory
+*/
+/*mi_API*/ mi_stream_t* mi_CALLCONV mi_stream_create_memory_stream (mi_BYTE *p_buffer,
+																	   mi_SIZE_T p_size,
+																	   mi_BOOL p_is_read_stream);
+
+/** Get the bytes of a stream created by mi_stream_create_memory_stream.
+ * For a write stream, these are the bytes written so far, complete once mi_end_compress is done.
+ * The bytes are in the buffer of the caller or, for a growing buffer, in a buffer freed by mi_stream_destroy.
+ * @param p_stream          the stream
+ * @param p_size            receives the number of bytes of the stream (may be NULL)
+ * @return the bytes of the stream, or NULL if the stream is not a memory stream
+*/
+/*mi_API*/ mi_BYTE* mi_CALLCONV mi_stream_get_memory_data (mi_stream_t* p_stream, mi_SIZE_T *p_size);
  
 /* 
 ==========================================================
@@ -1176,6 +1261,21 @@ extern "C" {
 													mi_msg_callback p_callback,
 													void * p_user_data);
 
+/**
+ * Set the number of threads of the thread pool shared by every parallel stage
+ * of the codec (tier-1 code-blocks, tiles).
+ * Must be called after mi_setup_encoder() and before mi_start_compress(), or
+ * after mi_setup_decoder() and before mi_decode(). It overrides the
+ * num_threads value of the parameters.
+ * @param p_codec       the codec previously initialise
+ * @param num_threads   number of worker threads, 0 to run in the calling thread
+ *
+ * @return mi_TRUE if successful, mi_FALSE if the library has no thread support
+ * or the threads cannot be created
+*/
+/*mi_API*/ mi_BOOL mi_CALLCONV mi_codec_set_threads(mi_codec_t * p_codec,
+													int num_threads);
+
 /* 
 ==========================================================
    codec functions definitions
@@ -1266,6 +1366,58 @@ extern "C" {
 											mi_stream_t *p_stream,
 											mi_image_t *p_image);
 
+/**
+ * Decode an image from a JPEG-2000 codestream into a buffer of the caller,
+ * instead of the components of p_image whose data is left to NULL.
+ * The last stage of the decoding (inverse MCT, DC level shift and clamping)
+ * writes the samples of each tile straight into the buffer.
+ *
+ * The mapped components must have the same size, sub-sampling and precision
+ * no larger than 8 * sample_size bits. Signed samples are stored in two's
+ * complement. The palette and channel definitions of a JP2 file are not
+ * applied: a JP2 file with a palette is refused.
+ *
+ * @param p_decompressor 	decompressor handle
+ * @param p_stream			Input buffer stream
+ * @param p_image 			the image header read by mi_read_header (and restricted by mi_set_decode_area)
+ * @param p_buffer			the buffer receiving the decoded area of p_image
+ * @return 					true if success, otherwise false
+ * */
+/*mi_API*/ mi_BOOL mi_CALLCONV mi_decode_to_buffer(   mi_codec_t *p_decompressor,
+											mi_stream_t *p_stream,
+											mi_image_t *p_image,
+											const mi_decode_buffer_t *p_buffer);
+
+/**
+ * Set transcoding parameters to default values: the progression order, the
+ * quality layers and the resolutions of the codestream are kept.
+ * @param parameters Transcoding parameters
+ */
+/*mi_API*/ void mi_CALLCONV mi_set_default_transcode_parameters(mi_transcode_parameters_t *parameters);
+
+/**
+ * Rewrite a JPEG-2000 codestream with another progression order, less quality
+ * layers or less resolution levels, without decoding it: the packet headers are
+ * read to find the packets, which are copied in the new order, and the SIZ,
+ * COD/COC, QCD/QCC and SOT markers are written again. Each tile is written in
+ * one tile-part. POC, PLT, PLM and COM markers are not kept, codestreams with
+ * PPM or PPT markers are refused.
+ *
+ * The codestream obtained by removing n resolution levels is the image decoded
+ * with a reduce factor of n: when the image has several tiles in a direction,
+ * the tile size must be a multiple of 2^n in that direction.
+ *
+ * @param p_decompressor 	J2K decompressor handle, mi_read_header being not called
+ * @param p_stream			Input stream, seekable
+ * @param p_out_stream		Output stream, seekable if a TLM marker is written
+ * @param parameters		Transcoding parameters
+ * @return 					true if success, otherwise false
+ * */
+/*mi_API*/ mi_BOOL mi_CALLCONV mi_transcode(	mi_codec_t *p_decompressor,
+											mi_stream_t *p_stream,
+											mi_stream_t *p_out_stream,
+											const mi_transcode_parameters_t *parameters);
+
 /**
  * Get the decoded tile from the codec
  *
@@ -39,6 +39,17 @@ Get next packet in component-precinct-resolution-layer order.
 */
 static mi_BOOL mi_pi_next_cprl(mi_pi_iterator_t * pi);
 
+/**
+ * Appends to a packet schedule the packets given by a packet iterator, as one more part.
+ *
+ * @param	p_schedule	the packet schedule.
+ * @param	p_pi		the packet iterator, ready to give its first packet.
+ *
+ * @return	false if the progression order is unknown or there is not enough memory.
+ */
+static mi_BOOL mi_pi_schedule_add_part(mi_pi_schedule_t *p_schedule,
+                                        mi_pi_iterator_t *p_pi);
+
 /**
  * Updates the coding parameters if the encoding is used with Progression order changes and final (or cinema parameters are used).
  *
@@ -1759,6 +1770,136 @@ void mi_pi_create_encode( 	mi_pi_iterator_t *pi,
 	}
 }
 
+static mi_BOOL mi_pi_schedule_add_part(mi_pi_schedule_t *p_schedule,
+                                        mi_pi_iterator_t *p_pi)
+{
+	mi_pi_packet_t *l_packet;
+
+	if (p_pi->poc.prg == mi_PROG_UNKNOWN) {
+		return mi_FALSE;
+	}
+
+	while (mi_pi_next(p_pi)) {
+		if (p_schedule->nb_packets == p_schedule->max_packets) {
+			mi_UINT32 l_max = p_schedule->max_packets ? 2 * p_schedule->max_packets : 256;
+			mi_pi_packet_t *l_packets;
+			if (l_max < p_schedule->max_packets) {
+				return mi_FALSE;
+			}
+			l_packets = (mi_pi_packet_t*) mi_realloc(p_schedule->packets, l_max * sizeof(mi_pi_packet_t));
+			if (! l_packets) {
+				return mi_FALSE;
+			}
+			p_schedule->packets = l_packets;
+			p_schedule->max_packets = l_max;
+		}
+		l_packet = &p_schedule->packets[p_schedule->nb_packets++];
+		l_packet->precno = p_pi->precno;
+		l_packet->compno = (mi_UINT16)p_pi->compno;
+		l_packet->layno = (mi_UINT16)p_pi->layno;
+		l_packet->resno = p_pi->resno;
+	}
+
+	/* the end of the part is the start of the next one */
+	p_schedule->part_start[++p_schedule->nb_parts] = p_schedule->nb_packets;
+
+	return mi_TRUE;
+}
+
+mi_pi_schedule_t *mi_pi_create_encode_schedule(const mi_image_t *image,
+                                                 mi_cp_t *cp,
+                                                 mi_UINT32 tileno,
+                                                 mi_UINT32 nb_comp_passes,
+                                                 mi_UINT32 pino,
+                                                 mi_UINT32 tpnum,
+                                                 mi_INT32 tppos,
+                                                 J2K_T2_MODE t2_mode)
+{
+	mi_UINT32 l_nb_pocs = cp->tcps[tileno].numpocs + 1;
+	mi_UINT32 l_pocno = (cp->rsiz == mi_PROFILE_CINEMA_4K)? 2: 1;
+	mi_UINT32 l_nb_parts = (t2_mode == THRESH_CALC) ? nb_comp_passes * l_pocno : 1;
+	mi_UINT32 compno, poc;
+	mi_pi_iterator_t *l_pi = 00;
+	mi_pi_schedule_t *l_schedule = 00;
+	mi_BOOL l_ok = mi_TRUE;
+
+	l_schedule = (mi_pi_schedule_t*) mi_calloc(1, sizeof(mi_pi_schedule_t));
+	if (! l_schedule) {
+		return 00;
+	}
+	l_schedule->part_start = (mi_UINT32*) mi_calloc(l_nb_parts + 1, sizeof(mi_UINT32));
+	l_pi = mi_pi_initialise_encode(image, cp, tileno, t2_mode);
+	if (! l_schedule->part_start || ! l_pi) {
+		mi_pi_destroy(l_pi, l_nb_pocs);
+		mi_pi_destroy_schedule(l_schedule);
+		return 00;
+	}
+
+	if (t2_mode == THRESH_CALC) {
+		/* as the passes of mi_t2_encode_packets, the include array being shared by the passes */
+		for (compno = 0; l_ok && compno < nb_comp_passes; ++compno) {
+			for (poc = 0; l_ok && poc < l_pocno; ++poc) {
+				mi_pi_create_encode(l_pi, cp, tileno, poc, compno, tppos, t2_mode);
+				l_ok = mi_pi_schedule_add_part(l_schedule, &l_pi[poc]);
+			}
+		}
+	}
+	else {
+		mi_pi_create_encode(l_pi, cp, tileno, pino, tpnum, tppos, t2_mode);
+		l_ok = mi_pi_schedule_add_part(l_schedule, &l_pi[pino]);
+	}
+
+	mi_pi_destroy(l_pi, l_nb_pocs);
+	if (! l_ok) {
+		mi_pi_destroy_schedule(l_schedule);
+		return 00;
+	}
+
+	return l_schedule;
+}
+
+mi_pi_schedule_t *mi_pi_create_decode_schedule(mi_image_t *image,
+                                                 mi_cp_t *cp,
+                                                 mi_UINT32 tileno)
+{
+	mi_UINT32 l_nb_pocs = cp->tcps[tileno].numpocs + 1;
+	mi_UINT32 pino;
+	mi_pi_iterator_t *l_pi = 00;
+	mi_pi_schedule_t *l_schedule = 00;
+
+	l_schedule = (mi_pi_schedule_t*) mi_calloc(1, sizeof(mi_pi_schedule_t));
+	if (! l_schedule) {
+		return 00;
+	}
+	l_schedule->part_start = (mi_UINT32*) mi_calloc(l_nb_pocs + 1, sizeof(mi_UINT32));
+	l_pi = mi_pi_create_decode(image, cp, tileno);
+	if (! l_schedule->part_start || ! l_pi) {
+		mi_pi_destroy(l_pi, l_nb_pocs);
+		mi_pi_destroy_schedule(l_schedule);
+		return 00;
+	}
+
+	for (pino = 0; pino < l_nb_pocs; ++pino) {
+		if (! mi_pi_schedule_add_part(l_schedule, &l_pi[pino])) {
+			mi_pi_destroy(l_pi, l_nb_pocs);
+			mi_pi_destroy_schedule(l_schedule);
+			return 00;
+		}
+	}
+
+	mi_pi_destroy(l_pi, l_nb_pocs);
+	return l_schedule;
+}
+
+void mi_pi_destroy_schedule(mi_pi_schedule_t *p_schedule)
+{
+	if (p_schedule) {
+		mi_free(p_schedule->packets);
+		mi_free(p_schedule->part_start);
+		mi_free(p_schedule);
+	}
+}
+
 void mi_pi_destroy(mi_pi_iterator_t *p_pi,
                     mi_UINT32 p_nb_elements)
 {
@@ -1822,6 +1963,25 @@ void mi_pi_update_encoding_parameters(	const mi_image_t *p_image,
 	}
 }
 
+mi_UINT32 mi_pi_get_encoding_packet_count(	const mi_image_t *p_image,
+                                            const mi_cp_t *p_cp,
+                                            mi_UINT32 p_tile_no )
+{
+	mi_UINT32 l_max_res;
+	mi_UINT32 l_max_prec;
+	mi_INT32 l_tx0,l_tx1,l_ty0,l_ty1;
+	mi_UINT32 l_dx_min,l_dy_min;
+
+	/* preconditions */
+	assert(p_cp != 00);
+	assert(p_image != 00);
+	assert(p_tile_no < p_cp->tw * p_cp->th);
+
+	mi_get_encoding_parameters(p_image,p_cp,p_tile_no,&l_tx0,&l_tx1,&l_ty0,&l_ty1,&l_dx_min,&l_dy_min,&l_max_prec,&l_max_res);
+
+	return p_cp->tcps[p_tile_no].numlayers * l_max_prec * p_image->numcomps * l_max_res;
+}
+
 mi_BOOL mi_pi_next(mi_pi_iterator_t * pi) {
 	switch (pi->poc.prg) {
 		case mi_LRCP:
@@ -72,6 +72,37 @@ typedef struct mi_pi_iterator {
   mi_UINT32 dx, dy;
 } mi_pi_iterator_t;
 
+/**
+A packet of a packet schedule
+*/
+typedef struct mi_pi_packet {
+  /** precinct that identify the packet */
+  mi_UINT32 precno;
+  /** component that identify the packet */
+  mi_UINT16 compno;
+  /** layer that identify the packet */
+  mi_UINT16 layno;
+  /** resolution that identify the packet */
+  mi_UINT32 resno;
+} mi_pi_packet_t;
+
+/**
+Packet schedule: the packets given by the packet iterators of a tile, listed once
+so that the passes over the packets of the tile do not run the iterators again
+*/
+typedef struct mi_pi_schedule {
+  /** the packets, in the order of the iterators */
+  mi_pi_packet_t *packets;
+  /** number of packets */
+  mi_UINT32 nb_packets;
+  /** number of packets the packets array can hold */
+  mi_UINT32 max_packets;
+  /** index of the first packet of each part (one part per run of an iterator), followed by nb_packets */
+  mi_UINT32 *part_start;
+  /** number of parts */
+  mi_UINT32 nb_parts;
+} mi_pi_schedule_t;
+
 /** @name Exported functions */
 /*@{*/
 /* ----------------------------------------------------------------------- */
@@ -101,6 +132,19 @@ void mi_pi_update_encoding_parameters(	const mi_image_t *p_image,
                                         mi_cp_t *p_cp,
                                         mi_UINT32 p_tile_no );
 
+/**
+ * Gets an upper bound of the number of packets of a tile being encoded.
+ *
+ * @param	p_image		the image being encoded.
+ * @param	p_cp		the coding parameters.
+ * @param	p_tile_no	index of the tile being encoded.
+ *
+ * @return	the maximum number of packets the tile may have.
+*/
+mi_UINT32 mi_pi_get_encoding_packet_count(	const mi_image_t *p_image,
+                                            const mi_cp_t *p_cp,
+                                            mi_UINT32 p_tile_no );
+
 /**
 Modify the packet iterator for enabling tile part generation
 @param pi Handle to the packet iterator generated in pi_initialise_encode
@@ -130,6 +174,54 @@ Create a packet iterator for Decoder
 mi_pi_iterator_t *mi_pi_create_decode(mi_image_t * image, 
                                         mi_cp_t * cp,
                                         mi_UINT32 tileno);
+/**
+ * Creates the schedule of the packets of a tile being encoded.
+ * For a FINAL_PASS, the schedule has one part, the packets of the tile-part tpnum of the progression pino.
+ * For THRESH_CALC, the schedule has one part per progression of each of the nb_comp_passes passes of
+ * mi_t2_encode_packets, the pass compno being the tile-part compno.
+ *
+ * @param	image		the image being encoded.
+ * @param	cp		the coding parameters.
+ * @param	tileno	index of the tile being encoded.
+ * @param	nb_comp_passes	the number of passes (THRESH_CALC).
+ * @param	pino	the progression (FINAL_PASS).
+ * @param	tpnum	the tile-part (FINAL_PASS).
+ * @param	tppos	the position of the tile part flag in the progression order.
+ * @param	t2_mode	the type of pass for generating the schedule.
+ *
+ * @return	the schedule, or 00 if a progression order is unknown or there is not enough memory.
+ * @see mi_pi_destroy_schedule
+*/
+mi_pi_schedule_t *mi_pi_create_encode_schedule(const mi_image_t *image,
+                                                 mi_cp_t *cp,
+                                                 mi_UINT32 tileno,
+                                                 mi_UINT32 nb_comp_passes,
+                                                 mi_UINT32 pino,
+                                                 mi_UINT32 tpnum,
+                                                 mi_INT32 tppos,
+                                                 J2K_T2_MODE t2_mode);
+
+/**
+ * Creates the schedule of the packets of a tile being decoded, with one part per progression.
+ *
+ * @param	image	Raw image for which the packets will be listed
+ * @param	cp		Coding parameters
+ * @param	tileno	Number that identifies the tile for which to list the packets
+ *
+ * @return	the schedule, or 00 if a progression order is unknown or there is not enough memory.
+ * @see mi_pi_destroy_schedule
+*/
+mi_pi_schedule_t *mi_pi_create_decode_schedule(mi_image_t *image,
+                                                 mi_cp_t *cp,
+                                                 mi_UINT32 tileno);
+
+/**
+ * Destroys a packet schedule.
+ *
+ * @param	p_schedule	the packet schedule to destroy.
+ */
+void mi_pi_destroy_schedule(mi_pi_schedule_t *p_schedule);
+
 /**
  * Destroys a packet iterator array.
  *
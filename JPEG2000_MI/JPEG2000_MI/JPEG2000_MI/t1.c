@@ -8,17 +8,39 @@
 /** @name Local static functions */
 /*@{*/
 
+/**
+Get the zero coding context of a sample
+@param f flags of the column, shifted by 3*ci
+@param orient band orientation
+*/
 static INLINE mi_BYTE mi_t1_getctxno_zc(mi_UINT32 f, mi_UINT32 orient);
-static mi_BYTE mi_t1_getctxno_sc(mi_UINT32 f);
+/**
+Get the index of lut_ctxno_sc and lut_spb for a sample, from the significance
+and the sign of its four direct neighbours
+@param fX flags of the column of the sample
+@param pfX flags of the column on the west
+@param nfX flags of the column on the east
+@param ci row of the sample in the stripe (0 to 3)
+*/
+static INLINE mi_UINT32 mi_t1_getctxtno_sc_or_spb_index(mi_UINT32 fX, mi_UINT32 pfX, mi_UINT32 nfX, mi_UINT32 ci);
+static INLINE mi_BYTE mi_t1_getctxno_sc(mi_UINT32 lu);
 static INLINE mi_UINT32 mi_t1_getctxno_mag(mi_UINT32 f);
-static mi_BYTE mi_t1_getspb(mi_UINT32 f);
+static INLINE mi_BYTE mi_t1_getspb(mi_UINT32 lu);
 static mi_INT16 mi_t1_getnmsedec_sig(mi_UINT32 x, mi_UINT32 bitpos);
 static mi_INT16 mi_t1_getnmsedec_ref(mi_UINT32 x, mi_UINT32 bitpos);
-static void mi_t1_updateflags(mi_flag_t *flagsp, mi_UINT32 s, mi_UINT32 stride);
+/**
+Mark a sample significant in its column and in the neighbouring columns
+(and in the stripe above or below when it is on the border of its stripe)
+@param flagsp flags of the column of the sample
+@param ci row of the sample in the stripe (0 to 3)
+@param s sign of the sample (1 if negative)
+@param stride distance between two stripes of flags
+*/
+static INLINE void mi_t1_updateflags(mi_flag_t *flagsp, mi_UINT32 ci, mi_UINT32 s, mi_UINT32 stride);
 /**
 Encode significant pass
 */
-static void mi_t1_enc_sigpass_step(mi_t1_t *t1,
+static INLINE void mi_t1_enc_sigpass_step(mi_t1_t *t1,
                                     mi_flag_t *flagsp,
                                     mi_INT32 *datap,
                                     mi_UINT32 orient,
@@ -26,41 +48,19 @@ static void mi_t1_enc_sigpass_step(mi_t1_t *t1,
                                     mi_INT32 one,
                                     mi_INT32 *nmsedec,
                                     mi_BYTE type,
+                                    mi_UINT32 ci,
                                     mi_UINT32 vsc);
 
 /**
 Decode significant pass
 */
-#if 0
-static void mi_t1_dec_sigpass_step(mi_t1_t *t1,
-                                    mi_flag_t *flagsp,
-                                    mi_INT32 *datap,
-                                    mi_UINT32 orient,
-                                    mi_INT32 oneplushalf,
-                                    mi_BYTE type,
-                                    mi_UINT32 vsc);
-#endif
-
 static INLINE void mi_t1_dec_sigpass_step_raw(
                 mi_t1_t *t1,
                 mi_flag_t *flagsp,
                 mi_INT32 *datap,
-                mi_INT32 orient,
                 mi_INT32 oneplushalf,
-                mi_INT32 vsc);
-static INLINE void mi_t1_dec_sigpass_step_mqc(
-                mi_t1_t *t1,
-                mi_flag_t *flagsp,
-                mi_INT32 *datap,
-                mi_INT32 orient,
-                mi_INT32 oneplushalf);
-static INLINE void mi_t1_dec_sigpass_step_mqc_vsc(
-                mi_t1_t *t1,
-                mi_flag_t *flagsp,
-                mi_INT32 *datap,
-                mi_INT32 orient,
-                mi_INT32 oneplushalf,
-                mi_INT32 vsc);
+                mi_UINT32 ci,
+                mi_UINT32 vsc);
 
 
 /**
@@ -79,29 +79,26 @@ Decode significant pass
 static void mi_t1_dec_sigpass_raw(
                 mi_t1_t *t1,
                 mi_INT32 bpno,
-                mi_INT32 orient,
                 mi_INT32 cblksty);
 static void mi_t1_dec_sigpass_mqc(
                 mi_t1_t *t1,
                 mi_INT32 bpno,
-                mi_INT32 orient);
-static void mi_t1_dec_sigpass_mqc_vsc(
-                mi_t1_t *t1,
-                mi_INT32 bpno,
-                mi_INT32 orient);
+                mi_INT32 orient,
+                mi_INT32 cblksty);
 
 
 
 /**
 Encode refinement pass
 */
-static void mi_t1_enc_refpass_step(mi_t1_t *t1,
+static INLINE void mi_t1_enc_refpass_step(mi_t1_t *t1,
                                     mi_flag_t *flagsp,
                                     mi_INT32 *datap,
                                     mi_INT32 bpno,
                                     mi_INT32 one,
                                     mi_INT32 *nmsedec,
                                     mi_BYTE type,
+                                    mi_UINT32 ci,
                                     mi_UINT32 vsc);
 
 
@@ -123,10 +120,8 @@ static void mi_t1_dec_refpass_raw(
                 mi_INT32 cblksty);
 static void mi_t1_dec_refpass_mqc(
                 mi_t1_t *t1,
-                mi_INT32 bpno);
-static void mi_t1_dec_refpass_mqc_vsc(
-                mi_t1_t *t1,
-                mi_INT32 bpno);
+                mi_INT32 bpno,
+                mi_INT32 cblksty);
 
 
 /**
@@ -139,27 +134,15 @@ static INLINE void  mi_t1_dec_refpass_step_raw(
                 mi_INT32 *datap,
                 mi_INT32 poshalf,
                 mi_INT32 neghalf,
-                mi_INT32 vsc);
-static INLINE void mi_t1_dec_refpass_step_mqc(
-                mi_t1_t *t1,
-                mi_flag_t *flagsp,
-                mi_INT32 *datap,
-                mi_INT32 poshalf,
-                mi_INT32 neghalf);
-static INLINE void mi_t1_dec_refpass_step_mqc_vsc(
-                mi_t1_t *t1,
-                mi_flag_t *flagsp,
-                mi_INT32 *datap,
-                mi_INT32 poshalf,
-                mi_INT32 neghalf,
-                mi_INT32 vsc);
+                mi_UINT32 ci,
+                mi_UINT32 vsc);
 
 
 
 /**
 Encode clean-up pass
 */
-static void mi_t1_enc_clnpass_step(
+static INLINE void mi_t1_enc_clnpass_step(
 		mi_t1_t *t1,
 		mi_flag_t *flagsp,
 		mi_INT32 *datap,
@@ -168,31 +151,9 @@ static void mi_t1_enc_clnpass_step(
 		mi_INT32 one,
 		mi_INT32 *nmsedec,
 		mi_UINT32 partial,
+		mi_UINT32 ci,
 		mi_UINT32 vsc);
 /**
-Decode clean-up pass
-*/
-static void mi_t1_dec_clnpass_step_partial(
-		mi_t1_t *t1,
-		mi_flag_t *flagsp,
-		mi_INT32 *datap,
-		mi_INT32 orient,
-		mi_INT32 oneplushalf);
-static void mi_t1_dec_clnpass_step(
-		mi_t1_t *t1,
-		mi_flag_t *flagsp,
-		mi_INT32 *datap,
-		mi_INT32 orient,
-		mi_INT32 oneplushalf);
-static void mi_t1_dec_clnpass_step_vsc(
-		mi_t1_t *t1,
-		mi_flag_t *flagsp,
-		mi_INT32 *datap,
-		mi_INT32 orient,
-		mi_INT32 oneplushalf,
-		mi_INT32 partial,
-		mi_INT32 vsc);
-/**
 Encode clean-up pass
 */
 static void mi_t1_enc_clnpass(
@@ -202,7 +163,9 @@ static void mi_t1_enc_clnpass(
 		mi_INT32 *nmsedec,
 		mi_UINT32 cblksty);
 /**
-Decode clean-up pass
+Decode clean-up pass.
+Like mi_t1_dec_sigpass_mqc and mi_t1_dec_refpass_mqc, it keeps the state of
+the MQ decoder in local variables for the whole pass (mi_mqc_dec_load).
 */
 static void mi_t1_dec_clnpass(
 		mi_t1_t *t1,
@@ -231,10 +194,34 @@ static void mi_t1_encode_cblk( mi_t1_t *t1,
                                 mi_FLOAT64 stepsize,
                                 mi_UINT32 cblksty,
                                 mi_UINT32 numcomps,
-                                mi_tcd_tile_t * tile,
                                 const mi_FLOAT64 * mct_norms,
                                 mi_UINT32 mct_numcomps);
 
+/**
+Job encoding one code-block: scales the coefficients of the code-block
+and runs the tier-1 coder of the worker on it.
+@param user_data a mi_t1_cblk_encode_processing_job_t, freed by the job
+@param tls thread local storage of the worker (holds its T1 handle)
+*/
+static void mi_t1_cblk_encode_processor(void* user_data, mi_tls_t* tls);
+
+/**
+Return the T1 handle kept in the thread local storage of a worker,
+creating it on first use.
+@param tls thread local storage of the worker
+@param isEncoder mi_TRUE for an encoder handle
+@return the T1 handle, or 00 in case of error
+*/
+static mi_t1_t* mi_t1_get_tls_t1(mi_tls_t* tls, mi_BOOL isEncoder);
+
+/**
+Job decoding one code-block and copying it, dequantized, into the tile
+component buffer (each code-block writes a disjoint area of it).
+@param user_data a mi_t1_cblk_decode_processing_job_t, freed by the job
+@param tls thread local storage of the worker (holds its T1 handle)
+*/
+static void mi_t1_cblk_decode_processor(void* user_data, mi_tls_t* tls);
+
 /**
 Decode 1 code-block
 @param t1 T1 handle
@@ -260,28 +247,49 @@ static mi_BOOL mi_t1_allocate_buffers(   mi_t1_t *t1,
 /* ----------------------------------------------------------------------- */
 
 static mi_BYTE mi_t1_getctxno_zc(mi_UINT32 f, mi_UINT32 orient) {
-	return lut_ctxno_zc[(orient << 8) | (f & T1_SIG_OTH)];
+	return lut_ctxno_zc[(orient << 9) | (f & T1_SIGMA_NEIGHBOURS)];
 }
 
-static mi_BYTE mi_t1_getctxno_sc(mi_UINT32 f) {
-	return lut_ctxno_sc[(f & (T1_SIG_PRIM | T1_SGN)) >> 4];
+static mi_UINT32 mi_t1_getctxtno_sc_or_spb_index(mi_UINT32 fX, mi_UINT32 pfX, mi_UINT32 nfX, mi_UINT32 ci) {
+	/*
+	bit of the index : flag
+	  0 : sign of W      1 : significance of N
+	  2 : sign of E      3 : significance of W
+	  4 : sign of N      5 : significance of E
+	  6 : sign of S      7 : significance of S
+	*/
+	mi_UINT32 lu = (fX >> (3U * ci)) & (T1_SIGMA_N | T1_SIGMA_W | T1_SIGMA_E | T1_SIGMA_S);
+
+	lu |= (pfX >> (T1_CHI_THIS_I + 3U * ci)) & (1U << 0);
+	lu |= (nfX >> (T1_CHI_THIS_I - 2U + 3U * ci)) & (1U << 2);
+	if (ci == 0U) {
+		lu |= (fX >> (T1_CHI_0_I - 4U)) & (1U << 4);
+	} else {
+		lu |= (fX >> (T1_CHI_1_I - 4U + 3U * (ci - 1U))) & (1U << 4);
+	}
+	lu |= (fX >> (T1_CHI_2_I - 6U + 3U * ci)) & (1U << 6);
+	return lu;
+}
+
+static mi_BYTE mi_t1_getctxno_sc(mi_UINT32 lu) {
+	return lut_ctxno_sc[lu];
 }
 
 static mi_UINT32 mi_t1_getctxno_mag(mi_UINT32 f) {
-	mi_UINT32 tmp1 = (f & T1_SIG_OTH) ? T1_CTXNO_MAG + 1 : T1_CTXNO_MAG;
-	mi_UINT32 tmp2 = (f & T1_REFINE) ? T1_CTXNO_MAG + 2 : tmp1;
+	mi_UINT32 tmp1 = (f & T1_SIGMA_NEIGHBOURS) ? T1_CTXNO_MAG + 1 : T1_CTXNO_MAG;
+	mi_UINT32 tmp2 = (f & T1_MU_THIS) ? T1_CTXNO_MAG + 2 : tmp1;
 	return (tmp2);
 }
 
-static mi_BYTE mi_t1_getspb(mi_UINT32 f) {
-	return lut_spb[(f & (T1_SIG_PRIM | T1_SGN)) >> 4];
+static mi_BYTE mi_t1_getspb(mi_UINT32 lu) {
+	return lut_spb[lu];
 }
 
 static mi_INT16 mi_t1_getnmsedec_sig(mi_UINT32 x, mi_UINT32 bitpos) {
 	if (bitpos > 0) {
 		return lut_nmsedec_sig[(x >> (bitpos)) & ((1 << T1_NMSEDEC_BITS) - 1)];
 	}
-	
+
 	return lut_nmsedec_sig0[x & ((1 << T1_NMSEDEC_BITS) - 1)];
 }
 
@@ -293,28 +301,27 @@ static mi_INT16 mi_t1_getnmsedec_ref(mi_UINT32 x, mi_UINT32 bitpos) {
     return lut_nmsedec_ref0[x & ((1 << T1_NMSEDEC_BITS) - 1)];
 }
 
-static void mi_t1_updateflags(mi_flag_t *flagsp, mi_UINT32 s, mi_UINT32 stride) {
-	mi_flag_t *np = flagsp - stride;
-	mi_flag_t *sp = flagsp + stride;
-
-	static const mi_flag_t mod[] = {
-		T1_SIG_S, T1_SIG_S|T1_SGN_S,
-		T1_SIG_E, T1_SIG_E|T1_SGN_E,
-		T1_SIG_W, T1_SIG_W|T1_SGN_W,
-		T1_SIG_N, T1_SIG_N|T1_SGN_N
-	};
-
-	np[-1] |= T1_SIG_SE;
-	np[0]  |= mod[s];
-	np[1]  |= T1_SIG_SW;
-
-	flagsp[-1] |= mod[s+2];
-	flagsp[0]  |= T1_SIG;
-	flagsp[1]  |= mod[s+4];
-
-	sp[-1] |= T1_SIG_NE;
-	sp[0]  |= mod[s+6];
-	sp[1]  |= T1_SIG_NW;
+static void mi_t1_updateflags(mi_flag_t *flagsp, mi_UINT32 ci, mi_UINT32 s, mi_UINT32 stride) {
+	/* the sample is the east neighbour of the west column and the west */
+	/* neighbour of the east column; in its own column the same bit is  */
+	/* the south neighbour of row ci-1 and the north one of row ci+1    */
+	flagsp[-1] |= T1_SIGMA_5 << (3U * ci);
+	flagsp[0]  |= (T1_SIGMA_4 | (s << T1_CHI_1_I)) << (3U * ci);
+	flagsp[1]  |= T1_SIGMA_3 << (3U * ci);
+
+	/* the rows 0 and 3 are also the rows below and above the window */
+	/* of the stripe above and of the stripe below                   */
+	if (ci == 0U) {
+		mi_flag_t *np = flagsp - stride;
+		np[-1] |= T1_SIGMA_17;
+		np[0]  |= T1_SIGMA_16 | (s << T1_CHI_5_I);
+		np[1]  |= T1_SIGMA_15;
+	} else if (ci == 3U) {
+		mi_flag_t *sp = flagsp + stride;
+		sp[-1] |= T1_SIGMA_2;
+		sp[0]  |= T1_SIGMA_1 | (s << T1_CHI_0_I);
+		sp[1]  |= T1_SIGMA_0;
+	}
 }
 //ҪԴ̣Significance Propagation
 static void mi_t1_enc_sigpass_step(   mi_t1_t *t1,
@@ -325,37 +332,40 @@ static void mi_t1_enc_sigpass_step(   mi_t1_t *t1,
                                 mi_INT32 one,
                                 mi_INT32 *nmsedec,
                                 mi_BYTE type,
+                                mi_UINT32 ci,
                                 mi_UINT32 vsc
                                 )
 {
 	mi_INT32 v;
-    mi_UINT32 flag;
-	
+	mi_UINT32 flags, f, lu;
+
 	mi_mqc_t *mqc = t1->mqc;	/* MQC component */
-	
-	flag = vsc ? (mi_UINT32)((*flagsp) & (~(T1_SIG_S | T1_SIG_SE | T1_SIG_SW | T1_SGN_S))) : (mi_UINT32)(*flagsp);
+
+	flags = vsc ? ((*flagsp) & ~T1_VSC_MASK) : (*flagsp);
+	f = flags >> (3U * ci);
 	//濪ʼҪԴ̵ҪԱ׶
-	if ((flag & T1_SIG_OTH) && !(flag & (T1_SIG | T1_VISIT))) {
+	if ((f & T1_SIGMA_NEIGHBOURS) && !(f & (T1_SIGMA_THIS | T1_PI_THIS))) {
 		v = (mi_int_abs(*datap) & one) ? 1 : 0;//ǰݵľֵڵǰλƽֵǷΪ1
-		mi_mqc_setcurctx(mqc, mi_t1_getctxno_zc(flag, orient));	/* ESSAI *///浱ǰctxsҵӦMQ״̬Ȼٽ״̬浽curctx
+		mi_mqc_setcurctx(mqc, mi_t1_getctxno_zc(f, orient));	/* ESSAI */
 		if (type == T1_TYPE_RAW) {	/* BYPASS/LAZY MODE */
 			mi_mqc_bypass_enc(mqc, (mi_UINT32)v);
 		} else {
 			mi_mqc_encode(mqc, (mi_UINT32)v);
 		}
 		//濪ʼҪԴ̵ķű׶
-		if (v) {//֮ǰݵλݵĵһbitִнķű׶
-			v = *datap < 0 ? 1 : 0;//ݱǷǸ򽫴ڵǰλƽλָΪ0
+		if (v) {
+			lu = mi_t1_getctxtno_sc_or_spb_index(flags, flagsp[-1], flagsp[1], ci);
+			v = *datap < 0 ? 1 : 0;
 			*nmsedec +=	mi_t1_getnmsedec_sig((mi_UINT32)mi_int_abs(*datap), (mi_UINT32)(bpno));
-			mi_mqc_setcurctx(mqc, mi_t1_getctxno_sc(flag));	/* ESSAI */
-			if (type == T1_TYPE_RAW) {	/* BYPASS/LAZY MODE *///lasyģʽõݲ
+			mi_mqc_setcurctx(mqc, mi_t1_getctxno_sc(lu));	/* ESSAI */
+			if (type == T1_TYPE_RAW) {	/* BYPASS/LAZY MODE */
 				mi_mqc_bypass_enc(mqc, (mi_UINT32)v);
 			} else {
-				mi_mqc_encode(mqc, (mi_UINT32)(v ^ mi_t1_getspb((mi_UINT32)flag)));//α166ҳ
+				mi_mqc_encode(mqc, (mi_UINT32)(v ^ mi_t1_getspb(lu)));//α166ҳ
 			}
-			mi_t1_updateflags(flagsp, (mi_UINT32)v, t1->flags_stride);
+			mi_t1_updateflags(flagsp, ci, (mi_UINT32)v, t1->flags_stride);
 		}
-		*flagsp |= T1_VISIT;
+		*flagsp |= T1_PI_THIS << (3U * ci);
 	}
 }
 
@@ -364,73 +374,24 @@ static INLINE void mi_t1_dec_sigpass_step_raw(
                 mi_t1_t *t1,
                 mi_flag_t *flagsp,
                 mi_INT32 *datap,
-                mi_INT32 orient,
                 mi_INT32 oneplushalf,
-                mi_INT32 vsc)
+                mi_UINT32 ci,
+                mi_UINT32 vsc)
 {
-        mi_INT32 v, flag;
+        mi_INT32 v;
+        mi_UINT32 f;
         mi_raw_t *raw = t1->raw;       /* RAW component */
-        mi_ARG_NOT_USED(orient);
-       
-        flag = vsc ? ((*flagsp) & (~(T1_SIG_S | T1_SIG_SE | T1_SIG_SW | T1_SGN_S))) : (*flagsp);
-        if ((flag & T1_SIG_OTH) && !(flag & (T1_SIG | T1_VISIT))) {
-                        if (mi_raw_decode(raw)) {
-                                v = (mi_INT32)mi_raw_decode(raw);    /* ESSAI */
-                                *datap = v ? -oneplushalf : oneplushalf;
-                                mi_t1_updateflags(flagsp, (mi_UINT32)v, t1->flags_stride);
-                        }
-                *flagsp |= T1_VISIT;
-        }
-}      
-
-static INLINE void mi_t1_dec_sigpass_step_mqc(
-                mi_t1_t *t1,
-                mi_flag_t *flagsp,
-                mi_INT32 *datap,
-                mi_INT32 orient,
-                mi_INT32 oneplushalf)
-{
-        mi_INT32 v, flag;
-       
-        mi_mqc_t *mqc = t1->mqc;       /* MQC component */
-       
-        flag = *flagsp;
-        if ((flag & T1_SIG_OTH) && !(flag & (T1_SIG | T1_VISIT))) {
-                        mi_mqc_setcurctx(mqc, mi_t1_getctxno_zc((mi_UINT32)flag, (mi_UINT32)orient));
-                        if (mi_mqc_decode(mqc)) {
-                                mi_mqc_setcurctx(mqc, mi_t1_getctxno_sc((mi_UINT32)flag));
-                                v = mi_mqc_decode(mqc) ^ mi_t1_getspb((mi_UINT32)flag);
-                                *datap = v ? -oneplushalf : oneplushalf;
-                                mi_t1_updateflags(flagsp, (mi_UINT32)v, t1->flags_stride);
-                        }
-                *flagsp |= T1_VISIT;
-        }
-}                               /* VSC and  BYPASS by Antonin */
 
-static INLINE void mi_t1_dec_sigpass_step_mqc_vsc(
-                mi_t1_t *t1,
-                mi_flag_t *flagsp,
-                mi_INT32 *datap,
-                mi_INT32 orient,
-                mi_INT32 oneplushalf,
-                mi_INT32 vsc)
-{
-        mi_INT32 v, flag;
-       
-        mi_mqc_t *mqc = t1->mqc;       /* MQC component */
-       
-        flag = vsc ? ((*flagsp) & (~(T1_SIG_S | T1_SIG_SE | T1_SIG_SW | T1_SGN_S))) : (*flagsp);
-        if ((flag & T1_SIG_OTH) && !(flag & (T1_SIG | T1_VISIT))) {
-                mi_mqc_setcurctx(mqc, mi_t1_getctxno_zc((mi_UINT32)flag, (mi_UINT32)orient));
-                if (mi_mqc_decode(mqc)) {
-                        mi_mqc_setcurctx(mqc, mi_t1_getctxno_sc((mi_UINT32)flag));
-                        v = mi_mqc_decode(mqc) ^ mi_t1_getspb((mi_UINT32)flag);
+        f = (vsc ? ((*flagsp) & ~T1_VSC_MASK) : (*flagsp)) >> (3U * ci);
+        if ((f & T1_SIGMA_NEIGHBOURS) && !(f & (T1_SIGMA_THIS | T1_PI_THIS))) {
+                if (mi_raw_decode(raw)) {
+                        v = (mi_INT32)mi_raw_decode(raw);    /* ESSAI */
                         *datap = v ? -oneplushalf : oneplushalf;
-                        mi_t1_updateflags(flagsp, (mi_UINT32)v, t1->flags_stride);
+                        mi_t1_updateflags(flagsp, ci, (mi_UINT32)v, t1->flags_stride);
                 }
-                *flagsp |= T1_VISIT;
+                *flagsp |= T1_PI_THIS << (3U * ci);
         }
-}                               /* VSC and  BYPASS by Antonin */
+}
 
 
 
@@ -442,25 +403,32 @@ static void mi_t1_enc_sigpass(mi_t1_t *t1,
                         mi_UINT32 cblksty//ԿOPENJPEGٷ˵ǡ-MĬ0mode
                         )
 {
-	mi_UINT32 i, j, k, vsc; 
-    mi_INT32 one;
+	mi_UINT32 i, k, ci, vsc;
+	mi_INT32 one;
+	mi_flag_t *flagsp;
 
 	*nmsedec = 0;
 	one = 1 << (bpno + T1_NMSEDEC_FRACBITS);//ʾλ-1+6
+	vsc = (cblksty & J2K_CCP_CBLKSTY_VSC) ? 1U : 0U;
 	for (k = 0; k < t1->h; k += 4) {//ɨ
-		for (i = 0; i < t1->w; ++i) {
-			for (j = k; j < k + 4 && j < t1->h; ++j) {
-				vsc = ((cblksty & J2K_CCP_CBLKSTY_VSC) && (j == k + 3 || j == t1->h - 1)) ? 1 : 0;//VSCģʽйأȷΪرգ0
+		flagsp = &MACRO_t1_flags(1 + (k >> 2), 1);
+		for (i = 0; i < t1->w; ++i, ++flagsp) {
+			/* no significant sample around the column: nothing to code */
+			if (*flagsp == 0U) {
+				continue;
+			}
+			for (ci = 0; ci < 4 && k + ci < t1->h; ++ci) {
 				mi_t1_enc_sigpass_step(
 						t1,
-						&t1->flags[((j+1) * t1->flags_stride) + i + 1],
-						&t1->data[(j * t1->data_stride) + i],
+						flagsp,
+						&t1->data[((k + ci) * t1->data_stride) + i],
 						orient,
 						bpno,
 						one,
 						nmsedec,
 						type,
-						vsc);
+						ci,
+						vsc && ci == 3);
 			}
 		}
 	}
@@ -469,97 +437,110 @@ static void mi_t1_enc_sigpass(mi_t1_t *t1,
 static void mi_t1_dec_sigpass_raw(
                 mi_t1_t *t1,
                 mi_INT32 bpno,
-                mi_INT32 orient,
                 mi_INT32 cblksty)
 {
-        mi_INT32 one, half, oneplushalf, vsc;
-        mi_UINT32 i, j, k; 
+        mi_INT32 one, half, oneplushalf;
+        mi_UINT32 i, k, ci, vsc;
+        mi_flag_t *flagsp;
         one = 1 << bpno;
         half = one >> 1;
         oneplushalf = one | half;
+        vsc = (cblksty & J2K_CCP_CBLKSTY_VSC) ? 1U : 0U;
         for (k = 0; k < t1->h; k += 4) {
-                for (i = 0; i < t1->w; ++i) {
-                        for (j = k; j < k + 4 && j < t1->h; ++j) {
-                                vsc = ((cblksty & J2K_CCP_CBLKSTY_VSC) && (j == k + 3 || j == t1->h - 1)) ? 1 : 0;
+                flagsp = &MACRO_t1_flags(1 + (k >> 2), 1);
+                for (i = 0; i < t1->w; ++i, ++flagsp) {
+                        if (*flagsp == 0U) {
+                                continue;
+                        }
+                        for (ci = 0; ci < 4 && k + ci < t1->h; ++ci) {
                                 mi_t1_dec_sigpass_step_raw(
                                                 t1,
-                                                &t1->flags[((j+1) * t1->flags_stride) + i + 1],
-                                                &t1->data[(j * t1->w) + i],
-                                                orient,
+                                                flagsp,
+                                                &t1->data[((k + ci) * t1->w) + i],
                                                 oneplushalf,
-                                                vsc);
+                                                ci,
+                                                vsc && ci == 3);
                         }
                 }
         }
 }                               /* VSC and  BYPASS by Antonin */
 
+/**
+Decode a sample of the significance pass with the local state of the MQ
+decoder (see mi_mqc_dec_load). ci and vsc should be constants, so that the
+shifts of the flags are folded when the steps of a column are unrolled.
+*/
+#define mi_t1_dec_sigpass_step_mqc_macro(flagsp, datap, flags_stride, orient, oneplushalf, ci, vsc, mqc, curctx, a, c, ct) \
+        { \
+                mi_UINT32 l_flags = (vsc) ? ((*(flagsp)) & ~T1_VSC_MASK) : (*(flagsp)); \
+                mi_UINT32 l_f = l_flags >> (3U * (ci)); \
+                if ((l_f & T1_SIGMA_NEIGHBOURS) && !(l_f & (T1_SIGMA_THIS | T1_PI_THIS))) { \
+                        mi_INT32 l_v; \
+                        mi_mqc_dec_setcurctx(mqc, curctx, mi_t1_getctxno_zc(l_f, (mi_UINT32)(orient))); \
+                        mi_mqc_decode_macro(l_v, mqc, curctx, a, c, ct); \
+                        if (l_v) { \
+                                mi_UINT32 l_lu = mi_t1_getctxtno_sc_or_spb_index(l_flags, (flagsp)[-1], (flagsp)[1], ci); \
+                                mi_mqc_dec_setcurctx(mqc, curctx, mi_t1_getctxno_sc(l_lu)); \
+                                mi_mqc_decode_macro(l_v, mqc, curctx, a, c, ct); \
+                                l_v ^= mi_t1_getspb(l_lu); \
+                                *(datap) = l_v ? -(oneplushalf) : (oneplushalf); \
+                                mi_t1_updateflags(flagsp, ci, (mi_UINT32)l_v, flags_stride); \
+                        } \
+                        *(flagsp) |= T1_PI_THIS << (3U * (ci)); \
+                } \
+        }
+
 static void mi_t1_dec_sigpass_mqc(
                 mi_t1_t *t1,
                 mi_INT32 bpno,
-                mi_INT32 orient)
+                mi_INT32 orient,
+                mi_INT32 cblksty)
 {
         mi_INT32 one, half, oneplushalf;
-        mi_UINT32 i, j, k;
+        mi_UINT32 i, k, ci, vsc;
         mi_INT32 *data1 = t1->data;
-        mi_flag_t *flags1 = &t1->flags[1];
+        mi_flag_t *flags1 = &MACRO_t1_flags(1, 1);
+        const mi_UINT32 w = t1->w;
+        const mi_UINT32 flags_stride = t1->flags_stride;
+        mi_mqc_t *mqc = t1->mqc;       /* MQC component */
+        mi_mqc_dec_load(mqc, curctx, a, c, ct);
+
         one = 1 << bpno;
         half = one >> 1;
         oneplushalf = one | half;
+        vsc = (cblksty & J2K_CCP_CBLKSTY_VSC) ? 1U : 0U;
         for (k = 0; k < (t1->h & ~3u); k += 4) {
-                for (i = 0; i < t1->w; ++i) {
+                for (i = 0; i < w; ++i) {
                         mi_INT32 *data2 = data1 + i;
                         mi_flag_t *flags2 = flags1 + i;
-                        flags2 += t1->flags_stride;
-                        mi_t1_dec_sigpass_step_mqc(t1, flags2, data2, orient, oneplushalf);
-                        data2 += t1->w;
-                        flags2 += t1->flags_stride;
-                        mi_t1_dec_sigpass_step_mqc(t1, flags2, data2, orient, oneplushalf);
-                        data2 += t1->w;
-                        flags2 += t1->flags_stride;
-                        mi_t1_dec_sigpass_step_mqc(t1, flags2, data2, orient, oneplushalf);
-                        data2 += t1->w;
-                        flags2 += t1->flags_stride;
-                        mi_t1_dec_sigpass_step_mqc(t1, flags2, data2, orient, oneplushalf);
-                        data2 += t1->w;
-                }
-                data1 += t1->w << 2;
-                flags1 += t1->flags_stride << 2;
-        }
-        for (i = 0; i < t1->w; ++i) {
-                mi_INT32 *data2 = data1 + i;
-                mi_flag_t *flags2 = flags1 + i;
-                for (j = k; j < t1->h; ++j) {
-                        flags2 += t1->flags_stride;
-                        mi_t1_dec_sigpass_step_mqc(t1, flags2, data2, orient, oneplushalf);
-                        data2 += t1->w;
+                        if (*flags2 == 0U) {
+                                continue;
+                        }
+                        mi_t1_dec_sigpass_step_mqc_macro(flags2, data2, flags_stride, orient, oneplushalf, 0U, 0U, mqc, curctx, a, c, ct);
+                        data2 += w;
+                        mi_t1_dec_sigpass_step_mqc_macro(flags2, data2, flags_stride, orient, oneplushalf, 1U, 0U, mqc, curctx, a, c, ct);
+                        data2 += w;
+                        mi_t1_dec_sigpass_step_mqc_macro(flags2, data2, flags_stride, orient, oneplushalf, 2U, 0U, mqc, curctx, a, c, ct);
+                        data2 += w;
+                        mi_t1_dec_sigpass_step_mqc_macro(flags2, data2, flags_stride, orient, oneplushalf, 3U, vsc, mqc, curctx, a, c, ct);
                 }
+                data1 += w << 2;
+                flags1 += flags_stride;
         }
-}                               /* VSC and  BYPASS by Antonin */
-
-static void mi_t1_dec_sigpass_mqc_vsc(
-                mi_t1_t *t1,
-                mi_INT32 bpno,
-                mi_INT32 orient)
-{
-        mi_INT32 one, half, oneplushalf, vsc;
-        mi_UINT32 i, j, k;
-        one = 1 << bpno;
-        half = one >> 1;
-        oneplushalf = one | half;
-        for (k = 0; k < t1->h; k += 4) {
-                for (i = 0; i < t1->w; ++i) {
-                        for (j = k; j < k + 4 && j < t1->h; ++j) {
-                                vsc = (j == k + 3 || j == t1->h - 1) ? 1 : 0;
-                                mi_t1_dec_sigpass_step_mqc_vsc(
-                                                t1,
-                                                &t1->flags[((j+1) * t1->flags_stride) + i + 1],
-                                                &t1->data[(j * t1->w) + i],
-                                                orient,
-                                                oneplushalf,
-                                                vsc);
+        if (k < t1->h) {
+                for (i = 0; i < w; ++i) {
+                        mi_INT32 *data2 = data1 + i;
+                        mi_flag_t *flags2 = flags1 + i;
+                        if (*flags2 == 0U) {
+                                continue;
+                        }
+                        for (ci = 0; k + ci < t1->h; ++ci) {
+                                mi_t1_dec_sigpass_step_mqc_macro(flags2, data2, flags_stride, orient, oneplushalf, ci, 0U, mqc, curctx, a, c, ct);
+                                data2 += w;
                         }
                 }
         }
+        mi_mqc_dec_store(mqc, curctx, a, c, ct);
 }                               /* VSC and  BYPASS by Antonin */
 
 
@@ -571,24 +552,25 @@ static void mi_t1_enc_refpass_step(   mi_t1_t *t1,
                                 mi_INT32 one,
                                 mi_INT32 *nmsedec,
                                 mi_BYTE type,
+                                mi_UINT32 ci,
                                 mi_UINT32 vsc)
 {
 	mi_INT32 v;
-	mi_UINT32 flag;
-	
+	mi_UINT32 f;
+
 	mi_mqc_t *mqc = t1->mqc;	/* MQC component */
-	
-	flag = vsc ? (mi_UINT32)((*flagsp) & (~(T1_SIG_S | T1_SIG_SE | T1_SIG_SW | T1_SGN_S))) : (mi_UINT32)(*flagsp);
-	if ((flag & (T1_SIG | T1_VISIT)) == T1_SIG) {
+
+	f = (vsc ? ((*flagsp) & ~T1_VSC_MASK) : (*flagsp)) >> (3U * ci);
+	if ((f & (T1_SIGMA_THIS | T1_PI_THIS)) == T1_SIGMA_THIS) {
 		*nmsedec += mi_t1_getnmsedec_ref((mi_UINT32)mi_int_abs(*datap), (mi_UINT32)(bpno));
 		v = (mi_int_abs(*datap) & one) ? 1 : 0;
-		mi_mqc_setcurctx(mqc, mi_t1_getctxno_mag(flag));	/* ESSAI */
+		mi_mqc_setcurctx(mqc, mi_t1_getctxno_mag(f));	/* ESSAI */
 		if (type == T1_TYPE_RAW) {	/* BYPASS/LAZY MODE */
 			mi_mqc_bypass_enc(mqc, (mi_UINT32)v);
 		} else {
 			mi_mqc_encode(mqc, (mi_UINT32)v);
 		}
-		*flagsp |= T1_REFINE;
+		*flagsp |= T1_MU_THIS << (3U * ci);
 	}
 }
 
@@ -598,61 +580,20 @@ static INLINE void mi_t1_dec_refpass_step_raw(
                 mi_INT32 *datap,
                 mi_INT32 poshalf,
                 mi_INT32 neghalf,
-                mi_INT32 vsc)
+                mi_UINT32 ci,
+                mi_UINT32 vsc)
 {
-        mi_INT32 v, t, flag;
-       
-        mi_raw_t *raw = t1->raw;       /* RAW component */
-       
-        flag = vsc ? ((*flagsp) & (~(T1_SIG_S | T1_SIG_SE | T1_SIG_SW | T1_SGN_S))) : (*flagsp);
-        if ((flag & (T1_SIG | T1_VISIT)) == T1_SIG) {
-                        v = (mi_INT32)mi_raw_decode(raw);
-                t = v ? poshalf : neghalf;
-                *datap += *datap < 0 ? -t : t;
-                *flagsp |= T1_REFINE;
-        }
-}                               /* VSC and  BYPASS by Antonin  */
+        mi_INT32 v, t;
+        mi_UINT32 f;
 
-static INLINE void mi_t1_dec_refpass_step_mqc(
-                mi_t1_t *t1,
-                mi_flag_t *flagsp,
-                mi_INT32 *datap,
-                mi_INT32 poshalf,
-                mi_INT32 neghalf)
-{
-        mi_INT32 v, t, flag;
-       
-        mi_mqc_t *mqc = t1->mqc;       /* MQC component */
-       
-        flag = *flagsp;
-        if ((flag & (T1_SIG | T1_VISIT)) == T1_SIG) {
-                mi_mqc_setcurctx(mqc, mi_t1_getctxno_mag((mi_UINT32)flag));      /* ESSAI */
-                        v = mi_mqc_decode(mqc);
-                t = v ? poshalf : neghalf;
-                *datap += *datap < 0 ? -t : t;
-                *flagsp |= T1_REFINE;
-                }
-}                               /* VSC and  BYPASS by Antonin  */
+        mi_raw_t *raw = t1->raw;       /* RAW component */
 
-static INLINE void mi_t1_dec_refpass_step_mqc_vsc(
-                mi_t1_t *t1,
-                mi_flag_t *flagsp,
-                mi_INT32 *datap,
-                mi_INT32 poshalf,
-                mi_INT32 neghalf,
-                mi_INT32 vsc)
-{
-        mi_INT32 v, t, flag;
-       
-        mi_mqc_t *mqc = t1->mqc;       /* MQC component */
-       
-        flag = vsc ? ((*flagsp) & (~(T1_SIG_S | T1_SIG_SE | T1_SIG_SW | T1_SGN_S))) : (*flagsp);
-        if ((flag & (T1_SIG | T1_VISIT)) == T1_SIG) {
-                mi_mqc_setcurctx(mqc, mi_t1_getctxno_mag((mi_UINT32)flag));      /* ESSAI */
-                v = mi_mqc_decode(mqc);
+        f = (vsc ? ((*flagsp) & ~T1_VSC_MASK) : (*flagsp)) >> (3U * ci);
+        if ((f & (T1_SIGMA_THIS | T1_PI_THIS)) == T1_SIGMA_THIS) {
+                v = (mi_INT32)mi_raw_decode(raw);
                 t = v ? poshalf : neghalf;
                 *datap += *datap < 0 ? -t : t;
-                *flagsp |= T1_REFINE;
+                *flagsp |= T1_MU_THIS << (3U * ci);
         }
 }                               /* VSC and  BYPASS by Antonin  */
 
@@ -664,24 +605,31 @@ static void mi_t1_enc_refpass(
 		mi_BYTE type,
 		mi_UINT32 cblksty)
 {
-	mi_UINT32 i, j, k, vsc;
-    mi_INT32 one;
+	mi_UINT32 i, k, ci, vsc;
+	mi_INT32 one;
+	mi_flag_t *flagsp;
 
 	*nmsedec = 0;
 	one = 1 << (bpno + T1_NMSEDEC_FRACBITS);
+	vsc = (cblksty & J2K_CCP_CBLKSTY_VSC) ? 1U : 0U;
 	for (k = 0; k < t1->h; k += 4) {
-		for (i = 0; i < t1->w; ++i) {
-			for (j = k; j < k + 4 && j < t1->h; ++j) {
-				vsc = ((cblksty & J2K_CCP_CBLKSTY_VSC) && (j == k + 3 || j == t1->h - 1)) ? 1 : 0;
+		flagsp = &MACRO_t1_flags(1 + (k >> 2), 1);
+		for (i = 0; i < t1->w; ++i, ++flagsp) {
+			/* no significant sample in the column: nothing to refine */
+			if (!(*flagsp & T1_SIGMA_COL)) {
+				continue;
+			}
+			for (ci = 0; ci < 4 && k + ci < t1->h; ++ci) {
 				mi_t1_enc_refpass_step(
 						t1,
-						&t1->flags[((j+1) * t1->flags_stride) + i + 1],
-						&t1->data[(j * t1->data_stride) + i],
+						flagsp,
+						&t1->data[((k + ci) * t1->data_stride) + i],
 						bpno,
 						one,
 						nmsedec,
 						type,
-						vsc);
+						ci,
+						vsc && ci == 3);
 			}
 		}
 	}
@@ -693,93 +641,98 @@ static void mi_t1_dec_refpass_raw(
                 mi_INT32 cblksty)
 {
         mi_INT32 one, poshalf, neghalf;
-        mi_UINT32 i, j, k;
-        mi_INT32 vsc;
+        mi_UINT32 i, k, ci, vsc;
+        mi_flag_t *flagsp;
         one = 1 << bpno;
         poshalf = one >> 1;
         neghalf = bpno > 0 ? -poshalf : -1;
+        vsc = (cblksty & J2K_CCP_CBLKSTY_VSC) ? 1U : 0U;
         for (k = 0; k < t1->h; k += 4) {
-                for (i = 0; i < t1->w; ++i) {
-                        for (j = k; j < k + 4 && j < t1->h; ++j) {
-                                vsc = ((cblksty & J2K_CCP_CBLKSTY_VSC) && (j == k + 3 || j == t1->h - 1)) ? 1 : 0;
+                flagsp = &MACRO_t1_flags(1 + (k >> 2), 1);
+                for (i = 0; i < t1->w; ++i, ++flagsp) {
+                        if (!(*flagsp & T1_SIGMA_COL)) {
+                                continue;
+                        }
+                        for (ci = 0; ci < 4 && k + ci < t1->h; ++ci) {
                                 mi_t1_dec_refpass_step_raw(
                                                 t1,
-                                                &t1->flags[((j+1) * t1->flags_stride) + i + 1],
-                                                &t1->data[(j * t1->w) + i],
+                                                flagsp,
+                                                &t1->data[((k + ci) * t1->w) + i],
                                                 poshalf,
                                                 neghalf,
-                                                vsc);
+                                                ci,
+                                                vsc && ci == 3);
                         }
                 }
         }
 }                               /* VSC and  BYPASS by Antonin */
 
+/**
+Decode a sample of the refinement pass with the local state of the MQ
+decoder (see mi_t1_dec_sigpass_step_mqc_macro)
+*/
+#define mi_t1_dec_refpass_step_mqc_macro(flagsp, datap, poshalf, neghalf, ci, vsc, mqc, curctx, a, c, ct) \
+        { \
+                mi_UINT32 l_f = ((vsc) ? ((*(flagsp)) & ~T1_VSC_MASK) : (*(flagsp))) >> (3U * (ci)); \
+                if ((l_f & (T1_SIGMA_THIS | T1_PI_THIS)) == T1_SIGMA_THIS) { \
+                        mi_INT32 l_v, l_t; \
+                        mi_mqc_dec_setcurctx(mqc, curctx, mi_t1_getctxno_mag(l_f));      /* ESSAI */ \
+                        mi_mqc_decode_macro(l_v, mqc, curctx, a, c, ct); \
+                        l_t = l_v ? (poshalf) : (neghalf); \
+                        *(datap) += *(datap) < 0 ? -l_t : l_t; \
+                        *(flagsp) |= T1_MU_THIS << (3U * (ci)); \
+                } \
+        }
+
 static void mi_t1_dec_refpass_mqc(
                 mi_t1_t *t1,
-                mi_INT32 bpno)
+                mi_INT32 bpno,
+                mi_INT32 cblksty)
 {
         mi_INT32 one, poshalf, neghalf;
-        mi_UINT32 i, j, k;
+        mi_UINT32 i, k, ci, vsc;
         mi_INT32 *data1 = t1->data;
-        mi_flag_t *flags1 = &t1->flags[1];
+        mi_flag_t *flags1 = &MACRO_t1_flags(1, 1);
+        const mi_UINT32 w = t1->w;
+        mi_mqc_t *mqc = t1->mqc;       /* MQC component */
+        mi_mqc_dec_load(mqc, curctx, a, c, ct);
+
         one = 1 << bpno;
         poshalf = one >> 1;
         neghalf = bpno > 0 ? -poshalf : -1;
+        vsc = (cblksty & J2K_CCP_CBLKSTY_VSC) ? 1U : 0U;
         for (k = 0; k < (t1->h & ~3u); k += 4) {
-                for (i = 0; i < t1->w; ++i) {
+                for (i = 0; i < w; ++i) {
                         mi_INT32 *data2 = data1 + i;
                         mi_flag_t *flags2 = flags1 + i;
-                        flags2 += t1->flags_stride;
-                        mi_t1_dec_refpass_step_mqc(t1, flags2, data2, poshalf, neghalf);
-                        data2 += t1->w;
-                        flags2 += t1->flags_stride;
-                        mi_t1_dec_refpass_step_mqc(t1, flags2, data2, poshalf, neghalf);
-                        data2 += t1->w;
-                        flags2 += t1->flags_stride;
-                        mi_t1_dec_refpass_step_mqc(t1, flags2, data2, poshalf, neghalf);
-                        data2 += t1->w;
-                        flags2 += t1->flags_stride;
-                        mi_t1_dec_refpass_step_mqc(t1, flags2, data2, poshalf, neghalf);
-                        data2 += t1->w;
-                }
-                data1 += t1->w << 2;
-                flags1 += t1->flags_stride << 2;
-        }
-        for (i = 0; i < t1->w; ++i) {
-                mi_INT32 *data2 = data1 + i;
-                mi_flag_t *flags2 = flags1 + i;
-                for (j = k; j < t1->h; ++j) {
-                        flags2 += t1->flags_stride;
-                        mi_t1_dec_refpass_step_mqc(t1, flags2, data2, poshalf, neghalf);
-                        data2 += t1->w;
+                        if (!(*flags2 & T1_SIGMA_COL)) {
+                                continue;
+                        }
+                        mi_t1_dec_refpass_step_mqc_macro(flags2, data2, poshalf, neghalf, 0U, 0U, mqc, curctx, a, c, ct);
+                        data2 += w;
+                        mi_t1_dec_refpass_step_mqc_macro(flags2, data2, poshalf, neghalf, 1U, 0U, mqc, curctx, a, c, ct);
+                        data2 += w;
+                        mi_t1_dec_refpass_step_mqc_macro(flags2, data2, poshalf, neghalf, 2U, 0U, mqc, curctx, a, c, ct);
+                        data2 += w;
+                        mi_t1_dec_refpass_step_mqc_macro(flags2, data2, poshalf, neghalf, 3U, vsc, mqc, curctx, a, c, ct);
                 }
+                data1 += w << 2;
+                flags1 += t1->flags_stride;
         }
-}                               /* VSC and  BYPASS by Antonin */
-
-static void mi_t1_dec_refpass_mqc_vsc(
-                mi_t1_t *t1,
-                mi_INT32 bpno)
-{
-        mi_INT32 one, poshalf, neghalf;
-        mi_UINT32 i, j, k;
-        mi_INT32 vsc;
-        one = 1 << bpno;
-        poshalf = one >> 1;
-        neghalf = bpno > 0 ? -poshalf : -1;
-        for (k = 0; k < t1->h; k += 4) {
-                for (i = 0; i < t1->w; ++i) {
-                        for (j = k; j < k + 4 && j < t1->h; ++j) {
-                                vsc = ((j == k + 3 || j == t1->h - 1)) ? 1 : 0;
-                                mi_t1_dec_refpass_step_mqc_vsc(
-                                                t1,
-                                                &t1->flags[((j+1) * t1->flags_stride) + i + 1],
-                                                &t1->data[(j * t1->w) + i],
-                                                poshalf,
-                                                neghalf,
-                                                vsc);
+        if (k < t1->h) {
+                for (i = 0; i < w; ++i) {
+                        mi_INT32 *data2 = data1 + i;
+                        mi_flag_t *flags2 = flags1 + i;
+                        if (!(*flags2 & T1_SIGMA_COL)) {
+                                continue;
+                        }
+                        for (ci = 0; k + ci < t1->h; ++ci) {
+                                mi_t1_dec_refpass_step_mqc_macro(flags2, data2, poshalf, neghalf, ci, 0U, mqc, curctx, a, c, ct);
+                                data2 += w;
                         }
                 }
         }
+        mi_mqc_dec_store(mqc, curctx, a, c, ct);
 }                               /* VSC and  BYPASS by Antonin */
 
 
@@ -792,105 +745,33 @@ static void mi_t1_enc_clnpass_step(
 		mi_INT32 one,
 		mi_INT32 *nmsedec,
 		mi_UINT32 partial,
+		mi_UINT32 ci,
 		mi_UINT32 vsc)
 {
 	mi_INT32 v;
-	mi_UINT32 flag;
-	
+	mi_UINT32 flags, f, lu;
+
 	mi_mqc_t *mqc = t1->mqc;	/* MQC component */
-	
-	flag = vsc ? (mi_UINT32)((*flagsp) & (~(T1_SIG_S | T1_SIG_SE | T1_SIG_SW | T1_SGN_S))) : (mi_UINT32)(*flagsp);
+
+	flags = vsc ? ((*flagsp) & ~T1_VSC_MASK) : (*flagsp);
+	f = flags >> (3U * ci);
 	if (partial) {
 		goto LABEL_PARTIAL;
 	}
-	if (!(*flagsp & (T1_SIG | T1_VISIT))) {
-		mi_mqc_setcurctx(mqc, mi_t1_getctxno_zc(flag, orient));
+	if (!(f & (T1_SIGMA_THIS | T1_PI_THIS))) {
+		mi_mqc_setcurctx(mqc, mi_t1_getctxno_zc(f, orient));
 		v = (mi_int_abs(*datap) & one) ? 1 : 0;
 		mi_mqc_encode(mqc, (mi_UINT32)v);
 		if (v) {
 LABEL_PARTIAL:
+			lu = mi_t1_getctxtno_sc_or_spb_index(flags, flagsp[-1], flagsp[1], ci);
 			*nmsedec += mi_t1_getnmsedec_sig((mi_UINT32)mi_int_abs(*datap), (mi_UINT32)(bpno));
-			mi_mqc_setcurctx(mqc, mi_t1_getctxno_sc(flag));
+			mi_mqc_setcurctx(mqc, mi_t1_getctxno_sc(lu));
 			v = *datap < 0 ? 1 : 0;
-			mi_mqc_encode(mqc, (mi_UINT32)(v ^ mi_t1_getspb((mi_UINT32)flag)));
-			mi_t1_updateflags(flagsp, (mi_UINT32)v, t1->flags_stride);
-		}
-	}
-	*flagsp &= ~T1_VISIT;
-}
-
-static void mi_t1_dec_clnpass_step_partial(
-		mi_t1_t *t1,
-		mi_flag_t *flagsp,
-		mi_INT32 *datap,
-		mi_INT32 orient,
-		mi_INT32 oneplushalf)
-{
-	mi_INT32 v, flag;
-	mi_mqc_t *mqc = t1->mqc;	/* MQC component */
-	
-	mi_ARG_NOT_USED(orient);
-	
-	flag = *flagsp;
-	mi_mqc_setcurctx(mqc, mi_t1_getctxno_sc((mi_UINT32)flag));
-	v = mi_mqc_decode(mqc) ^ mi_t1_getspb((mi_UINT32)flag);
-	*datap = v ? -oneplushalf : oneplushalf;
-	mi_t1_updateflags(flagsp, (mi_UINT32)v, t1->flags_stride);
-	*flagsp &= ~T1_VISIT;
-}				/* VSC and  BYPASS by Antonin */
-
-static void mi_t1_dec_clnpass_step(
-		mi_t1_t *t1,
-		mi_flag_t *flagsp,
-		mi_INT32 *datap,
-		mi_INT32 orient,
-		mi_INT32 oneplushalf)
-{
-	mi_INT32 v, flag;
-	
-	mi_mqc_t *mqc = t1->mqc;	/* MQC component */
-	
-	flag = *flagsp;
-	if (!(flag & (T1_SIG | T1_VISIT))) {
-		mi_mqc_setcurctx(mqc, mi_t1_getctxno_zc((mi_UINT32)flag, (mi_UINT32)orient));
-		if (mi_mqc_decode(mqc)) {
-			mi_mqc_setcurctx(mqc, mi_t1_getctxno_sc((mi_UINT32)flag));
-			v = mi_mqc_decode(mqc) ^ mi_t1_getspb((mi_UINT32)flag);
-			*datap = v ? -oneplushalf : oneplushalf;
-			mi_t1_updateflags(flagsp, (mi_UINT32)v, t1->flags_stride);
-		}
-	}
-	*flagsp &= ~T1_VISIT;
-}				/* VSC and  BYPASS by Antonin */
-
-static void mi_t1_dec_clnpass_step_vsc(
-		mi_t1_t *t1,
-		mi_flag_t *flagsp,
-		mi_INT32 *datap,
-		mi_INT32 orient,
-		mi_INT32 oneplushalf,
-		mi_INT32 partial,
-		mi_INT32 vsc)
-{
-	mi_INT32 v, flag;
-	
-	mi_mqc_t *mqc = t1->mqc;	/* MQC component */
-	
-	flag = vsc ? ((*flagsp) & (~(T1_SIG_S | T1_SIG_SE | T1_SIG_SW | T1_SGN_S))) : (*flagsp);
-	if (partial) {
-		goto LABEL_PARTIAL;
-	}
-	if (!(flag & (T1_SIG | T1_VISIT))) {
-		mi_mqc_setcurctx(mqc, mi_t1_getctxno_zc((mi_UINT32)flag, (mi_UINT32)orient));
-		if (mi_mqc_decode(mqc)) {
-LABEL_PARTIAL:
-			mi_mqc_setcurctx(mqc, mi_t1_getctxno_sc((mi_UINT32)flag));
-			v = mi_mqc_decode(mqc) ^ mi_t1_getspb((mi_UINT32)flag);
-			*datap = v ? -oneplushalf : oneplushalf;
-			mi_t1_updateflags(flagsp, (mi_UINT32)v, t1->flags_stride);
+			mi_mqc_encode(mqc, (mi_UINT32)(v ^ mi_t1_getspb(lu)));
+			mi_t1_updateflags(flagsp, ci, (mi_UINT32)v, t1->flags_stride);
 		}
 	}
-	*flagsp &= ~T1_VISIT;
 }
 
 static void mi_t1_enc_clnpass(
@@ -900,29 +781,27 @@ static void mi_t1_enc_clnpass(
 		mi_INT32 *nmsedec,
 		mi_UINT32 cblksty)
 {
-	mi_UINT32 i, j, k;
+	mi_UINT32 i, k, ci;
 	mi_INT32 one;
-	mi_UINT32 agg, runlen, vsc;
-	
+	mi_UINT32 agg, runlen, vsc, agg_mask;
+	mi_flag_t *flagsp;
+
 	mi_mqc_t *mqc = t1->mqc;	/* MQC component */
-	
+
 	*nmsedec = 0;
 	one = 1 << (bpno + T1_NMSEDEC_FRACBITS);
+	vsc = (cblksty & J2K_CCP_CBLKSTY_VSC) ? 1U : 0U;
+	/* a column is coded in run-length mode when none of its samples and */
+	/* of their neighbours is significant, and none has been visited     */
+	agg_mask = T1_SIGMA_ALL | T1_PI_COL;
+	if (vsc) {
+		agg_mask &= ~T1_VSC_MASK;
+	}
 	for (k = 0; k < t1->h; k += 4) {
-		for (i = 0; i < t1->w; ++i) {
+		flagsp = &MACRO_t1_flags(1 + (k >> 2), 1);
+		for (i = 0; i < t1->w; ++i, ++flagsp) {
 			if (k + 3 < t1->h) {
-				if (cblksty & J2K_CCP_CBLKSTY_VSC) {
-					agg = !(MACRO_t1_flags(1 + k,1 + i) & (T1_SIG | T1_VISIT | T1_SIG_OTH)
-						|| MACRO_t1_flags(1 + k + 1,1 + i) & (T1_SIG | T1_VISIT | T1_SIG_OTH)
-						|| MACRO_t1_flags(1 + k + 2,1 + i) & (T1_SIG | T1_VISIT | T1_SIG_OTH)
-						|| (MACRO_t1_flags(1 + k + 3,1 + i) 
-						& (~(T1_SIG_S | T1_SIG_SE | T1_SIG_SW |	T1_SGN_S))) & (T1_SIG | T1_VISIT | T1_SIG_OTH));
-				} else {
-					agg = !((MACRO_t1_flags(1 + k,1 + i) | 
-						    MACRO_t1_flags(1 + k + 1,1 + i) |
-						    MACRO_t1_flags(1 + k + 2,1 + i) | 
-						     MACRO_t1_flags(1 + k + 3,1 + i)) & (T1_SIG | T1_VISIT | T1_SIG_OTH));
-				}
+				agg = !(*flagsp & agg_mask);
 			} else {
 				agg = 0;
 			}
@@ -943,146 +822,152 @@ static void mi_t1_enc_clnpass(
 			} else {
 				runlen = 0;
 			}
-			for (j = k + runlen; j < k + 4 && j < t1->h; ++j) {
-				vsc = ((cblksty & J2K_CCP_CBLKSTY_VSC) && (j == k + 3 || j == t1->h - 1)) ? 1 : 0;
+			for (ci = runlen; ci < 4 && k + ci < t1->h; ++ci) {
 				mi_t1_enc_clnpass_step(
 						t1,
-						&t1->flags[((j+1) * t1->flags_stride) + i + 1],
-						&t1->data[(j * t1->data_stride) + i],
+						flagsp,
+						&t1->data[((k + ci) * t1->data_stride) + i],
 						orient,
 						bpno,
 						one,
 						nmsedec,
-						agg && (j == k + runlen),
-						vsc);
+						agg && (ci == runlen),
+						ci,
+						vsc && ci == 3);
 			}
+			*flagsp &= ~T1_PI_COL;
 		}
 	}
 }
 
+/**
+Decode the sign of a sample of the clean-up pass which is known to become
+significant, with the local state of the MQ decoder
+*/
+#define mi_t1_dec_clnpass_step_partial_macro(flagsp, datap, flags_stride, oneplushalf, ci, vsc, mqc, curctx, a, c, ct) \
+	{ \
+		mi_INT32 l_v; \
+		mi_UINT32 l_lu = mi_t1_getctxtno_sc_or_spb_index((vsc) ? ((*(flagsp)) & ~T1_VSC_MASK) : (*(flagsp)), (flagsp)[-1], (flagsp)[1], ci); \
+		mi_mqc_dec_setcurctx(mqc, curctx, mi_t1_getctxno_sc(l_lu)); \
+		mi_mqc_decode_macro(l_v, mqc, curctx, a, c, ct); \
+		l_v ^= mi_t1_getspb(l_lu); \
+		*(datap) = l_v ? -(oneplushalf) : (oneplushalf); \
+		mi_t1_updateflags(flagsp, ci, (mi_UINT32)l_v, flags_stride); \
+	}
+
+/**
+Decode a sample of the clean-up pass with the local state of the MQ decoder
+(see mi_t1_dec_sigpass_step_mqc_macro)
+*/
+#define mi_t1_dec_clnpass_step_macro(flagsp, datap, flags_stride, orient, oneplushalf, ci, vsc, mqc, curctx, a, c, ct) \
+	{ \
+		mi_UINT32 l_flags = (vsc) ? ((*(flagsp)) & ~T1_VSC_MASK) : (*(flagsp)); \
+		mi_UINT32 l_f = l_flags >> (3U * (ci)); \
+		if (!(l_f & (T1_SIGMA_THIS | T1_PI_THIS))) { \
+			mi_INT32 l_v; \
+			mi_mqc_dec_setcurctx(mqc, curctx, mi_t1_getctxno_zc(l_f, (mi_UINT32)(orient))); \
+			mi_mqc_decode_macro(l_v, mqc, curctx, a, c, ct); \
+			if (l_v) { \
+				mi_UINT32 l_lu = mi_t1_getctxtno_sc_or_spb_index(l_flags, (flagsp)[-1], (flagsp)[1], ci); \
+				mi_mqc_dec_setcurctx(mqc, curctx, mi_t1_getctxno_sc(l_lu)); \
+				mi_mqc_decode_macro(l_v, mqc, curctx, a, c, ct); \
+				l_v ^= mi_t1_getspb(l_lu); \
+				*(datap) = l_v ? -(oneplushalf) : (oneplushalf); \
+				mi_t1_updateflags(flagsp, ci, (mi_UINT32)l_v, flags_stride); \
+			} \
+		} \
+	}
+
 static void mi_t1_dec_clnpass(
 		mi_t1_t *t1,
 		mi_INT32 bpno,
 		mi_INT32 orient,
 		mi_INT32 cblksty)
 {
-	mi_INT32 one, half, oneplushalf, agg, runlen, vsc;
-    mi_UINT32 i, j, k;
+	mi_INT32 one, half, oneplushalf, v;
+	mi_UINT32 i, k, ci, runlen, vsc, agg_mask;
 	mi_INT32 segsym = cblksty & J2K_CCP_CBLKSTY_SEGSYM;
-	
+	mi_INT32 *data1 = t1->data;
+	mi_flag_t *flags1 = &MACRO_t1_flags(1, 1);
+	const mi_UINT32 w = t1->w;
+	const mi_UINT32 flags_stride = t1->flags_stride;
 	mi_mqc_t *mqc = t1->mqc;	/* MQC component */
-	
+	mi_mqc_dec_load(mqc, curctx, a, c, ct);
+
 	one = 1 << bpno;
 	half = one >> 1;
 	oneplushalf = one | half;
-	if (cblksty & J2K_CCP_CBLKSTY_VSC) {
-	for (k = 0; k < t1->h; k += 4) {
-		for (i = 0; i < t1->w; ++i) {
-			if (k + 3 < t1->h) {
-					agg = !(MACRO_t1_flags(1 + k,1 + i) & (T1_SIG | T1_VISIT | T1_SIG_OTH)
-						|| MACRO_t1_flags(1 + k + 1,1 + i) & (T1_SIG | T1_VISIT | T1_SIG_OTH)
-						|| MACRO_t1_flags(1 + k + 2,1 + i) & (T1_SIG | T1_VISIT | T1_SIG_OTH)
-						|| (MACRO_t1_flags(1 + k + 3,1 + i) 
-						& (~(T1_SIG_S | T1_SIG_SE | T1_SIG_SW |	T1_SGN_S))) & (T1_SIG | T1_VISIT | T1_SIG_OTH));
-				} else {
-				agg = 0;
-			}
-			if (agg) {
-				mi_mqc_setcurctx(mqc, T1_CTXNO_AGG);
-				if (!mi_mqc_decode(mqc)) {
+	vsc = (cblksty & J2K_CCP_CBLKSTY_VSC) ? 1U : 0U;
+	agg_mask = T1_SIGMA_ALL | T1_PI_COL;
+	if (vsc) {
+		agg_mask &= ~T1_VSC_MASK;
+	}
+	for (k = 0; k < (t1->h & ~3u); k += 4) {
+		for (i = 0; i < w; ++i) {
+			mi_INT32 *data2 = data1 + i;
+			mi_flag_t *flags2 = flags1 + i;
+			if (!(*flags2 & agg_mask)) {
+				mi_mqc_dec_setcurctx(mqc, curctx, T1_CTXNO_AGG);
+				mi_mqc_decode_macro(v, mqc, curctx, a, c, ct);
+				if (!v) {
 					continue;
 				}
-				mi_mqc_setcurctx(mqc, T1_CTXNO_UNI);
-				runlen = mi_mqc_decode(mqc);
-				runlen = (runlen << 1) | mi_mqc_decode(mqc);
+				mi_mqc_dec_setcurctx(mqc, curctx, T1_CTXNO_UNI);
+				mi_mqc_decode_macro(v, mqc, curctx, a, c, ct);
+				runlen = (mi_UINT32)v;
+				mi_mqc_decode_macro(v, mqc, curctx, a, c, ct);
+				runlen = (runlen << 1) | (mi_UINT32)v;
+				data2 += runlen * w;
+				mi_t1_dec_clnpass_step_partial_macro(flags2, data2, flags_stride, oneplushalf, runlen, vsc && runlen == 3, mqc, curctx, a, c, ct);
+				for (ci = runlen + 1; ci < 4; ++ci) {
+					data2 += w;
+					mi_t1_dec_clnpass_step_macro(flags2, data2, flags_stride, orient, oneplushalf, ci, vsc && ci == 3, mqc, curctx, a, c, ct);
+				}
 			} else {
-				runlen = 0;
-			}
-			for (j = k + (mi_UINT32)runlen; j < k + 4 && j < t1->h; ++j) {
-					vsc = (j == k + 3 || j == t1->h - 1) ? 1 : 0;
-					mi_t1_dec_clnpass_step_vsc(
-						t1,
-						&t1->flags[((j+1) * t1->flags_stride) + i + 1],
-						&t1->data[(j * t1->w) + i],
-						orient,
-						oneplushalf,
-						agg && (j == k + (mi_UINT32)runlen),
-						vsc);
+				mi_t1_dec_clnpass_step_macro(flags2, data2, flags_stride, orient, oneplushalf, 0U, 0U, mqc, curctx, a, c, ct);
+				data2 += w;
+				mi_t1_dec_clnpass_step_macro(flags2, data2, flags_stride, orient, oneplushalf, 1U, 0U, mqc, curctx, a, c, ct);
+				data2 += w;
+				mi_t1_dec_clnpass_step_macro(flags2, data2, flags_stride, orient, oneplushalf, 2U, 0U, mqc, curctx, a, c, ct);
+				data2 += w;
+				mi_t1_dec_clnpass_step_macro(flags2, data2, flags_stride, orient, oneplushalf, 3U, vsc, mqc, curctx, a, c, ct);
 			}
+			*flags2 &= ~T1_PI_COL;
 		}
+		data1 += w << 2;
+		flags1 += flags_stride;
 	}
-	} else {
-		mi_INT32 *data1 = t1->data;
-		mi_flag_t *flags1 = &t1->flags[1];
-		for (k = 0; k < (t1->h & ~3u); k += 4) {
-			for (i = 0; i < t1->w; ++i) {
-				mi_INT32 *data2 = data1 + i;
-				mi_flag_t *flags2 = flags1 + i;
-				agg = !((MACRO_t1_flags(1 + k, 1 + i) |
-							MACRO_t1_flags(1 + k + 1, 1 + i) |
-							MACRO_t1_flags(1 + k + 2, 1 + i) |
-							MACRO_t1_flags(1 + k + 3, 1 + i)) & (T1_SIG | T1_VISIT | T1_SIG_OTH));
-				if (agg) {
-					mi_mqc_setcurctx(mqc, T1_CTXNO_AGG);
-					if (!mi_mqc_decode(mqc)) {
-						continue;
-					}
-					mi_mqc_setcurctx(mqc, T1_CTXNO_UNI);
-					runlen = mi_mqc_decode(mqc);
-					runlen = (runlen << 1) | mi_mqc_decode(mqc);
-					flags2 += (mi_UINT32)runlen * t1->flags_stride;
-					data2 += (mi_UINT32)runlen * t1->w;
-					for (j = (mi_UINT32)runlen; j < 4 && j < t1->h; ++j) {
-						flags2 += t1->flags_stride;
-						if (agg && (j == (mi_UINT32)runlen)) {
-							mi_t1_dec_clnpass_step_partial(t1, flags2, data2, orient, oneplushalf);
-						} else {
-							mi_t1_dec_clnpass_step(t1, flags2, data2, orient, oneplushalf);
-						}
-						data2 += t1->w;
-					}
-				} else {
-					flags2 += t1->flags_stride;
-					mi_t1_dec_clnpass_step(t1, flags2, data2, orient, oneplushalf);
-					data2 += t1->w;
-					flags2 += t1->flags_stride;
-					mi_t1_dec_clnpass_step(t1, flags2, data2, orient, oneplushalf);
-					data2 += t1->w;
-					flags2 += t1->flags_stride;
-					mi_t1_dec_clnpass_step(t1, flags2, data2, orient, oneplushalf);
-					data2 += t1->w;
-					flags2 += t1->flags_stride;
-					mi_t1_dec_clnpass_step(t1, flags2, data2, orient, oneplushalf);
-					data2 += t1->w;
-				}
-			}
-			data1 += t1->w << 2;
-			flags1 += t1->flags_stride << 2;
-		}
-		for (i = 0; i < t1->w; ++i) {
+	if (k < t1->h) {
+		for (i = 0; i < w; ++i) {
 			mi_INT32 *data2 = data1 + i;
 			mi_flag_t *flags2 = flags1 + i;
-			for (j = k; j < t1->h; ++j) {
-				flags2 += t1->flags_stride;
-				mi_t1_dec_clnpass_step(t1, flags2, data2, orient, oneplushalf);
-				data2 += t1->w;
+			for (ci = 0; k + ci < t1->h; ++ci) {
+				mi_t1_dec_clnpass_step_macro(flags2, data2, flags_stride, orient, oneplushalf, ci, 0U, mqc, curctx, a, c, ct);
+				data2 += w;
 			}
+			*flags2 &= ~T1_PI_COL;
 		}
 	}
 
 	if (segsym) {
-		mi_INT32 v = 0;
-		mi_mqc_setcurctx(mqc, T1_CTXNO_UNI);
-		v = mi_mqc_decode(mqc);
-		v = (v << 1) | mi_mqc_decode(mqc);
-		v = (v << 1) | mi_mqc_decode(mqc);
-		v = (v << 1) | mi_mqc_decode(mqc);
+		mi_INT32 s;
+		mi_mqc_dec_setcurctx(mqc, curctx, T1_CTXNO_UNI);
+		mi_mqc_decode_macro(v, mqc, curctx, a, c, ct);
+		s = v;
+		mi_mqc_decode_macro(v, mqc, curctx, a, c, ct);
+		s = (s << 1) | v;
+		mi_mqc_decode_macro(v, mqc, curctx, a, c, ct);
+		s = (s << 1) | v;
+		mi_mqc_decode_macro(v, mqc, curctx, a, c, ct);
+		s = (s << 1) | v;
 		/*
-		if (v!=0xa) {
-			mi_event_msg(t1->cinfo, EVT_WARNING, "Bad segmentation symbol %x\n", v);
-		} 
+		if (s!=0xa) {
+			mi_event_msg(t1->cinfo, EVT_WARNING, "Bad segmentation symbol %x\n", s);
+		}
 		*/
+		(void)s;
 	}
+	mi_mqc_dec_store(mqc, curctx, a, c, ct);
 }				/* VSC and  BYPASS by Antonin */
 
 
@@ -1142,8 +1027,9 @@ static mi_BOOL mi_t1_allocate_buffers(
 			memset(t1->data,0,datasize * sizeof(mi_INT32));
 		}
 	}
+	/* one column of flags per stripe of 4 rows, plus a border around */
 	t1->flags_stride=w+2;
-	flagssize=t1->flags_stride * (h+2);
+	flagssize=t1->flags_stride * (((h+3U) >> 2) + 2U);
 
 	if(flagssize > t1->flagssize){
 		mi_aligned_free(t1->flags);
@@ -1228,13 +1114,114 @@ void mi_t1_destroy(mi_t1_t *p_t1)
 	mi_free(p_t1);
 }
 
-mi_BOOL mi_t1_decode_cblks(   mi_t1_t* t1,
+typedef struct
+{
+	mi_UINT32 resno;
+	mi_tcd_cblk_dec_t* cblk;
+	mi_tcd_band_t* band;
+	mi_tcd_tilecomp_t* tilec;
+	mi_tccp_t* tccp;
+	volatile mi_BOOL* pret;
+} mi_t1_cblk_decode_processing_job_t;
+
+static void mi_t1_cblk_decode_processor(void* user_data, mi_tls_t* tls)
+{
+	mi_t1_cblk_decode_processing_job_t* job = (mi_t1_cblk_decode_processing_job_t*) user_data;
+	mi_tcd_cblk_dec_t* cblk = job->cblk;
+	const mi_tcd_band_t* band = job->band;
+	const mi_tcd_tilecomp_t* tilec = job->tilec;
+	const mi_tccp_t* tccp = job->tccp;
+	const mi_UINT32 resno = job->resno;
+	mi_UINT32 tile_w = (mi_UINT32)(tilec->x1 - tilec->x0);
+	mi_t1_t* t1;
+	mi_INT32* restrict datap;
+	mi_UINT32 cblk_w, cblk_h;
+	mi_INT32 x, y;
+	mi_UINT32 i, j;
+
+	if (!*(job->pret)) {
+		mi_free(job);
+		return;
+	}
+
+	t1 = mi_t1_get_tls_t1(tls, mi_FALSE);
+	if (t1 == 00) {
+		*(job->pret) = mi_FALSE;
+		mi_free(job);
+		return;
+	}
+
+	if (mi_FALSE == mi_t1_decode_cblk(
+							t1,
+							cblk,
+							band->bandno,
+							(mi_UINT32)tccp->roishift,
+							tccp->cblksty)) {
+		*(job->pret) = mi_FALSE;
+		mi_free(job);
+		return;
+	}
+
+	x = cblk->x0 - band->x0;
+	y = cblk->y0 - band->y0;
+	if (band->bandno & 1) {
+		mi_tcd_resolution_t* pres = &tilec->resolutions[resno - 1];
+		x += pres->x1 - pres->x0;
+	}
+	if (band->bandno & 2) {
+		mi_tcd_resolution_t* pres = &tilec->resolutions[resno - 1];
+		y += pres->y1 - pres->y0;
+	}
+
+	datap=t1->data;
+	cblk_w = t1->w;
+	cblk_h = t1->h;
+
+	if (tccp->roishift) {
+		mi_INT32 thresh = 1 << tccp->roishift;
+		for (j = 0; j < cblk_h; ++j) {
+			for (i = 0; i < cblk_w; ++i) {
+				mi_INT32 val = datap[(j * cblk_w) + i];
+				mi_INT32 mag = abs(val);
+				if (mag >= thresh) {
+					mag >>= tccp->roishift;
+					datap[(j * cblk_w) + i] = val < 0 ? -mag : mag;
+				}
+			}
+		}
+	}
+	if (tccp->qmfbid == 1) {
+		mi_INT32* restrict tiledp = &tilec->data[(mi_UINT32)y * tile_w + (mi_UINT32)x];
+		for (j = 0; j < cblk_h; ++j) {
+			for (i = 0; i < cblk_w; ++i) {
+				mi_INT32 tmp = datap[(j * cblk_w) + i];
+				((mi_INT32*)tiledp)[(j * tile_w) + i] = tmp/2;
+			}
+		}
+	} else {		/* if (tccp->qmfbid == 0) */
+		mi_FLOAT32* restrict tiledp = (mi_FLOAT32*) &tilec->data[(mi_UINT32)y * tile_w + (mi_UINT32)x];
+		for (j = 0; j < cblk_h; ++j) {
+			mi_FLOAT32* restrict tiledp2 = tiledp;
+			for (i = 0; i < cblk_w; ++i) {
+				mi_FLOAT32 tmp = (mi_FLOAT32)*datap * band->stepsize;
+				*tiledp2 = tmp;
+				datap++;
+				tiledp2++;
+			}
+			tiledp += tile_w;
+		}
+	}
+
+	mi_free(job);
+}
+
+void mi_t1_decode_cblks(   mi_job_group_t* group,
+                            volatile mi_BOOL* pret,
                             mi_tcd_tilecomp_t* tilec,
                             mi_tccp_t* tccp
                             )
 {
 	mi_UINT32 resno, bandno, precno, cblkno;
-	mi_UINT32 tile_w = (mi_UINT32)(tilec->x1 - tilec->x0);
 
 	for (resno = 0; resno < tilec->minimum_num_resolutions; ++resno) {
 		mi_tcd_resolution_t* res = &tilec->resolutions[resno];
@@ -1247,74 +1234,37 @@ mi_BOOL mi_t1_decode_cblks(   mi_t1_t* t1,
 
 				for (cblkno = 0; cblkno < precinct->cw * precinct->ch; ++cblkno) {
 					mi_tcd_cblk_dec_t* cblk = &precinct->cblks.dec[cblkno];
-					mi_INT32* restrict datap;
-					mi_UINT32 cblk_w, cblk_h;
-					mi_INT32 x, y;
-					mi_UINT32 i, j;
-
-                    if (mi_FALSE == mi_t1_decode_cblk(
-                                            t1,
-                                            cblk,
-                                            band->bandno,
-                                            (mi_UINT32)tccp->roishift,
-                                            tccp->cblksty)) {
-                            return mi_FALSE;
-                    }
+					mi_t1_cblk_decode_processing_job_t* job;
 
-					x = cblk->x0 - band->x0;
-					y = cblk->y0 - band->y0;
-					if (band->bandno & 1) {
-						mi_tcd_resolution_t* pres = &tilec->resolutions[resno - 1];
-						x += pres->x1 - pres->x0;
-					}
-					if (band->bandno & 2) {
-						mi_tcd_resolution_t* pres = &tilec->resolutions[resno - 1];
-						y += pres->y1 - pres->y0;
+					/* the code-blocks out of the coefficients needed by the decoded area are skipped */
+					if (cblk->x1 - band->x0 <= (mi_INT32)band->win_x0 || cblk->x0 - band->x0 >= (mi_INT32)band->win_x1 ||
+					    cblk->y1 - band->y0 <= (mi_INT32)band->win_y0 || cblk->y0 - band->y0 >= (mi_INT32)band->win_y1) {
+						continue;
 					}
 
-					datap=t1->data;
-					cblk_w = t1->w;
-					cblk_h = t1->h;
-
-					if (tccp->roishift) {
-						mi_INT32 thresh = 1 << tccp->roishift;
-						for (j = 0; j < cblk_h; ++j) {
-							for (i = 0; i < cblk_w; ++i) {
-								mi_INT32 val = datap[(j * cblk_w) + i];
-								mi_INT32 mag = abs(val);
-								if (mag >= thresh) {
-									mag >>= tccp->roishift;
-									datap[(j * cblk_w) + i] = val < 0 ? -mag : mag;
-								}
-							}
-						}
+					job = (mi_t1_cblk_decode_processing_job_t*) mi_calloc(1, sizeof(mi_t1_cblk_decode_processing_job_t));
+					if (!job) {
+						*pret = mi_FALSE;
+						return;
 					}
-					if (tccp->qmfbid == 1) {
-                        mi_INT32* restrict tiledp = &tilec->data[(mi_UINT32)y * tile_w + (mi_UINT32)x];
-						for (j = 0; j < cblk_h; ++j) {
-							for (i = 0; i < cblk_w; ++i) {
-								mi_INT32 tmp = datap[(j * cblk_w) + i];
-								((mi_INT32*)tiledp)[(j * tile_w) + i] = tmp/2;
-							}
-						}
-					} else {		/* if (tccp->qmfbid == 0) */
-                        mi_FLOAT32* restrict tiledp = (mi_FLOAT32*) &tilec->data[(mi_UINT32)y * tile_w + (mi_UINT32)x];
-						for (j = 0; j < cblk_h; ++j) {
-                            mi_FLOAT32* restrict tiledp2 = tiledp;
-							for (i = 0; i < cblk_w; ++i) {
-                                mi_FLOAT32 tmp = (mi_FLOAT32)*datap * band->stepsize;
-                                *tiledp2 = tmp;
-                                datap++;
-                                tiledp2++;
-							}
-                            tiledp += tile_w;
-						}
+					job->resno = resno;
+					job->cblk = cblk;
+					job->band = band;
+					job->tilec = tilec;
+					job->tccp = tccp;
+					job->pret = pret;
+					if (!mi_job_group_submit_job(group, mi_t1_cblk_decode_processor, job)) {
+						mi_free(job);
+						*pret = mi_FALSE;
+						return;
+					}
+					if (!*pret) {
+						return;
 					}
 				} /* cblkno */
 			} /* precno */
 		} /* bandno */
 	} /* resno */
-        return mi_TRUE;
 }
 
 
@@ -1369,24 +1319,16 @@ static mi_BOOL mi_t1_decode_cblk(mi_t1_t *t1,
             switch (passtype) {
                 case 0:
                     if (type == T1_TYPE_RAW) {
-                        mi_t1_dec_sigpass_raw(t1, bpno_plus_one, (mi_INT32)orient, (mi_INT32)cblksty);
+                        mi_t1_dec_sigpass_raw(t1, bpno_plus_one, (mi_INT32)cblksty);
                     } else {
-                        if (cblksty & J2K_CCP_CBLKSTY_VSC) {
-                            mi_t1_dec_sigpass_mqc_vsc(t1, bpno_plus_one, (mi_INT32)orient);
-                        } else {
-                            mi_t1_dec_sigpass_mqc(t1, bpno_plus_one, (mi_INT32)orient);
-                        }
+                        mi_t1_dec_sigpass_mqc(t1, bpno_plus_one, (mi_INT32)orient, (mi_INT32)cblksty);
                     }
                     break;
                 case 1:
                     if (type == T1_TYPE_RAW) {
                             mi_t1_dec_refpass_raw(t1, bpno_plus_one, (mi_INT32)cblksty);
                     } else {
-                        if (cblksty & J2K_CCP_CBLKSTY_VSC) {
-                            mi_t1_dec_refpass_mqc_vsc(t1, bpno_plus_one);
-                        } else {
-                            mi_t1_dec_refpass_mqc(t1, bpno_plus_one);
-                        }
+                        mi_t1_dec_refpass_mqc(t1, bpno_plus_one, (mi_INT32)cblksty);
                     }
                     break;
                 case 2:
@@ -1405,6 +1347,10 @@ static mi_BOOL mi_t1_decode_cblk(mi_t1_t *t1,
 				bpno_plus_one--;
 			}
 		}
+		if (type == T1_TYPE_MQ) {
+			/* the end marker overwrote the start of the next segment */
+			mi_mqc_finish_dec(mqc);
+		}
 	}
     return mi_TRUE;
 }
@@ -1412,106 +1358,224 @@ static mi_BOOL mi_t1_decode_cblk(mi_t1_t *t1,
 
 
 
-mi_BOOL mi_t1_encode_cblks(   mi_t1_t *t1,
+typedef struct
+{
+	mi_UINT32 compno;
+	mi_UINT32 resno;
+	mi_tcd_cblk_enc_t* cblk;
+	mi_tcd_tile_t *tile;
+	mi_tcd_band_t* band;
+	mi_tcd_tilecomp_t* tilec;
+	mi_tccp_t* tccp;
+	const mi_FLOAT64 * mct_norms;
+	mi_UINT32 mct_numcomps;
+	volatile mi_BOOL* pret;
+} mi_t1_cblk_encode_processing_job_t;
+
+static void mi_t1_free_tls_t1(void* value)
+{
+	mi_t1_destroy((mi_t1_t*) value);
+}
+
+static mi_t1_t* mi_t1_get_tls_t1(mi_tls_t* tls, mi_BOOL isEncoder)
+{
+	mi_t1_t* t1 = (mi_t1_t*) mi_tls_get(tls, mi_TLS_KEY_T1);
+	if (t1 == 00) {
+		t1 = mi_t1_create(isEncoder);
+		if (t1 == 00) {
+			return 00;
+		}
+		if (!mi_tls_set(tls, mi_TLS_KEY_T1, t1, mi_t1_free_tls_t1)) {
+			mi_t1_destroy(t1);
+			return 00;
+		}
+	}
+	return t1;
+}
+
+static void mi_t1_cblk_encode_processor(void* user_data, mi_tls_t* tls)
+{
+	mi_t1_cblk_encode_processing_job_t* job = (mi_t1_cblk_encode_processing_job_t*) user_data;
+	mi_tcd_cblk_enc_t* cblk = job->cblk;
+	const mi_tcd_band_t* band = job->band;
+	const mi_tcd_tilecomp_t* tilec = job->tilec;
+	const mi_tccp_t* tccp = job->tccp;
+	const mi_UINT32 resno = job->resno;
+	mi_t1_t* t1;
+	mi_UINT32 tile_w = (mi_UINT32)(tilec->x1 - tilec->x0);//ͼƬ
+	mi_INT32* restrict tiledp;
+	mi_UINT32 cblk_w;
+	mi_UINT32 cblk_h;
+	mi_UINT32 i, j, tileIndex=0, tileLineAdvance;
+
+	mi_INT32 x = cblk->x0 - band->x0;//ͷӴͷƫx
+	mi_INT32 y = cblk->y0 - band->y0;//ͷӴͷƫy
+
+	if (!*(job->pret)) {
+		mi_free(job);
+		return;
+	}
+
+	t1 = mi_t1_get_tls_t1(tls, mi_TRUE);
+	if (t1 == 00) {
+		*(job->pret) = mi_FALSE;
+		mi_free(job);
+		return;
+	}
+
+	if (band->bandno & 1) {
+		mi_tcd_resolution_t *pres = &tilec->resolutions[resno - 1];
+		x += pres->x1 - pres->x0;
+	}
+	if (band->bandno & 2) {
+		mi_tcd_resolution_t *pres = &tilec->resolutions[resno - 1];
+		y += pres->y1 - pres->y0;
+	}
+
+	if(!mi_t1_allocate_buffers(
+				t1,
+				(mi_UINT32)(cblk->x1 - cblk->x0),
+				(mi_UINT32)(cblk->y1 - cblk->y0)))
+	{
+		*(job->pret) = mi_FALSE;
+		mi_free(job);
+		return;
+	}
+
+	cblk_w = t1->w;
+	cblk_h = t1->h;
+	tileLineAdvance = tile_w - cblk_w;
+
+	tiledp=&tilec->data[(mi_UINT32)y * tile_w + (mi_UINT32)x];
+	t1->data = tiledp;
+	t1->data_stride = tile_w;
+	if (tccp->qmfbid == 1) {
+		for (j = 0; j < cblk_h; ++j) {
+			for (i = 0; i < cblk_w; ++i) {
+				tiledp[tileIndex] *= (1 << T1_NMSEDEC_FRACBITS);//
+				tileIndex++;
+			}
+			tileIndex += tileLineAdvance;
+		}
+	} else {		/* if (tccp->qmfbid == 0) */
+		mi_INT32 bandconst = 8192 * 8192 / ((mi_INT32) floor(band->stepsize * 8192));
+		for (j = 0; j < cblk_h; ++j) {
+			for (i = 0; i < cblk_w; ++i) {
+				mi_INT32 tmp = tiledp[tileIndex];
+				tiledp[tileIndex] =
+					mi_int_fix_mul_t1(
+					tmp,
+					bandconst);
+				tileIndex++;
+			}
+			tileIndex += tileLineAdvance;
+		}
+	}
+
+	mi_t1_encode_cblk(
+			t1,
+			cblk,
+			band->bandno,
+			job->compno,
+			tilec->numresolutions - 1 - resno,
+			tccp->qmfbid,
+			band->stepsize,
+			tccp->cblksty,
+			job->tile->numcomps,
+			job->mct_norms,
+			job->mct_numcomps);
+
+	mi_free(job);
+}
+
+mi_BOOL mi_t1_encode_cblks(   mi_thread_pool_t* tp,
                                 mi_tcd_tile_t *tile,
                                 mi_tcp_t *tcp,
                                 const mi_FLOAT64 * mct_norms,
                                 mi_UINT32 mct_numcomps
                                 )
 {
-	mi_UINT32 compno, resno, bandno, precno, cblkno;
+	volatile mi_BOOL ret = mi_TRUE;
+	mi_UINT32 compno, resno, bandno, precno, cblkno, passno;
+	mi_job_group_t* group = mi_job_group_create(tp);
+
+	if (!group) {
+		return mi_FALSE;
+	}
 
 	tile->distotile = 0;		/* fixed_quality */
 
 	for (compno = 0; compno < tile->numcomps; ++compno) {
 		mi_tcd_tilecomp_t* tilec = &tile->comps[compno];//ƬصķϢ
 		mi_tccp_t* tccp = &tcp->tccps[compno];//Ƭ
-		mi_UINT32 tile_w = (mi_UINT32)(tilec->x1 - tilec->x0);//ͼƬ
 
 		for (resno = 0; resno < tilec->numresolutions; ++resno) {
 			mi_tcd_resolution_t *res = &tilec->resolutions[resno];//ǰֱʵķֱϢ
 
 			for (bandno = 0; bandno < res->numbands; ++bandno) {
 				mi_tcd_band_t* restrict band = &res->bands[bandno];//ǰӴӴϢ
-                mi_INT32 bandconst = 8192 * 8192 / ((mi_INT32) floor(band->stepsize * 8192));//ѹò
 
 				for (precno = 0; precno < res->pw * res->ph; ++precno) {
 					mi_tcd_precinct_t *prc = &band->precincts[precno];//ǰϢ
 
 					for (cblkno = 0; cblkno < prc->cw * prc->ch; ++cblkno) {
 						mi_tcd_cblk_enc_t* cblk = &prc->cblks.enc[cblkno];//ǰϢ
-						mi_INT32* restrict tiledp;
-						mi_UINT32 cblk_w;
-						mi_UINT32 cblk_h;
-						mi_UINT32 i, j, tileIndex=0, tileLineAdvance;
-
-						mi_INT32 x = cblk->x0 - band->x0;//ͷӴͷƫx
-						mi_INT32 y = cblk->y0 - band->y0;//ͷӴͷƫy
-						if (band->bandno & 1) {
-							mi_tcd_resolution_t *pres = &tilec->resolutions[resno - 1];
-							x += pres->x1 - pres->x0;
-						}
-						if (band->bandno & 2) {
-							mi_tcd_resolution_t *pres = &tilec->resolutions[resno - 1];
-							y += pres->y1 - pres->y0;
-						}
+						mi_t1_cblk_encode_processing_job_t* job;
 
-						if(!mi_t1_allocate_buffers(
-									t1,
-									(mi_UINT32)(cblk->x1 - cblk->x0),
-									(mi_UINT32)(cblk->y1 - cblk->y0)))
-						{
-							return mi_FALSE;
+						job = (mi_t1_cblk_encode_processing_job_t*) mi_calloc(1, sizeof(mi_t1_cblk_encode_processing_job_t));
+						if (!job) {
+							ret = mi_FALSE;
+							goto end;
 						}
-
-						cblk_w = t1->w;
-						cblk_h = t1->h;
-						tileLineAdvance = tile_w - cblk_w;
-
-						tiledp=&tilec->data[(mi_UINT32)y * tile_w + (mi_UINT32)x];
-						t1->data = tiledp;
-						t1->data_stride = tile_w;
-						if (tccp->qmfbid == 1) {
-							for (j = 0; j < cblk_h; ++j) {
-								for (i = 0; i < cblk_w; ++i) {
-									tiledp[tileIndex] *= (1 << T1_NMSEDEC_FRACBITS);//
-									tileIndex++;
-								}
-								tileIndex += tileLineAdvance;
-							}
-						} else {		/* if (tccp->qmfbid == 0) */
-							for (j = 0; j < cblk_h; ++j) {
-								for (i = 0; i < cblk_w; ++i) {
-									mi_INT32 tmp = tiledp[tileIndex];
-									tiledp[tileIndex] =
-										mi_int_fix_mul_t1(
-										tmp,
-										bandconst);
-									tileIndex++;
-								}
-								tileIndex += tileLineAdvance;
-							}
+						job->compno = compno;
+						job->resno = resno;
+						job->cblk = cblk;
+						job->tile = tile;
+						job->band = band;
+						job->tilec = tilec;
+						job->tccp = tccp;
+						job->mct_norms = mct_norms;
+						job->mct_numcomps = mct_numcomps;
+						job->pret = &ret;
+						if (!mi_job_group_submit_job(group, mi_t1_cblk_encode_processor, job)) {
+							mi_free(job);
+							ret = mi_FALSE;
+							goto end;
 						}
 
-						mi_t1_encode_cblk(
-								t1,
-								cblk,
-								band->bandno,
-								compno,
-								tilec->numresolutions - 1 - resno,
-								tccp->qmfbid,
-								band->stepsize,
-								tccp->cblksty,
-								tile->numcomps,
-								tile,
-								mct_norms,
-								mct_numcomps);
-
 					} /* cblkno */
 				} /* precno */
 			} /* bandno */
 		} /* resno  */
 	} /* compno  */
+
+end:
+	mi_job_group_destroy(group);
+	if (!ret) {
+		return mi_FALSE;
+	}
+
+	/* fixed_quality: accumulate the distortion decreases in code-block
+	   order, as the serial coder did, so that the result does not depend
+	   on the order in which the workers completed the code-blocks */
+	for (compno = 0; compno < tile->numcomps; ++compno) {
+		mi_tcd_tilecomp_t* tilec = &tile->comps[compno];
+		for (resno = 0; resno < tilec->numresolutions; ++resno) {
+			mi_tcd_resolution_t *res = &tilec->resolutions[resno];
+			for (bandno = 0; bandno < res->numbands; ++bandno) {
+				mi_tcd_band_t* band = &res->bands[bandno];
+				for (precno = 0; precno < res->pw * res->ph; ++precno) {
+					mi_tcd_precinct_t *prc = &band->precincts[precno];
+					for (cblkno = 0; cblkno < prc->cw * prc->ch; ++cblkno) {
+						mi_tcd_cblk_enc_t* cblk = &prc->cblks.enc[cblkno];
+						for (passno = 0; passno < cblk->totalpasses; ++passno) {
+							tile->distotile += cblk->passes[passno].wmsedec;
+						}
+					}
+				}
+			}
+		}
+	}
 	return mi_TRUE;
 }
 
@@ -1525,7 +1589,6 @@ static void mi_t1_encode_cblk(mi_t1_t *t1,
                         mi_FLOAT64 stepsize,
                         mi_UINT32 cblksty,
                         mi_UINT32 numcomps,
-                        mi_tcd_tile_t * tile,
                         const mi_FLOAT64 * mct_norms,
                         mi_UINT32 mct_numcomps)
 {
@@ -1584,7 +1647,7 @@ static void mi_t1_encode_cblk(mi_t1_t *t1,
 		/* fixed_quality */
 		tempwmsedec = mi_t1_getwmsedec(nmsedec, compno, level, orient, bpno, qmfbid, stepsize, numcomps,mct_norms, mct_numcomps) ;
 		cumwmsedec += tempwmsedec;
-		tile->distotile += tempwmsedec;
+		pass->wmsedec = tempwmsedec;
 
 		/* Code switch "RESTART" (i.e. TERMALL) */
 		if ((cblksty & J2K_CCP_CBLKSTY_TERMALL)	&& !((passtype == 2) && (bpno - 1 < 0))) {
@@ -14,28 +14,86 @@ in T1.C are used by some function in TCD.C.
 
 /* ----------------------------------------------------------------------- */
 #define T1_NMSEDEC_BITS 7
-//˸λ־ֻҪЯа˸κһᱻҪԱ루ZC
-#define T1_SIG_NE 0x0001	/**< Context orientation : North-East direction */
-#define T1_SIG_SE 0x0002	/**< Context orientation : South-East direction */
-#define T1_SIG_SW 0x0004	/**< Context orientation : South-West direction */
-#define T1_SIG_NW 0x0008	/**< Context orientation : North-West direction */
-#define T1_SIG_N 0x0010		/**< Context orientation : North direction */
-#define T1_SIG_E 0x0020		/**< Context orientation : East direction */
-#define T1_SIG_S 0x0040		/**< Context orientation : South direction */
-#define T1_SIG_W 0x0080		/**< Context orientation : West direction */
-
-#define T1_SIG_OTH (T1_SIG_N|T1_SIG_NE|T1_SIG_E|T1_SIG_SE|T1_SIG_S|T1_SIG_SW|T1_SIG_W|T1_SIG_NW)
-#define T1_SIG_PRIM (T1_SIG_N|T1_SIG_E|T1_SIG_S|T1_SIG_W)
-
-#define T1_SGN_N 0x0100//Ǹ
-#define T1_SGN_E 0x0200//Ǹ
-#define T1_SGN_S 0x0400//Ǹ
-#define T1_SGN_W 0x0800//Ǹ
-#define T1_SGN (T1_SGN_N|T1_SGN_E|T1_SGN_S|T1_SGN_W)
-
-#define T1_SIG 0x1000//ڵǰλƽѱZC˵֮ǰѾҵ׸λ
-#define T1_REFINE 0x2000//ڵǰλƽڷϸб
-#define T1_VISIT 0x4000//ڵǰλƽҪԴб
+/*
+The flags of the code-block are kept per column of a stripe: one mi_flag_t
+holds the state of the 4 samples of a column (rows 0 to 3 of the stripe)
+together with the significance of their neighbours, so that the context of
+a sample is read from a single word (plus the sign of its west and east
+neighbours, in the words of the adjacent columns).
+
+Bits 0 to 17 are the significance (sigma) of a 3 columns x 6 rows window:
+the row above the stripe, the 4 rows of the stripe and the row below it,
+3 bits per row from west to east. Sample ci of the column is bit 3*ci+4 and
+its 3x3 neighbourhood is bits 3*ci to 3*ci+8, so (flags >> (3*ci)) gives it
+at the position of the row 0 sample.
+
+The upper bits hold the sign (chi) of the rows -1 to 4, and for the 4 rows
+of the stripe the refinement (mu) and visit (pi) flags, interleaved by 3
+bits so that they also shift with 3*ci.
+*/
+#define T1_SIGMA_0  (1U << 0)
+#define T1_SIGMA_1  (1U << 1)
+#define T1_SIGMA_2  (1U << 2)
+#define T1_SIGMA_3  (1U << 3)
+#define T1_SIGMA_4  (1U << 4)
+#define T1_SIGMA_5  (1U << 5)
+#define T1_SIGMA_6  (1U << 6)
+#define T1_SIGMA_7  (1U << 7)
+#define T1_SIGMA_8  (1U << 8)
+#define T1_SIGMA_9  (1U << 9)
+#define T1_SIGMA_10 (1U << 10)
+#define T1_SIGMA_11 (1U << 11)
+#define T1_SIGMA_12 (1U << 12)
+#define T1_SIGMA_13 (1U << 13)
+#define T1_SIGMA_14 (1U << 14)
+#define T1_SIGMA_15 (1U << 15)
+#define T1_SIGMA_16 (1U << 16)
+#define T1_SIGMA_17 (1U << 17)
+
+#define T1_CHI_0    (1U << 18)	/**< Sign of the sample above the stripe */
+#define T1_CHI_0_I  18
+#define T1_CHI_1    (1U << 19)	/**< Sign of row 0 */
+#define T1_CHI_1_I  19
+#define T1_MU_0     (1U << 20)	/**< Row 0 has been refined */
+#define T1_PI_0     (1U << 21)	/**< Row 0 has been visited in the current bit-plane */
+#define T1_CHI_2    (1U << 22)
+#define T1_CHI_2_I  22
+#define T1_MU_1     (1U << 23)
+#define T1_PI_1     (1U << 24)
+#define T1_CHI_3    (1U << 25)
+#define T1_MU_2     (1U << 26)
+#define T1_PI_2     (1U << 27)
+#define T1_CHI_4    (1U << 28)
+#define T1_MU_3     (1U << 29)
+#define T1_PI_3     (1U << 30)
+#define T1_CHI_5    (1U << 31)	/**< Sign of the sample below the stripe */
+#define T1_CHI_5_I  31
+
+/* 3x3 neighbourhood of a sample, once shifted by 3*ci */
+#define T1_SIGMA_NW   T1_SIGMA_0	/**< Context orientation : North-West direction */
+#define T1_SIGMA_N    T1_SIGMA_1	/**< Context orientation : North direction */
+#define T1_SIGMA_NE   T1_SIGMA_2	/**< Context orientation : North-East direction */
+#define T1_SIGMA_W    T1_SIGMA_3	/**< Context orientation : West direction */
+#define T1_SIGMA_THIS T1_SIGMA_4	/**< The sample is significant */
+#define T1_SIGMA_E    T1_SIGMA_5	/**< Context orientation : East direction */
+#define T1_SIGMA_SW   T1_SIGMA_6	/**< Context orientation : South-West direction */
+#define T1_SIGMA_S    T1_SIGMA_7	/**< Context orientation : South direction */
+#define T1_SIGMA_SE   T1_SIGMA_8	/**< Context orientation : South-East direction */
+#define T1_SIGMA_NEIGHBOURS (T1_SIGMA_NW|T1_SIGMA_N|T1_SIGMA_NE|T1_SIGMA_W|T1_SIGMA_E|T1_SIGMA_SW|T1_SIGMA_S|T1_SIGMA_SE)
+
+#define T1_CHI_THIS   T1_CHI_1
+#define T1_CHI_THIS_I T1_CHI_1_I
+#define T1_MU_THIS    T1_MU_0
+#define T1_PI_THIS    T1_PI_0
+
+/** Significance of the 4 samples of the column */
+#define T1_SIGMA_COL (T1_SIGMA_4|T1_SIGMA_7|T1_SIGMA_10|T1_SIGMA_13)
+/** Visit flags of the 4 samples of the column */
+#define T1_PI_COL (T1_PI_0|T1_PI_1|T1_PI_2|T1_PI_3)
+/** Significance of the whole 3x6 window */
+#define T1_SIGMA_ALL 0x3FFFFU
+/** State of the row below the stripe, ignored by the last row of a stripe in VSC mode */
+#define T1_VSC_MASK (T1_SIGMA_15|T1_SIGMA_16|T1_SIGMA_17|T1_CHI_5)
 
 #define T1_NUMCTXS_ZC 9//ZC
 #define T1_NUMCTXS_SC 5//SC
@@ -56,8 +114,8 @@ in T1.C are used by some function in TCD.C.
 #define T1_TYPE_RAW 1	/**< No encoding the information is store under raw format in codestream (mode switch RAW)*/
 
 /* ----------------------------------------------------------------------- */
-//ҪԱ־
-typedef mi_INT16 mi_flag_t;
+//ҪԱ־һһ4
+typedef mi_UINT32 mi_flag_t;
 
 /**
 Tier-1 coding (coding of code-block coefficients)
@@ -80,6 +138,7 @@ typedef struct mi_t1 {
 	mi_BOOL   encoder;
 } mi_t1_t;
 
+/** Flags of the column y of the stripe x, both counted from the border (1 is the first one) */
 #define MACRO_t1_flags(x,y) t1->flags[((x)*(t1->flags_stride))+(y)]
 
 /** @name Exported functions */
@@ -87,28 +146,37 @@ typedef struct mi_t1 {
 /* ----------------------------------------------------------------------- */
 
 /**
-Encode the code-blocks of a tile
-@param t1 T1 handle
+Encode the code-blocks of a tile.
+Each code-block is encoded as a job of the thread pool, by the T1 handle
+kept in the thread local storage of the worker.
+@param tp Thread pool
 @param tile The tile to encode
 @param tcp Tile coding parameters
 @param mct_norms  FIXME DOC
 @param mct_numcomps Number of components used for MCT
 */
-mi_BOOL mi_t1_encode_cblks(   mi_t1_t *t1,
+mi_BOOL mi_t1_encode_cblks(   mi_thread_pool_t* tp,
                                 mi_tcd_tile_t *tile,
                                 mi_tcp_t *tcp,
                                 const mi_FLOAT64 * mct_norms,
                                 mi_UINT32 mct_numcomps);
 
 /**
-Decode the code-blocks of a tile
-@param t1 T1 handle
+Decode the code-blocks of a tile component.
+Each code-block is decoded as a job of the group, by the T1 handle
+kept in the thread local storage of the worker. The jobs may still be
+running on return: the caller must wait for the completion of the group
+before reading tilec->data or *pret.
+Only the code-blocks intersecting the window of their subband are decoded.
+@param group Job group of the decoding of the tile
+@param pret Set to mi_FALSE by a job that fails (must be mi_TRUE on entry)
 @param tilec The tile to decode
 @param tccp Tile coding parameters
 */
-mi_BOOL mi_t1_decode_cblks(   mi_t1_t* t1,
-                                mi_tcd_tilecomp_t* tilec,
-                                mi_tccp_t* tccp);
+void mi_t1_decode_cblks(   mi_job_group_t* group,
+                             volatile mi_BOOL* pret,
+                             mi_tcd_tilecomp_t* tilec,
+                             mi_tccp_t* tccp);
 
 
 
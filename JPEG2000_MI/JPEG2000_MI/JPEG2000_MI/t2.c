@@ -33,7 +33,7 @@ Encode a packet of a tile to a destination buffer
 static mi_BOOL mi_t2_encode_packet(   mi_UINT32 tileno,
                                         mi_tcd_tile_t *tile,
                                         mi_tcp_t *tcp,
-                                        mi_pi_iterator_t *pi,
+                                        const mi_pi_packet_t *pi,
                                         mi_BYTE *dest,
                                         mi_UINT32 * p_data_written,
                                         mi_UINT32 len,
@@ -55,7 +55,7 @@ Decode a packet of a tile from a source buffer
 static mi_BOOL mi_t2_decode_packet(   mi_t2_t* t2,
                                         mi_tcd_tile_t *tile,
                                         mi_tcp_t *tcp,
-                                        mi_pi_iterator_t *pi,
+                                        const mi_pi_packet_t *pi,
                                         mi_BYTE *src,
                                         mi_UINT32 * data_read,
                                         mi_UINT32 max_length,
@@ -65,7 +65,7 @@ static mi_BOOL mi_t2_decode_packet(   mi_t2_t* t2,
 static mi_BOOL mi_t2_skip_packet( mi_t2_t* p_t2,
                                     mi_tcd_tile_t *p_tile,
                                     mi_tcp_t *p_tcp,
-                                    mi_pi_iterator_t *p_pi,
+                                    const mi_pi_packet_t *p_pi,
                                     mi_BYTE *p_src,
                                     mi_UINT32 * p_data_read,
                                     mi_UINT32 p_max_length,
@@ -75,7 +75,7 @@ static mi_BOOL mi_t2_skip_packet( mi_t2_t* p_t2,
 static mi_BOOL mi_t2_read_packet_header(  mi_t2_t* p_t2,
                                             mi_tcd_tile_t *p_tile,
                                             mi_tcp_t *p_tcp,
-                                            mi_pi_iterator_t *p_pi,
+                                            const mi_pi_packet_t *p_pi,
                                             mi_BOOL * p_is_data_present,
                                             mi_BYTE *p_src_data,
                                             mi_UINT32 * p_data_read,
@@ -85,7 +85,7 @@ static mi_BOOL mi_t2_read_packet_header(  mi_t2_t* p_t2,
 
 static mi_BOOL mi_t2_read_packet_data(mi_t2_t* p_t2,
                                         mi_tcd_tile_t *p_tile,
-                                        mi_pi_iterator_t *p_pi,
+                                        const mi_pi_packet_t *p_pi,
                                         mi_BYTE *p_src_data,
                                         mi_UINT32 * p_data_read,
                                         mi_UINT32 p_max_length,
@@ -94,7 +94,7 @@ static mi_BOOL mi_t2_read_packet_data(mi_t2_t* p_t2,
 
 static mi_BOOL mi_t2_skip_packet_data(mi_t2_t* p_t2,
                                         mi_tcd_tile_t *p_tile,
-                                        mi_pi_iterator_t *p_pi,
+                                        const mi_pi_packet_t *p_pi,
                                         mi_UINT32 * p_data_read,
                                         mi_UINT32 p_max_length,
                                         mi_packet_info_t *pack_info,
@@ -105,11 +105,22 @@ static mi_BOOL mi_t2_skip_packet_data(mi_t2_t* p_t2,
 @param index
 @param cblksty
 @param first
+@param p_arena arena the segments of the code-block grow in
 */
 static mi_BOOL mi_t2_init_seg(    mi_tcd_cblk_dec_t* cblk,
                                     mi_UINT32 index,
                                     mi_UINT32 cblksty,
-                                    mi_UINT32 first);
+                                    mi_UINT32 first,
+                                    mi_arena_t* p_arena);
+
+/**
+Gets the schedule of the packets of a tile being decoded, created at the first call and kept by
+the coding parameters of the tile until the tile is decoded
+@param p_t2 T2 handle
+@param p_tile_no index of the tile
+@return the packet schedule, NULL if it cannot be created
+*/
+static mi_pi_schedule_t * mi_t2_get_decode_schedule(mi_t2_t *p_t2, mi_UINT32 p_tile_no);
 
 /*@}*/
 
@@ -119,10 +130,12 @@ static mi_BOOL mi_t2_init_seg(    mi_tcd_cblk_dec_t* cblk,
 
 /* #define RESTART 0x04 */
 static void mi_t2_putcommacode(mi_bio_t *bio, mi_INT32 n) {
-        while (--n >= 0) {
-                mi_bio_write(bio, 1, 1);
+        /* n 1's followed by a 0 */
+        while (n >= 31) {
+                mi_bio_write(bio, 0x7fffffffU, 31);
+                n -= 31;
         }
-        mi_bio_write(bio, 0, 1);
+        mi_bio_write(bio, ((1U << n) - 1U) << 1, (mi_UINT32)n + 1U);
 }
 
 static mi_UINT32 mi_t2_getcommacode(mi_bio_t *bio)
@@ -174,52 +187,54 @@ mi_BOOL mi_t2_encode_packets( mi_t2_t* p_t2,
                                 mi_UINT32 p_tp_num,
                                 mi_INT32 p_tp_pos,
                                 mi_UINT32 p_pino,
-                                J2K_T2_MODE p_t2_mode)
+                                J2K_T2_MODE p_t2_mode,
+                                mi_tcd_marker_info_t *p_marker_info)
 {
         mi_BYTE *l_current_data = p_dest;
         mi_UINT32 l_nb_bytes = 0;
         mi_UINT32 compno;
         mi_UINT32 poc;
-        mi_pi_iterator_t *l_pi = 00;
-        mi_pi_iterator_t *l_current_pi = 00;
+        mi_UINT32 i;
+        mi_pi_schedule_t *l_schedule = 00;
+        const mi_pi_packet_t *l_packet = 00;
         mi_image_t *l_image = p_t2->image;
         mi_cp_t *l_cp = p_t2->cp;
         mi_tcp_t *l_tcp = &l_cp->tcps[p_tile_no];
         mi_UINT32 pocno = (l_cp->rsiz == mi_PROFILE_CINEMA_4K)? 2: 1;
         mi_UINT32 l_max_comp = l_cp->m_specific_param.m_enc.m_max_comp_size > 0 ? l_image->numcomps : 1;
-        mi_UINT32 l_nb_pocs = l_tcp->numpocs + 1;
-
-        l_pi = mi_pi_initialise_encode(l_image, l_cp, p_tile_no, p_t2_mode);
-        if (!l_pi) {
-                return mi_FALSE;
-        }
 
         * p_data_written = 0;
 
         if (p_t2_mode == THRESH_CALC ){ /* Calculating threshold */
-                l_current_pi = l_pi;
+                /* the packets of the passes are the same for all the layers of the tile: they are listed
+                   once and kept by the t2 handle for the next passes */
+                if (p_t2->m_schedule && p_t2->m_schedule_tileno != p_tile_no) {
+                        mi_pi_destroy_schedule(p_t2->m_schedule);
+                        p_t2->m_schedule = 00;
+                }
+                if (! p_t2->m_schedule) {
+                        /* TODO MSD : check why this function cannot fail (cf. v1) */
+                        /* TODO ADE : add an error when the progression order is unknown */
+                        p_t2->m_schedule = mi_pi_create_encode_schedule(l_image, l_cp, p_tile_no, l_max_comp, 0, 0, p_tp_pos, p_t2_mode);
+                        if (! p_t2->m_schedule) {
+                                return mi_FALSE;
+                        }
+                        p_t2->m_schedule_tileno = p_tile_no;
+                }
+                l_schedule = p_t2->m_schedule;
 
                 for     (compno = 0; compno < l_max_comp; ++compno) {
                         mi_UINT32 l_comp_len = 0;
-                        l_current_pi = l_pi;
 
                         for (poc = 0; poc < pocno ; ++poc) {
-                                mi_UINT32 l_tp_num = compno;
-
-                                /* TODO MSD : check why this function cannot fail (cf. v1) */
-                                mi_pi_create_encode(l_pi, l_cp,p_tile_no,poc,l_tp_num,p_tp_pos,p_t2_mode);
+                                mi_UINT32 l_part = compno * pocno + poc;
 
-                                if (l_current_pi->poc.prg == mi_PROG_UNKNOWN) {
-                                    /* TODO ADE : add an error */
-                                    mi_pi_destroy(l_pi, l_nb_pocs);
-                                    return mi_FALSE;
-                                }
-                                while (mi_pi_next(l_current_pi)) {
-                                        if (l_current_pi->layno < p_maxlayers) {
+                                for (i = l_schedule->part_start[l_part]; i < l_schedule->part_start[l_part + 1]; ++i) {
+                                        l_packet = &l_schedule->packets[i];
+                                        if (l_packet->layno < p_maxlayers) {
                                                 l_nb_bytes = 0;
 
-                                                if (! mi_t2_encode_packet(p_tile_no,p_tile, l_tcp, l_current_pi, l_current_data, &l_nb_bytes, p_max_len, cstr_info)) {
-                                                        mi_pi_destroy(l_pi, l_nb_pocs);
+                                                if (! mi_t2_encode_packet(p_tile_no,p_tile, l_tcp, l_packet, l_current_data, &l_nb_bytes, p_max_len, cstr_info)) {
                                                         return mi_FALSE;
                                                 }
 
@@ -233,30 +248,26 @@ mi_BOOL mi_t2_encode_packets( mi_t2_t* p_t2,
 
                                 if (l_cp->m_specific_param.m_enc.m_max_comp_size) {
                                         if (l_comp_len > l_cp->m_specific_param.m_enc.m_max_comp_size) {
-                                                mi_pi_destroy(l_pi, l_nb_pocs);
                                                 return mi_FALSE;
                                         }
                                 }
-
-                                ++l_current_pi;
                         }
                 }
         }
         else {  /* t2_mode == FINAL_PASS  */
-                mi_pi_create_encode(l_pi, l_cp,p_tile_no,p_pino,p_tp_num,p_tp_pos,p_t2_mode);
-
-                l_current_pi = &l_pi[p_pino];
-                if (l_current_pi->poc.prg == mi_PROG_UNKNOWN) {
-                    /* TODO ADE : add an error */
-                    mi_pi_destroy(l_pi, l_nb_pocs);
-                    return mi_FALSE;
+                /* TODO ADE : add an error when the progression order is unknown */
+                l_schedule = mi_pi_create_encode_schedule(l_image, l_cp, p_tile_no, 0, p_pino, p_tp_num, p_tp_pos, p_t2_mode);
+                if (! l_schedule) {
+                        return mi_FALSE;
                 }
-                while (mi_pi_next(l_current_pi)) {
-                        if (l_current_pi->layno < p_maxlayers) {
+
+                for (i = 0; i < l_schedule->nb_packets; ++i) {
+                        l_packet = &l_schedule->packets[i];
+                        if (l_packet->layno < p_maxlayers) {
                                 l_nb_bytes=0;
 
-                                if (! mi_t2_encode_packet(p_tile_no,p_tile, l_tcp, l_current_pi, l_current_data, &l_nb_bytes, p_max_len, cstr_info)) {
-                                        mi_pi_destroy(l_pi, l_nb_pocs);
+                                if (! mi_t2_encode_packet(p_tile_no,p_tile, l_tcp, l_packet, l_current_data, &l_nb_bytes, p_max_len, cstr_info)) {
+                                        mi_pi_destroy_schedule(l_schedule);
                                         return mi_FALSE;
                                 }
 
@@ -265,6 +276,11 @@ mi_BOOL mi_t2_encode_packets( mi_t2_t* p_t2,
 
                                 * p_data_written += l_nb_bytes;
 
+                                if (p_marker_info && p_marker_info->need_PLT) {
+                                        p_marker_info->p_packet_size[p_marker_info->packet_count] = l_nb_bytes;
+                                        ++p_marker_info->packet_count;
+                                }
+
                                 /* INDEX >> */
                                 if(cstr_info) {
                                         if(cstr_info->index_write) {
@@ -286,9 +302,9 @@ mi_BOOL mi_t2_encode_packets( mi_t2_t* p_t2,
                                 ++p_tile->packno;
                         }
                 }
-        }
 
-        mi_pi_destroy(l_pi, l_nb_pocs);
+                mi_pi_destroy_schedule(l_schedule);
+        }
 
         return mi_TRUE;
 }
@@ -316,101 +332,186 @@ mi_BOOL mi_t2_decode_packets( mi_t2_t *p_t2,
                                 mi_event_mgr_t *p_manager)
 {
         mi_BYTE *l_current_data = p_src;
-        mi_pi_iterator_t *l_pi = 00;
+        mi_pi_schedule_t *l_schedule = 00;
+        const mi_pi_packet_t *l_packet = 00;
         mi_UINT32 pino;
+        mi_UINT32 i;
         mi_image_t *l_image = p_t2->image;
-        mi_cp_t *l_cp = p_t2->cp;
         mi_tcp_t *l_tcp = &(p_t2->cp->tcps[p_tile_no]);
         mi_UINT32 l_nb_bytes_read;
-        mi_UINT32 l_nb_pocs = l_tcp->numpocs + 1;
-        mi_pi_iterator_t *l_current_pi = 00;
         mi_packet_info_t *l_pack_info = 00;
         mi_image_comp_t* l_img_comp = 00;
+        mi_UINT32 l_packet_no = 0;
+        mi_UINT32 l_nb_left_out = 0;
 
-        mi_ARG_NOT_USED(p_cstr_index);
-
-
+        /* the packets not decoded among the first ones, whose lengths are known,
+           have been left out of the tile data when it was read */
+        if (p_cstr_index && p_cstr_index->tile_index && l_tcp->m_nb_packets_left_out) {
+                l_nb_left_out = p_cstr_index->tile_index[p_tile_no].nb_packet;
+        }
 
-        /* create a packet iterator */
-        l_pi = mi_pi_create_decode(l_image, l_cp, p_tile_no);
-        if (!l_pi) {
+        /* the packets of the tile, in the order of the progressions */
+        l_schedule = mi_t2_get_decode_schedule(p_t2, p_tile_no);
+        if (!l_schedule) {
+                /* TODO ADE : add an error */
                 return mi_FALSE;
         }
 
-
-        l_current_pi = l_pi;
-
-        for     (pino = 0; pino <= l_tcp->numpocs; ++pino) {
+        for     (pino = 0; pino < l_schedule->nb_parts; ++pino) {
 
                 /* if the resolution needed is too low, one dim of the tilec could be equal to zero
                  * and no packets are used to decode this resolution and
-                 * l_current_pi->resno is always >= p_tile->comps[l_current_pi->compno].minimum_num_resolutions
+                 * l_packet->resno is always >= p_tile->comps[l_packet->compno].minimum_num_resolutions
                  * and no l_img_comp->resno_decoded are computed
                  */
                 mi_BOOL* first_pass_failed = NULL;
-					
-                if (l_current_pi->poc.prg == mi_PROG_UNKNOWN) {
-                    /* TODO ADE : add an error */
-                    mi_pi_destroy(l_pi, l_nb_pocs);
-                    return mi_FALSE;
-                }
-					
+
                 first_pass_failed = (mi_BOOL*)mi_malloc(l_image->numcomps * sizeof(mi_BOOL));
                 if (!first_pass_failed)
                 {
-                    mi_pi_destroy(l_pi,l_nb_pocs);
                     return mi_FALSE;
                 }
                 memset(first_pass_failed, mi_TRUE, l_image->numcomps * sizeof(mi_BOOL));
 
-                while (mi_pi_next(l_current_pi)) {
-                  JAS_FPRINTF( stderr, "packet offset=00000166 prg=%d cmptno=%02d rlvlno=%02d prcno=%03d lyrno=%02d\n\n",
-                    l_current_pi->poc.prg1, l_current_pi->compno, l_current_pi->resno, l_current_pi->precno, l_current_pi->layno );
+                for (i = l_schedule->part_start[pino]; i < l_schedule->part_start[pino + 1]; ++i) {
+                        l_packet = &l_schedule->packets[i];
+                        JAS_FPRINTF( stderr, "packet offset=00000166 cmptno=%02d rlvlno=%02d prcno=%03d lyrno=%02d\n\n",
+                          l_packet->compno, l_packet->resno, l_packet->precno, l_packet->layno );
 
-                        if (l_tcp->num_layers_to_decode > l_current_pi->layno
-                                        && l_current_pi->resno < p_tile->comps[l_current_pi->compno].minimum_num_resolutions) {
+                        if (l_tcp->num_layers_to_decode > l_packet->layno
+                                        && l_packet->resno < p_tile->comps[l_packet->compno].minimum_num_resolutions) {
                                 l_nb_bytes_read = 0;
 
-                                first_pass_failed[l_current_pi->compno] = mi_FALSE;
+                                first_pass_failed[l_packet->compno] = mi_FALSE;
 
-                                if (! mi_t2_decode_packet(p_t2,p_tile,l_tcp,l_current_pi,l_current_data,&l_nb_bytes_read,p_max_len,l_pack_info, p_manager)) {
-                                        mi_pi_destroy(l_pi,l_nb_pocs);
+                                if (! mi_t2_decode_packet(p_t2,p_tile,l_tcp,l_packet,l_current_data,&l_nb_bytes_read,p_max_len,l_pack_info, p_manager)) {
                                         mi_free(first_pass_failed);
                                         return mi_FALSE;
                                 }
 
-                                l_img_comp = &(l_image->comps[l_current_pi->compno]);
-                                l_img_comp->resno_decoded = mi_uint_max(l_current_pi->resno, l_img_comp->resno_decoded);
+                                l_img_comp = &(l_image->comps[l_packet->compno]);
+                                l_img_comp->resno_decoded = mi_uint_max(l_packet->resno, l_img_comp->resno_decoded);
+                        }
+                        else if (l_packet_no < l_nb_left_out) {
+                                l_nb_bytes_read = 0;
                         }
                         else {
                                 l_nb_bytes_read = 0;
-                                if (! mi_t2_skip_packet(p_t2,p_tile,l_tcp,l_current_pi,l_current_data,&l_nb_bytes_read,p_max_len,l_pack_info, p_manager)) {
-                                        mi_pi_destroy(l_pi,l_nb_pocs);
+                                if (! mi_t2_skip_packet(p_t2,p_tile,l_tcp,l_packet,l_current_data,&l_nb_bytes_read,p_max_len,l_pack_info, p_manager)) {
                                         mi_free(first_pass_failed);
                                         return mi_FALSE;
                                 }
                         }
 
-                        if (first_pass_failed[l_current_pi->compno]) {
-                                l_img_comp = &(l_image->comps[l_current_pi->compno]);
+                        if (first_pass_failed[l_packet->compno]) {
+                                l_img_comp = &(l_image->comps[l_packet->compno]);
                                 if (l_img_comp->resno_decoded == 0)
-                                        l_img_comp->resno_decoded = p_tile->comps[l_current_pi->compno].minimum_num_resolutions - 1;
+                                        l_img_comp->resno_decoded = p_tile->comps[l_packet->compno].minimum_num_resolutions - 1;
                         }
 
                         l_current_data += l_nb_bytes_read;
                         p_max_len -= l_nb_bytes_read;
+                        ++l_packet_no;
                 }
-                ++l_current_pi;
 
                 mi_free(first_pass_failed);
         }
 
-        /* don't forget to release pi */
-        mi_pi_destroy(l_pi,l_nb_pocs);
         *p_data_read = (mi_UINT32)(l_current_data - p_src);
         return mi_TRUE;
 }
 
+mi_BOOL mi_t2_get_needed_packets( mi_t2_t *p_t2,
+                                        mi_UINT32 p_tile_no,
+                                        mi_UINT32 p_first_packet,
+                                        mi_UINT32 p_nb_packets,
+                                        mi_BYTE *p_needed)
+{
+        mi_pi_schedule_t *l_schedule = 00;
+        const mi_pi_packet_t *l_packet = 00;
+        mi_cp_t *l_cp = p_t2->cp;
+        mi_tcp_t *l_tcp = &(p_t2->cp->tcps[p_tile_no]);
+        mi_UINT32 l_reduce = l_cp->m_specific_param.m_dec.m_reduce;
+        mi_UINT32 l_packet_no;
+        mi_UINT32 l_end = p_first_packet + p_nb_packets;
+
+        l_schedule = mi_t2_get_decode_schedule(p_t2, p_tile_no);
+        if (!l_schedule || l_schedule->nb_packets < l_end) {
+                return mi_FALSE;
+        }
+
+        for (l_packet_no = p_first_packet; l_packet_no < l_end; ++l_packet_no) {
+                /* same test as in mi_t2_decode_packets, with the minimum_num_resolutions of mi_tcd_init_tile */
+                mi_UINT32 l_numres;
+                mi_UINT32 l_min_res;
+                l_packet = &l_schedule->packets[l_packet_no];
+                l_numres = l_tcp->tccps[l_packet->compno].numresolutions;
+                l_min_res = (l_numres < l_reduce) ? 1 : l_numres - l_reduce;
+                p_needed[l_packet_no - p_first_packet] = (mi_BYTE)
+                        (l_tcp->num_layers_to_decode > l_packet->layno && l_packet->resno < l_min_res);
+        }
+
+        return mi_TRUE;
+}
+
+mi_BOOL mi_t2_get_packet_lengths( mi_t2_t *p_t2,
+                                    mi_UINT32 p_tile_no,
+                                    mi_tcd_tile_t *p_tile,
+                                    mi_BYTE *p_src,
+                                    mi_UINT32 p_max_len,
+                                    mi_UINT32 **p_lengths,
+                                    mi_UINT32 *p_max_nb_lengths,
+                                    mi_event_mgr_t *p_manager)
+{
+        mi_pi_schedule_t *l_schedule = 00;
+        mi_tcp_t *l_tcp = &(p_t2->cp->tcps[p_tile_no]);
+        mi_UINT32 l_nb_bytes_read;
+        mi_UINT32 l_packet_no;
+
+        if (l_tcp->m_nb_packets_left_out) {
+                mi_event_msg(p_manager, EVT_ERROR, "Packets of tile %d were not read\n", p_tile_no);
+                return mi_FALSE;
+        }
+
+        l_schedule = mi_t2_get_decode_schedule(p_t2, p_tile_no);
+        if (!l_schedule) {
+                return mi_FALSE;
+        }
+
+        if (l_schedule->nb_packets > *p_max_nb_lengths) {
+                mi_UINT32 *l_new_lengths = (mi_UINT32*)mi_realloc(*p_lengths, l_schedule->nb_packets * sizeof(mi_UINT32));
+                if (!l_new_lengths) {
+                        mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to list the packets of tile %d\n", p_tile_no);
+                        return mi_FALSE;
+                }
+                *p_lengths = l_new_lengths;
+                *p_max_nb_lengths = l_schedule->nb_packets;
+        }
+
+        /* the headers are read as when the packets are skipped, which gives the length of their data */
+        for (l_packet_no = 0; l_packet_no < l_schedule->nb_packets; ++l_packet_no) {
+                l_nb_bytes_read = 0;
+                if (! mi_t2_skip_packet(p_t2,p_tile,l_tcp,&l_schedule->packets[l_packet_no],p_src,&l_nb_bytes_read,p_max_len,00,p_manager)) {
+                        return mi_FALSE;
+                }
+                (*p_lengths)[l_packet_no] = l_nb_bytes_read;
+                p_src += l_nb_bytes_read;
+                p_max_len -= l_nb_bytes_read;
+        }
+
+        return mi_TRUE;
+}
+
+static mi_pi_schedule_t * mi_t2_get_decode_schedule(mi_t2_t *p_t2, mi_UINT32 p_tile_no)
+{
+        mi_tcp_t *l_tcp = &(p_t2->cp->tcps[p_tile_no]);
+
+        if (! l_tcp->m_packet_schedule) {
+                l_tcp->m_packet_schedule = mi_pi_create_decode_schedule(p_t2->image, p_t2->cp, p_tile_no);
+        }
+        return l_tcp->m_packet_schedule;
+}
+
 /* ----------------------------------------------------------------------- */
 
 /**
@@ -436,6 +537,7 @@ mi_t2_t* mi_t2_create(mi_image_t *p_image, mi_cp_t *p_cp)
 
 void mi_t2_destroy(mi_t2_t *t2) {
         if(t2) {
+                mi_pi_destroy_schedule(t2->m_schedule);
                 mi_free(t2);
         }
 }
@@ -443,7 +545,7 @@ void mi_t2_destroy(mi_t2_t *t2) {
 static mi_BOOL mi_t2_decode_packet(  mi_t2_t* p_t2,
                                 mi_tcd_tile_t *p_tile,
                                 mi_tcp_t *p_tcp,
-                                mi_pi_iterator_t *p_pi,
+                                const mi_pi_packet_t *p_pi,
                                 mi_BYTE *p_src,
                                 mi_UINT32 * p_data_read,
                                 mi_UINT32 p_max_length,
@@ -483,7 +585,7 @@ static mi_BOOL mi_t2_decode_packet(  mi_t2_t* p_t2,
 static mi_BOOL mi_t2_encode_packet(  mi_UINT32 tileno,
                                 mi_tcd_tile_t * tile,
                                 mi_tcp_t * tcp,
-                                mi_pi_iterator_t *pi,
+                                const mi_pi_packet_t *pi,
                                 mi_BYTE *dest,
                                 mi_UINT32 * p_data_written,
                                 mi_UINT32 length,
@@ -508,6 +610,9 @@ static mi_BOOL mi_t2_encode_packet(  mi_UINT32 tileno,
 
         /* <SOP 0xff91> */
         if (tcp->csty & J2K_CP_CSTY_SOP) {//ĬûSOP
+                if (length < 6) {
+                        return mi_FALSE;
+                }
                 c[0] = 255;
                 c[1] = 145;
                 c[2] = 0;
@@ -649,6 +754,9 @@ static mi_BOOL mi_t2_encode_packet(  mi_UINT32 tileno,
 
         /* <EPH 0xff92> */
         if (tcp->csty & J2K_CP_CSTY_EPH) {
+                if (length < 2) {
+                        return mi_FALSE;
+                }
                 c[0] = 255;
                 c[1] = 146;
                 c += 2;
@@ -714,7 +822,7 @@ static mi_BOOL mi_t2_encode_packet(  mi_UINT32 tileno,
 static mi_BOOL mi_t2_skip_packet( mi_t2_t* p_t2,
                                     mi_tcd_tile_t *p_tile,
                                     mi_tcp_t *p_tcp,
-                                    mi_pi_iterator_t *p_pi,
+                                    const mi_pi_packet_t *p_pi,
                                     mi_BYTE *p_src,
                                     mi_UINT32 * p_data_read,
                                     mi_UINT32 p_max_length,
@@ -754,7 +862,7 @@ static mi_BOOL mi_t2_skip_packet( mi_t2_t* p_t2,
 static mi_BOOL mi_t2_read_packet_header( mi_t2_t* p_t2,
                                     mi_tcd_tile_t *p_tile,
                                     mi_tcp_t *p_tcp,
-                                    mi_pi_iterator_t *p_pi,
+                                    const mi_pi_packet_t *p_pi,
                                     mi_BOOL * p_is_data_present,
                                     mi_BYTE *p_src_data,
                                     mi_UINT32 * p_data_read,
@@ -945,7 +1053,7 @@ static mi_BOOL mi_t2_read_packet_header( mi_t2_t* p_t2,
                         l_segno = 0;
 
                         if (!l_cblk->numsegs) {
-                                if (! mi_t2_init_seg(l_cblk, l_segno, p_tcp->tccps[p_pi->compno].cblksty, 1)) {
+                                if (! mi_t2_init_seg(l_cblk, l_segno, p_tcp->tccps[p_pi->compno].cblksty, 1, p_t2->m_arena)) {
                                         mi_bio_destroy(l_bio);
                                         return mi_FALSE;
                                 }
@@ -954,7 +1062,7 @@ static mi_BOOL mi_t2_read_packet_header( mi_t2_t* p_t2,
                                 l_segno = l_cblk->numsegs - 1;
                                 if (l_cblk->segs[l_segno].numpasses == l_cblk->segs[l_segno].maxpasses) {
                                         ++l_segno;
-                                        if (! mi_t2_init_seg(l_cblk, l_segno, p_tcp->tccps[p_pi->compno].cblksty, 0)) {
+                                        if (! mi_t2_init_seg(l_cblk, l_segno, p_tcp->tccps[p_pi->compno].cblksty, 0, p_t2->m_arena)) {
                                                 mi_bio_destroy(l_bio);
                                                 return mi_FALSE;
                                         }
@@ -971,7 +1079,7 @@ static mi_BOOL mi_t2_read_packet_header( mi_t2_t* p_t2,
                                 if (n > 0) {
                                         ++l_segno;
 
-                                        if (! mi_t2_init_seg(l_cblk, l_segno, p_tcp->tccps[p_pi->compno].cblksty, 0)) {
+                                        if (! mi_t2_init_seg(l_cblk, l_segno, p_tcp->tccps[p_pi->compno].cblksty, 0, p_t2->m_arena)) {
                                                 mi_bio_destroy(l_bio);
                                                 return mi_FALSE;
                                         }
@@ -1025,7 +1133,7 @@ static mi_BOOL mi_t2_read_packet_header( mi_t2_t* p_t2,
 
 static mi_BOOL mi_t2_read_packet_data(   mi_t2_t* p_t2,
                                     mi_tcd_tile_t *p_tile,
-                                    mi_pi_iterator_t *p_pi,
+                                    const mi_pi_packet_t *p_pi,
                                     mi_BYTE *p_src_data,
                                     mi_UINT32 * p_data_read,
                                     mi_UINT32 p_max_length,
@@ -1091,16 +1199,20 @@ static mi_BOOL mi_t2_read_packet_data(   mi_t2_t* p_t2,
                                         return mi_FALSE;
                                 }
                                 /* Check if the cblk->data have allocated enough memory */
+                                /* (plus the end marker written by the MQ decoder) */
                                 if ((l_cblk->data_current_size + l_seg->newlen) > l_cblk->data_max_size) {
-                                    mi_BYTE* new_cblk_data = (mi_BYTE*) mi_realloc(l_cblk->data, l_cblk->data_current_size + l_seg->newlen);
+                                    /* the former data stays in the arena until the next tile: at least double the room */
+                                    mi_UINT32 l_max_size = mi_uint_max(l_cblk->data_current_size + l_seg->newlen,
+                                                                        mi_uint_adds(l_cblk->data_max_size, l_cblk->data_max_size));
+                                    mi_BYTE* new_cblk_data = (mi_BYTE*) mi_arena_alloc(p_t2->m_arena, (mi_SIZE_T)l_max_size + MQC_SENTINEL_SIZE);
                                     if(! new_cblk_data) {
-                                        mi_free(l_cblk->data);
-                                        l_cblk->data = NULL;
-                                        l_cblk->data_max_size = 0;
                                         /* mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to realloc code block cata!\n"); */
                                         return mi_FALSE;
                                     }
-                                    l_cblk->data_max_size = l_cblk->data_current_size + l_seg->newlen;
+                                    if (l_cblk->data_current_size) {
+                                        memcpy(new_cblk_data, l_cblk->data, l_cblk->data_current_size);
+                                    }
+                                    l_cblk->data_max_size = l_max_size;
                                     l_cblk->data = new_cblk_data;
                                 }
                                
@@ -1140,7 +1252,7 @@ static mi_BOOL mi_t2_read_packet_data(   mi_t2_t* p_t2,
 
 static mi_BOOL mi_t2_skip_packet_data(   mi_t2_t* p_t2,
                                     mi_tcd_tile_t *p_tile,
-                                    mi_pi_iterator_t *p_pi,
+                                    const mi_pi_packet_t *p_pi,
                                     mi_UINT32 * p_data_read,
                                     mi_UINT32 p_max_length,
                                     mi_packet_info_t *pack_info,
@@ -1224,24 +1336,25 @@ static mi_BOOL mi_t2_skip_packet_data(   mi_t2_t* p_t2,
 static mi_BOOL mi_t2_init_seg(   mi_tcd_cblk_dec_t* cblk,
                             mi_UINT32 index, 
                             mi_UINT32 cblksty, 
-                            mi_UINT32 first)
+                            mi_UINT32 first,
+                            mi_arena_t* p_arena)
 {
         mi_tcd_seg_t* seg = 00;
         mi_UINT32 l_nb_segs = index + 1;
 
         if (l_nb_segs > cblk->m_current_max_segs) {
-                mi_tcd_seg_t* new_segs;
-                cblk->m_current_max_segs += mi_J2K_DEFAULT_NB_SEGS;
-
-                new_segs = (mi_tcd_seg_t*) mi_realloc(cblk->segs, cblk->m_current_max_segs * sizeof(mi_tcd_seg_t));
+                /* the former segments stay in the arena until the next tile */
+                mi_UINT32 l_max_segs = mi_uint_max(l_nb_segs, 2 * cblk->m_current_max_segs);
+                mi_tcd_seg_t* new_segs = (mi_tcd_seg_t*) mi_arena_alloc(p_arena, l_max_segs * sizeof(mi_tcd_seg_t));
                 if(! new_segs) {
-                        mi_free(cblk->segs);
-                        cblk->segs = NULL;
-                        cblk->m_current_max_segs = 0;
                         /* mi_event_msg(p_manager, EVT_ERROR, "Not enough memory to initialize segment %d\n", l_nb_segs); */
                         return mi_FALSE;
                 }
+                if (cblk->m_current_max_segs) {
+                        memcpy(new_segs, cblk->segs, cblk->m_current_max_segs * sizeof(mi_tcd_seg_t));
+                }
                 cblk->segs = new_segs;
+                cblk->m_current_max_segs = l_max_segs;
         }
 
         seg = &cblk->segs[index];
@@ -19,6 +19,12 @@ typedef struct mi_t2 {
 	mi_image_t *image;
 	/** pointer to the image coding parameters */
 	mi_cp_t *cp;
+	/** Encoding: packets of the rate allocation passes (THRESH_CALC), kept for the passes of the next layers */
+	struct mi_pi_schedule *m_schedule;
+	/** Encoding: tile of m_schedule */
+	mi_UINT32 m_schedule_tileno;
+	/** Decoding: arena the data and the segments of the code-blocks grow in (the one of the tile decoder) */
+	mi_arena_t *m_arena;
 } mi_t2_t;
 
 /** @name Exported functions */
@@ -39,6 +45,7 @@ Encode the packets of a tile to a destination buffer
 @param tppos            The position of the tile part flag in the progression order
 @param pino             FIXME DOC
 @param t2_mode          If == 0 In Threshold calculation ,If == 1 Final pass
+@param p_marker_info    Receives the lengths of the packets written in the final pass, if not null
 */
 mi_BOOL mi_t2_encode_packets(	mi_t2_t* t2,
 								mi_UINT32 tileno,
@@ -51,7 +58,8 @@ mi_BOOL mi_t2_encode_packets(	mi_t2_t* t2,
 								mi_UINT32 tpnum,
 								mi_INT32 tppos,
 								mi_UINT32 pino,
-								J2K_T2_MODE t2_mode);
+								J2K_T2_MODE t2_mode,
+								mi_tcd_marker_info_t *p_marker_info);
 
 /**
 Decode the packets of a tile from a source buffer
@@ -74,6 +82,44 @@ mi_BOOL mi_t2_decode_packets(	mi_t2_t *t2,
                                 mi_codestream_index_t *cstr_info,
                                 mi_event_mgr_t *p_manager);
 
+/**
+Tell which packets of a range of packets of a tile are decoded (the others are above the number
+of layers or the number of resolutions to decode)
+@param t2           T2 handle
+@param tileno       number of the tile
+@param first_packet index of the first packet of the range, in the order of the codestream
+@param nb_packets   number of packets of the range
+@param needed       receives 1 for each packet of the range which is decoded, 0 for the others
+@return false if the tile has less packets than the range asks for
+*/
+mi_BOOL mi_t2_get_needed_packets(	mi_t2_t *t2,
+                                        mi_UINT32 tileno,
+                                        mi_UINT32 first_packet,
+                                        mi_UINT32 nb_packets,
+                                        mi_BYTE *needed);
+
+/**
+Read the headers of all the packets of a tile without decoding their data, giving the length
+of each packet (header and data) in the order of the packet schedule of the tile
+@param t2             T2 handle
+@param tileno         number of the tile
+@param tile           tile the packets belong to
+@param src            source buffer
+@param len            length of the source buffer
+@param lengths        receives the packet lengths, reallocated if it holds less than the number of packets
+@param max_nb_lengths number of packet lengths *lengths can hold
+@param p_manager      the user event manager
+@return false if a packet header cannot be read
+*/
+mi_BOOL mi_t2_get_packet_lengths(	mi_t2_t *t2,
+                                        mi_UINT32 tileno,
+                                        mi_tcd_tile_t *tile,
+                                        mi_BYTE *src,
+                                        mi_UINT32 len,
+                                        mi_UINT32 **lengths,
+                                        mi_UINT32 *max_nb_lengths,
+                                        mi_event_mgr_t *p_manager);
+
 /**
  * Creates a Tier 2 handle
  *
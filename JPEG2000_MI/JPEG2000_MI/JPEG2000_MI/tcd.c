@@ -11,27 +11,17 @@ static INLINE mi_BOOL mi_tcd_init_tile(mi_tcd_t *p_tcd, mi_UINT32 p_tile_no, mi_
 /**
 * Allocates memory for a decoding code block.
 */
-static mi_BOOL mi_tcd_code_block_dec_allocate (mi_tcd_cblk_dec_t * p_code_block);
-
-/**
- * Deallocates the decoding data of the given precinct.
- */
-static void mi_tcd_code_block_dec_deallocate (mi_tcd_precinct_t * p_precinct);
+static mi_BOOL mi_tcd_code_block_dec_allocate (mi_arena_t * p_arena, mi_tcd_cblk_dec_t * p_code_block);
 
 /**
  * Allocates memory for an encoding code block (but not data).
  */
-static mi_BOOL mi_tcd_code_block_enc_allocate (mi_tcd_cblk_enc_t * p_code_block);
+static mi_BOOL mi_tcd_code_block_enc_allocate (mi_arena_t * p_arena, mi_tcd_cblk_enc_t * p_code_block);
 
 /**
  * Allocates data for an encoding code block
  */
-static mi_BOOL mi_tcd_code_block_enc_allocate_data (mi_tcd_cblk_enc_t * p_code_block);
-
-/**
- * Deallocates the encoding data of the given precinct.
- */
-static void mi_tcd_code_block_enc_deallocate (mi_tcd_precinct_t * p_precinct);
+static mi_BOOL mi_tcd_code_block_enc_allocate_data (mi_arena_t * p_arena, mi_tcd_cblk_enc_t * p_code_block);
 
 
 /**
@@ -48,18 +38,103 @@ static mi_BOOL mi_tcd_t2_decode ( mi_tcd_t *p_tcd,
                                     mi_codestream_index_t *p_cstr_index,
                                     mi_event_mgr_t *p_manager);
 
+/**
+Compute the windows of the resolutions and subbands of the tile components which
+the decoded area depends on. From the decoded resolution down to the lowest one,
+the window of a resolution is widened by the support of the inverse wavelet
+filter, which gives the coefficients read in its subbands and in the resolution
+below it.
+@param p_tcd         TCD handle
+*/
+static void mi_tcd_init_decode_windows (mi_tcd_t *p_tcd);
+
+/**
+Range of the low-pass and high-pass coefficients read by an inverse 1-D wavelet
+transform of n samples to compute the samples [x0, x1) exactly.
+@param x0      first sample needed
+@param x1      sample after the last one needed
+@param n       number of samples
+@param cas     0 if the first sample is low-pass, 1 otherwise
+@param margin  number of samples of the filter support on each side
+@param l0      first low-pass coefficient read
+@param l1      low-pass coefficient after the last one read
+@param h0      first high-pass coefficient read
+@param h1      high-pass coefficient after the last one read
+*/
+static void mi_tcd_get_decode_window_1d (mi_UINT32 x0, mi_UINT32 x1, mi_UINT32 n, mi_UINT32 cas, mi_UINT32 margin,
+                                           mi_UINT32 * l0, mi_UINT32 * l1, mi_UINT32 * h0, mi_UINT32 * h1);
+
 static mi_BOOL mi_tcd_t1_decode (mi_tcd_t *p_tcd);
 
 static mi_BOOL mi_tcd_dwt_decode (mi_tcd_t *p_tcd);
 
-static mi_BOOL mi_tcd_mct_decode (mi_tcd_t *p_tcd, mi_event_mgr_t *p_manager);
+/**
+Apply the inverse MCT. When possible, the DC level shift of the three transformed
+components is done in the same pass (see mi_tcd_mct_dc_level_shift_decode).
+@param p_tcd         TCD handle
+@param p_manager     the event manager
+@param p_dc_shifted  set to mi_TRUE if the components 0 to 2 got their DC level shift
+*/
+static mi_BOOL mi_tcd_mct_decode (mi_tcd_t *p_tcd, mi_event_mgr_t *p_manager, mi_BOOL * p_dc_shifted);
+
+/**
+Tells if the inverse MCT and the DC level shift of the components 0 to 2 can be
+done in one pass: the three components use the same wavelet and have the same
+decoded region.
+*/
+static mi_BOOL mi_tcd_mct_dc_level_shift_fusable (mi_tcd_t *p_tcd);
+
+/**
+Inverse MCT, DC level shift and clamping of the components 0 to 2, row by row over
+the decoded region.
+*/
+static void mi_tcd_mct_dc_level_shift_decode (mi_tcd_t *p_tcd);
+
+/**
+Apply the DC level shift and the clamping to the decoded components.
+@param p_tcd         TCD handle
+@param p_first_comp  first component to shift, the previous ones are already shifted
+*/
+static mi_BOOL mi_tcd_dc_level_shift_decode (mi_tcd_t *p_tcd, mi_UINT32 p_first_comp);
+
+/**
+Range of the sample values of a component.
+*/
+static void mi_tcd_get_sample_range (const mi_image_comp_t * p_img_comp, mi_INT32 * p_min, mi_INT32 * p_max);
 
-static mi_BOOL mi_tcd_dc_level_shift_decode (mi_tcd_t *p_tcd);
+/**
+Write a row of decoded samples of a component into the buffer of the caller
+(see mi_tcd_set_output), to each channel mapped to the component.
+@param p_tcd     TCD handle
+@param p_compno  the component
+@param p_src     the samples, after the DC level shift and the clamping
+@param p_x       abscissa of the first sample in the decoded resolution
+@param p_y       ordinate of the row in the decoded resolution
+@param p_width   number of samples
+*/
+static void mi_tcd_write_output_row (mi_tcd_t *p_tcd, mi_UINT32 p_compno, const mi_INT32 * p_src,
+                                       mi_UINT32 p_x, mi_UINT32 p_y, mi_UINT32 p_width);
 
+/**
+Tells if the DC level shift of the components 0 to 2 can be done by the forward
+MCT: reversible or irreversible transform of three components of the same size
+using the same wavelet.
+*/
+static mi_BOOL mi_tcd_mct_encode_fuses_dc_level_shift ( mi_tcd_t *p_tcd );
 
-static mi_BOOL mi_tcd_dc_level_shift_encode ( mi_tcd_t *p_tcd );
+/**
+Apply the DC level shift to the components to encode.
+@param p_tcd         TCD handle
+@param p_first_comp  first component to shift, the previous ones are shifted by the MCT
+*/
+static mi_BOOL mi_tcd_dc_level_shift_encode ( mi_tcd_t *p_tcd, mi_UINT32 p_first_comp );
 
-static mi_BOOL mi_tcd_mct_encode ( mi_tcd_t *p_tcd );
+/**
+Apply the forward MCT.
+@param p_tcd         TCD handle
+@param p_dc_shift    if mi_TRUE, the MCT also does the DC level shift of the components 0 to 2
+*/
+static mi_BOOL mi_tcd_mct_encode ( mi_tcd_t *p_tcd, mi_BOOL p_dc_shift );
 
 static mi_BOOL mi_tcd_dwt_encode ( mi_tcd_t *p_tcd );
 
@@ -69,13 +144,139 @@ static mi_BOOL mi_tcd_t2_encode (     mi_tcd_t *p_tcd,
                                                                     mi_BYTE * p_dest_data,
                                                                     mi_UINT32 * p_data_written,
                                                                     mi_UINT32 p_max_dest_size,
-                                                                    mi_codestream_info_t *p_cstr_info );
+                                                                    mi_codestream_info_t *p_cstr_info,
+                                                                    mi_tcd_marker_info_t *p_marker_info );
 
 static mi_BOOL mi_tcd_rate_allocate_encode(   mi_tcd_t *p_tcd,
                                                                                         mi_BYTE * p_dest_data,
                                                                                         mi_UINT32 p_max_dest_size,
                                                                                         mi_codestream_info_t *p_cstr_info );
 
+/**
+Segment of the convex hull of the rate-distortion points of a code-block
+*/
+typedef struct mi_tcd_rd_seg {
+        /** slope of the segment (distortion decrease per byte) */
+        mi_FLOAT64 slope;
+        /** distortion decrease at the end of the segment */
+        mi_FLOAT64 disto;
+        /** bytes of the segment (bytes up to its end while the hull is built) */
+        mi_UINT32 rate;
+} mi_tcd_rd_seg_t;
+
+/**
+Rate-distortion curve of a tile: the hull segments of all its code-blocks merged
+by decreasing slope. For a threshold equal to slopes[k], mi_tcd_makelayer keeps
+rates[k] bytes of code-block data, made of nb_segs[k] hull segments.
+*/
+typedef struct mi_tcd_rd_curve {
+        /** number of distinct slopes */
+        mi_UINT32 nb_slopes;
+        /** distinct slopes of the hull segments, decreasing */
+        mi_FLOAT64 * slopes;
+        /** code-block data kept at each slope */
+        mi_UINT32 * rates;
+        /** number of hull segments kept at each slope */
+        mi_UINT32 * nb_segs;
+} mi_tcd_rd_curve_t;
+
+/**
+Compute the convex hull of the rate-distortion points of the passes of a code-block.
+@param p_cblk  the code-block
+@param p_segs  receives the hull segments, p_cblk->totalpasses at most
+@return the number of hull segments
+*/
+static mi_UINT32 mi_tcd_rd_hull(const mi_tcd_cblk_enc_t * p_cblk, mi_tcd_rd_seg_t * p_segs);
+
+/**
+Order of the hull segments by decreasing slope (qsort callback).
+*/
+static int mi_tcd_rd_seg_compare(const void * p_a, const void * p_b);
+
+/**
+Build the rate-distortion curve of the current tile.
+@param tcd          TCD handle
+@param p_nb_passes  number of coding passes of the tile
+@param p_curve      the curve to fill
+@return mi_FALSE if there is not enough memory
+*/
+static mi_BOOL mi_tcd_rd_curve_create(mi_tcd_t *tcd, mi_UINT32 p_nb_passes, mi_tcd_rd_curve_t * p_curve);
+
+/**
+Free the arrays of a rate-distortion curve.
+*/
+static void mi_tcd_rd_curve_destroy(mi_tcd_rd_curve_t * p_curve);
+
+/**
+Find the smallest slope of the curve (the largest index) whose layer satisfies the
+rate or quality constraint. For a rate, the index is estimated from the curve and the
+mean packet header cost per hull segment; each real T2 encode that fits gives the exact
+length at its index, from which the next index is estimated. A check which fails is
+followed by steps doubling down, and the last interval is bisected.
+@param tcd            TCD handle
+@param t2             T2 handle used for the checks
+@param p_curve        the rate-distortion curve of the tile
+@param layno          the layer to allocate
+@param p_first        the slope of the previous layer, nothing smaller is searched
+@param dest           buffer for the T2 checks
+@param p_data_written bytes written by the T2 checks
+@param maxlen         maximum length of the layers 0 to layno
+@param cstr_info      codestream information
+@param p_disto_done   distortion decrease of the layers 0 to layno - 1 (fixed_quality)
+@param p_distotarget  target distortion decrease (fixed_quality)
+@param p_hdr_cost     mean packet header cost per hull segment, updated by the checks
+@param p_found        the index found
+@return mi_FALSE if no slope satisfies the constraint
+*/
+static mi_BOOL mi_tcd_rd_search(mi_tcd_t *tcd,
+                                 mi_t2_t *t2,
+                                 const mi_tcd_rd_curve_t * p_curve,
+                                 mi_UINT32 layno,
+                                 mi_UINT32 p_first,
+                                 mi_BYTE *dest,
+                                 mi_UINT32 * p_data_written,
+                                 mi_UINT32 maxlen,
+                                 mi_codestream_info_t *cstr_info,
+                                 mi_FLOAT64 p_disto_done,
+                                 mi_FLOAT64 p_distotarget,
+                                 mi_FLOAT64 * p_hdr_cost,
+                                 mi_UINT32 * p_found);
+
+/**
+Estimate the last index of the curve whose layer fits in maxlen bytes.
+@param p_curve    the rate-distortion curve of the tile
+@param p_from     first index to consider
+@param p_to       last index to consider
+@param p_anchor   index whose length is known
+@param p_length   length at p_anchor (the code-block data only if p_anchor is not an index)
+@param maxlen     maximum length
+@param p_hdr_cost mean packet header cost per hull segment
+@return the index, p_from - 1 if none fits
+*/
+static mi_INT64 mi_tcd_rd_estimate(const mi_tcd_rd_curve_t * p_curve,
+                                    mi_INT64 p_from,
+                                    mi_INT64 p_to,
+                                    mi_INT64 p_anchor,
+                                    mi_FLOAT64 p_length,
+                                    mi_UINT32 maxlen,
+                                    mi_FLOAT64 p_hdr_cost);
+
+/**
+Form a layer at the threshold slopes[k] and tell if it satisfies the rate or quality constraint.
+The parameters are the ones of mi_tcd_rd_search.
+*/
+static mi_BOOL mi_tcd_rd_check(mi_tcd_t *tcd,
+                                mi_t2_t *t2,
+                                const mi_tcd_rd_curve_t * p_curve,
+                                mi_UINT32 layno,
+                                mi_UINT32 k,
+                                mi_BYTE *dest,
+                                mi_UINT32 * p_data_written,
+                                mi_UINT32 maxlen,
+                                mi_codestream_info_t *cstr_info,
+                                mi_FLOAT64 p_disto_done,
+                                mi_FLOAT64 p_distotarget);
+
 /* ----------------------------------------------------------------------- */
 
 /**
@@ -92,6 +293,7 @@ mi_tcd_t* mi_tcd_create(mi_BOOL p_is_decoder)
         }
 
         l_tcd->m_is_decoder = p_is_decoder ? 1 : 0;
+        mi_arena_init(&l_tcd->m_arena, mi_TCD_ARENA_BLOCK_SIZE);
 
         l_tcd->tcd_image = (mi_tcd_image_t*)mi_calloc(1,sizeof(mi_tcd_image_t));
         if (!l_tcd->tcd_image) {
@@ -292,6 +494,268 @@ void mi_tcd_makelayer_fixed(mi_tcd_t *tcd, mi_UINT32 layno, mi_UINT32 final) {
         }
 }
 
+static mi_UINT32 mi_tcd_rd_hull(const mi_tcd_cblk_enc_t * p_cblk, mi_tcd_rd_seg_t * p_segs)
+{
+        mi_UINT32 passno;
+        mi_UINT32 l_nb_segs = 0;
+
+        for (passno = 0; passno < p_cblk->totalpasses; ++passno) {
+                const mi_tcd_pass_t *pass = &p_cblk->passes[passno];
+
+                for (;;) {
+                        /* start of the new segment: end of the last one, or the empty code-block */
+                        mi_UINT32 l_rate = l_nb_segs ? p_segs[l_nb_segs - 1].rate : 0;
+                        mi_FLOAT64 l_disto = l_nb_segs ? p_segs[l_nb_segs - 1].disto : 0;
+                        mi_FLOAT64 l_slope;
+
+                        if (pass->rate <= l_rate) {
+                                /* no byte added: the pass replaces the last point if it is better */
+                                if (l_nb_segs && pass->distortiondec > l_disto) {
+                                        --l_nb_segs;
+                                        continue;
+                                }
+                                break;
+                        }
+
+                        /* same computation as mi_tcd_makelayer, so that the slopes are found exactly */
+                        l_slope = (pass->distortiondec - l_disto) / (mi_FLOAT64)(pass->rate - l_rate);
+                        if (l_nb_segs && l_slope >= p_segs[l_nb_segs - 1].slope) {
+                                /* the last point is under the hull */
+                                --l_nb_segs;
+                                continue;
+                        }
+
+                        p_segs[l_nb_segs].slope = l_slope;
+                        p_segs[l_nb_segs].disto = pass->distortiondec;
+                        p_segs[l_nb_segs].rate = pass->rate;
+                        ++l_nb_segs;
+                        break;
+                }
+        }
+
+        /* end points to lengths */
+        for (passno = l_nb_segs; passno > 1; --passno) {
+                p_segs[passno - 1].rate -= p_segs[passno - 2].rate;
+        }
+
+        return l_nb_segs;
+}
+
+static int mi_tcd_rd_seg_compare(const void * p_a, const void * p_b)
+{
+        mi_FLOAT64 l_a = ((const mi_tcd_rd_seg_t *) p_a)->slope;
+        mi_FLOAT64 l_b = ((const mi_tcd_rd_seg_t *) p_b)->slope;
+
+        return (l_a < l_b) - (l_a > l_b);
+}
+
+static mi_BOOL mi_tcd_rd_curve_create(mi_tcd_t *tcd, mi_UINT32 p_nb_passes, mi_tcd_rd_curve_t * p_curve)
+{
+        mi_UINT32 compno, resno, bandno, precno, cblkno;
+        mi_UINT32 l_nb_segs = 0, i, k;
+        mi_UINT32 l_rate = 0;
+        mi_tcd_rd_seg_t * l_segs;
+        mi_tcd_tile_t *tcd_tile = tcd->tcd_image->tiles;
+
+        memset(p_curve, 0, sizeof(mi_tcd_rd_curve_t));
+        if (p_nb_passes == 0) {
+                return mi_TRUE;
+        }
+
+        l_segs = (mi_tcd_rd_seg_t *) mi_malloc(p_nb_passes * sizeof(mi_tcd_rd_seg_t));
+        if (! l_segs) {
+                return mi_FALSE;
+        }
+
+        for (compno = 0; compno < tcd_tile->numcomps; compno++) {
+                mi_tcd_tilecomp_t *tilec = &tcd_tile->comps[compno];
+
+                for (resno = 0; resno < tilec->numresolutions; resno++) {
+                        mi_tcd_resolution_t *res = &tilec->resolutions[resno];
+
+                        for (bandno = 0; bandno < res->numbands; bandno++) {
+                                mi_tcd_band_t *band = &res->bands[bandno];
+
+                                for (precno = 0; precno < res->pw * res->ph; precno++) {
+                                        mi_tcd_precinct_t *prc = &band->precincts[precno];
+
+                                        for (cblkno = 0; cblkno < prc->cw * prc->ch; cblkno++) {
+                                                l_nb_segs += mi_tcd_rd_hull(&prc->cblks.enc[cblkno], l_segs + l_nb_segs);
+                                        }
+                                }
+                        }
+                }
+        }
+
+        if (l_nb_segs == 0) {
+                mi_free(l_segs);
+                return mi_TRUE;
+        }
+
+        qsort(l_segs, l_nb_segs, sizeof(mi_tcd_rd_seg_t), mi_tcd_rd_seg_compare);
+
+        p_curve->slopes = (mi_FLOAT64 *) mi_malloc(l_nb_segs * sizeof(mi_FLOAT64));
+        p_curve->rates = (mi_UINT32 *) mi_malloc(l_nb_segs * sizeof(mi_UINT32));
+        p_curve->nb_segs = (mi_UINT32 *) mi_malloc(l_nb_segs * sizeof(mi_UINT32));
+        if (! p_curve->slopes || ! p_curve->rates || ! p_curve->nb_segs) {
+                mi_free(l_segs);
+                mi_tcd_rd_curve_destroy(p_curve);
+                return mi_FALSE;
+        }
+
+        /* the segments of the same slope are all kept or all dropped */
+        k = 0;
+        for (i = 0; i < l_nb_segs; ++i) {
+                l_rate += l_segs[i].rate;
+                if (i + 1 == l_nb_segs || l_segs[i + 1].slope != l_segs[i].slope) {
+                        p_curve->slopes[k] = l_segs[i].slope;
+                        p_curve->rates[k] = l_rate;
+                        p_curve->nb_segs[k] = i + 1;
+                        ++k;
+                }
+        }
+        p_curve->nb_slopes = k;
+
+        mi_free(l_segs);
+        return mi_TRUE;
+}
+
+static void mi_tcd_rd_curve_destroy(mi_tcd_rd_curve_t * p_curve)
+{
+        mi_free(p_curve->slopes);
+        mi_free(p_curve->rates);
+        mi_free(p_curve->nb_segs);
+        memset(p_curve, 0, sizeof(mi_tcd_rd_curve_t));
+}
+
+static mi_BOOL mi_tcd_rd_check(mi_tcd_t *tcd,
+                                mi_t2_t *t2,
+                                const mi_tcd_rd_curve_t * p_curve,
+                                mi_UINT32 layno,
+                                mi_UINT32 k,
+                                mi_BYTE *dest,
+                                mi_UINT32 * p_data_written,
+                                mi_UINT32 maxlen,
+                                mi_codestream_info_t *cstr_info,
+                                mi_FLOAT64 p_disto_done,
+                                mi_FLOAT64 p_distotarget)
+{
+        mi_cp_t *cp = tcd->cp;
+        mi_tcd_tile_t *tcd_tile = tcd->tcd_image->tiles;
+
+        mi_tcd_makelayer(tcd, layno, p_curve->slopes[k], 0);
+
+        if (cp->m_specific_param.m_enc.m_fixed_quality) {       /* fixed_quality */
+                if (mi_IS_CINEMA(cp->rsiz) &&
+                    ! mi_t2_encode_packets(t2,tcd->tcd_tileno, tcd_tile, layno + 1, dest, p_data_written, maxlen, cstr_info,tcd->cur_tp_num,tcd->tp_pos,tcd->cur_pino,THRESH_CALC,00)) {
+                        return mi_FALSE;
+                }
+                return (p_disto_done + tcd_tile->distolayer[layno]) < p_distotarget;
+        }
+
+        return mi_t2_encode_packets(t2, tcd->tcd_tileno, tcd_tile, layno + 1, dest,p_data_written, maxlen, cstr_info,tcd->cur_tp_num,tcd->tp_pos,tcd->cur_pino,THRESH_CALC,00);
+}
+
+static mi_INT64 mi_tcd_rd_estimate(const mi_tcd_rd_curve_t * p_curve,
+                                    mi_INT64 p_from,
+                                    mi_INT64 p_to,
+                                    mi_INT64 p_anchor,
+                                    mi_FLOAT64 p_length,
+                                    mi_UINT32 maxlen,
+                                    mi_FLOAT64 p_hdr_cost)
+{
+        mi_FLOAT64 l_rate = p_anchor >= 0 ? p_curve->rates[p_anchor] : 0;
+        mi_FLOAT64 l_nb_segs = p_anchor >= 0 ? p_curve->nb_segs[p_anchor] : 0;
+        mi_INT64 l_lo = p_from - 1, l_hi = p_to, k;
+
+        /* the lengths increase with the index */
+        while (l_lo < l_hi) {
+                k = (l_lo + l_hi + 1) / 2;
+                if (p_length + (p_curve->rates[k] - l_rate) + p_hdr_cost * (p_curve->nb_segs[k] - l_nb_segs) <= (mi_FLOAT64)maxlen) {
+                        l_lo = k;
+                }
+                else {
+                        l_hi = k - 1;
+                }
+        }
+
+        return l_lo;
+}
+
+static mi_BOOL mi_tcd_rd_search(mi_tcd_t *tcd,
+                                 mi_t2_t *t2,
+                                 const mi_tcd_rd_curve_t * p_curve,
+                                 mi_UINT32 layno,
+                                 mi_UINT32 p_first,
+                                 mi_BYTE *dest,
+                                 mi_UINT32 * p_data_written,
+                                 mi_UINT32 maxlen,
+                                 mi_codestream_info_t *cstr_info,
+                                 mi_FLOAT64 p_disto_done,
+                                 mi_FLOAT64 p_distotarget,
+                                 mi_FLOAT64 * p_hdr_cost,
+                                 mi_UINT32 * p_found)
+{
+        /* the constraint holds up to l_true and fails from l_false on */
+        mi_INT64 l_true = (mi_INT64)p_first - 1;
+        mi_INT64 l_false = p_curve->nb_slopes;
+        mi_INT64 l_step_up = 1, l_step_down = 1;
+        mi_INT64 l_next, l_width, k;
+        mi_BOOL l_fixed_quality = tcd->cp->m_specific_param.m_enc.m_fixed_quality;
+        /* no length to estimate from in the fixed quality mode: bisection */
+        mi_BOOL l_bisect = l_fixed_quality;
+
+        if (l_fixed_quality) {
+                l_next = -1;
+        }
+        else {
+                l_next = mi_tcd_rd_estimate(p_curve, l_true + 1, l_false - 1, -1, 0, maxlen, *p_hdr_cost);
+        }
+
+        while (l_false - l_true > 1) {
+                l_width = l_false - l_true;
+                k = (! l_bisect && l_next > l_true && l_next < l_false) ? l_next : l_true + l_width / 2;
+
+                if (mi_tcd_rd_check(tcd, t2, p_curve, layno, (mi_UINT32)k, dest, p_data_written, maxlen, cstr_info, p_disto_done, p_distotarget)) {
+                        l_true = k;
+                        l_step_down = 1;
+                        if (! l_fixed_quality) {
+                                /* what is not code-block data is packet headers */
+                                if (p_curve->nb_segs[k] && *p_data_written >= p_curve->rates[k]) {
+                                        *p_hdr_cost = (mi_FLOAT64)(*p_data_written - p_curve->rates[k]) / p_curve->nb_segs[k];
+                                }
+                                l_next = mi_tcd_rd_estimate(p_curve, k + 1, l_false - 1, k, *p_data_written, maxlen, *p_hdr_cost);
+                                if (l_next <= k) {
+                                        /* too pessimistic an estimate: steps doubling upwards */
+                                        l_next = k + l_step_up;
+                                        l_step_up *= 2;
+                                }
+                                else {
+                                        l_step_up = 1;
+                                }
+                        }
+                }
+                else {
+                        l_false = k;
+                        if (! l_fixed_quality) {
+                                l_next = k - l_step_down;
+                                l_step_down *= 2;
+                        }
+                }
+
+                /* a guess not halving the interval is followed by a bisection step,
+                   which bounds the checks by twice the log of the number of slopes */
+                l_bisect = l_fixed_quality || (l_false - l_true) * 2 > l_width;
+        }
+
+        if (l_true < (mi_INT64)p_first) {
+                return mi_FALSE;
+        }
+
+        *p_found = (mi_UINT32)l_true;
+        return mi_TRUE;
+}
+
 mi_BOOL mi_tcd_rateallocate(  mi_tcd_t *tcd,
                                                                 mi_BYTE *dest,
                                                                 mi_UINT32 * p_data_written,
@@ -304,6 +768,11 @@ mi_BOOL mi_tcd_rateallocate(  mi_tcd_t *tcd,
         mi_FLOAT64 cumdisto[100];      /* fixed_quality */
         const mi_FLOAT64 K = 1;                /* 1.1; fixed_quality */
         mi_FLOAT64 maxSE = 0;
+        mi_UINT32 l_nb_passes = 0;
+        mi_tcd_rd_curve_t l_curve;
+        mi_t2_t *t2 = 00;
+        mi_UINT32 l_first = 0;
+        mi_FLOAT64 l_hdr_cost = 2.0;           /* bytes of packet header per hull segment, first guess */
 
         mi_cp_t *cp = tcd->cp;
         mi_tcd_tile_t *tcd_tile = tcd->tcd_image->tiles;
@@ -357,6 +826,8 @@ mi_BOOL mi_tcd_rateallocate(  mi_tcd_t *tcd,
                                                         }
                                                 } /* passno */
 
+                                                l_nb_passes += cblk->totalpasses;
+
                                                 /* fixed_quality */
                                                 tcd_tile->numpix += ((cblk->x1 - cblk->x0) * (cblk->y1 - cblk->y0));
                                                 tilec->numpix += ((cblk->x1 - cblk->x0) * (cblk->y1 - cblk->y0));
@@ -382,13 +853,21 @@ mi_BOOL mi_tcd_rateallocate(  mi_tcd_t *tcd,
                 }
         }
 
+        /* the slopes where the layers can change, found once for all the layers */
+        if (! mi_tcd_rd_curve_create(tcd, l_nb_passes, &l_curve)) {
+                return mi_FALSE;
+        }
+
+        /* one t2 handle for all the layers, which keeps the order of the packets of the tile */
+        t2 = mi_t2_create(tcd->image, cp);
+        if (t2 == 00) {
+                mi_tcd_rd_curve_destroy(&l_curve);
+                return mi_FALSE;
+        }
+
         for (layno = 0; layno < tcd_tcp->numlayers; layno++) {
-                mi_FLOAT64 lo = min;
-                mi_FLOAT64 hi = max;
                 mi_UINT32 maxlen = tcd_tcp->rates[layno] > 0.0f ? mi_uint_min(((mi_UINT32) ceil(tcd_tcp->rates[layno])), len) : len;
                 mi_FLOAT64 goodthresh = 0;
-                mi_FLOAT64 stable_thresh = 0;
-                mi_UINT32 i;
                 mi_FLOAT64 distotarget;                /* fixed_quality */
 
                 /* fixed_quality */
@@ -399,69 +878,21 @@ mi_BOOL mi_tcd_rateallocate(  mi_tcd_t *tcd,
                   -q xx,yy,zz,0   (fixed_quality == 1 and distoratio == 0)
                   ==> possible to have some lossy layers and the last layer for sure lossless */
                 if ( ((cp->m_specific_param.m_enc.m_disto_alloc==1) && (tcd_tcp->rates[layno]>0.0f)) || ((cp->m_specific_param.m_enc.m_fixed_quality==1) && (tcd_tcp->distoratio[layno]>0.0))) {
-                        mi_t2_t*t2 = mi_t2_create(tcd->image, cp);
-                        mi_FLOAT64 thresh = 0;
+                        mi_UINT32 l_found;
 
-                        if (t2 == 00) {
-                                return mi_FALSE;
+                        /* the layer only changes at the slopes of the curve: search among them */
+                        if (mi_tcd_rd_search(tcd, t2, &l_curve, layno, l_first, dest, p_data_written, maxlen, cstr_info,
+                                             (layno == 0) ? 0 : cumdisto[layno - 1], distotarget, &l_hdr_cost, &l_found)) {
+                                goodthresh = l_curve.slopes[l_found];
+                                l_first = l_found;
                         }
-
-                        for     (i = 0; i < 128; ++i) {
-                                mi_FLOAT64 distoachieved = 0;  /* fixed_quality */
-
-                                thresh = (lo + hi) / 2;
-
-                                mi_tcd_makelayer(tcd, layno, thresh, 0);
-
-                                if (cp->m_specific_param.m_enc.m_fixed_quality) {       /* fixed_quality */
-                                        if(mi_IS_CINEMA(cp->rsiz)){
-                                                if (! mi_t2_encode_packets(t2,tcd->tcd_tileno, tcd_tile, layno + 1, dest, p_data_written, maxlen, cstr_info,tcd->cur_tp_num,tcd->tp_pos,tcd->cur_pino,THRESH_CALC)) {
-
-                                                        lo = thresh;
-                                                        continue;
-                                                }
-                                                else {
-                                                        distoachieved = layno == 0 ?
-                                                                        tcd_tile->distolayer[0] : cumdisto[layno - 1] + tcd_tile->distolayer[layno];
-
-                                                        if (distoachieved < distotarget) {
-                                                                hi=thresh;
-                                                                stable_thresh = thresh;
-                                                                continue;
-                                                        }else{
-                                                                lo=thresh;
-                                                        }
-                                                }
-                                        }else{
-                                                distoachieved = (layno == 0) ?
-                                                                tcd_tile->distolayer[0] : (cumdisto[layno - 1] + tcd_tile->distolayer[layno]);
-
-                                                if (distoachieved < distotarget) {
-                                                        hi = thresh;
-                                                        stable_thresh = thresh;
-                                                        continue;
-                                                }
-                                                lo = thresh;
-                                        }
-                                } else {
-                                        if (! mi_t2_encode_packets(t2, tcd->tcd_tileno, tcd_tile, layno + 1, dest,p_data_written, maxlen, cstr_info,tcd->cur_tp_num,tcd->tp_pos,tcd->cur_pino,THRESH_CALC))
-                                        {
-                                                /* TODO: what to do with l ??? seek / tell ??? */
-                                                /* mi_event_msg(tcd->cinfo, EVT_INFO, "rate alloc: len=%d, max=%d\n", l, maxlen); */
-                                                lo = thresh;
-                                                continue;
-                                        }
-
-                                        hi = thresh;
-                                        stable_thresh = thresh;
-                                }
+                        else {
+                                /* nothing satisfies the constraint: the passes of the largest slope, or nothing more than the previous layers */
+                                goodthresh = l_curve.nb_slopes ? l_curve.slopes[l_first] : max;
                         }
-
-                        goodthresh = stable_thresh == 0? thresh : stable_thresh;
-
-                        mi_t2_destroy(t2);
                 } else {
                         goodthresh = min;
+                        l_first = l_curve.nb_slopes ? l_curve.nb_slopes - 1 : 0;
                 }
 
                 if(cstr_info) { /* Threshold for Marcela Index */
@@ -474,15 +905,20 @@ mi_BOOL mi_tcd_rateallocate(  mi_tcd_t *tcd,
                 cumdisto[layno] = (layno == 0) ? tcd_tile->distolayer[0] : (cumdisto[layno - 1] + tcd_tile->distolayer[layno]);
         }
 
+        mi_t2_destroy(t2);
+        mi_tcd_rd_curve_destroy(&l_curve);
+
         return mi_TRUE;
 }
 
 mi_BOOL mi_tcd_init( mi_tcd_t *p_tcd,
                                            mi_image_t * p_image,
-                                           mi_cp_t * p_cp )
+                                           mi_cp_t * p_cp,
+                                           mi_thread_pool_t* p_tp )
 {
         p_tcd->image = p_image;
         p_tcd->cp = p_cp;
+        p_tcd->thread_pool = p_tp;
 
         p_tcd->tcd_image->tiles = (mi_tcd_tile_t *) mi_calloc(1,sizeof(mi_tcd_tile_t));
         if (! p_tcd->tcd_image->tiles) {
@@ -515,6 +951,35 @@ void mi_tcd_destroy(mi_tcd_t *tcd) {
         }
 }
 
+mi_tcd_marker_info_t * mi_tcd_marker_info_create(mi_tcd_t *p_tcd, mi_BOOL p_need_PLT)
+{
+        mi_tcd_marker_info_t *l_marker_info =
+                (mi_tcd_marker_info_t *) mi_calloc(1, sizeof(mi_tcd_marker_info_t));
+        if (! l_marker_info) {
+                return 00;
+        }
+
+        l_marker_info->need_PLT = p_need_PLT;
+        if (p_need_PLT) {
+                mi_UINT32 l_nb_packets = mi_pi_get_encoding_packet_count(p_tcd->image, p_tcd->cp, p_tcd->tcd_tileno);
+                l_marker_info->p_packet_size = (mi_UINT32 *) mi_malloc((l_nb_packets ? l_nb_packets : 1) * sizeof(mi_UINT32));
+                if (! l_marker_info->p_packet_size) {
+                        mi_free(l_marker_info);
+                        return 00;
+                }
+        }
+
+        return l_marker_info;
+}
+
+void mi_tcd_marker_info_destroy(mi_tcd_marker_info_t *p_marker_info)
+{
+        if (p_marker_info) {
+                mi_free(p_marker_info->p_packet_size);
+                mi_free(p_marker_info);
+        }
+}
+
 mi_BOOL mi_alloc_tile_component_data(mi_tcd_tilecomp_t *l_tilec)
 {
 	if ((l_tilec->data == 00) || ((l_tilec->data_size_needed > l_tilec->data_size) && (l_tilec->ownsData == mi_FALSE))) {
@@ -589,6 +1054,9 @@ static INLINE mi_BOOL mi_tcd_init_tile(mi_tcd_t *p_tcd, mi_UINT32 p_tile_no, mi_
 	l_image = p_tcd->image;
 	l_image_comp = p_tcd->image->comps;
 	
+	/* the structures of the previous tile are not used anymore */
+	mi_arena_reset(&p_tcd->m_arena);
+	
 	p = p_tile_no % l_cp->tw;       /* tile coordinates */
 	q = p_tile_no / l_cp->tw;
 	/*fprintf(stderr, "Tile coordinate = %d,%d\n", p, q);*/
@@ -649,29 +1117,13 @@ static INLINE mi_BOOL mi_tcd_init_tile(mi_tcd_t *p_tcd, mi_UINT32 p_tile_no, mi_
 		
 		l_data_size = l_tilec->numresolutions * (mi_UINT32)sizeof(mi_tcd_resolution_t);
 		
-		if (l_tilec->resolutions == 00) {
-			l_tilec->resolutions = (mi_tcd_resolution_t *) mi_malloc(l_data_size);
-			if (! l_tilec->resolutions ) {
-				return mi_FALSE;
-			}
-			/*fprintf(stderr, "\tAllocate resolutions of tilec (mi_tcd_resolution_t): %d\n",l_data_size);*/
-			l_tilec->resolutions_size = l_data_size;
-			memset(l_tilec->resolutions,0,l_data_size);
-		}
-		else if (l_data_size > l_tilec->resolutions_size) {
-			mi_tcd_resolution_t* new_resolutions = (mi_tcd_resolution_t *) mi_realloc(l_tilec->resolutions, l_data_size);
-			if (! new_resolutions) {
-				mi_event_msg(manager, EVT_ERROR, "Not enough memory for tile resolutions\n");
-				mi_free(l_tilec->resolutions);
-				l_tilec->resolutions = NULL;
-				l_tilec->resolutions_size = 0;
-				return mi_FALSE;
-			}
-			l_tilec->resolutions = new_resolutions;
-			/*fprintf(stderr, "\tReallocate data of tilec (int): from %d to %d x mi_UINT32\n", l_tilec->resolutions_size, l_data_size);*/
-			memset(((mi_BYTE*) l_tilec->resolutions)+l_tilec->resolutions_size,0,l_data_size - l_tilec->resolutions_size);
-			l_tilec->resolutions_size = l_data_size;
+		l_tilec->resolutions = (mi_tcd_resolution_t *) mi_arena_calloc(&p_tcd->m_arena, l_tilec->numresolutions, sizeof(mi_tcd_resolution_t));
+		if (! l_tilec->resolutions) {
+			mi_event_msg(manager, EVT_ERROR, "Not enough memory for tile resolutions\n");
+			l_tilec->resolutions_size = 0;
+			return mi_FALSE;
 		}
+		l_tilec->resolutions_size = l_data_size;
 #pragma endregion
 
 		l_level_no = l_tilec->numresolutions;
@@ -773,28 +1225,14 @@ static INLINE mi_BOOL mi_tcd_init_tile(mi_tcd_t *p_tcd, mi_UINT32 p_tile_no, mi_
 				l_band->stepsize = (mi_FLOAT32)(((1.0 + l_step_size->mant / 2048.0) * pow(2.0, (mi_INT32) (numbps - l_step_size->expn)))) * fraction;//α5.6-2
 				l_band->numbps = l_step_size->expn + (mi_INT32)l_tccp->numgbits - 1;      /* WHY -1 ? *///α5.6-6
 				
-				if (!l_band->precincts && (l_nb_precincts > 0U)) {
-					l_band->precincts = (mi_tcd_precinct_t *) mi_malloc( /*3 * */ l_nb_precinct_size);
+				l_band->precincts = 00;
+				l_band->precincts_data_size = 0;
+				if (l_nb_precincts > 0U) {
+					l_band->precincts = (mi_tcd_precinct_t *) mi_arena_calloc(&p_tcd->m_arena, l_nb_precincts, sizeof(mi_tcd_precinct_t));
 					if (! l_band->precincts) {
-						return mi_FALSE;
-					}
-					/*fprintf(stderr, "\t\t\t\tAllocate precincts of a band (mi_tcd_precinct_t): %d\n",l_nb_precinct_size);     */
-					memset(l_band->precincts,0,l_nb_precinct_size);
-					l_band->precincts_data_size = l_nb_precinct_size;
-				}
-				else if (l_band->precincts_data_size < l_nb_precinct_size) {
-					
-					mi_tcd_precinct_t * new_precincts = (mi_tcd_precinct_t *) mi_realloc(l_band->precincts,/*3 * */ l_nb_precinct_size);
-					if (! new_precincts) {
 						mi_event_msg(manager, EVT_ERROR, "Not enough memory to handle band precints\n");
-						mi_free(l_band->precincts);
-						l_band->precincts = NULL;
-						l_band->precincts_data_size = 0;
 						return mi_FALSE;
 					}
-					l_band->precincts = new_precincts;
-					/*fprintf(stderr, "\t\t\t\tReallocate precincts of a band (mi_tcd_precinct_t): from %d to %d\n",l_band->precincts_data_size, l_nb_precinct_size);*/
-					memset(((mi_BYTE *) l_band->precincts) + l_band->precincts_data_size,0,l_nb_precinct_size - l_band->precincts_data_size);
 					l_band->precincts_data_size = l_nb_precinct_size;
 				}
 #pragma endregion				
@@ -834,56 +1272,27 @@ static INLINE mi_BOOL mi_tcd_init_tile(mi_tcd_t *p_tcd, mi_UINT32 p_tile_no, mi_
 					/*fprintf(stderr, "\t\t\t\t precinct_cw = %d x recinct_ch = %d\n",l_current_precinct->cw, l_current_precinct->ch);      */
 					l_nb_code_blocks_size = l_nb_code_blocks * (mi_UINT32)sizeof_block;
 					
-					if (!l_current_precinct->cblks.blocks && (l_nb_code_blocks > 0U)) {
-						l_current_precinct->cblks.blocks = mi_malloc(l_nb_code_blocks_size);
+					l_current_precinct->cblks.blocks = 00;
+					l_current_precinct->block_size = 0;
+					if (l_nb_code_blocks > 0U) {
+						l_current_precinct->cblks.blocks = mi_arena_calloc(&p_tcd->m_arena, l_nb_code_blocks, sizeof_block);
 						if (! l_current_precinct->cblks.blocks ) {
-							return mi_FALSE;
-						}
-						/*fprintf(stderr, "\t\t\t\tAllocate cblks of a precinct (mi_tcd_cblk_dec_t): %d\n",l_nb_code_blocks_size);*/
-						
-						memset(l_current_precinct->cblks.blocks,0,l_nb_code_blocks_size);
-						
-						l_current_precinct->block_size = l_nb_code_blocks_size;
-					}
-					else if (l_nb_code_blocks_size > l_current_precinct->block_size) {
-						void *new_blocks = mi_realloc(l_current_precinct->cblks.blocks, l_nb_code_blocks_size);
-						if (! new_blocks) {
-							mi_free(l_current_precinct->cblks.blocks);
-							l_current_precinct->cblks.blocks = NULL;
-							l_current_precinct->block_size = 0;
 							mi_event_msg(manager, EVT_ERROR, "Not enough memory for current precinct codeblock element\n");
 							return mi_FALSE;
 						}
-						l_current_precinct->cblks.blocks = new_blocks;
-						/*fprintf(stderr, "\t\t\t\tReallocate cblks of a precinct (mi_tcd_cblk_dec_t): from %d to %d\n",l_current_precinct->block_size, l_nb_code_blocks_size);     */
-						
-						memset(((mi_BYTE *) l_current_precinct->cblks.blocks) + l_current_precinct->block_size
-									 ,0
-									 ,l_nb_code_blocks_size - l_current_precinct->block_size);
-						
 						l_current_precinct->block_size = l_nb_code_blocks_size;
 					}
 #pragma endregion
 
 #pragma region set tag-tree
-					if (! l_current_precinct->incltree) {
-						l_current_precinct->incltree = mi_tgt_create(l_current_precinct->cw, l_current_precinct->ch, manager);
-					}
-					else{
-						l_current_precinct->incltree = mi_tgt_init(l_current_precinct->incltree, l_current_precinct->cw, l_current_precinct->ch, manager);
-					}
+					l_current_precinct->incltree = mi_tgt_create_arena(&p_tcd->m_arena, l_current_precinct->cw, l_current_precinct->ch, manager);
 
 					if (! l_current_precinct->incltree)     {
 						mi_event_msg(manager, EVT_WARNING, "No incltree created.\n");
 						/*return mi_FALSE;*/
 					}
 
-					if (! l_current_precinct->imsbtree) {
-						l_current_precinct->imsbtree = mi_tgt_create(l_current_precinct->cw, l_current_precinct->ch, manager);
-					}
-					else {
-						l_current_precinct->imsbtree = mi_tgt_init(l_current_precinct->imsbtree, l_current_precinct->cw, l_current_precinct->ch, manager);
-					}
+					l_current_precinct->imsbtree = mi_tgt_create_arena(&p_tcd->m_arena, l_current_precinct->cw, l_current_precinct->ch, manager);
 
 					if (! l_current_precinct->imsbtree) {
 						mi_event_msg(manager, EVT_WARNING, "No imsbtree created.\n");
@@ -899,7 +1308,7 @@ static INLINE mi_BOOL mi_tcd_init_tile(mi_tcd_t *p_tcd, mi_UINT32 p_tile_no, mi_
 						if (isEncoder) {
 							mi_tcd_cblk_enc_t* l_code_block = l_current_precinct->cblks.enc + cblkno;
 							
-							if (! mi_tcd_code_block_enc_allocate(l_code_block)) {
+							if (! mi_tcd_code_block_enc_allocate(&p_tcd->m_arena, l_code_block)) {
 								return mi_FALSE;
 							}
 							/* code-block size (global) */
@@ -908,13 +1317,13 @@ static INLINE mi_BOOL mi_tcd_init_tile(mi_tcd_t *p_tcd, mi_UINT32 p_tile_no, mi_
 							l_code_block->x1 = mi_int_min(cblkxend, l_current_precinct->x1);
 							l_code_block->y1 = mi_int_min(cblkyend, l_current_precinct->y1);
 							
-							if (! mi_tcd_code_block_enc_allocate_data(l_code_block)) {
+							if (! mi_tcd_code_block_enc_allocate_data(&p_tcd->m_arena, l_code_block)) {
 								return mi_FALSE;
 							}
 						} else {
 							mi_tcd_cblk_dec_t* l_code_block = l_current_precinct->cblks.dec + cblkno;
 							
-							if (! mi_tcd_code_block_dec_allocate(l_code_block)) {
+							if (! mi_tcd_code_block_dec_allocate(&p_tcd->m_arena, l_code_block)) {
 								return mi_FALSE;
 							}
 							/* code-block size (global) */
@@ -941,31 +1350,59 @@ static INLINE mi_BOOL mi_tcd_init_tile(mi_tcd_t *p_tcd, mi_UINT32 p_tile_no, mi_
 
 mi_BOOL mi_tcd_init_encode_tile (mi_tcd_t *p_tcd, mi_UINT32 p_tile_no, mi_event_mgr_t* p_manager)
 {
+	p_tcd->m_is_tile_coded = 0;
 	return mi_tcd_init_tile(p_tcd, p_tile_no, mi_TRUE, 1.0F, sizeof(mi_tcd_cblk_enc_t), p_manager);
 }
 
 mi_BOOL mi_tcd_init_decode_tile (mi_tcd_t *p_tcd, mi_UINT32 p_tile_no, mi_event_mgr_t* p_manager)
 {
-	return mi_tcd_init_tile(p_tcd, p_tile_no, mi_FALSE, 0.5F, sizeof(mi_tcd_cblk_dec_t), p_manager);
+	mi_tcd_tile_t * l_tile;
+
+	if (! mi_tcd_init_tile(p_tcd, p_tile_no, mi_FALSE, 0.5F, sizeof(mi_tcd_cblk_dec_t), p_manager)) {
+		return mi_FALSE;
+	}
+
+	l_tile = p_tcd->tcd_image->tiles;
+	p_tcd->win_x0 = (mi_UINT32)l_tile->x0;
+	p_tcd->win_y0 = (mi_UINT32)l_tile->y0;
+	p_tcd->win_x1 = (mi_UINT32)l_tile->x1;
+	p_tcd->win_y1 = (mi_UINT32)l_tile->y1;
+	return mi_TRUE;
+}
+
+void mi_tcd_set_decode_area (mi_tcd_t *p_tcd, mi_UINT32 p_x0, mi_UINT32 p_y0, mi_UINT32 p_x1, mi_UINT32 p_y1)
+{
+	mi_tcd_tile_t * l_tile = p_tcd->tcd_image->tiles;
+
+	p_tcd->win_x0 = mi_uint_min(mi_uint_max(p_x0, (mi_UINT32)l_tile->x0), (mi_UINT32)l_tile->x1);
+	p_tcd->win_y0 = mi_uint_min(mi_uint_max(p_y0, (mi_UINT32)l_tile->y0), (mi_UINT32)l_tile->y1);
+	p_tcd->win_x1 = mi_uint_max(mi_uint_min(p_x1, (mi_UINT32)l_tile->x1), p_tcd->win_x0);
+	p_tcd->win_y1 = mi_uint_max(mi_uint_min(p_y1, (mi_UINT32)l_tile->y1), p_tcd->win_y0);
+}
+
+void mi_tcd_set_output (mi_tcd_t *p_tcd, const mi_decode_buffer_t *p_output,
+                        mi_UINT32 p_x0, mi_UINT32 p_y0, mi_UINT32 p_x1, mi_UINT32 p_y1)
+{
+	p_tcd->m_output = p_output;
+	p_tcd->m_output_x0 = p_x0;
+	p_tcd->m_output_y0 = p_y0;
+	p_tcd->m_output_x1 = p_x1;
+	p_tcd->m_output_y1 = p_y1;
 }
 
 /**
  * Allocates memory for an encoding code block (but not data memory).
  */
-static mi_BOOL mi_tcd_code_block_enc_allocate (mi_tcd_cblk_enc_t * p_code_block)
+static mi_BOOL mi_tcd_code_block_enc_allocate (mi_arena_t * p_arena, mi_tcd_cblk_enc_t * p_code_block)
 {
+	/* no memset since data */
+	p_code_block->layers = (mi_tcd_layer_t*) mi_arena_calloc(p_arena, 100, sizeof(mi_tcd_layer_t));
 	if (! p_code_block->layers) {
-		/* no memset since data */
-		p_code_block->layers = (mi_tcd_layer_t*) mi_calloc(100, sizeof(mi_tcd_layer_t));
-		if (! p_code_block->layers) {
-			return mi_FALSE;
-		}
+		return mi_FALSE;
 	}
+	p_code_block->passes = (mi_tcd_pass_t*) mi_arena_calloc(p_arena, 100, sizeof(mi_tcd_pass_t));
 	if (! p_code_block->passes) {
-		p_code_block->passes = (mi_tcd_pass_t*) mi_calloc(100, sizeof(mi_tcd_pass_t));
-		if (! p_code_block->passes) {
-			return mi_FALSE;
-		}
+		return mi_FALSE;
 	}
 	return mi_TRUE;
 }
@@ -973,64 +1410,41 @@ static mi_BOOL mi_tcd_code_block_enc_allocate (mi_tcd_cblk_enc_t * p_code_block)
 /**
  * Allocates data memory for an encoding code block.
  */
-static mi_BOOL mi_tcd_code_block_enc_allocate_data (mi_tcd_cblk_enc_t * p_code_block)
+static mi_BOOL mi_tcd_code_block_enc_allocate_data (mi_arena_t * p_arena, mi_tcd_cblk_enc_t * p_code_block)
 {
 	mi_UINT32 l_data_size;
 	
 	l_data_size = (mi_UINT32)((p_code_block->x1 - p_code_block->x0) * (p_code_block->y1 - p_code_block->y0) * (mi_INT32)sizeof(mi_UINT32));
 	
-	if (l_data_size > p_code_block->data_size) {
-		if (p_code_block->data) {
-			mi_free(p_code_block->data - 1); /* again, why -1 */
-		}
-		p_code_block->data = (mi_BYTE*) mi_malloc(l_data_size+1);
-		if(! p_code_block->data) {
-			p_code_block->data_size = 0U;
-			return mi_FALSE;
-		}
-		p_code_block->data_size = l_data_size;
-		
-		p_code_block->data[0] = 0;
-		p_code_block->data+=1;   /*why +1 ?*/
+	p_code_block->data = (mi_BYTE*) mi_arena_alloc(p_arena, l_data_size+1);
+	if(! p_code_block->data) {
+		p_code_block->data_size = 0U;
+		return mi_FALSE;
 	}
+	p_code_block->data_size = l_data_size;
+	
+	p_code_block->data[0] = 0;
+	p_code_block->data+=1;   /*why +1 ?*/
 	return mi_TRUE;
 }
 
 /**
  * Allocates memory for a decoding code block.
  */
-static mi_BOOL mi_tcd_code_block_dec_allocate (mi_tcd_cblk_dec_t * p_code_block)
+static mi_BOOL mi_tcd_code_block_dec_allocate (mi_arena_t * p_arena, mi_tcd_cblk_dec_t * p_code_block)
 {
+        /* data_max_size does not count the end marker of the MQ decoder */
+        p_code_block->data = (mi_BYTE*) mi_arena_alloc(p_arena, mi_J2K_DEFAULT_CBLK_DATA_SIZE + MQC_SENTINEL_SIZE);
         if (! p_code_block->data) {
+                return mi_FALSE;
+        }
+        p_code_block->data_max_size = mi_J2K_DEFAULT_CBLK_DATA_SIZE;
 
-                p_code_block->data = (mi_BYTE*) mi_malloc(mi_J2K_DEFAULT_CBLK_DATA_SIZE);
-                if (! p_code_block->data) {
-                        return mi_FALSE;
-                }
-                p_code_block->data_max_size = mi_J2K_DEFAULT_CBLK_DATA_SIZE;
-                /*fprintf(stderr, "Allocate 8192 elements of code_block->data\n");*/
-
-                p_code_block->segs = (mi_tcd_seg_t *) mi_calloc(mi_J2K_DEFAULT_NB_SEGS,sizeof(mi_tcd_seg_t));
-                if (! p_code_block->segs) {
-                        return mi_FALSE;
-                }
-                /*fprintf(stderr, "Allocate %d elements of code_block->data\n", mi_J2K_DEFAULT_NB_SEGS * sizeof(mi_tcd_seg_t));*/
-
-                p_code_block->m_current_max_segs = mi_J2K_DEFAULT_NB_SEGS;
-                /*fprintf(stderr, "m_current_max_segs of code_block->data = %d\n", p_code_block->m_current_max_segs);*/
-        } else {
-					/* sanitize */
-					mi_BYTE* l_data = p_code_block->data;
-					mi_UINT32 l_data_max_size = p_code_block->data_max_size;
-					mi_tcd_seg_t * l_segs = p_code_block->segs;
-					mi_UINT32 l_current_max_segs = p_code_block->m_current_max_segs;
-
-					memset(p_code_block, 0, sizeof(mi_tcd_cblk_dec_t));
-					p_code_block->data = l_data;
-					p_code_block->data_max_size = l_data_max_size;
-					p_code_block->segs = l_segs;
-					p_code_block->m_current_max_segs = l_current_max_segs;
-				}
+        p_code_block->segs = (mi_tcd_seg_t *) mi_arena_calloc(p_arena, mi_J2K_DEFAULT_NB_SEGS,sizeof(mi_tcd_seg_t));
+        if (! p_code_block->segs) {
+                return mi_FALSE;
+        }
+        p_code_block->m_current_max_segs = mi_J2K_DEFAULT_NB_SEGS;
 
         return mi_TRUE;
 }
@@ -1073,85 +1487,103 @@ mi_BOOL mi_tcd_encode_tile(   mi_tcd_t *p_tcd,
                                                         mi_BYTE *p_dest,
                                                         mi_UINT32 * p_data_written,
                                                         mi_UINT32 p_max_length,
-                                                        mi_codestream_info_t *p_cstr_info)
+                                                        mi_codestream_info_t *p_cstr_info,
+                                                        mi_tcd_marker_info_t *p_marker_info)
 {
 
-        if (p_tcd->cur_tp_num == 0) {
+        if (p_tcd->cur_tp_num == 0 && ! p_tcd->m_is_tile_coded) {
+                if (! mi_tcd_pre_encode_tile(p_tcd, p_tile_no, p_dest, p_max_length, p_cstr_info)) {
+                        return mi_FALSE;
+                }
+        }
+        /*--------------TIER2------------------*/
 
-                p_tcd->tcd_tileno = p_tile_no;
-                p_tcd->tcp = &p_tcd->cp->tcps[p_tile_no];
+        /* INDEX */
+        if (p_cstr_info) {
+                p_cstr_info->index_write = 1;
+        }
+        /* FIXME _ProfStart(PGROUP_T2); */
 
-                /* INDEX >> "Precinct_nb_X et Precinct_nb_Y" */
-                if(p_cstr_info)  {
-                        mi_UINT32 l_num_packs = 0;
-                        mi_UINT32 i;
-                        mi_tcd_tilecomp_t *l_tilec_idx = &p_tcd->tcd_image->tiles->comps[0];        /* based on component 0 */
-                        mi_tccp_t *l_tccp = p_tcd->tcp->tccps; /* based on component 0 */
+        if (! mi_tcd_t2_encode(p_tcd,p_dest,p_data_written,p_max_length,p_cstr_info,p_marker_info)) {
+                return mi_FALSE;
+        }
+        /* FIXME _ProfStop(PGROUP_T2); */
 
-                        for (i = 0; i < l_tilec_idx->numresolutions; i++) {
-                                mi_tcd_resolution_t *l_res_idx = &l_tilec_idx->resolutions[i];
+        /*---------------CLEAN-------------------*/
 
-                                p_cstr_info->tile[p_tile_no].pw[i] = (int)l_res_idx->pw;
-                                p_cstr_info->tile[p_tile_no].ph[i] = (int)l_res_idx->ph;
+        return mi_TRUE;
+}
 
-                                l_num_packs += l_res_idx->pw * l_res_idx->ph;
-                                p_cstr_info->tile[p_tile_no].pdx[i] = (int)l_tccp->prcw[i];
-                                p_cstr_info->tile[p_tile_no].pdy[i] = (int)l_tccp->prch[i];
-                        }
-                        p_cstr_info->tile[p_tile_no].packet = (mi_packet_info_t*) mi_calloc((size_t)p_cstr_info->numcomps * (size_t)p_cstr_info->numlayers * l_num_packs, sizeof(mi_packet_info_t));
-                        if (!p_cstr_info->tile[p_tile_no].packet) {
-                                /* FIXME event manager error callback */
-                                return mi_FALSE;
-                        }
-                }
-                /* << INDEX */
+mi_BOOL mi_tcd_pre_encode_tile(   mi_tcd_t *p_tcd,
+                                                        mi_UINT32 p_tile_no,
+                                                        mi_BYTE *p_dest,
+                                                        mi_UINT32 p_max_length,
+                                                        mi_codestream_info_t *p_cstr_info)
+{
+        mi_BOOL l_mct_dc_shift;
 
-                /* FIXME _ProfStart(PGROUP_DC_SHIFT); */
-                /*---------------TILE-------------------*/
-                if (! mi_tcd_dc_level_shift_encode(p_tcd)) {
-                        return mi_FALSE;
-                }
-                /* FIXME _ProfStop(PGROUP_DC_SHIFT); */
+        p_tcd->tcd_tileno = p_tile_no;
+        p_tcd->tcp = &p_tcd->cp->tcps[p_tile_no];
 
-                /* FIXME _ProfStart(PGROUP_MCT); */
-                if (! mi_tcd_mct_encode(p_tcd)) {
-                        return mi_FALSE;
-                }
-                /* FIXME _ProfStop(PGROUP_MCT); */
+        /* INDEX >> "Precinct_nb_X et Precinct_nb_Y" */
+        if(p_cstr_info)  {
+                mi_UINT32 l_num_packs = 0;
+                mi_UINT32 i;
+                mi_tcd_tilecomp_t *l_tilec_idx = &p_tcd->tcd_image->tiles->comps[0];        /* based on component 0 */
+                mi_tccp_t *l_tccp = p_tcd->tcp->tccps; /* based on component 0 */
 
-                /* FIXME _ProfStart(PGROUP_DWT); */
-                if (! mi_tcd_dwt_encode(p_tcd)) {
-                        return mi_FALSE;
-                }
-                /* FIXME  _ProfStop(PGROUP_DWT); */
+                for (i = 0; i < l_tilec_idx->numresolutions; i++) {
+                        mi_tcd_resolution_t *l_res_idx = &l_tilec_idx->resolutions[i];
 
-                /* FIXME  _ProfStart(PGROUP_T1); */
-                if (! mi_tcd_t1_encode(p_tcd)) {
-                        return mi_FALSE;
-                }
-                /* FIXME _ProfStop(PGROUP_T1); */
+                        p_cstr_info->tile[p_tile_no].pw[i] = (int)l_res_idx->pw;
+                        p_cstr_info->tile[p_tile_no].ph[i] = (int)l_res_idx->ph;
 
-                /* FIXME _ProfStart(PGROUP_RATE); */
-                if (! mi_tcd_rate_allocate_encode(p_tcd,p_dest,p_max_length,p_cstr_info)) {
+                        l_num_packs += l_res_idx->pw * l_res_idx->ph;
+                        p_cstr_info->tile[p_tile_no].pdx[i] = (int)l_tccp->prcw[i];
+                        p_cstr_info->tile[p_tile_no].pdy[i] = (int)l_tccp->prch[i];
+                }
+                p_cstr_info->tile[p_tile_no].packet = (mi_packet_info_t*) mi_calloc((size_t)p_cstr_info->numcomps * (size_t)p_cstr_info->numlayers * l_num_packs, sizeof(mi_packet_info_t));
+                if (!p_cstr_info->tile[p_tile_no].packet) {
+                        /* FIXME event manager error callback */
                         return mi_FALSE;
                 }
-                /* FIXME _ProfStop(PGROUP_RATE); */
+        }
+        /* << INDEX */
 
+        /* FIXME _ProfStart(PGROUP_DC_SHIFT); */
+        /*---------------TILE-------------------*/
+        /* the RGB samples are read once: the MCT does their DC level shift */
+        l_mct_dc_shift = mi_tcd_mct_encode_fuses_dc_level_shift(p_tcd);
+        if (! mi_tcd_dc_level_shift_encode(p_tcd, l_mct_dc_shift ? 3 : 0)) {
+                return mi_FALSE;
         }
-        /*--------------TIER2------------------*/
+        /* FIXME _ProfStop(PGROUP_DC_SHIFT); */
 
-        /* INDEX */
-        if (p_cstr_info) {
-                p_cstr_info->index_write = 1;
+        /* FIXME _ProfStart(PGROUP_MCT); */
+        if (! mi_tcd_mct_encode(p_tcd, l_mct_dc_shift)) {
+                return mi_FALSE;
         }
-        /* FIXME _ProfStart(PGROUP_T2); */
+        /* FIXME _ProfStop(PGROUP_MCT); */
 
-        if (! mi_tcd_t2_encode(p_tcd,p_dest,p_data_written,p_max_length,p_cstr_info)) {
+        /* FIXME _ProfStart(PGROUP_DWT); */
+        if (! mi_tcd_dwt_encode(p_tcd)) {
                 return mi_FALSE;
         }
-        /* FIXME _ProfStop(PGROUP_T2); */
+        /* FIXME  _ProfStop(PGROUP_DWT); */
 
-        /*---------------CLEAN-------------------*/
+        /* FIXME  _ProfStart(PGROUP_T1); */
+        if (! mi_tcd_t1_encode(p_tcd)) {
+                return mi_FALSE;
+        }
+        /* FIXME _ProfStop(PGROUP_T1); */
+
+        /* FIXME _ProfStart(PGROUP_RATE); */
+        if (! mi_tcd_rate_allocate_encode(p_tcd,p_dest,p_max_length,p_cstr_info)) {
+                return mi_FALSE;
+        }
+        /* FIXME _ProfStop(PGROUP_RATE); */
+
+        p_tcd->m_is_tile_coded = 1;
 
         return mi_TRUE;
 }
@@ -1165,6 +1597,7 @@ mi_BOOL mi_tcd_decode_tile(   mi_tcd_t *p_tcd,
                                 )
 {
         mi_UINT32 l_data_read;
+        mi_BOOL l_dc_shifted = mi_FALSE;
         p_tcd->tcd_tileno = p_tile_no;
         p_tcd->tcp = &(p_tcd->cp->tcps[p_tile_no]);
 
@@ -1177,6 +1610,9 @@ mi_BOOL mi_tcd_decode_tile(   mi_tcd_t *p_tcd,
         }
         /* FIXME _ProfStop(PGROUP_T2); */
 
+        /* the decoded resolutions are known once the packets are read */
+        mi_tcd_init_decode_windows(p_tcd);
+
         /*------------------TIER1-----------------*/
 
         /* FIXME _ProfStart(PGROUP_T1); */
@@ -1200,7 +1636,7 @@ mi_BOOL mi_tcd_decode_tile(   mi_tcd_t *p_tcd,
         /*----------------MCT-------------------*/
         /* FIXME _ProfStart(PGROUP_MCT); */
         if
-                (! mi_tcd_mct_decode(p_tcd, p_manager))
+                (! mi_tcd_mct_decode(p_tcd, p_manager, &l_dc_shifted))
         {
                 return mi_FALSE;
         }
@@ -1208,7 +1644,7 @@ mi_BOOL mi_tcd_decode_tile(   mi_tcd_t *p_tcd,
 
         /* FIXME _ProfStart(PGROUP_DC_SHIFT); */
         if
-                (! mi_tcd_dc_level_shift_decode(p_tcd))
+                (! mi_tcd_dc_level_shift_decode(p_tcd, l_dc_shifted ? 3 : 0))
         {
                 return mi_FALSE;
         }
@@ -1219,6 +1655,35 @@ mi_BOOL mi_tcd_decode_tile(   mi_tcd_t *p_tcd,
         return mi_TRUE;
 }
 
+mi_BOOL mi_tcd_get_packet_lengths(   mi_tcd_t *p_tcd,
+                                      mi_BYTE *p_src,
+                                      mi_UINT32 p_max_length,
+                                      mi_UINT32 p_tile_no,
+                                      mi_UINT32 **p_lengths,
+                                      mi_UINT32 *p_max_nb_lengths,
+                                      mi_event_mgr_t *p_manager
+                                      )
+{
+        mi_t2_t * l_t2;
+        mi_BOOL l_ret;
+
+        p_tcd->tcd_tileno = p_tile_no;
+        p_tcd->tcp = &(p_tcd->cp->tcps[p_tile_no]);
+
+        l_t2 = mi_t2_create(p_tcd->image, p_tcd->cp);
+        if (l_t2 == 00) {
+                return mi_FALSE;
+        }
+        l_t2->m_arena = &p_tcd->m_arena;
+
+        l_ret = mi_t2_get_packet_lengths(l_t2, p_tile_no, p_tcd->tcd_image->tiles, p_src, p_max_length,
+                                         p_lengths, p_max_nb_lengths, p_manager);
+
+        mi_t2_destroy(l_t2);
+
+        return l_ret;
+}
+
 mi_BOOL mi_tcd_update_tile_data ( mi_tcd_t *p_tcd,
                                     mi_BYTE * p_dest,
                                     mi_UINT32 p_dest_length
@@ -1230,6 +1695,8 @@ mi_BOOL mi_tcd_update_tile_data ( mi_tcd_t *p_tcd,
         mi_tcd_resolution_t * l_res;
         mi_UINT32 l_size_comp, l_remaining;
         mi_UINT32 l_stride, l_width,l_height;
+        mi_UINT32 l_win_width, l_win_height, l_dest_stride;
+        mi_SIZE_T l_src_offset, l_dest_offset;
 
         l_data_size = mi_tcd_get_decoded_tile_size(p_tcd);
         if (l_data_size > p_dest_length) {
@@ -1245,7 +1712,14 @@ mi_BOOL mi_tcd_update_tile_data ( mi_tcd_t *p_tcd,
                 l_res = l_tilec->resolutions + l_img_comp->resno_decoded;
                 l_width = (mi_UINT32)(l_res->x1 - l_res->x0);
                 l_height = (mi_UINT32)(l_res->y1 - l_res->y0);
-                l_stride = (mi_UINT32)(l_tilec->x1 - l_tilec->x0) - l_width;
+
+                /* only the decoded area is copied, the other samples of p_dest are left as is */
+                l_win_width = l_res->win_x1 - l_res->win_x0;
+                l_win_height = l_res->win_y1 - l_res->win_y0;
+                l_stride = (mi_UINT32)(l_tilec->x1 - l_tilec->x0) - l_win_width;
+                l_dest_stride = l_width - l_win_width;
+                l_src_offset = (mi_SIZE_T)l_res->win_y0 * (mi_SIZE_T)(l_tilec->x1 - l_tilec->x0) + l_res->win_x0;
+                l_dest_offset = (mi_SIZE_T)l_res->win_y0 * l_width + l_res->win_x0;
 
                 if (l_remaining) {
                         ++l_size_comp;
@@ -1259,67 +1733,72 @@ mi_BOOL mi_tcd_update_tile_data ( mi_tcd_t *p_tcd,
                         {
                         case 1:
                                 {
-                                        mi_CHAR * l_dest_ptr = (mi_CHAR *) p_dest;
-                                        const mi_INT32 * l_src_ptr = l_tilec->data;
+                                        mi_CHAR * l_dest_ptr = (mi_CHAR *) p_dest + l_dest_offset;
+                                        const mi_INT32 * l_src_ptr = l_tilec->data + l_src_offset;
 
                                         if (l_img_comp->sgnd) {
-                                                for (j=0;j<l_height;++j) {
-                                                        for (k=0;k<l_width;++k) {
+                                                for (j=0;j<l_win_height;++j) {
+                                                        for (k=0;k<l_win_width;++k) {
                                                                 *(l_dest_ptr++) = (mi_CHAR) (*(l_src_ptr++));
                                                         }
                                                         l_src_ptr += l_stride;
+                                                        l_dest_ptr += l_dest_stride;
                                                 }
                                         }
                                         else {
-                                                for (j=0;j<l_height;++j) {
-                                                        for     (k=0;k<l_width;++k) {
+                                                for (j=0;j<l_win_height;++j) {
+                                                        for     (k=0;k<l_win_width;++k) {
                                                                 *(l_dest_ptr++) = (mi_CHAR) ((*(l_src_ptr++))&0xff);
                                                         }
                                                         l_src_ptr += l_stride;
+                                                        l_dest_ptr += l_dest_stride;
                                                 }
                                         }
 
-                                        p_dest = (mi_BYTE *)l_dest_ptr;
+                                        p_dest += (mi_SIZE_T)l_width * l_height;
                                 }
                                 break;
                         case 2:
                                 {
-                                        const mi_INT32 * l_src_ptr = l_tilec->data;
-                                        mi_INT16 * l_dest_ptr = (mi_INT16 *) p_dest;
+                                        const mi_INT32 * l_src_ptr = l_tilec->data + l_src_offset;
+                                        mi_INT16 * l_dest_ptr = (mi_INT16 *) p_dest + l_dest_offset;
 
                                         if (l_img_comp->sgnd) {
-                                                for (j=0;j<l_height;++j) {
-                                                        for (k=0;k<l_width;++k) {
+                                                for (j=0;j<l_win_height;++j) {
+                                                        for (k=0;k<l_win_width;++k) {
                                                                 *(l_dest_ptr++) = (mi_INT16) (*(l_src_ptr++));
                                                         }
                                                         l_src_ptr += l_stride;
+                                                        l_dest_ptr += l_dest_stride;
                                                 }
                                         }
                                         else {
-                                                for (j=0;j<l_height;++j) {
-                                                        for (k=0;k<l_width;++k) {
+                                                for (j=0;j<l_win_height;++j) {
+                                                        for (k=0;k<l_win_width;++k) {
                                                                 *(l_dest_ptr++) = (mi_INT16) ((*(l_src_ptr++))&0xffff);
                                                         }
                                                         l_src_ptr += l_stride;
+                                                        l_dest_ptr += l_dest_stride;
                                                 }
                                         }
 
-                                        p_dest = (mi_BYTE*) l_dest_ptr;
+                                        p_dest += (mi_SIZE_T)l_width * l_height * sizeof(mi_INT16);
                                 }
                                 break;
                         case 4:
                                 {
-                                        mi_INT32 * l_dest_ptr = (mi_INT32 *) p_dest;
-                                        mi_INT32 * l_src_ptr = l_tilec->data;
+                                        mi_INT32 * l_dest_ptr = (mi_INT32 *) p_dest + l_dest_offset;
+                                        mi_INT32 * l_src_ptr = l_tilec->data + l_src_offset;
 
-                                        for (j=0;j<l_height;++j) {
-                                                for (k=0;k<l_width;++k) {
+                                        for (j=0;j<l_win_height;++j) {
+                                                for (k=0;k<l_win_width;++k) {
                                                         *(l_dest_ptr++) = (*(l_src_ptr++));
                                                 }
                                                 l_src_ptr += l_stride;
+                                                l_dest_ptr += l_dest_stride;
                                         }
 
-                                        p_dest = (mi_BYTE*) l_dest_ptr;
+                                        p_dest += (mi_SIZE_T)l_width * l_height * sizeof(mi_INT32);
                                 }
                                 break;
                 }
@@ -1336,30 +1815,21 @@ mi_BOOL mi_tcd_update_tile_data ( mi_tcd_t *p_tcd,
 
 static void mi_tcd_free_tile(mi_tcd_t *p_tcd)
 {
-        mi_UINT32 compno, resno, bandno, precno;
+        mi_UINT32 compno;
         mi_tcd_tile_t *l_tile = 00;
         mi_tcd_tilecomp_t *l_tile_comp = 00;
-        mi_tcd_resolution_t *l_res = 00;
-        mi_tcd_band_t *l_band = 00;
-        mi_tcd_precinct_t *l_precinct = 00;
-        mi_UINT32 l_nb_resolutions, l_nb_precincts;
-        void (* l_tcd_code_block_deallocate) (mi_tcd_precinct_t *) = 00;
 
         if (! p_tcd) {
                 return;
         }
 
+        /* the resolutions, precincts, code-blocks and tag trees */
+        mi_arena_destroy(&p_tcd->m_arena);
+
         if (! p_tcd->tcd_image) {
                 return;
         }
 
-        if (p_tcd->m_is_decoder) {
-                l_tcd_code_block_deallocate = mi_tcd_code_block_dec_deallocate;
-        }
-        else {
-                l_tcd_code_block_deallocate = mi_tcd_code_block_enc_deallocate;
-        }
-
         l_tile = p_tcd->tcd_image->tiles;
         if (! l_tile) {
                 return;
@@ -1368,37 +1838,8 @@ static void mi_tcd_free_tile(mi_tcd_t *p_tcd)
         l_tile_comp = l_tile->comps;
 
         for (compno = 0; compno < l_tile->numcomps; ++compno) {
-                l_res = l_tile_comp->resolutions;
-                if (l_res) {
-
-                        l_nb_resolutions = l_tile_comp->resolutions_size / sizeof(mi_tcd_resolution_t);
-                        for (resno = 0; resno < l_nb_resolutions; ++resno) {
-                                l_band = l_res->bands;
-                                for     (bandno = 0; bandno < 3; ++bandno) {
-                                        l_precinct = l_band->precincts;
-                                        if (l_precinct) {
-
-                                                l_nb_precincts = l_band->precincts_data_size / sizeof(mi_tcd_precinct_t);
-                                                for (precno = 0; precno < l_nb_precincts; ++precno) {
-                                                        mi_tgt_destroy(l_precinct->incltree);
-                                                        l_precinct->incltree = 00;
-                                                        mi_tgt_destroy(l_precinct->imsbtree);
-                                                        l_precinct->imsbtree = 00;
-                                                        (*l_tcd_code_block_deallocate) (l_precinct);
-                                                        ++l_precinct;
-                                                }
-
-                                                mi_free(l_band->precincts);
-                                                l_band->precincts = 00;
-                                        }
-                                        ++l_band;
-                                } /* for (resno */
-                                ++l_res;
-                        }
-
-                        mi_free(l_tile_comp->resolutions);
-                        l_tile_comp->resolutions = 00;
-                }
+                l_tile_comp->resolutions = 00;
+                l_tile_comp->resolutions_size = 0;
 
                 if (l_tile_comp->ownsData && l_tile_comp->data) {
                         mi_aligned_free(l_tile_comp->data);
@@ -1431,6 +1872,7 @@ static mi_BOOL mi_tcd_t2_decode (mi_tcd_t *p_tcd,
         if (l_t2 == 00) {
                 return mi_FALSE;
         }
+        l_t2->m_arena = &p_tcd->m_arena;
 
         if (! mi_t2_decode_packets(
                                         l_t2,
@@ -1451,33 +1893,132 @@ static mi_BOOL mi_tcd_t2_decode (mi_tcd_t *p_tcd,
         return mi_TRUE;
 }
 
+static void mi_tcd_get_decode_window_1d (mi_UINT32 x0, mi_UINT32 x1, mi_UINT32 n, mi_UINT32 cas, mi_UINT32 margin,
+                                           mi_UINT32 * l0, mi_UINT32 * l1, mi_UINT32 * h0, mi_UINT32 * h1)
+{
+        mi_UINT32 p0 = 0, p1 = 0;
+
+        /* samples [p0, p1) are transformed, which are exact in [p0 + margin, p1 - margin) */
+        if (x0 < x1) {
+                p0 = x0 > margin ? x0 - margin : 0;
+                p1 = mi_uint_min(x1 + margin, n);
+        }
+        /* the sample p is low-pass when p - cas is even */
+        *l0 = (p0 + 1 - cas) >> 1;
+        *l1 = (p1 + 1 - cas) >> 1;
+        *h0 = (p0 + cas) >> 1;
+        *h1 = (p1 + cas) >> 1;
+}
+
+static void mi_tcd_init_decode_windows ( mi_tcd_t *p_tcd )
+{
+        mi_UINT32 compno, resno, bandno;
+        mi_tcd_tile_t * l_tile = p_tcd->tcd_image->tiles;
+        mi_tcd_tilecomp_t * l_tile_comp = l_tile->comps;
+        mi_tccp_t * l_tccp = p_tcd->tcp->tccps;
+        mi_image_comp_t * l_img_comp = p_tcd->image->comps;
+
+        for (compno = 0; compno < l_tile->numcomps; ++compno) {
+                /* 2 lifting steps for the 5-3 wavelet, 4 for the 9-7 one */
+                mi_UINT32 l_margin = (l_tccp->qmfbid == 1) ? 2U : 4U;
+                mi_tcd_resolution_t * l_res;
+                mi_UINT32 l_level;
+
+                /* the resolutions which are not used by the inverse wavelet transform are */
+                /* decoded as a whole */
+                for (resno = 0; resno < l_tile_comp->numresolutions; ++resno) {
+                        l_res = l_tile_comp->resolutions + resno;
+                        l_res->win_x0 = 0;
+                        l_res->win_y0 = 0;
+                        l_res->win_x1 = (mi_UINT32)(l_res->x1 - l_res->x0);
+                        l_res->win_y1 = (mi_UINT32)(l_res->y1 - l_res->y0);
+                        for (bandno = 0; bandno < l_res->numbands; ++bandno) {
+                                mi_tcd_band_t * l_band = l_res->bands + bandno;
+                                l_band->win_x0 = 0;
+                                l_band->win_y0 = 0;
+                                l_band->win_x1 = (mi_UINT32)(l_band->x1 - l_band->x0);
+                                l_band->win_y1 = (mi_UINT32)(l_band->y1 - l_band->y0);
+                        }
+                }
+
+                /* a truncated codestream may leave resolutions undecoded, which */
+                /* mi_j2k_update_image_data does not scale as the decoded area  */
+                if (l_img_comp->resno_decoded + 1 == l_tile_comp->minimum_num_resolutions) {
+                        mi_UINT32 l_x0, l_y0, l_x1, l_y1;
+
+                        /* decoded area in the coordinates of the decoded resolution */
+                        l_res = l_tile_comp->resolutions + l_img_comp->resno_decoded;
+                        l_level = l_tile_comp->numresolutions - 1 - l_img_comp->resno_decoded;
+                        l_x0 = mi_uint_ceildivpow2(mi_uint_ceildiv(p_tcd->win_x0, l_img_comp->dx), l_level);
+                        l_y0 = mi_uint_ceildivpow2(mi_uint_ceildiv(p_tcd->win_y0, l_img_comp->dy), l_level);
+                        l_x1 = mi_uint_ceildivpow2(mi_uint_ceildiv(p_tcd->win_x1, l_img_comp->dx), l_level);
+                        l_y1 = mi_uint_ceildivpow2(mi_uint_ceildiv(p_tcd->win_y1, l_img_comp->dy), l_level);
+                        l_res->win_x0 = mi_uint_min(mi_uint_max(l_x0, (mi_UINT32)l_res->x0), (mi_UINT32)l_res->x1) - (mi_UINT32)l_res->x0;
+                        l_res->win_y0 = mi_uint_min(mi_uint_max(l_y0, (mi_UINT32)l_res->y0), (mi_UINT32)l_res->y1) - (mi_UINT32)l_res->y0;
+                        l_res->win_x1 = mi_uint_min(mi_uint_max(l_x1, (mi_UINT32)l_res->x0), (mi_UINT32)l_res->x1) - (mi_UINT32)l_res->x0;
+                        l_res->win_y1 = mi_uint_min(mi_uint_max(l_y1, (mi_UINT32)l_res->y0), (mi_UINT32)l_res->y1) - (mi_UINT32)l_res->y0;
+
+                        for (resno = l_img_comp->resno_decoded; resno > 0; --resno, --l_res) {
+                                mi_tcd_resolution_t * l_low_res = l_res - 1;
+                                mi_UINT32 l_lx0, l_lx1, l_hx0, l_hx1, l_ly0, l_ly1, l_hy0, l_hy1;
+
+                                mi_tcd_get_decode_window_1d(l_res->win_x0, l_res->win_x1, (mi_UINT32)(l_res->x1 - l_res->x0),
+                                                            (mi_UINT32)l_res->x0 & 1U, l_margin, &l_lx0, &l_lx1, &l_hx0, &l_hx1);
+                                mi_tcd_get_decode_window_1d(l_res->win_y0, l_res->win_y1, (mi_UINT32)(l_res->y1 - l_res->y0),
+                                                            (mi_UINT32)l_res->y0 & 1U, l_margin, &l_ly0, &l_ly1, &l_hy0, &l_hy1);
+
+                                for (bandno = 0; bandno < l_res->numbands; ++bandno) {
+                                        mi_tcd_band_t * l_band = l_res->bands + bandno;
+                                        l_band->win_x0 = (l_band->bandno & 1) ? l_hx0 : l_lx0;
+                                        l_band->win_x1 = (l_band->bandno & 1) ? l_hx1 : l_lx1;
+                                        l_band->win_y0 = (l_band->bandno & 2) ? l_hy0 : l_ly0;
+                                        l_band->win_y1 = (l_band->bandno & 2) ? l_hy1 : l_ly1;
+                                }
+                                l_low_res->win_x0 = l_lx0;
+                                l_low_res->win_x1 = l_lx1;
+                                l_low_res->win_y0 = l_ly0;
+                                l_low_res->win_y1 = l_ly1;
+                        }
+
+                        /* the lowest resolution is its own subband */
+                        l_res->bands[0].win_x0 = l_res->win_x0;
+                        l_res->bands[0].win_y0 = l_res->win_y0;
+                        l_res->bands[0].win_x1 = l_res->win_x1;
+                        l_res->bands[0].win_y1 = l_res->win_y1;
+                }
+
+                ++l_tile_comp;
+                ++l_img_comp;
+                ++l_tccp;
+        }
+}
+
 static mi_BOOL mi_tcd_t1_decode ( mi_tcd_t *p_tcd )
 {
         mi_UINT32 compno;
-        mi_t1_t * l_t1;
         mi_tcd_tile_t * l_tile = p_tcd->tcd_image->tiles;
         mi_tcd_tilecomp_t* l_tile_comp = l_tile->comps;
         mi_tccp_t * l_tccp = p_tcd->tcp->tccps;
+        volatile mi_BOOL ret = mi_TRUE;
+        mi_job_group_t* l_group = mi_job_group_create(p_tcd->thread_pool);
 
-
-        l_t1 = mi_t1_create(mi_FALSE);
-        if (l_t1 == 00) {
+        if (! l_group) {
                 return mi_FALSE;
         }
 
+        /* the code-blocks of all the components are queued before waiting */
         for (compno = 0; compno < l_tile->numcomps; ++compno) {
-                /* The +3 is headroom required by the vectorized DWT */
-                if (mi_FALSE == mi_t1_decode_cblks(l_t1, l_tile_comp, l_tccp)) {
-                        mi_t1_destroy(l_t1);
-                        return mi_FALSE;
+                mi_t1_decode_cblks(l_group, &ret, l_tile_comp, l_tccp);
+                if (!ret) {
+                        break;
                 }
                 ++l_tile_comp;
                 ++l_tccp;
         }
 
-        mi_t1_destroy(l_t1);
+        mi_job_group_destroy(l_group);
 
-        return mi_TRUE;
+        return ret;
 }
 
 
@@ -1504,12 +2045,12 @@ static mi_BOOL mi_tcd_dwt_decode ( mi_tcd_t *p_tcd )
                 */
 
                 if (l_tccp->qmfbid == 1) {
-                        if (! mi_dwt_decode(l_tile_comp, l_img_comp->resno_decoded+1)) {
+                        if (! mi_dwt_decode(p_tcd->thread_pool, l_tile_comp, l_img_comp->resno_decoded+1)) {
                                 return mi_FALSE;
                         }
                 }
                 else {
-                        if (! mi_dwt_decode_real(l_tile_comp, l_img_comp->resno_decoded+1)) {
+                        if (! mi_dwt_decode_real(p_tcd->thread_pool, l_tile_comp, l_img_comp->resno_decoded+1)) {
                                 return mi_FALSE;
                         }
                 }
@@ -1521,7 +2062,7 @@ static mi_BOOL mi_tcd_dwt_decode ( mi_tcd_t *p_tcd )
 
         return mi_TRUE;
 }
-static mi_BOOL mi_tcd_mct_decode ( mi_tcd_t *p_tcd, mi_event_mgr_t *p_manager)
+static mi_BOOL mi_tcd_mct_decode ( mi_tcd_t *p_tcd, mi_event_mgr_t *p_manager, mi_BOOL * p_dc_shifted)
 {
         mi_tcd_tile_t * l_tile = p_tcd->tcd_image->tiles;
         mi_tcp_t * l_tcp = p_tcd->tcp;
@@ -1575,6 +2116,10 @@ static mi_BOOL mi_tcd_mct_decode ( mi_tcd_t *p_tcd, mi_event_mgr_t *p_manager)
 
                         mi_free(l_data);
                 }
+                else if (mi_tcd_mct_dc_level_shift_fusable(p_tcd)) {
+                        mi_tcd_mct_dc_level_shift_decode(p_tcd);
+                        *p_dc_shifted = mi_TRUE;
+                }
                 else {
                         if (l_tcp->tccps->qmfbid == 1) {
                                 mi_mct_decode(     l_tile->comps[0].data,
@@ -1597,8 +2142,142 @@ static mi_BOOL mi_tcd_mct_decode ( mi_tcd_t *p_tcd, mi_event_mgr_t *p_manager)
         return mi_TRUE;
 }
 
+static mi_BOOL mi_tcd_mct_dc_level_shift_fusable (mi_tcd_t *p_tcd)
+{
+        mi_tcd_tile_t * l_tile = p_tcd->tcd_image->tiles;
+        mi_tccp_t * l_tccp = p_tcd->tcp->tccps;
+        mi_image_comp_t * l_img_comp = p_tcd->image->comps;
+        mi_tcd_resolution_t * l_res0 = l_tile->comps[0].resolutions + l_img_comp[0].resno_decoded;
+        mi_UINT32 compno;
+
+        for (compno = 1; compno < 3; ++compno) {
+                mi_tcd_tilecomp_t * l_tile_comp = l_tile->comps + compno;
+                mi_tcd_resolution_t * l_res = l_tile_comp->resolutions + l_img_comp[compno].resno_decoded;
 
-static mi_BOOL mi_tcd_dc_level_shift_decode ( mi_tcd_t *p_tcd )
+                if (l_tccp[compno].qmfbid != l_tccp[0].qmfbid ||
+                    l_tile_comp->x1 - l_tile_comp->x0 != l_tile->comps[0].x1 - l_tile->comps[0].x0 ||
+                    l_res->x1 - l_res->x0 != l_res0->x1 - l_res0->x0 ||
+                    l_res->y1 - l_res->y0 != l_res0->y1 - l_res0->y0 ||
+                    l_res->win_x0 != l_res0->win_x0 || l_res->win_x1 != l_res0->win_x1 ||
+                    l_res->win_y0 != l_res0->win_y0 || l_res->win_y1 != l_res0->win_y1) {
+                        return mi_FALSE;
+                }
+        }
+
+        return mi_TRUE;
+}
+
+static void mi_tcd_mct_dc_level_shift_decode (mi_tcd_t *p_tcd)
+{
+        mi_tcd_tile_t * l_tile = p_tcd->tcd_image->tiles;
+        mi_tccp_t * l_tccp = p_tcd->tcp->tccps;
+        mi_image_comp_t * l_img_comp = p_tcd->image->comps;
+        mi_tcd_resolution_t * l_res = l_tile->comps[0].resolutions + l_img_comp[0].resno_decoded;
+        mi_UINT32 l_width = l_res->win_x1 - l_res->win_x0;
+        mi_UINT32 l_height = l_res->win_y1 - l_res->win_y0;
+        mi_UINT32 l_tile_width = (mi_UINT32)(l_tile->comps[0].x1 - l_tile->comps[0].x0);
+        mi_INT32 l_dc_shift[3], l_min[3], l_max[3];
+        mi_UINT32 compno, j;
+        mi_SIZE_T l_offset;
+
+        for (compno = 0; compno < 3; ++compno) {
+                l_dc_shift[compno] = l_tccp[compno].m_dc_level_shift;
+                mi_tcd_get_sample_range(l_img_comp + compno, l_min + compno, l_max + compno);
+        }
+
+        /* a full width region is done in one call, unless its rows go to the buffer of the caller */
+        if (l_width == l_tile_width && ! p_tcd->m_output) {
+                l_width *= l_height;
+                l_height = l_height ? 1 : 0;
+        }
+
+        for (j = 0; j < l_height; ++j) {
+                l_offset = (mi_SIZE_T)(l_res->win_y0 + j) * l_tile_width + l_res->win_x0;
+                if (l_tccp->qmfbid == 1) {
+                        mi_mct_decode_dc_shift(l_tile->comps[0].data + l_offset,
+                                               l_tile->comps[1].data + l_offset,
+                                               l_tile->comps[2].data + l_offset,
+                                               l_width, l_dc_shift, l_min, l_max);
+                }
+                else {
+                        mi_mct_decode_real_dc_shift(l_tile->comps[0].data + l_offset,
+                                                    l_tile->comps[1].data + l_offset,
+                                                    l_tile->comps[2].data + l_offset,
+                                                    l_width, l_dc_shift, l_min, l_max);
+                }
+                if (p_tcd->m_output) {
+                        /* the row is still in the cache */
+                        for (compno = 0; compno < 3; ++compno) {
+                                mi_tcd_resolution_t * l_res_comp = l_tile->comps[compno].resolutions + l_img_comp[compno].resno_decoded;
+                                mi_tcd_write_output_row(p_tcd, compno, l_tile->comps[compno].data + l_offset,
+                                                        (mi_UINT32)l_res_comp->x0 + l_res->win_x0,
+                                                        (mi_UINT32)l_res_comp->y0 + l_res->win_y0 + j, l_width);
+                        }
+                }
+        }
+}
+
+static void mi_tcd_get_sample_range (const mi_image_comp_t * p_img_comp, mi_INT32 * p_min, mi_INT32 * p_max)
+{
+        if (p_img_comp->sgnd) {
+                *p_min = -(1 << (p_img_comp->prec - 1));
+                *p_max = (1 << (p_img_comp->prec - 1)) - 1;
+        }
+        else {
+                *p_min = 0;
+                *p_max = (1 << p_img_comp->prec) - 1;
+        }
+}
+
+static void mi_tcd_write_output_row (mi_tcd_t *p_tcd, mi_UINT32 p_compno, const mi_INT32 * p_src,
+                                       mi_UINT32 p_x, mi_UINT32 p_y, mi_UINT32 p_width)
+{
+        const mi_decode_buffer_t * l_output = p_tcd->m_output;
+        mi_UINT32 l_x1 = p_x + p_width;
+        mi_UINT32 c, i, l_width;
+
+        /* the decoded area of the tile is clipped to the one of the buffer */
+        if (p_y < p_tcd->m_output_y0 || p_y >= p_tcd->m_output_y1) {
+                return;
+        }
+        if (p_x < p_tcd->m_output_x0) {
+                p_src += p_tcd->m_output_x0 - p_x;
+                p_x = p_tcd->m_output_x0;
+        }
+        if (l_x1 > p_tcd->m_output_x1) {
+                l_x1 = p_tcd->m_output_x1;
+        }
+        if (p_x >= l_x1) {
+                return;
+        }
+        l_width = l_x1 - p_x;
+
+        for (c = 0; c < l_output->nb_channels; ++c) {
+                mi_BYTE * l_dest;
+
+                if (l_output->comp_map[c] != p_compno) {
+                        continue;
+                }
+                l_dest = l_output->data + (mi_SIZE_T)c * l_output->channel_stride
+                                        + (mi_SIZE_T)(p_y - p_tcd->m_output_y0) * l_output->row_stride
+                                        + (mi_SIZE_T)(p_x - p_tcd->m_output_x0) * l_output->pixel_stride;
+
+                if (l_output->sample_size == 1) {
+                        for (i = 0; i < l_width; ++i) {
+                                *l_dest = (mi_BYTE)p_src[i];
+                                l_dest += l_output->pixel_stride;
+                        }
+                }
+                else {
+                        for (i = 0; i < l_width; ++i) {
+                                *((mi_UINT16 *)l_dest) = (mi_UINT16)p_src[i];
+                                l_dest += l_output->pixel_stride;
+                        }
+                }
+        }
+}
+
+static mi_BOOL mi_tcd_dc_level_shift_decode ( mi_tcd_t *p_tcd, mi_UINT32 p_first_comp )
 {
         mi_UINT32 compno;
         mi_tcd_tilecomp_t * l_tile_comp = 00;
@@ -1612,28 +2291,21 @@ static mi_BOOL mi_tcd_dc_level_shift_decode ( mi_tcd_t *p_tcd )
         mi_UINT32 l_stride;
 
         l_tile = p_tcd->tcd_image->tiles;
-        l_tile_comp = l_tile->comps;
-        l_tccp = p_tcd->tcp->tccps;
-        l_img_comp = p_tcd->image->comps;
+        l_tile_comp = l_tile->comps + p_first_comp;
+        l_tccp = p_tcd->tcp->tccps + p_first_comp;
+        l_img_comp = p_tcd->image->comps + p_first_comp;
 
-        for (compno = 0; compno < l_tile->numcomps; compno++) {
+        for (compno = p_first_comp; compno < l_tile->numcomps; compno++) {
                 l_res = l_tile_comp->resolutions + l_img_comp->resno_decoded;
-                l_width = (mi_UINT32)(l_res->x1 - l_res->x0);
-                l_height = (mi_UINT32)(l_res->y1 - l_res->y0);
+                l_width = l_res->win_x1 - l_res->win_x0;
+                l_height = l_res->win_y1 - l_res->win_y0;
                 l_stride = (mi_UINT32)(l_tile_comp->x1 - l_tile_comp->x0) - l_width;
 
                 assert(l_height == 0 || l_width + l_stride <= l_tile_comp->data_size / l_height); /*MUPDF*/
 
-                if (l_img_comp->sgnd) {
-                        l_min = -(1 << (l_img_comp->prec - 1));
-                        l_max = (1 << (l_img_comp->prec - 1)) - 1;
-                }
-                else {
-            l_min = 0;
-                        l_max = (1 << l_img_comp->prec) - 1;
-                }
+                mi_tcd_get_sample_range(l_img_comp, &l_min, &l_max);
 
-                l_current_ptr = l_tile_comp->data;
+                l_current_ptr = l_tile_comp->data + (mi_SIZE_T)l_res->win_y0 * (mi_SIZE_T)(l_tile_comp->x1 - l_tile_comp->x0) + l_res->win_x0;
 
                 if (l_tccp->qmfbid == 1) {
                         for (j=0;j<l_height;++j) {
@@ -1641,6 +2313,11 @@ static mi_BOOL mi_tcd_dc_level_shift_decode ( mi_tcd_t *p_tcd )
                                         *l_current_ptr = mi_int_clamp(*l_current_ptr + l_tccp->m_dc_level_shift, l_min, l_max);
                                         ++l_current_ptr;
                                 }
+                                if (p_tcd->m_output) {
+                                        mi_tcd_write_output_row(p_tcd, compno, l_current_ptr - l_width,
+                                                                (mi_UINT32)l_res->x0 + l_res->win_x0,
+                                                                (mi_UINT32)l_res->y0 + l_res->win_y0 + j, l_width);
+                                }
                                 l_current_ptr += l_stride;
                         }
                 }
@@ -1651,6 +2328,11 @@ static mi_BOOL mi_tcd_dc_level_shift_decode ( mi_tcd_t *p_tcd )
                                         *l_current_ptr = mi_int_clamp((mi_INT32)mi_lrintf(l_value) + l_tccp->m_dc_level_shift, l_min, l_max); ;
                                         ++l_current_ptr;
                                 }
+                                if (p_tcd->m_output) {
+                                        mi_tcd_write_output_row(p_tcd, compno, l_current_ptr - l_width,
+                                                                (mi_UINT32)l_res->x0 + l_res->win_x0,
+                                                                (mi_UINT32)l_res->y0 + l_res->win_y0 + j, l_width);
+                                }
                                 l_current_ptr += l_stride;
                         }
                 }
@@ -1665,79 +2347,6 @@ static mi_BOOL mi_tcd_dc_level_shift_decode ( mi_tcd_t *p_tcd )
 
 
 
-/**
- * Deallocates the encoding data of the given precinct.
- */
-static void mi_tcd_code_block_dec_deallocate (mi_tcd_precinct_t * p_precinct)
-{
-        mi_UINT32 cblkno , l_nb_code_blocks;
-
-        mi_tcd_cblk_dec_t * l_code_block = p_precinct->cblks.dec;
-        if (l_code_block) {
-                /*fprintf(stderr,"deallocate codeblock:{\n");*/
-                /*fprintf(stderr,"\t x0=%d, y0=%d, x1=%d, y1=%d\n",l_code_block->x0, l_code_block->y0, l_code_block->x1, l_code_block->y1);*/
-                /*fprintf(stderr,"\t numbps=%d, numlenbits=%d, len=%d, numnewpasses=%d, real_num_segs=%d, m_current_max_segs=%d\n ",
-                                l_code_block->numbps, l_code_block->numlenbits, l_code_block->len, l_code_block->numnewpasses, l_code_block->real_num_segs, l_code_block->m_current_max_segs );*/
-
-
-                l_nb_code_blocks = p_precinct->block_size / sizeof(mi_tcd_cblk_dec_t);
-                /*fprintf(stderr,"nb_code_blocks =%d\t}\n", l_nb_code_blocks);*/
-
-                for (cblkno = 0; cblkno < l_nb_code_blocks; ++cblkno) {
-
-                        if (l_code_block->data) {
-                                mi_free(l_code_block->data);
-                                l_code_block->data = 00;
-                        }
-
-                        if (l_code_block->segs) {
-                                mi_free(l_code_block->segs );
-                                l_code_block->segs = 00;
-                        }
-
-                        ++l_code_block;
-                }
-
-                mi_free(p_precinct->cblks.dec);
-                p_precinct->cblks.dec = 00;
-        }
-}
-
-/**
- * Deallocates the encoding data of the given precinct.
- */
-static void mi_tcd_code_block_enc_deallocate (mi_tcd_precinct_t * p_precinct)
-{       
-        mi_UINT32 cblkno , l_nb_code_blocks;
-
-        mi_tcd_cblk_enc_t * l_code_block = p_precinct->cblks.enc;
-        if (l_code_block) {
-                l_nb_code_blocks = p_precinct->block_size / sizeof(mi_tcd_cblk_enc_t);
-                
-                for     (cblkno = 0; cblkno < l_nb_code_blocks; ++cblkno)  {
-                        if (l_code_block->data) {
-                                mi_free(l_code_block->data - 1);
-                                l_code_block->data = 00;
-                        }
-
-                        if (l_code_block->layers) {
-                                mi_free(l_code_block->layers );
-                                l_code_block->layers = 00;
-                        }
-
-                        if (l_code_block->passes) {
-                                mi_free(l_code_block->passes );
-                                l_code_block->passes = 00;
-                        }
-                        ++l_code_block;
-                }
-
-                mi_free(p_precinct->cblks.enc);
-                
-                p_precinct->cblks.enc = 00;
-        }
-}
-
 mi_UINT32 mi_tcd_get_encoded_tile_size ( mi_tcd_t *p_tcd )
 {
         mi_UINT32 i,l_data_size = 0;
@@ -1767,7 +2376,31 @@ mi_UINT32 mi_tcd_get_encoded_tile_size ( mi_tcd_t *p_tcd )
         return l_data_size;
 }
 //Ӧֱƽƺ                
-static mi_BOOL mi_tcd_dc_level_shift_encode ( mi_tcd_t *p_tcd )
+static mi_BOOL mi_tcd_mct_encode_fuses_dc_level_shift ( mi_tcd_t *p_tcd )
+{
+        mi_tcd_tile_t * l_tile = p_tcd->tcd_image->tiles;
+        mi_tccp_t * l_tccp = p_tcd->tcp->tccps;
+        mi_INT32 l_samples;
+        mi_UINT32 compno;
+
+        if (p_tcd->tcp->mct != 1 || l_tile->numcomps < 3) {
+                return mi_FALSE;
+        }
+
+        l_samples = (l_tile->comps[0].x1 - l_tile->comps[0].x0) * (l_tile->comps[0].y1 - l_tile->comps[0].y0);
+        for (compno = 1; compno < 3; ++compno) {
+                mi_tcd_tilecomp_t * l_tile_comp = l_tile->comps + compno;
+
+                if (l_tccp[compno].qmfbid != l_tccp[0].qmfbid ||
+                    (l_tile_comp->x1 - l_tile_comp->x0) * (l_tile_comp->y1 - l_tile_comp->y0) != l_samples) {
+                        return mi_FALSE;
+                }
+        }
+
+        return mi_TRUE;
+}
+
+static mi_BOOL mi_tcd_dc_level_shift_encode ( mi_tcd_t *p_tcd, mi_UINT32 p_first_comp )
 {
         mi_UINT32 compno;
         mi_tcd_tilecomp_t * l_tile_comp = 00;
@@ -1778,11 +2411,11 @@ static mi_BOOL mi_tcd_dc_level_shift_encode ( mi_tcd_t *p_tcd )
         mi_INT32 * l_current_ptr;
 
         l_tile = p_tcd->tcd_image->tiles;
-        l_tile_comp = l_tile->comps;
-        l_tccp = p_tcd->tcp->tccps;
-        l_img_comp = p_tcd->image->comps;
+        l_tile_comp = l_tile->comps + p_first_comp;
+        l_tccp = p_tcd->tcp->tccps + p_first_comp;
+        l_img_comp = p_tcd->image->comps + p_first_comp;
 
-        for (compno = 0; compno < l_tile->numcomps; compno++) {
+        for (compno = p_first_comp; compno < l_tile->numcomps; compno++) {
                 l_current_ptr = l_tile_comp->data;
                 l_nb_elem = (mi_UINT32)((l_tile_comp->x1 - l_tile_comp->x0) * (l_tile_comp->y1 - l_tile_comp->y0));
 
@@ -1807,7 +2440,7 @@ static mi_BOOL mi_tcd_dc_level_shift_encode ( mi_tcd_t *p_tcd )
         return mi_TRUE;
 }
 //任
-static mi_BOOL mi_tcd_mct_encode ( mi_tcd_t *p_tcd )
+static mi_BOOL mi_tcd_mct_encode ( mi_tcd_t *p_tcd, mi_BOOL p_dc_shift )
 {
         mi_tcd_tile_t * l_tile = p_tcd->tcd_image->tiles;
         mi_tcd_tilecomp_t * l_tile_comp = p_tcd->tcd_image->tiles->comps;
@@ -1852,6 +2485,19 @@ static mi_BOOL mi_tcd_mct_encode ( mi_tcd_t *p_tcd )
 
                 mi_free(l_data);
         }
+        else if (p_dc_shift) {
+                mi_INT32 l_dc_shift[3];
+
+                for (i = 0; i < 3; ++i) {
+                        l_dc_shift[i] = l_tcp->tccps[i].m_dc_level_shift;
+                }
+                if (l_tcp->tccps->qmfbid == 0) {
+                        mi_mct_encode_real_dc_shift(l_tile->comps[0].data, l_tile->comps[1].data, l_tile->comps[2].data, samples, l_dc_shift);
+                }
+                else {
+                        mi_mct_encode_dc_shift(l_tile->comps[0].data, l_tile->comps[1].data, l_tile->comps[2].data, samples, l_dc_shift);
+                }
+        }
         else if (l_tcp->tccps->qmfbid == 0) {
                 mi_mct_encode_real(l_tile->comps[0].data, l_tile->comps[1].data, l_tile->comps[2].data, samples);
         }
@@ -1871,12 +2517,12 @@ static mi_BOOL mi_tcd_dwt_encode ( mi_tcd_t *p_tcd )
 
         for (compno = 0; compno < l_tile->numcomps; ++compno) {
                 if (l_tccp->qmfbid == 1) {
-                        if (! mi_dwt_encode(l_tile_comp)) {
+                        if (! mi_dwt_encode(p_tcd->thread_pool, l_tile_comp)) {
                                 return mi_FALSE;
                         }
                 }
                 else if (l_tccp->qmfbid == 0) {
-                        if (! mi_dwt_encode_real(l_tile_comp)) {
+                        if (! mi_dwt_encode_real(p_tcd->thread_pool, l_tile_comp)) {
                                 return mi_FALSE;
                         }
                 }
@@ -1890,16 +2536,10 @@ static mi_BOOL mi_tcd_dwt_encode ( mi_tcd_t *p_tcd )
 
 static mi_BOOL mi_tcd_t1_encode ( mi_tcd_t *p_tcd )
 {
-        mi_t1_t * l_t1;
         const mi_FLOAT64 * l_mct_norms;
         mi_UINT32 l_mct_numcomps = 0U;
         mi_tcp_t * l_tcp = p_tcd->tcp;
 
-        l_t1 = mi_t1_create(mi_TRUE);
-        if (l_t1 == 00) {
-                return mi_FALSE;
-        }
-
         if (l_tcp->mct == 1) {
                 l_mct_numcomps = 3U;
                 /* irreversible encoding */
@@ -1915,21 +2555,15 @@ static mi_BOOL mi_tcd_t1_encode ( mi_tcd_t *p_tcd )
                 l_mct_norms = (const mi_FLOAT64 *) (l_tcp->mct_norms);
         }
 
-        if (! mi_t1_encode_cblks(l_t1, p_tcd->tcd_image->tiles , l_tcp, l_mct_norms, l_mct_numcomps)) {
-        mi_t1_destroy(l_t1);
-                return mi_FALSE;
-        }
-
-        mi_t1_destroy(l_t1);
-
-        return mi_TRUE;
+        return mi_t1_encode_cblks(p_tcd->thread_pool, p_tcd->tcd_image->tiles , l_tcp, l_mct_norms, l_mct_numcomps);
 }
 
 static mi_BOOL mi_tcd_t2_encode (mi_tcd_t *p_tcd,
                                                 mi_BYTE * p_dest_data,
                                                 mi_UINT32 * p_data_written,
                                                 mi_UINT32 p_max_dest_size,
-                                                mi_codestream_info_t *p_cstr_info )
+                                                mi_codestream_info_t *p_cstr_info,
+                                                mi_tcd_marker_info_t *p_marker_info )
 {
         mi_t2_t * l_t2;
 
@@ -1950,7 +2584,8 @@ static mi_BOOL mi_tcd_t2_encode (mi_tcd_t *p_tcd,
                                         p_tcd->tp_num,
                                         p_tcd->tp_pos,
                                         p_tcd->cur_pino,
-                                        FINAL_PASS))
+                                        FINAL_PASS,
+                                        p_marker_info))
         {
                 mi_t2_destroy(l_t2);
                 return mi_FALSE;
@@ -12,6 +12,9 @@ each other. The functions in TCD.C are used by other functions in J2K.C.
 /** @defgroup TCD TCD - Implementation of a tile coder/decoder */
 /*@{*/
 
+/** minimum size of the blocks of the arena of a tile coder/decoder */
+#define mi_TCD_ARENA_BLOCK_SIZE (256U * 1024U)
+
 /**
 FIXME DOC
 */
@@ -32,6 +35,8 @@ FIXME DOC
 typedef struct mi_tcd_pass {
 	mi_UINT32 rate;
 	mi_FLOAT64 distortiondec;
+	/** distortion decrease of this pass alone (fixed_quality) */
+	mi_FLOAT64 wmsedec;
 	mi_UINT32 len;
 	mi_UINT32 term : 1;
 } mi_tcd_pass_t;
@@ -103,6 +108,7 @@ typedef struct mi_tcd_band {
 	mi_UINT32 precincts_data_size;	/* size of data taken by precincts */
 	mi_INT32 numbps;//Ӵֵλ
 	mi_FLOAT32 stepsize;//
+	mi_UINT32 win_x0, win_y0, win_x1, win_y1;	/* coefficients needed by the decoded area, relative to (x0, y0) */
 } mi_tcd_band_t;
 
 /**
@@ -113,6 +119,7 @@ typedef struct mi_tcd_resolution {
 	mi_UINT32 pw, ph;//һֱں/
 	mi_UINT32 numbands;			/* number sub-band for the resolution level */
 	mi_tcd_band_t bands[3];		/* subband information */
+	mi_UINT32 win_x0, win_y0, win_x1, win_y1;	/* samples needed by the decoded area, relative to (x0, y0) */
 } mi_tcd_resolution_t;
 
 /**
@@ -155,6 +162,19 @@ typedef struct mi_tcd_image
 }
 mi_tcd_image_t;
 
+/**
+Information gathered while the packets of a tile-part are encoded, to write
+the markers of its header
+*/
+typedef struct mi_tcd_marker_info
+{
+	/** tell if the packet lengths are collected (PLT marker) */
+	mi_BOOL need_PLT;
+	/** number of packets written in the tile-part */
+	mi_UINT32 packet_count;
+	/** length of each packet of the tile-part, including its header */
+	mi_UINT32 *p_packet_size;
+} mi_tcd_marker_info_t;
 
 /**
 Tile coder/decoder
@@ -183,6 +203,18 @@ typedef struct mi_tcd
 	mi_UINT32 tcd_tileno;
 	/** tell if the tcd is a decoder. */
 	mi_UINT32 m_is_decoder : 1;
+	/** thread pool used for the tier-1 coding of the code-blocks */
+	mi_thread_pool_t* thread_pool;
+	/** tell if mi_tcd_pre_encode_tile has already been run on the current tile. */
+	mi_UINT32 m_is_tile_coded : 1;
+	/** area of the reference grid to decode (the whole tile unless mi_tcd_set_decode_area is called) */
+	mi_UINT32 win_x0, win_y0, win_x1, win_y1;
+	/** arena of the resolutions, precincts, code-blocks and tag trees of the current tile, reset by each mi_tcd_init_*_tile */
+	mi_arena_t m_arena;
+	/** buffer of the caller receiving the decoded samples instead of the tile components, 00 if none */
+	const mi_decode_buffer_t * m_output;
+	/** area of the decoded resolution covered by m_output */
+	mi_UINT32 m_output_x0, m_output_y0, m_output_x1, m_output_y1;
 } mi_tcd_t;
 
 /** @name Exported functions */
@@ -212,12 +244,14 @@ void mi_tcd_destroy(mi_tcd_t *tcd);
  * @param	p_tcd		TCD handle.
  * @param	p_image		raw image.
  * @param	p_cp		coding parameters.
+ * @param	p_tp		thread pool (shared with the codec, not owned by the TCD).
  *
  * @return true if the encoding values could be set (false otherwise).
 */
 mi_BOOL mi_tcd_init(	mi_tcd_t *p_tcd,
 						mi_image_t * p_image,
-						mi_cp_t * p_cp );
+						mi_cp_t * p_cp,
+						mi_thread_pool_t* p_tp );
 
 /**
  * Allocates memory for decoding a specific tile.
@@ -231,6 +265,35 @@ mi_BOOL mi_tcd_init(	mi_tcd_t *p_tcd,
  */
 mi_BOOL mi_tcd_init_decode_tile(mi_tcd_t *p_tcd, mi_UINT32 p_tile_no, mi_event_mgr_t* p_manager);
 
+/**
+ * Restricts the decoding of the current tile to an area of the reference grid.
+ * Only the code-blocks and the samples of the wavelet transform which the
+ * area depends on are decoded, the other samples of the tile being undefined.
+ * mi_tcd_init_decode_tile resets the area to the whole tile.
+ *
+ * @param	p_tcd		the tile decoder.
+ * @param	p_x0		left of the area.
+ * @param	p_y0		top of the area.
+ * @param	p_x1		right of the area (excluded).
+ * @param	p_y1		bottom of the area (excluded).
+ */
+void mi_tcd_set_decode_area(mi_tcd_t *p_tcd, mi_UINT32 p_x0, mi_UINT32 p_y0, mi_UINT32 p_x1, mi_UINT32 p_y1);
+
+/**
+ * Makes the DC level shift of the decoded tiles write the samples of the
+ * decoded area into a buffer of the caller, the tile components not being
+ * updated any more (mi_tcd_update_tile_data is not needed).
+ *
+ * @param	p_tcd		the tile decoder.
+ * @param	p_output	the buffer, 00 to decode into the tile components again.
+ * @param	p_x0		left of the area covered by the buffer, in the coordinates of the decoded resolution.
+ * @param	p_y0		top of the area.
+ * @param	p_x1		right of the area (excluded).
+ * @param	p_y1		bottom of the area (excluded).
+ */
+void mi_tcd_set_output(mi_tcd_t *p_tcd, const mi_decode_buffer_t *p_output,
+                       mi_UINT32 p_x0, mi_UINT32 p_y0, mi_UINT32 p_x1, mi_UINT32 p_y1);
+
 void mi_tcd_makelayer_fixed(mi_tcd_t *tcd, mi_UINT32 layno, mi_UINT32 final);
 
 void mi_tcd_rateallocate_fixed(mi_tcd_t *tcd);
@@ -259,6 +322,7 @@ mi_UINT32 mi_tcd_get_decoded_tile_size (mi_tcd_t *p_tcd );
  * @param	p_data_written	pointer to an int that is incremented by the number of bytes really written on p_dest
  * @param	p_len			Maximum length of the destination buffer
  * @param	p_cstr_info		Codestream information structure
+ * @param	p_marker_info	Receives the lengths of the packets written, if not null
  * @return  true if the coding is successful.
 */
 mi_BOOL mi_tcd_encode_tile(   mi_tcd_t *p_tcd,
@@ -266,6 +330,38 @@ mi_BOOL mi_tcd_encode_tile(   mi_tcd_t *p_tcd,
 							    mi_BYTE *p_dest,
 							    mi_UINT32 * p_data_written,
 							    mi_UINT32 p_len,
+							    struct mi_codestream_info *p_cstr_info,
+							    mi_tcd_marker_info_t *p_marker_info);
+
+/**
+ * Creates the marker information of a tile-part of the tile being encoded.
+ * @param	p_tcd			Tile Coder handle
+ * @param	p_need_PLT		true if the packet lengths have to be collected
+ * @return  the marker information, or 00 if there is not enough memory.
+*/
+mi_tcd_marker_info_t * mi_tcd_marker_info_create(mi_tcd_t *p_tcd, mi_BOOL p_need_PLT);
+
+/**
+ * Destroys the marker information created by mi_tcd_marker_info_create.
+*/
+void mi_tcd_marker_info_destroy(mi_tcd_marker_info_t *p_marker_info);
+
+/**
+ * Runs the tile level coding of a tile (DC level shift, MCT, DWT, tier-1 and
+ * rate allocation), so that the next mi_tcd_encode_tile call on the first
+ * tile-part of the tile only performs tier-2 coding.
+ * mi_tcd_encode_tile calls it itself when it has not been done beforehand.
+ * @param	p_tcd			Tile Coder handle
+ * @param	p_tile_no		Index of the tile to encode.
+ * @param	p_dest			Scratch buffer used by the rate allocation
+ * @param	p_len			Maximum length of the first tile-part data
+ * @param	p_cstr_info		Codestream information structure
+ * @return  true if the coding is successful.
+*/
+mi_BOOL mi_tcd_pre_encode_tile(   mi_tcd_t *p_tcd,
+							    mi_UINT32 p_tile_no,
+							    mi_BYTE *p_dest,
+							    mi_UINT32 p_len,
 							    struct mi_codestream_info *p_cstr_info);
 
 
@@ -285,6 +381,25 @@ mi_BOOL mi_tcd_decode_tile(   mi_tcd_t *tcd,
 							    mi_codestream_index_t *cstr_info,
 							    mi_event_mgr_t *manager);
 
+/**
+Read the packet headers of a tile without decoding the packets, giving the length of each packet
+(header and data) in the order of the packet schedule of the tile
+@param tcd TCD handle, initialized for the tile by mi_tcd_init_decode_tile
+@param src Source buffer
+@param len Length of source buffer
+@param tileno Number that identifies the tile
+@param lengths receives the packet lengths, reallocated if needed
+@param max_nb_lengths number of packet lengths *lengths can hold
+@param manager the event manager.
+*/
+mi_BOOL mi_tcd_get_packet_lengths(   mi_tcd_t *tcd,
+							    mi_BYTE *src,
+							    mi_UINT32 len,
+							    mi_UINT32 tileno,
+							    mi_UINT32 **lengths,
+							    mi_UINT32 *max_nb_lengths,
+							    mi_event_mgr_t *manager);
+
 
 /**
  * Copies tile data from the system onto the given memory block.
@@ -1,23 +1,88 @@
 
 #include "mi_includes.h"
 
+/**
+Counts the nodes of a tag-tree
+@param numleafsh Width of the array of leafs of the tree
+@param numleafsv Height of the array of leafs of the tree
+@param nplh Receives the width of each level of the tree
+@param nplv Receives the height of each level of the tree
+@param numlvls Receives the number of levels of the tree
+@return the number of nodes of the tree
+*/
+static mi_UINT32 mi_tgt_count_nodes(mi_UINT32 numleafsh, mi_UINT32 numleafsv, mi_INT32 *nplh, mi_INT32 *nplv, mi_UINT32 *numlvls);
+
+/**
+Links the nodes of a tag-tree to their parents, and resets the tree
+@param tree Tag-tree whose numleafsh, numleafsv and nodes are set
+@param nplh Width of each level of the tree
+@param nplv Height of each level of the tree
+@param numlvls Number of levels of the tree
+*/
+static void mi_tgt_link_nodes(mi_tgt_tree_t *tree, const mi_INT32 *nplh, const mi_INT32 *nplv, mi_UINT32 numlvls);
+
 /* 
 ==========================================================
    Tag-tree coder interface
 ==========================================================
 */
 
+static mi_UINT32 mi_tgt_count_nodes(mi_UINT32 numleafsh, mi_UINT32 numleafsv, mi_INT32 *nplh, mi_INT32 *nplv, mi_UINT32 *numlvls)
+{
+        mi_UINT32 l_numnodes = 0;
+        mi_UINT32 n;
+
+        *numlvls = 0;
+        nplh[0] = (mi_INT32)numleafsh;
+        nplv[0] = (mi_INT32)numleafsv;
+        do {
+                n = (mi_UINT32)(nplh[*numlvls] * nplv[*numlvls]);
+                nplh[*numlvls + 1] = (nplh[*numlvls] + 1) / 2;
+                nplv[*numlvls + 1] = (nplv[*numlvls] + 1) / 2;
+                l_numnodes += n;
+                ++(*numlvls);
+        } while (n > 1);
+
+        return l_numnodes;
+}
+
+static void mi_tgt_link_nodes(mi_tgt_tree_t *tree, const mi_INT32 *nplh, const mi_INT32 *nplv, mi_UINT32 numlvls)
+{
+        mi_tgt_node_t *node = tree->nodes;
+        mi_tgt_node_t *l_parent_node = &tree->nodes[tree->numleafsh * tree->numleafsv];
+        mi_tgt_node_t *l_parent_node0 = l_parent_node;
+        mi_UINT32 i;
+        mi_INT32  j,k;
+
+        for (i = 0; i < numlvls - 1; ++i) {
+                for (j = 0; j < nplv[i]; ++j) {
+                        k = nplh[i];
+                        while (--k >= 0) {
+                                node->parent = l_parent_node;
+                                ++node;
+                                if (--k >= 0) {
+                                        node->parent = l_parent_node;
+                                        ++node;
+                                }
+                                ++l_parent_node;
+                        }
+                        if ((j & 1) || j == nplv[i] - 1) {
+                                l_parent_node0 = l_parent_node;
+                        } else {
+                                l_parent_node = l_parent_node0;
+                                l_parent_node0 += nplh[i];
+                        }
+                }
+        }
+        node->parent = 0;
+        mi_tgt_reset(tree);
+}
+
 mi_tgt_tree_t *mi_tgt_create(mi_UINT32 numleafsh, mi_UINT32 numleafsv, mi_event_mgr_t *manager) {
         mi_INT32 nplh[32];
         mi_INT32 nplv[32];
-        mi_tgt_node_t *node = 00;
-        mi_tgt_node_t *l_parent_node = 00;
-        mi_tgt_node_t *l_parent_node0 = 00;
         mi_tgt_tree_t *tree = 00;
-        mi_UINT32 i;
-        mi_INT32  j,k;
         mi_UINT32 numlvls;
-        mi_UINT32 n;
 
         tree = (mi_tgt_tree_t *) mi_calloc(1,sizeof(mi_tgt_tree_t));
         if(!tree) {
@@ -27,18 +92,7 @@ mi_tgt_tree_t *mi_tgt_create(mi_UINT32 numleafsh, mi_UINT32 numleafsv, mi_event_
 
         tree->numleafsh = numleafsh;
         tree->numleafsv = numleafsv;
-
-        numlvls = 0;
-        nplh[0] = (mi_INT32)numleafsh;
-        nplv[0] = (mi_INT32)numleafsv;
-        tree->numnodes = 0;
-        do {
-                n = (mi_UINT32)(nplh[numlvls] * nplv[numlvls]);
-                nplh[numlvls + 1] = (nplh[numlvls] + 1) / 2;
-                nplv[numlvls + 1] = (nplv[numlvls] + 1) / 2;
-                tree->numnodes += n;
-                ++numlvls;
-        } while (n > 1);
+        tree->numnodes = mi_tgt_count_nodes(numleafsh, numleafsv, nplh, nplv, &numlvls);
 
         /* ADD */
         if (tree->numnodes == 0) {
@@ -55,32 +109,39 @@ mi_tgt_tree_t *mi_tgt_create(mi_UINT32 numleafsh, mi_UINT32 numleafsv, mi_event_
         }
         tree->nodes_size = tree->numnodes * (mi_UINT32)sizeof(mi_tgt_node_t);
 
-        node = tree->nodes;
-        l_parent_node = &tree->nodes[tree->numleafsh * tree->numleafsv];
-        l_parent_node0 = l_parent_node;
+        mi_tgt_link_nodes(tree, nplh, nplv, numlvls);
+        return tree;
+}
 
-        for (i = 0; i < numlvls - 1; ++i) {
-                for (j = 0; j < nplv[i]; ++j) {
-                        k = nplh[i];
-                        while (--k >= 0) {
-                                node->parent = l_parent_node;
-                                ++node;
-                                if (--k >= 0) {
-                                        node->parent = l_parent_node;
-                                        ++node;
-                                }
-                                ++l_parent_node;
-                        }
-                        if ((j & 1) || j == nplv[i] - 1) {
-                                l_parent_node0 = l_parent_node;
-                        } else {
-                                l_parent_node = l_parent_node0;
-                                l_parent_node0 += nplh[i];
-                        }
-                }
+mi_tgt_tree_t *mi_tgt_create_arena(mi_arena_t *arena, mi_UINT32 numleafsh, mi_UINT32 numleafsv, mi_event_mgr_t *manager)
+{
+        mi_INT32 nplh[32];
+        mi_INT32 nplv[32];
+        mi_tgt_tree_t *tree = 00;
+        mi_UINT32 numlvls;
+        mi_UINT32 numnodes;
+
+        numnodes = mi_tgt_count_nodes(numleafsh, numleafsv, nplh, nplv, &numlvls);
+        if (numnodes == 0) {
+                mi_event_msg(manager, EVT_WARNING, "tgt_create tree->numnodes == 0, no tree created.\n");
+                return 00;
         }
-        node->parent = 0;
-        mi_tgt_reset(tree);
+
+        tree = (mi_tgt_tree_t *) mi_arena_alloc(arena, sizeof(mi_tgt_tree_t));
+        if (tree) {
+                tree->nodes = (mi_tgt_node_t*) mi_arena_alloc(arena, numnodes * sizeof(mi_tgt_node_t));
+        }
+        if (!tree || !tree->nodes) {
+                mi_event_msg(manager, EVT_ERROR, "Not enough memory to create Tag-tree\n");
+                return 00;
+        }
+        tree->numleafsh = numleafsh;
+        tree->numleafsv = numleafsv;
+        tree->numnodes = numnodes;
+        tree->nodes_size = numnodes * (mi_UINT32)sizeof(mi_tgt_node_t);
+
+        /* mi_tgt_reset sets the values of all the nodes */
+        mi_tgt_link_nodes(tree, nplh, nplv, numlvls);
         return tree;
 }
 
@@ -46,6 +46,15 @@ Create a tag-tree
 */
 mi_tgt_tree_t *mi_tgt_create(mi_UINT32 numleafsh, mi_UINT32 numleafsv, mi_event_mgr_t *manager);
 
+/**
+Create a tag-tree in an arena, the tree being released with the arena (not by mi_tgt_destroy)
+@param arena Arena the tree is allocated from
+@param numleafsh Width of the array of leafs of the tree
+@param numleafsv Height of the array of leafs of the tree
+@return Returns a new tag-tree if successful, returns NULL otherwise
+*/
+mi_tgt_tree_t *mi_tgt_create_arena(mi_arena_t *arena, mi_UINT32 numleafsh, mi_UINT32 numleafsv, mi_event_mgr_t *manager);
+
 /**
  * Reinitialises a tag-tree from an exixting one.
  *
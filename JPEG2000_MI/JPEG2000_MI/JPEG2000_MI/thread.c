@@ -0,0 +1,700 @@
+
+#include "mi_includes.h"
+
+#if defined(_WIN32)
+#define mi_MUTEX_WIN32
+#elif defined(__unix__) || defined(__unix) || defined(__APPLE__)
+#define mi_MUTEX_PTHREAD
+#endif
+
+#if defined(mi_MUTEX_WIN32)
+#include <windows.h>
+#include <process.h>
+#elif defined(mi_MUTEX_PTHREAD)
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+/* ----------------------------------------------------------------------- */
+/* Native primitives                                                       */
+/* ----------------------------------------------------------------------- */
+
+#if defined(mi_MUTEX_WIN32)
+
+mi_BOOL mi_has_thread_support(void)
+{
+	return mi_TRUE;
+}
+
+int mi_get_num_cpus(void)
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (info.dwNumberOfProcessors < 1) ? 1 : (int)info.dwNumberOfProcessors;
+}
+
+struct mi_mutex
+{
+	CRITICAL_SECTION cs;
+};
+
+mi_mutex_t* mi_mutex_create(void)
+{
+	mi_mutex_t* mutex = (mi_mutex_t*) mi_malloc(sizeof(mi_mutex_t));
+	if (!mutex) {
+		return 00;
+	}
+	InitializeCriticalSectionAndSpinCount(&(mutex->cs), 4000);
+	return mutex;
+}
+
+void mi_mutex_lock(mi_mutex_t* mutex)
+{
+	EnterCriticalSection(&(mutex->cs));
+}
+
+void mi_mutex_unlock(mi_mutex_t* mutex)
+{
+	LeaveCriticalSection(&(mutex->cs));
+}
+
+void mi_mutex_destroy(mi_mutex_t* mutex)
+{
+	if (!mutex) {
+		return;
+	}
+	DeleteCriticalSection(&(mutex->cs));
+	mi_free(mutex);
+}
+
+struct mi_cond
+{
+	CONDITION_VARIABLE cv;
+};
+
+mi_cond_t* mi_cond_create(void)
+{
+	mi_cond_t* cond = (mi_cond_t*) mi_malloc(sizeof(mi_cond_t));
+	if (!cond) {
+		return 00;
+	}
+	InitializeConditionVariable(&(cond->cv));
+	return cond;
+}
+
+void mi_cond_wait(mi_cond_t* cond, mi_mutex_t* mutex)
+{
+	SleepConditionVariableCS(&(cond->cv), &(mutex->cs), INFINITE);
+}
+
+void mi_cond_signal(mi_cond_t* cond)
+{
+	WakeConditionVariable(&(cond->cv));
+}
+
+void mi_cond_broadcast(mi_cond_t* cond)
+{
+	WakeAllConditionVariable(&(cond->cv));
+}
+
+void mi_cond_destroy(mi_cond_t* cond)
+{
+	mi_free(cond);
+}
+
+struct mi_thread
+{
+	mi_thread_fn thread_fn;
+	void* user_data;
+	HANDLE hThread;
+};
+
+static unsigned int __stdcall mi_thread_callback_adapter(void *info)
+{
+	mi_thread_t* thread = (mi_thread_t*) info;
+	thread->thread_fn(thread->user_data);
+	return 0;
+}
+
+mi_thread_t* mi_thread_create(mi_thread_fn thread_fn, void* user_data)
+{
+	mi_thread_t* thread = (mi_thread_t*) mi_malloc(sizeof(mi_thread_t));
+	if (!thread) {
+		return 00;
+	}
+	thread->thread_fn = thread_fn;
+	thread->user_data = user_data;
+	thread->hThread = (HANDLE)_beginthreadex(00, 0, mi_thread_callback_adapter, thread, 0, 00);
+	if (thread->hThread == 00) {
+		mi_free(thread);
+		return 00;
+	}
+	return thread;
+}
+
+void mi_thread_join(mi_thread_t* thread)
+{
+	WaitForSingleObject(thread->hThread, INFINITE);
+	CloseHandle(thread->hThread);
+	mi_free(thread);
+}
+
+#elif defined(mi_MUTEX_PTHREAD)
+
+mi_BOOL mi_has_thread_support(void)
+{
+	return mi_TRUE;
+}
+
+int mi_get_num_cpus(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+	long l_num = sysconf(_SC_NPROCESSORS_ONLN);
+	return (l_num < 1) ? 1 : (int)l_num;
+#else
+	return 1;
+#endif
+}
+
+struct mi_mutex
+{
+	pthread_mutex_t mutex;
+};
+
+mi_mutex_t* mi_mutex_create(void)
+{
+	mi_mutex_t* mutex = (mi_mutex_t*) mi_malloc(sizeof(mi_mutex_t));
+	if (!mutex) {
+		return 00;
+	}
+	if (pthread_mutex_init(&(mutex->mutex), 00) != 0) {
+		mi_free(mutex);
+		return 00;
+	}
+	return mutex;
+}
+
+void mi_mutex_lock(mi_mutex_t* mutex)
+{
+	pthread_mutex_lock(&(mutex->mutex));
+}
+
+void mi_mutex_unlock(mi_mutex_t* mutex)
+{
+	pthread_mutex_unlock(&(mutex->mutex));
+}
+
+void mi_mutex_destroy(mi_mutex_t* mutex)
+{
+	if (!mutex) {
+		return;
+	}
+	pthread_mutex_destroy(&(mutex->mutex));
+	mi_free(mutex);
+}
+
+struct mi_cond
+{
+	pthread_cond_t cond;
+};
+
+mi_cond_t* mi_cond_create(void)
+{
+	mi_cond_t* cond = (mi_cond_t*) mi_malloc(sizeof(mi_cond_t));
+	if (!cond) {
+		return 00;
+	}
+	if (pthread_cond_init(&(cond->cond), 00) != 0) {
+		mi_free(cond);
+		return 00;
+	}
+	return cond;
+}
+
+void mi_cond_wait(mi_cond_t* cond, mi_mutex_t* mutex)
+{
+	pthread_cond_wait(&(cond->cond), &(mutex->mutex));
+}
+
+void mi_cond_signal(mi_cond_t* cond)
+{
+	pthread_cond_signal(&(cond->cond));
+}
+
+void mi_cond_broadcast(mi_cond_t* cond)
+{
+	pthread_cond_broadcast(&(cond->cond));
+}
+
+void mi_cond_destroy(mi_cond_t* cond)
+{
+	if (!cond) {
+		return;
+	}
+	pthread_cond_destroy(&(cond->cond));
+	mi_free(cond);
+}
+
+struct mi_thread
+{
+	mi_thread_fn thread_fn;
+	void* user_data;
+	pthread_t thread;
+};
+
+static void* mi_thread_callback_adapter(void* info)
+{
+	mi_thread_t* thread = (mi_thread_t*) info;
+	thread->thread_fn(thread->user_data);
+	return 00;
+}
+
+mi_thread_t* mi_thread_create(mi_thread_fn thread_fn, void* user_data)
+{
+	mi_thread_t* thread = (mi_thread_t*) mi_malloc(sizeof(mi_thread_t));
+	if (!thread) {
+		return 00;
+	}
+	thread->thread_fn = thread_fn;
+	thread->user_data = user_data;
+	if (pthread_create(&(thread->thread), 00, mi_thread_callback_adapter, thread) != 0) {
+		mi_free(thread);
+		return 00;
+	}
+	return thread;
+}
+
+void mi_thread_join(mi_thread_t* thread)
+{
+	void* status;
+	pthread_join(thread->thread, &status);
+	mi_free(thread);
+}
+
+#else
+
+/* No thread support: every primitive fails, the pool is synchronous */
+
+mi_BOOL mi_has_thread_support(void)
+{
+	return mi_FALSE;
+}
+
+int mi_get_num_cpus(void)
+{
+	return 1;
+}
+
+mi_mutex_t* mi_mutex_create(void)
+{
+	return 00;
+}
+
+void mi_mutex_lock(mi_mutex_t* mutex)
+{
+	(void) mutex;
+}
+
+void mi_mutex_unlock(mi_mutex_t* mutex)
+{
+	(void) mutex;
+}
+
+void mi_mutex_destroy(mi_mutex_t* mutex)
+{
+	(void) mutex;
+}
+
+mi_cond_t* mi_cond_create(void)
+{
+	return 00;
+}
+
+void mi_cond_wait(mi_cond_t* cond, mi_mutex_t* mutex)
+{
+	(void) cond;
+	(void) mutex;
+}
+
+void mi_cond_signal(mi_cond_t* cond)
+{
+	(void) cond;
+}
+
+void mi_cond_broadcast(mi_cond_t* cond)
+{
+	(void) cond;
+}
+
+void mi_cond_destroy(mi_cond_t* cond)
+{
+	(void) cond;
+}
+
+mi_thread_t* mi_thread_create(mi_thread_fn thread_fn, void* user_data)
+{
+	(void) thread_fn;
+	(void) user_data;
+	return 00;
+}
+
+void mi_thread_join(mi_thread_t* thread)
+{
+	(void) thread;
+}
+
+#endif
+
+/* ----------------------------------------------------------------------- */
+/* Thread local storage                                                    */
+/* ----------------------------------------------------------------------- */
+
+typedef struct mi_tls_key_val
+{
+	int key;
+	void* value;
+	mi_tls_free_func free_func;
+} mi_tls_key_val_t;
+
+struct mi_tls
+{
+	mi_tls_key_val_t* key_val;
+	int key_val_count;
+};
+
+static mi_tls_t* mi_tls_new(void)
+{
+	return (mi_tls_t*) mi_calloc(1, sizeof(mi_tls_t));
+}
+
+static void mi_tls_destroy(mi_tls_t* tls)
+{
+	int i;
+	if (!tls) {
+		return;
+	}
+	for (i = 0; i < tls->key_val_count; i++) {
+		if (tls->key_val[i].free_func) {
+			tls->key_val[i].free_func(tls->key_val[i].value);
+		}
+	}
+	mi_free(tls->key_val);
+	mi_free(tls);
+}
+
+void* mi_tls_get(mi_tls_t* tls, int key)
+{
+	int i;
+	for (i = 0; i < tls->key_val_count; i++) {
+		if (tls->key_val[i].key == key) {
+			return tls->key_val[i].value;
+		}
+	}
+	return 00;
+}
+
+mi_BOOL mi_tls_set(mi_tls_t* tls, int key, void* value, mi_tls_free_func free_func)
+{
+	mi_tls_key_val_t* l_new_key_val;
+	int i;
+
+	for (i = 0; i < tls->key_val_count; i++) {
+		if (tls->key_val[i].key == key) {
+			if (tls->key_val[i].free_func) {
+				tls->key_val[i].free_func(tls->key_val[i].value);
+			}
+			tls->key_val[i].value = value;
+			tls->key_val[i].free_func = free_func;
+			return mi_TRUE;
+		}
+	}
+	l_new_key_val = (mi_tls_key_val_t*) mi_realloc(tls->key_val,
+		((size_t)tls->key_val_count + 1U) * sizeof(mi_tls_key_val_t));
+	if (!l_new_key_val) {
+		return mi_FALSE;
+	}
+	tls->key_val = l_new_key_val;
+	l_new_key_val[tls->key_val_count].key = key;
+	l_new_key_val[tls->key_val_count].value = value;
+	l_new_key_val[tls->key_val_count].free_func = free_func;
+	tls->key_val_count ++;
+	return mi_TRUE;
+}
+
+/* ----------------------------------------------------------------------- */
+/* Thread pool                                                             */
+/* ----------------------------------------------------------------------- */
+
+typedef struct mi_worker_thread_job
+{
+	mi_job_fn job_fn;
+	void* user_data;
+	/** group of the job, or 00 */
+	mi_job_group_t* group;
+	struct mi_worker_thread_job* next;
+} mi_worker_thread_job_t;
+
+typedef struct mi_worker_thread
+{
+	mi_thread_pool_t* tp;
+	mi_thread_t* thread;
+	/** thread local storage of the worker, destroyed by the worker when it ends */
+	mi_tls_t* tls;
+} mi_worker_thread_t;
+
+struct mi_thread_pool
+{
+	mi_worker_thread_t* worker_threads;
+	int worker_threads_count;
+	/** protects the job queue, the pending count and the stop flag */
+	mi_mutex_t* mutex;
+	/** signaled when a job is queued or the pool is stopping */
+	mi_cond_t* job_cond;
+	/** signaled when a job has been completed */
+	mi_cond_t* done_cond;
+	/** FIFO of queued jobs */
+	mi_worker_thread_job_t* job_queue_head;
+	mi_worker_thread_job_t* job_queue_tail;
+	/** number of jobs queued or running */
+	int pending_jobs_count;
+	mi_BOOL stop;
+	/** thread local storage of the caller for a synchronous pool */
+	mi_tls_t* tls;
+};
+
+struct mi_job_group
+{
+	mi_thread_pool_t* tp;
+	/** number of jobs of the group queued or running, protected by the mutex of the pool */
+	int pending_jobs_count;
+};
+
+/**
+Main function of a worker thread: pops and runs jobs until the pool stops.
+*/
+static void mi_worker_thread_function(void* user_data);
+
+/**
+Start the worker threads of a pool.
+*/
+static mi_BOOL mi_thread_pool_setup(mi_thread_pool_t* tp, int num_threads);
+
+/**
+Queue a job, or run it for a synchronous pool.
+*/
+static mi_BOOL mi_thread_pool_submit(mi_thread_pool_t* tp, mi_job_group_t* group, mi_job_fn job_fn, void* user_data);
+
+mi_thread_pool_t* mi_thread_pool_create(int num_threads)
+{
+	mi_thread_pool_t* tp = (mi_thread_pool_t*) mi_calloc(1, sizeof(mi_thread_pool_t));
+	if (!tp) {
+		return 00;
+	}
+	if (num_threads <= 0 || !mi_has_thread_support()) {
+		tp->tls = mi_tls_new();
+		if (!tp->tls) {
+			mi_free(tp);
+			return 00;
+		}
+		return tp;
+	}
+	if (!mi_thread_pool_setup(tp, num_threads)) {
+		mi_thread_pool_destroy(tp);
+		return 00;
+	}
+	return tp;
+}
+
+static mi_BOOL mi_thread_pool_setup(mi_thread_pool_t* tp, int num_threads)
+{
+	int i;
+
+	tp->mutex = mi_mutex_create();
+	tp->job_cond = mi_cond_create();
+	tp->done_cond = mi_cond_create();
+	tp->worker_threads = (mi_worker_thread_t*) mi_calloc((size_t)num_threads, sizeof(mi_worker_thread_t));
+	if (!tp->mutex || !tp->job_cond || !tp->done_cond || !tp->worker_threads) {
+		return mi_FALSE;
+	}
+	for (i = 0; i < num_threads; i++) {
+		tp->worker_threads[i].tp = tp;
+		tp->worker_threads[i].tls = mi_tls_new();
+		if (!tp->worker_threads[i].tls) {
+			return mi_FALSE;
+		}
+		tp->worker_threads[i].thread = mi_thread_create(mi_worker_thread_function, &(tp->worker_threads[i]));
+		if (!tp->worker_threads[i].thread) {
+			mi_tls_destroy(tp->worker_threads[i].tls);
+			return mi_FALSE;
+		}
+		tp->worker_threads_count ++;
+	}
+	return mi_TRUE;
+}
+
+static void mi_worker_thread_function(void* user_data)
+{
+	mi_worker_thread_t* l_worker = (mi_worker_thread_t*) user_data;
+	mi_thread_pool_t* tp = l_worker->tp;
+	mi_tls_t* l_tls = l_worker->tls;
+	mi_worker_thread_job_t* l_job;
+	mi_job_group_t* l_group;
+
+	for (;;) {
+		mi_mutex_lock(tp->mutex);
+		while (tp->job_queue_head == 00 && !tp->stop) {
+			mi_cond_wait(tp->job_cond, tp->mutex);
+		}
+		l_job = tp->job_queue_head;
+		if (l_job == 00) {
+			/* stop requested and nothing left to do */
+			mi_mutex_unlock(tp->mutex);
+			break;
+		}
+		tp->job_queue_head = l_job->next;
+		if (tp->job_queue_head == 00) {
+			tp->job_queue_tail = 00;
+		}
+		mi_mutex_unlock(tp->mutex);
+
+		l_job->job_fn(l_job->user_data, l_tls);
+		l_group = l_job->group;
+		mi_free(l_job);
+
+		mi_mutex_lock(tp->mutex);
+		tp->pending_jobs_count --;
+		if (l_group) {
+			l_group->pending_jobs_count --;
+		}
+		mi_cond_broadcast(tp->done_cond);
+		mi_mutex_unlock(tp->mutex);
+	}
+
+	mi_tls_destroy(l_tls);
+}
+
+mi_BOOL mi_thread_pool_submit_job(mi_thread_pool_t* tp, mi_job_fn job_fn, void* user_data)
+{
+	return mi_thread_pool_submit(tp, 00, job_fn, user_data);
+}
+
+static mi_BOOL mi_thread_pool_submit(mi_thread_pool_t* tp, mi_job_group_t* group, mi_job_fn job_fn, void* user_data)
+{
+	mi_worker_thread_job_t* l_job;
+
+	if (tp->worker_threads_count == 0) {
+		job_fn(user_data, tp->tls);
+		return mi_TRUE;
+	}
+
+	l_job = (mi_worker_thread_job_t*) mi_malloc(sizeof(mi_worker_thread_job_t));
+	if (!l_job) {
+		return mi_FALSE;
+	}
+	l_job->job_fn = job_fn;
+	l_job->user_data = user_data;
+	l_job->group = group;
+	l_job->next = 00;
+
+	mi_mutex_lock(tp->mutex);
+	if (tp->job_queue_tail) {
+		tp->job_queue_tail->next = l_job;
+	}
+	else {
+		tp->job_queue_head = l_job;
+	}
+	tp->job_queue_tail = l_job;
+	tp->pending_jobs_count ++;
+	if (group) {
+		group->pending_jobs_count ++;
+	}
+	mi_cond_signal(tp->job_cond);
+	mi_mutex_unlock(tp->mutex);
+
+	return mi_TRUE;
+}
+
+void mi_thread_pool_wait_completion(mi_thread_pool_t* tp, int max_remaining_jobs)
+{
+	if (tp->worker_threads_count == 0) {
+		return;
+	}
+	if (max_remaining_jobs < 0) {
+		max_remaining_jobs = 0;
+	}
+	mi_mutex_lock(tp->mutex);
+	while (tp->pending_jobs_count > max_remaining_jobs) {
+		mi_cond_wait(tp->done_cond, tp->mutex);
+	}
+	mi_mutex_unlock(tp->mutex);
+}
+
+mi_job_group_t* mi_job_group_create(mi_thread_pool_t* tp)
+{
+	mi_job_group_t* group = (mi_job_group_t*) mi_calloc(1, sizeof(mi_job_group_t));
+	if (!group) {
+		return 00;
+	}
+	group->tp = tp;
+	return group;
+}
+
+mi_BOOL mi_job_group_submit_job(mi_job_group_t* group, mi_job_fn job_fn, void* user_data)
+{
+	return mi_thread_pool_submit(group->tp, group, job_fn, user_data);
+}
+
+void mi_job_group_wait(mi_job_group_t* group)
+{
+	mi_thread_pool_t* tp = group->tp;
+
+	if (tp->worker_threads_count == 0) {
+		return;
+	}
+	mi_mutex_lock(tp->mutex);
+	while (group->pending_jobs_count > 0) {
+		mi_cond_wait(tp->done_cond, tp->mutex);
+	}
+	mi_mutex_unlock(tp->mutex);
+}
+
+void mi_job_group_destroy(mi_job_group_t* group)
+{
+	if (!group) {
+		return;
+	}
+	mi_job_group_wait(group);
+	mi_free(group);
+}
+
+int mi_thread_pool_get_thread_count(mi_thread_pool_t* tp)
+{
+	return tp->worker_threads_count;
+}
+
+void mi_thread_pool_destroy(mi_thread_pool_t* tp)
+{
+	int i;
+
+	if (!tp) {
+		return;
+	}
+	if (tp->worker_threads_count > 0) {
+		mi_thread_pool_wait_completion(tp, 0);
+
+		mi_mutex_lock(tp->mutex);
+		tp->stop = mi_TRUE;
+		mi_cond_broadcast(tp->job_cond);
+		mi_mutex_unlock(tp->mutex);
+	}
+	for (i = 0; i < tp->worker_threads_count; i++) {
+		mi_thread_join(tp->worker_threads[i].thread);
+	}
+
+	mi_free(tp->worker_threads);
+	mi_cond_destroy(tp->done_cond);
+	mi_cond_destroy(tp->job_cond);
+	mi_mutex_destroy(tp->mutex);
+	mi_tls_destroy(tp->tls);
+	mi_free(tp);
+}
@@ -0,0 +1,253 @@
+
+#ifndef __THREAD_H
+#define __THREAD_H
+/**
+@file thread.h
+@brief Thread API
+
+The functions in THREAD.C give a minimal, portable layer over the native
+thread primitives (Win32 or POSIX threads) and implement a thread pool on top
+of it. When no thread support is available, the pool runs every job in the
+calling thread.
+*/
+
+/** @defgroup THREAD THREAD - Mutex, condition, threads and thread pools */
+/*@{*/
+
+/** Keys of the thread local values used by the library */
+#define mi_TLS_KEY_T1		0	/**< T1 handle of a worker */
+
+/** @name Exported functions */
+/*@{*/
+/* ----------------------------------------------------------------------- */
+
+/**
+Return whether the library has been built with thread support.
+@return mi_TRUE if mutex, condition, thread and thread pool are available.
+*/
+mi_BOOL mi_has_thread_support(void);
+
+/**
+Return the number of logical cores of the machine.
+@return number of cores (at least 1)
+*/
+int mi_get_num_cpus(void);
+
+/**
+Opaque type for a mutex
+*/
+typedef struct mi_mutex mi_mutex_t;
+
+/**
+Create a mutex.
+@return a new mutex, or 00 in case of error or if no thread support
+*/
+mi_mutex_t* mi_mutex_create(void);
+
+/**
+Lock a mutex (blocking call).
+@param mutex mutex to lock
+*/
+void mi_mutex_lock(mi_mutex_t* mutex);
+
+/**
+Unlock a mutex.
+@param mutex mutex to unlock
+*/
+void mi_mutex_unlock(mi_mutex_t* mutex);
+
+/**
+Destroy a mutex.
+@param mutex mutex to destroy
+*/
+void mi_mutex_destroy(mi_mutex_t* mutex);
+
+/**
+Opaque type for a condition
+*/
+typedef struct mi_cond mi_cond_t;
+
+/**
+Create a condition.
+@return a new condition, or 00 in case of error or if no thread support
+*/
+mi_cond_t* mi_cond_create(void);
+
+/**
+Wait for the condition to be signaled.
+The mutex must be locked by the caller; it is released while waiting and
+locked again before returning.
+@param cond  condition to wait on
+@param mutex mutex held by the caller
+*/
+void mi_cond_wait(mi_cond_t* cond, mi_mutex_t* mutex);
+
+/**
+Wake up one thread waiting on the condition.
+@param cond condition to signal
+*/
+void mi_cond_signal(mi_cond_t* cond);
+
+/**
+Wake up every thread waiting on the condition.
+@param cond condition to broadcast
+*/
+void mi_cond_broadcast(mi_cond_t* cond);
+
+/**
+Destroy a condition.
+@param cond condition to destroy
+*/
+void mi_cond_destroy(mi_cond_t* cond);
+
+/**
+Opaque type for a thread handle
+*/
+typedef struct mi_thread mi_thread_t;
+
+/**
+User function to execute in a thread
+@param user_data user data provided with the function
+*/
+typedef void (*mi_thread_fn)(void* user_data);
+
+/**
+Start a new thread.
+@param thread_fn function to run in the new thread
+@param user_data user data provided to the function
+@return a thread handle, or 00 in case of error or if no thread support
+*/
+mi_thread_t* mi_thread_create(mi_thread_fn thread_fn, void* user_data);
+
+/**
+Wait for a thread to be finished and release its handle.
+@param thread thread to wait for
+*/
+void mi_thread_join(mi_thread_t* thread);
+
+/**
+Opaque type for thread local storage.
+Each worker of a thread pool owns one, in which jobs may keep per-thread
+data (for instance a tier-1 coder) alive across jobs.
+*/
+typedef struct mi_tls mi_tls_t;
+
+/**
+Get a thread local value corresponding to the provided key.
+@param tls thread local storage handle
+@param key key whose value to retrieve
+@return value associated with the key, or 00 if there is none
+*/
+void* mi_tls_get(mi_tls_t* tls, int key);
+
+/**
+Function to free a TLS value
+*/
+typedef void (*mi_tls_free_func)(void* value);
+
+/**
+Set a thread local value corresponding to the provided key.
+@param tls       thread local storage handle
+@param key       key whose value to set
+@param value     value to set (may be 00)
+@param free_func function called to free the value when the thread ends or
+                 the value is replaced (may be 00)
+@return mi_TRUE if successful
+*/
+mi_BOOL mi_tls_set(mi_tls_t* tls, int key, void* value, mi_tls_free_func free_func);
+
+/**
+Opaque type for a thread pool
+*/
+typedef struct mi_thread_pool mi_thread_pool_t;
+
+/**
+Job function run by a worker of the pool
+@param user_data user data provided with the function
+@param tls       thread local storage of the worker running the job
+*/
+typedef void (*mi_job_fn)(void* user_data, mi_tls_t* tls);
+
+/**
+Create a thread pool.
+@param num_threads number of worker threads. A value of 0 (or no thread
+                   support) gives a pool that runs the jobs synchronously in
+                   the thread that submits them.
+@return a new thread pool, or 00 in case of error
+*/
+mi_thread_pool_t* mi_thread_pool_create(int num_threads);
+
+/**
+Submit a new job to be run by one of the workers of the pool.
+Jobs are started in submission order. The job function must not wait on the
+pool it runs in.
+@param tp        thread pool
+@param job_fn    function to run
+@param user_data user data provided to the function
+@return mi_TRUE if the job has been queued (or run)
+*/
+mi_BOOL mi_thread_pool_submit_job(mi_thread_pool_t* tp, mi_job_fn job_fn, void* user_data);
+
+/**
+Wait until no more than max_remaining_jobs jobs remain queued or running.
+@param tp                 thread pool
+@param max_remaining_jobs number of jobs allowed to remain (0 to wait for all)
+*/
+void mi_thread_pool_wait_completion(mi_thread_pool_t* tp, int max_remaining_jobs);
+
+/**
+Opaque type for a group of jobs.
+The jobs of a group are run by the workers of its pool along with the other
+jobs of the pool, but can be waited for on their own, so that several stages
+may share one pool.
+*/
+typedef struct mi_job_group mi_job_group_t;
+
+/**
+Create an empty group of jobs.
+@param tp thread pool running the jobs of the group
+@return a new job group, or 00 in case of error
+*/
+mi_job_group_t* mi_job_group_create(mi_thread_pool_t* tp);
+
+/**
+Submit a new job of the group to its thread pool.
+@param group     job group
+@param job_fn    function to run
+@param user_data user data provided to the function
+@return mi_TRUE if the job has been queued (or run)
+*/
+mi_BOOL mi_job_group_submit_job(mi_job_group_t* group, mi_job_fn job_fn, void* user_data);
+
+/**
+Wait until every job submitted to the group has been run.
+The group may be given new jobs afterwards.
+@param group job group
+*/
+void mi_job_group_wait(mi_job_group_t* group);
+
+/**
+Destroy a job group, after having waited for its jobs.
+@param group job group to destroy (may be 00)
+*/
+void mi_job_group_destroy(mi_job_group_t* group);
+
+/**
+Return the number of worker threads of the pool.
+@param tp thread pool
+@return number of worker threads (0 for a synchronous pool)
+*/
+int mi_thread_pool_get_thread_count(mi_thread_pool_t* tp);
+
+/**
+Destroy a thread pool, after having run every pending job.
+@param tp thread pool to destroy
+*/
+void mi_thread_pool_destroy(mi_thread_pool_t* tp);
+
+/* ----------------------------------------------------------------------- */
+/*@}*/
+
+/*@}*/
+
+#endif /* __THREAD_H */
@@ -1918,6 +1918,76 @@ int imagetopnm(mi_image_t * image, const char *outfile, int force_split)
     return 0;
 }/* imagetopnm() */
 
+/* Writes the samples decoded by mi_decode_to_buffer into a PGM (ncomp 1) or
+   PPM (ncomp 3) file, as imagetopnm does for the same image. The ncomp
+   channels of a pixel are interleaved, on 16 bits in the byte order of the
+   host when prec > 8. */
+int buffertopnm(const unsigned char *data, int w, int h, int ncomp, int prec, const char *outfile)
+{
+    FILE *fdest = NULL;
+    unsigned char *row;
+    size_t row_size, i;
+    int y, max;
+
+    if((ncomp != 1 && ncomp != 3) || prec > 16)
+    {
+        fprintf(stderr,"%s:%d:buffertopnm\n\t%d components of precision %d"
+                "\n\t: refused.\n",__FILE__,__LINE__,ncomp,prec);
+        return 1;
+    }
+    row_size = (size_t)w * (size_t)ncomp * (prec > 8 ? 2U : 1U);
+    max = (1<<prec) - 1;
+
+    row = (unsigned char*)malloc(row_size + 1);
+    if(row == NULL)
+    {
+        fprintf(stderr, "buffertopnm: memory out\n");
+        return 1;
+    }
+    fdest = fopen(outfile, "wb");
+    if (!fdest)
+    {
+        fprintf(stderr, "ERROR -> failed to open %s for writing\n", outfile);
+        free(row);
+        return 1;
+    }
+
+    if(ncomp == 3)
+        fprintf(fdest, "P6\n# OpenJPEG-%s\n%d %d\n%d\n",
+                mi_version(), w, h, max);
+    else
+        fprintf(fdest, "P5\n#OpenJPEG-%s\n%d %d\n%d\n",
+                mi_version(), w, h, max);
+
+    for(y = 0; y < h; ++y)
+    {
+        const unsigned char *src = data + (size_t)y * row_size;
+
+        if(prec > 8)
+        {
+            /* netpbm: */
+            for(i = 0; i < row_size; i += 2)
+            {
+                unsigned short v;
+
+                memcpy(&v, src + i, 2);
+                row[i] = (unsigned char)(v >> 8);
+                row[i + 1] = (unsigned char)v;
+            }
+            src = row;
+        }
+        if(fwrite(src, 1, row_size, fdest) != row_size)
+        {
+            fprintf(stderr, "ERROR -> failed to write %s\n", outfile);
+            fclose(fdest); free(row);
+            return 1;
+        }
+    }
+    fclose(fdest); free(row);
+
+    return 0;
+}/* buffertopnm() */
+
 /* -->> -->> -->> -->>
 
     RAW IMAGE FORMAT
@@ -69,6 +69,7 @@ int imagetopgx(mi_image_t *image, const char *outfile);
 
 mi_image_t* pnmtoimage(const char *filename, mi_cparameters_t *parameters);
 int imagetopnm(mi_image_t *image, const char *outfile, int force_split);
+int buffertopnm(const unsigned char *data, int w, int h, int ncomp, int prec, const char *outfile);
 
 /* RAW conversion */
 int imagetoraw(mi_image_t * image, const char *outfile);
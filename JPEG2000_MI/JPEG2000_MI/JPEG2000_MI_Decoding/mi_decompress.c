@@ -112,6 +112,8 @@ typedef struct mi_decompress_params
 	int upsample;
 	/* split output components to different files */
 	int split_pnm;
+	/** number of threads */
+	int num_threads;
 }mi_decompress_parameters;
 
 /* -------------------------------------------------------------------------- */
@@ -126,6 +128,8 @@ int parse_cmdline_decoder(int argc, char **argv, mi_decompress_parameters *param
 int parse_DA_values( char* inArg, unsigned int *DA_x0, unsigned int *DA_y0, unsigned int *DA_x1, unsigned int *DA_y1);
 
 static mi_image_t* convert_gray_to_rgb(mi_image_t* original);
+static int can_decode_to_pnm_buffer(const mi_decompress_parameters* parameters, const mi_image_t* image);
+static mi_BYTE* decode_to_pnm_buffer(mi_codec_t* l_codec, mi_stream_t* l_stream, mi_image_t* image);
 
 /* -------------------------------------------------------------------------- */
 
@@ -410,7 +414,8 @@ int parse_cmdline_decoder(int argc, char **argv, mi_decompress_parameters *param
 		{"OutFor",    REQ_ARG, NULL,'O'},
 		{"force-rgb", NO_ARG,  NULL, 1},
 		{"upsample",  NO_ARG,  NULL, 1},
-		{"split-pnm", NO_ARG,  NULL, 1}
+		{"split-pnm", NO_ARG,  NULL, 1},
+		{"threads",   REQ_ARG, NULL,'H'}
 	};
 
 	const char optlist[] = "i:o:r:l:x:d:t:p:"
@@ -627,6 +632,14 @@ int parse_cmdline_decoder(int argc, char **argv, mi_decompress_parameters *param
 				}
 				break;
 				/* ----------------------------------------------------- */
+			case 'H': /* number of threads */
+				{
+					if (sscanf(mi_optarg, "%d", &parameters->num_threads) != 1 || parameters->num_threads < 0) {
+						fprintf(stderr, "[ERROR] Invalid number of threads: %s\n", mi_optarg);
+						return 1;
+					}
+				}
+				break;
 				/* ----------------------------------------------------- */
 			
         default:
@@ -767,6 +780,72 @@ static void destroy_parameters(mi_decompress_parameters* parameters)
 
 /* -------------------------------------------------------------------------- */
 
+/* The samples of a PGM or PPM file are decoded in place when none of the
+   conversions of the image components applies to the image */
+static int can_decode_to_pnm_buffer(const mi_decompress_parameters* parameters, const mi_image_t* image)
+{
+	const char *ext;
+	mi_UINT32 compno;
+
+	/* the color boxes of a JP2 file may change the components */
+	if (parameters->cod_format != PXM_DFMT || parameters->decod_format != J2K_CFMT
+		|| parameters->split_pnm || parameters->precision != NULL
+		|| parameters->upsample || parameters->force_rgb || image->icc_profile_buf) {
+		return 0;
+	}
+	if (image->numcomps != 1 && image->numcomps != 3) {
+		return 0;
+	}
+	/* a .pgm file gets the first component only */
+	ext = parameters->outfile + strlen(parameters->outfile) - 2;
+	if (image->numcomps == 3 && (*ext == 'g' || *ext == 'G')) {
+		return 0;
+	}
+	if (image->color_space == mi_CLRSPC_SYCC || image->color_space == mi_CLRSPC_EYCC
+		|| image->color_space == mi_CLRSPC_CMYK) {
+		return 0;
+	}
+	for (compno = 0; compno < image->numcomps; compno++) {
+		const mi_image_comp_t* comp = &(image->comps[compno]);
+
+		if (comp->dx != 1 || comp->dy != 1 || comp->sgnd || comp->prec > 16
+			|| comp->prec != image->comps[0].prec
+			|| comp->w != image->comps[0].w || comp->h != image->comps[0].h) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* Decodes the image into the interleaved samples written by buffertopnm */
+static mi_BYTE* decode_to_pnm_buffer(mi_codec_t* l_codec, mi_stream_t* l_stream, mi_image_t* image)
+{
+	static const mi_UINT32 l_comp_map[3] = { 0, 1, 2 };
+	mi_decode_buffer_t l_buffer;
+
+	l_buffer.sample_size = image->comps[0].prec > 8 ? 2U : 1U;
+	l_buffer.nb_channels = image->numcomps;
+	l_buffer.comp_map = l_comp_map;
+	l_buffer.channel_stride = l_buffer.sample_size;
+	l_buffer.pixel_stride = (mi_SIZE_T)l_buffer.sample_size * image->numcomps;
+	l_buffer.row_stride = l_buffer.pixel_stride * image->comps[0].w;
+	l_buffer.data = (mi_BYTE*)malloc(l_buffer.row_stride * image->comps[0].h + 1);
+	if (!l_buffer.data) {
+		fprintf(stderr, "ERROR -> mi_decompress: failed to allocate memory for the decoded samples!\n");
+		return NULL;
+	}
+	/* as in the image components, the samples of the tiles missing from the codestream are 0 */
+	memset(l_buffer.data, 0, l_buffer.row_stride * image->comps[0].h);
+
+	if (!(mi_decode_to_buffer(l_codec, l_stream, image, &l_buffer) && mi_end_decompress(l_codec, l_stream))) {
+		free(l_buffer.data);
+		return NULL;
+	}
+	return l_buffer.data;
+}
+
+/* -------------------------------------------------------------------------- */
+
 static mi_image_t* convert_gray_to_rgb(mi_image_t* original)
 {
 	mi_UINT32 compno;
@@ -1005,6 +1084,7 @@ int main(int argc, char **argv)
 	mi_stream_t *l_stream = NULL;				/* Stream */
 	mi_codec_t* l_codec = NULL;				/* Handle to a decompressor */
 	mi_codestream_index_t* cstr_index = NULL;
+	mi_BYTE* pnm_data = NULL;				/* samples decoded in the layout of the PNM file */
 
 	mi_INT32 num_images, imageno;
 	img_fol_t img_fol;
@@ -1075,7 +1155,11 @@ int main(int argc, char **argv)
 		/* read the input file and put it in memory */
 		/* ---------------------------------------- */
 
-		l_stream = mi_stream_create_default_file_stream(parameters.infile,1);
+		/* the file is mapped when possible, the tiles being then decoded from the mapping */
+		l_stream = mi_stream_create_mmap_stream(parameters.infile);
+		if (!l_stream){
+			l_stream = mi_stream_create_default_file_stream(parameters.infile,1);
+		}
 		if (!l_stream){
 			fprintf(stderr, "ERROR -> failed to create the stream from the file %s\n", parameters.infile);
 			failed = 1; goto fin;
@@ -1125,6 +1209,13 @@ int main(int argc, char **argv)
 			failed = 1; goto fin;
 		}
 
+		if (parameters.num_threads > 0 && !mi_codec_set_threads(l_codec, parameters.num_threads)) {
+			fprintf(stderr, "ERROR -> mi_decompress: failed to set the number of threads\n");
+			mi_stream_destroy(l_stream);
+			mi_destroy_codec(l_codec);
+			failed = 1; goto fin;
+		}
+
 
 		/* Read the main header of the codestream and if necessary the JP2 boxes*/
 		if(! mi_read_header(l_stream, l_codec, &image)){
@@ -1147,7 +1238,17 @@ int main(int argc, char **argv)
 			}
 
 			/* Get the decoded image */
-			if (!(mi_decode(l_codec, l_stream, image) && mi_end_decompress(l_codec,	l_stream))) {
+			if (can_decode_to_pnm_buffer(&parameters, image)) {
+				pnm_data = decode_to_pnm_buffer(l_codec, l_stream, image);
+				if (!pnm_data) {
+					fprintf(stderr,"ERROR -> mi_decompress: failed to decode image!\n");
+					mi_destroy_codec(l_codec);
+					mi_stream_destroy(l_stream);
+					mi_image_destroy(image);
+					failed = 1; goto fin;
+				}
+			}
+			else if (!(mi_decode(l_codec, l_stream, image) && mi_end_decompress(l_codec,	l_stream))) {
 				fprintf(stderr,"ERROR -> mi_decompress: failed to decode image!\n");
 				mi_destroy_codec(l_codec);
 				mi_stream_destroy(l_stream);
@@ -1182,6 +1283,20 @@ int main(int argc, char **argv)
 		/* Close the byte stream */
 		mi_stream_destroy(l_stream);
 
+		if (pnm_data) {
+			if (buffertopnm(pnm_data, (int)image->comps[0].w, (int)image->comps[0].h,
+					(int)image->numcomps, (int)image->comps[0].prec, parameters.outfile)) {
+                fprintf(stderr,"[ERROR] Outfile %s not generated\n",parameters.outfile);
+        failed = 1;
+			}
+			else {
+                fprintf(stdout,"[INFO] Generated Outfile %s\n",parameters.outfile);
+			}
+			free(pnm_data);
+			pnm_data = NULL;
+			goto release;
+		}
+
 		if( image->color_space != mi_CLRSPC_SYCC 
 			&& image->numcomps == 3 && image->comps[0].dx == image->comps[0].dy
 			&& image->comps[1].dx != 1 )
@@ -1347,6 +1462,7 @@ int main(int argc, char **argv)
         failed = 1;
 		}
 
+release:
 		/* free remaining structures */
 		if (l_codec) {
 			mi_destroy_codec(l_codec);
@@ -181,7 +181,8 @@ static int parse_cmdline_encoder(
     img_fol_t *img_fol, 
 	raw_cparameters_t *raw_cp, 
 	char *indexfilename,
-	size_t indexfilename_size) {
+	size_t indexfilename_size,
+	int* pnum_threads) {
 
     mi_UINT32 i, j;
     int totlen, c;
@@ -192,11 +193,13 @@ static int parse_cmdline_encoder(
         {"TP",REQ_ARG, NULL ,'u'},
         {"SOP",NO_ARG, NULL ,'S'},
         {"EPH",NO_ARG, NULL ,'E'},
+        {"PLT",NO_ARG, NULL ,'L'},
         {"OutFor",REQ_ARG, NULL ,'O'},
         {"POC",REQ_ARG, NULL ,'P'},
         {"ROI",REQ_ARG, NULL ,'R'},
         {"jpip",NO_ARG, NULL, 'J'},
-        {"mct",REQ_ARG, NULL, 'Y'}
+        {"mct",REQ_ARG, NULL, 'Y'},
+        {"threads",REQ_ARG, NULL, 'H'}
     };
 
     /* parse the command line */
@@ -634,6 +637,14 @@ static int parse_cmdline_encoder(
 
             /* ------------------------------------------------------ */
 
+        case 'L':			/* PLT markers */
+        {
+            parameters->plt_on = mi_TRUE;
+        }
+            break;
+
+            /* ------------------------------------------------------ */
+
         case 'M':			/* Mode switch pas tous au point !! */
         {
             int value = 0;
@@ -852,6 +863,16 @@ static int parse_cmdline_encoder(
             break;
             /* ------------------------------------------------------ */
 
+        case 'H':			/* number of threads */
+        {
+            if (sscanf(mi_optarg, "%d", pnum_threads) != 1 || *pnum_threads < 0) {
+                fprintf(stderr, "[ERROR] Invalid number of threads: %s\n", mi_optarg);
+                return 1;
+            }
+        }
+            break;
+            /* ------------------------------------------------------ */
+
 
         default:
             fprintf(stderr, "[WARNING] An invalid option has been ignored\n");
@@ -995,6 +1016,7 @@ int main(int argc, char **argv) {
     mi_BOOL bSuccess;
     mi_BOOL bUseTiles = mi_FALSE; /* mi_TRUE */
     mi_UINT32 l_nb_tiles = 4;
+    int num_threads = 0;
     mi_FLOAT64 t = mi_clock();
 
     /* set encoding parameters to default values */
@@ -1014,7 +1036,7 @@ int main(int argc, char **argv) {
 
     /* parse input and get user encoding parameters */
     parameters.tcp_mct = (char) 255; /* This will be set later according to the input image or the provided option */
-    if(parse_cmdline_encoder(argc, argv, &parameters,&img_fol, &raw_cp, indexfilename, sizeof(indexfilename)) == 1) {
+    if(parse_cmdline_encoder(argc, argv, &parameters,&img_fol, &raw_cp, indexfilename, sizeof(indexfilename), &num_threads) == 1) {
         goto fails;
     }
 
@@ -1193,6 +1215,13 @@ int main(int argc, char **argv) {
             return 1;
         }
 
+        if (num_threads > 0 && ! mi_codec_set_threads(l_codec, num_threads)) {
+            fprintf(stderr, "failed to set the number of threads\n");
+            mi_destroy_codec(l_codec);
+            mi_image_destroy(image);
+            return 1;
+        }
+
         /* open a byte stream for writing and allocate memory for all tiles */
         l_stream = mi_stream_create_default_file_stream(parameters.outfile,mi_FALSE);
         if (! l_stream){
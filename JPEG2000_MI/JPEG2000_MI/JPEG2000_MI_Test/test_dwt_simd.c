@@ -0,0 +1,244 @@
+/*
+ * Checks that the SIMD kernels of the inverse wavelet transforms give the
+ * same results, bit for bit, as the scalar code.
+ *
+ * The inverse 9-7 (mi_dwt_decode_real: mi_v4dwt_decode and the interleave
+ * functions) and the inverse 5-3 (mi_dwt_decode) are run on the same
+ * coefficients with the SIMD instruction sets of the machine restricted by
+ * mi_cpu_set_features: scalar code only, SSE2, then SSE2 and AVX2. Each run
+ * is done in the calling thread and on a thread pool.
+ *
+ * The program returns 0 if every result matches the scalar one.
+ */
+
+#include "mi_includes.h"
+
+/** Tile component geometry of a test case */
+typedef struct dwt_test_case {
+	mi_INT32 x0, y0, x1, y1;
+	mi_UINT32 numres;
+} dwt_test_case_t;
+
+/* -------------------------------------------------------------------------- */
+/* Declarations                                                               */
+static mi_INT32 ceildivpow2(mi_INT32 a, mi_UINT32 b);
+static mi_BOOL init_tilec(mi_tcd_tilecomp_t *tilec, const dwt_test_case_t *tc);
+static void fill_data(mi_tcd_tilecomp_t *tilec, mi_BOOL p_real, mi_UINT32 p_seed);
+static mi_BOOL run_dwt(mi_tcd_tilecomp_t *tilec, mi_BOOL p_real, mi_thread_pool_t *tp, mi_UINT32 p_features, mi_INT32 *p_result);
+static int test_case(const dwt_test_case_t *tc, mi_BOOL p_real, mi_thread_pool_t *tp, const mi_UINT32 *p_features, int p_nb_features);
+
+/* -------------------------------------------------------------------------- */
+
+static mi_INT32 ceildivpow2(mi_INT32 a, mi_UINT32 b)
+{
+	return (mi_INT32)((a + ((mi_INT64)1 << b) - 1) >> b);
+}
+
+/* -------------------------------------------------------------------------- */
+/**
+ * Sets up the resolution levels of a tile component as the tile coder does,
+ * the whole component being decoded.
+ */
+/* -------------------------------------------------------------------------- */
+static mi_BOOL init_tilec(mi_tcd_tilecomp_t *tilec, const dwt_test_case_t *tc)
+{
+	mi_UINT32 resno;
+
+	memset(tilec, 0, sizeof(mi_tcd_tilecomp_t));
+	tilec->x0 = tc->x0;
+	tilec->y0 = tc->y0;
+	tilec->x1 = tc->x1;
+	tilec->y1 = tc->y1;
+	tilec->numresolutions = tc->numres;
+	tilec->minimum_num_resolutions = tc->numres;
+	tilec->resolutions = (mi_tcd_resolution_t *) mi_calloc(tc->numres, sizeof(mi_tcd_resolution_t));
+	tilec->data_size = (mi_UINT32)((tc->x1 - tc->x0) * (tc->y1 - tc->y0)) * (mi_UINT32)sizeof(mi_INT32);
+	tilec->data = (mi_INT32 *) mi_aligned_malloc(tilec->data_size);
+	if (!tilec->resolutions || !tilec->data) {
+		return mi_FALSE;
+	}
+
+	for (resno = 0; resno < tc->numres; ++resno) {
+		mi_tcd_resolution_t *res = &tilec->resolutions[resno];
+		mi_UINT32 levelno = tc->numres - 1 - resno;
+
+		res->x0 = ceildivpow2(tc->x0, levelno);
+		res->y0 = ceildivpow2(tc->y0, levelno);
+		res->x1 = ceildivpow2(tc->x1, levelno);
+		res->y1 = ceildivpow2(tc->y1, levelno);
+		res->win_x1 = (mi_UINT32)(res->x1 - res->x0);
+		res->win_y1 = (mi_UINT32)(res->y1 - res->y0);
+
+		if (resno > 0) {
+			const mi_tcd_resolution_t *lr = &tilec->resolutions[resno - 1];
+
+			/* bands[0] is HL and bands[1] is LH: their high-pass widths and heights */
+			res->numbands = 3;
+			res->bands[0].win_x1 = (mi_UINT32)((res->x1 - res->x0) - (lr->x1 - lr->x0));
+			res->bands[0].win_y1 = (mi_UINT32)(lr->y1 - lr->y0);
+			res->bands[1].win_x1 = (mi_UINT32)(lr->x1 - lr->x0);
+			res->bands[1].win_y1 = (mi_UINT32)((res->y1 - res->y0) - (lr->y1 - lr->y0));
+		}
+		else {
+			res->numbands = 1;
+		}
+	}
+
+	return mi_TRUE;
+}
+
+/* -------------------------------------------------------------------------- */
+
+static void fill_data(mi_tcd_tilecomp_t *tilec, mi_BOOL p_real, mi_UINT32 p_seed)
+{
+	mi_UINT32 i, n = tilec->data_size / (mi_UINT32)sizeof(mi_INT32);
+	mi_UINT32 l_state = p_seed * 2654435761U + 1;
+
+	for (i = 0; i < n; ++i) {
+		mi_INT32 v;
+
+		l_state = l_state * 1664525U + 1013904223U;
+		v = (mi_INT32)(l_state >> 19) - 4096;
+		if (p_real) {
+			mi_FLOAT32 f = (mi_FLOAT32)v * 0.37f;
+			memcpy(&tilec->data[i], &f, sizeof(f));
+		}
+		else {
+			tilec->data[i] = v;
+		}
+	}
+}
+
+/* -------------------------------------------------------------------------- */
+
+static mi_BOOL run_dwt(mi_tcd_tilecomp_t *tilec, mi_BOOL p_real, mi_thread_pool_t *tp, mi_UINT32 p_features, mi_INT32 *p_result)
+{
+	mi_INT32 *l_data = tilec->data;
+	mi_UINT32 l_previous;
+	mi_BOOL l_ret;
+
+	memcpy(p_result, l_data, tilec->data_size);
+	tilec->data = p_result;
+
+	l_previous = mi_cpu_set_features(p_features);
+	if (p_real) {
+		l_ret = mi_dwt_decode_real(tp, tilec, tilec->numresolutions);
+	}
+	else {
+		l_ret = mi_dwt_decode(tp, tilec, tilec->numresolutions);
+	}
+	mi_cpu_set_features(l_previous);
+
+	tilec->data = l_data;
+	return l_ret;
+}
+
+/* -------------------------------------------------------------------------- */
+/**
+ * Runs a test case with every feature set and compares the results with the
+ * scalar one.
+ * @return the number of failures
+ */
+/* -------------------------------------------------------------------------- */
+static int test_case(const dwt_test_case_t *tc, mi_BOOL p_real, mi_thread_pool_t *tp, const mi_UINT32 *p_features, int p_nb_features)
+{
+	mi_tcd_tilecomp_t l_tilec;
+	mi_INT32 *l_reference = 00;
+	mi_INT32 *l_result = 00;
+	int i, l_nb_failures = 0;
+
+	if (!init_tilec(&l_tilec, tc)) {
+		fprintf(stderr, "[ERROR] Not enough memory\n");
+		l_nb_failures = 1;
+		goto cleanup;
+	}
+	fill_data(&l_tilec, p_real, (mi_UINT32)(tc->x1 * 31 + tc->y1));
+
+	l_reference = (mi_INT32 *) mi_aligned_malloc(l_tilec.data_size);
+	l_result = (mi_INT32 *) mi_aligned_malloc(l_tilec.data_size);
+	if (!l_reference || !l_result || !run_dwt(&l_tilec, p_real, 00, 0, l_reference)) {
+		fprintf(stderr, "[ERROR] Scalar transform failed\n");
+		l_nb_failures = 1;
+		goto cleanup;
+	}
+
+	for (i = 0; i < p_nb_features; ++i) {
+		if (!run_dwt(&l_tilec, p_real, tp, p_features[i], l_result) ||
+		    memcmp(l_reference, l_result, l_tilec.data_size) != 0) {
+			fprintf(stderr, "[ERROR] %s inverse DWT of [%d,%d)x[%d,%d), %u resolutions: features 0x%x %s differ from the scalar code\n",
+			        p_real ? "9-7" : "5-3", tc->x0, tc->x1, tc->y0, tc->y1, tc->numres, p_features[i],
+			        tp ? "on the thread pool" : "in the calling thread");
+			++l_nb_failures;
+		}
+	}
+
+cleanup:
+	mi_aligned_free(l_result);
+	mi_aligned_free(l_reference);
+	mi_aligned_free(l_tilec.data);
+	mi_free(l_tilec.resolutions);
+	return l_nb_failures;
+}
+
+/* -------------------------------------------------------------------------- */
+/**
+ * TEST_DWT_SIMD MAIN
+ */
+/* -------------------------------------------------------------------------- */
+int main(void)
+{
+	static const dwt_test_case_t l_cases[] = {
+		{ 0, 0, 64, 64, 6 },
+		{ 1, 3, 70, 45, 4 },
+		{ 5, 0, 133, 97, 5 },
+		{ 2, 9, 300, 17, 6 },
+		{ 0, 0, 33, 257, 3 },
+		{ 3, 3, 4, 200, 4 },
+		{ 7, 2, 8, 3, 3 },
+		{ 0, 0, 1, 1, 1 },
+		{ 11, 13, 1034, 517, 7 }
+	};
+	mi_UINT32 l_features[3];
+	int l_nb_features = 0;
+	int l_nb_failures = 0;
+	mi_UINT32 l_supported = mi_cpu_get_features();
+	mi_thread_pool_t *l_tp = mi_thread_pool_create(3);
+	size_t i;
+	int j;
+
+	if (!l_tp) {
+		fprintf(stderr, "[ERROR] Cannot create the thread pool\n");
+		return EXIT_FAILURE;
+	}
+
+	/* the scalar code is also compared with itself on the thread pool */
+	l_features[l_nb_features++] = 0;
+	if (l_supported & mi_CPU_SSE2) {
+		l_features[l_nb_features++] = mi_CPU_SSE2;
+	}
+	else {
+		fprintf(stdout, "[WARNING] SSE2 not supported: SSE2 kernels not tested\n");
+	}
+	if ((l_supported & (mi_CPU_SSE2 | mi_CPU_AVX2)) == (mi_CPU_SSE2 | mi_CPU_AVX2)) {
+		l_features[l_nb_features++] = mi_CPU_SSE2 | mi_CPU_AVX2;
+	}
+	else {
+		fprintf(stdout, "[WARNING] AVX2 not supported: AVX2 kernels not tested\n");
+	}
+
+	for (i = 0; i < sizeof(l_cases) / sizeof(*l_cases); ++i) {
+		for (j = 0; j < 2; ++j) {
+			l_nb_failures += test_case(&l_cases[i], (mi_BOOL)j, 00, l_features + 1, l_nb_features - 1);
+			l_nb_failures += test_case(&l_cases[i], (mi_BOOL)j, l_tp, l_features, l_nb_features);
+		}
+	}
+
+	mi_thread_pool_destroy(l_tp);
+
+	if (l_nb_failures) {
+		fprintf(stdout, "[ERROR] %d comparisons failed\n", l_nb_failures);
+		return EXIT_FAILURE;
+	}
+	fprintf(stdout, "[INFO] The SIMD inverse DWT matches the scalar code\n");
+	return EXIT_SUCCESS;
+}
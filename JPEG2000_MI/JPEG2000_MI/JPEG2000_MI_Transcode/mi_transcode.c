@@ -0,0 +1,319 @@
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <strings.h>
+#define _stricmp strcasecmp
+#define _strnicmp strncasecmp
+#endif /* _WIN32 */
+
+#include "openjpeg.h"
+#include "mi_getopt.h"
+
+#include "format_defs.h"
+#include "mi_string.h"
+
+typedef struct transcode_parameters{
+	/** input file name */
+	char infile[mi_PATH_LEN];
+	/** output file name */
+	char outfile[mi_PATH_LEN];
+	/** parameters of the library */
+	mi_transcode_parameters_t parameters;
+	/** Verbose mode */
+	mi_BOOL m_verbose;
+}transcode_parameters_t;
+
+/* -------------------------------------------------------------------------- */
+/* Declarations                                                               */
+static void transcode_help_display(void);
+static mi_PROG_ORDER give_progression(const char progression[4]);
+static int get_file_format(const char *filename);
+static int parse_cmdline_transcoder(int argc, char **argv, transcode_parameters_t *parameters);
+
+/* -------------------------------------------------------------------------- */
+static void transcode_help_display(void) {
+	fprintf(stdout,"\nmi_transcode rewrites a JPEG-2000 codestream without decoding it: the\n"
+	               "packets are copied in a new order, the highest quality layers or\n"
+	               "resolution levels being dropped if asked.\n\n");
+
+	fprintf(stdout,"Parameters:\n"
+	               "-----------\n"
+	               "\n"
+	               "  -i <compressed file>\n"
+	               "    REQUIRED. Input codestream, *.j2k, *.j2c or *.jpc.\n"
+	               "  -o <compressed file>\n"
+	               "    REQUIRED. Output codestream, *.j2k, *.j2c or *.jpc.\n"
+	               "  -p <LRCP|RLCP|RPCL|PCRL|CPRL>\n"
+	               "    OPTIONAL. Progression order of the output. The one of each tile is\n"
+	               "    kept by default. The POC markers are not written.\n"
+	               "  -l <number of quality layers>\n"
+	               "    OPTIONAL. Only the first layers are kept.\n"
+	               "  -r <reduce factor>\n"
+	               "    OPTIONAL. Number of highest resolution levels removed. The output is the\n"
+	               "    image decoded with -r, its tiles (when there are several of them in a\n"
+	               "    direction) having a size multiple of 2^(reduce factor).\n"
+	               "  -TLM\n"
+	               "    OPTIONAL. Write a TLM marker giving the length of each tile-part.\n"
+	               "  -PLT\n"
+	               "    OPTIONAL. Write PLT markers giving the length of each packet.\n"
+	               "  -v\n"
+	               "    OPTIONAL. Verbose mode.\n"
+	               "\n"
+	               "Each tile is written as one tile-part. Codestreams whose packet headers\n"
+	               "are in PPM or PPT markers cannot be transcoded.\n\n");
+}
+
+/* -------------------------------------------------------------------------- */
+static mi_PROG_ORDER give_progression(const char progression[4]) {
+	if(strncmp(progression, "LRCP", 4) == 0) {
+		return mi_LRCP;
+	}
+	if(strncmp(progression, "RLCP", 4) == 0) {
+		return mi_RLCP;
+	}
+	if(strncmp(progression, "RPCL", 4) == 0) {
+		return mi_RPCL;
+	}
+	if(strncmp(progression, "PCRL", 4) == 0) {
+		return mi_PCRL;
+	}
+	if(strncmp(progression, "CPRL", 4) == 0) {
+		return mi_CPRL;
+	}
+
+	return mi_PROG_UNKNOWN;
+}
+
+/* -------------------------------------------------------------------------- */
+static int get_file_format(const char *filename) {
+	unsigned int i;
+	static const char *extension[] = { "j2k", "jp2", "jpt", "j2c", "jpc" };
+	static const int format[] = { J2K_CFMT, JP2_CFMT, JPT_CFMT, J2K_CFMT, J2K_CFMT };
+	const char *ext = strrchr(filename, '.');
+	if (ext == NULL)
+		return -1;
+	ext++;
+	for(i = 0; i < sizeof(format)/sizeof(*format); i++) {
+		if(_strnicmp(ext, extension[i], 3) == 0) {
+			return format[i];
+		}
+	}
+
+	return -1;
+}
+
+/* -------------------------------------------------------------------------- */
+/**
+ * Parse the command line
+ */
+/* -------------------------------------------------------------------------- */
+static int parse_cmdline_transcoder(int argc, char **argv, transcode_parameters_t *parameters) {
+	int totlen, c;
+	mi_option_t long_option[]={
+		{"TLM",NO_ARG, NULL ,'T'},
+		{"PLT",NO_ARG, NULL ,'L'}
+	};
+	const char optlist[] = "i:o:p:l:r:hv";
+
+	totlen=sizeof(long_option);
+	do {
+		c = mi_getopt_long(argc, argv,optlist,long_option,totlen);
+		if (c == -1)
+			break;
+		switch (c) {
+			case 'i':			/* input file */
+			case 'o':			/* output file */
+			{
+				char *file = mi_optarg;
+				if (get_file_format(file) != J2K_CFMT) {
+					fprintf(stderr,
+					        "[ERROR] Unknown file format: %s \n"
+					        "        Only codestreams are transcoded: *.j2k, *.j2c or *.jpc\n",
+					        file);
+					return 1;
+				}
+				if (mi_strcpy_s(c == 'i' ? parameters->infile : parameters->outfile, mi_PATH_LEN, file) != 0) {
+					fprintf(stderr, "[ERROR] Path is too long\n");
+					return 1;
+				}
+			}
+			break;
+
+				/* ----------------------------------------------------- */
+
+			case 'p':			/* progression order */
+			{
+				char progression[4];
+
+				strncpy(progression, mi_optarg, 4);
+				parameters->parameters.prog_order = give_progression(progression);
+				if (parameters->parameters.prog_order == mi_PROG_UNKNOWN) {
+					fprintf(stderr, "[ERROR] Unrecognized progression order "
+					        "[LRCP, RLCP, RPCL, PCRL, CPRL] !!\n");
+					return 1;
+				}
+			}
+			break;
+
+				/* ----------------------------------------------------- */
+
+			case 'l':			/* number of quality layers kept */
+			{
+				int layers = atoi(mi_optarg);
+				if (layers <= 0) {
+					fprintf(stderr, "[ERROR] The number of layers must be positive\n");
+					return 1;
+				}
+				parameters->parameters.max_layers = (mi_UINT32)layers;
+			}
+			break;
+
+				/* ----------------------------------------------------- */
+
+			case 'r':			/* number of resolution levels removed */
+			{
+				int reduce = atoi(mi_optarg);
+				if (reduce < 0) {
+					fprintf(stderr, "[ERROR] The reduce factor cannot be negative\n");
+					return 1;
+				}
+				parameters->parameters.reduce = (mi_UINT32)reduce;
+			}
+			break;
+
+				/* ----------------------------------------------------- */
+
+			case 'T':			/* TLM marker */
+				parameters->parameters.tlm = mi_TRUE;
+				break;
+
+			case 'L':			/* PLT markers */
+				parameters->parameters.plt = mi_TRUE;
+				break;
+
+				/* ----------------------------------------------------- */
+
+			case 'h': 			/* display an help description */
+				transcode_help_display();
+				return 1;
+
+			case 'v':     		/* Verbose mode */
+				parameters->m_verbose = mi_TRUE;
+				break;
+
+				/* ----------------------------------------------------- */
+			default:
+				fprintf(stderr, "[WARNING] An invalid option has been ignored.\n");
+				break;
+		}
+	}while(c != -1);
+
+	if(parameters->infile[0] == 0 || parameters->outfile[0] == 0) {
+		fprintf(stderr, "[ERROR] Required parameter is missing\n");
+		fprintf(stderr, "Example: %s -i image.j2k -o image_rpcl.j2k -p RPCL\n",argv[0]);
+		fprintf(stderr, "   Help: %s -h\n",argv[0]);
+		return 1;
+	}
+
+	return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+
+/**
+sample error debug callback expecting no client object
+*/
+static void error_callback(const char *msg, void *client_data) {
+	(void)client_data;
+	fprintf(stdout, "[ERROR] %s", msg);
+}
+/**
+sample warning debug callback expecting no client object
+*/
+static void warning_callback(const char *msg, void *client_data) {
+	(void)client_data;
+	fprintf(stdout, "[WARNING] %s", msg);
+}
+/**
+sample debug callback expecting no client object
+*/
+static void info_callback(const char *msg, void *client_data) {
+	(void)client_data;
+	fprintf(stdout, "[INFO] %s", msg);
+}
+
+/* -------------------------------------------------------------------------- */
+/**
+ * mi_TRANSCODE MAIN
+ */
+/* -------------------------------------------------------------------------- */
+int main(int argc, char *argv[])
+{
+	transcode_parameters_t parameters;		/* Transcoding parameters */
+	mi_codec_t* l_codec = NULL;				/* Handle to a decompressor */
+	mi_stream_t *l_stream = NULL;				/* Input stream */
+	mi_stream_t *l_out_stream = NULL;			/* Output stream */
+	int ret = EXIT_FAILURE;
+
+	memset(&parameters,0,sizeof(transcode_parameters_t));
+	mi_set_default_transcode_parameters(&parameters.parameters);
+
+	/* Parse input and get user transcoding parameters */
+	if(parse_cmdline_transcoder(argc, argv, &parameters) == 1) {
+		return EXIT_FAILURE;
+	}
+
+	if (strcmp(parameters.infile, parameters.outfile) == 0) {
+		fprintf(stderr, "ERROR -> the input and the output files must be different\n");
+		return EXIT_FAILURE;
+	}
+
+	l_stream = mi_stream_create_default_file_stream(parameters.infile,1);
+	if (!l_stream){
+		fprintf(stderr, "ERROR -> failed to create the stream from the file %s\n",parameters.infile);
+		return EXIT_FAILURE;
+	}
+
+	l_out_stream = mi_stream_create_default_file_stream(parameters.outfile,0);
+	if (!l_out_stream){
+		fprintf(stderr, "ERROR -> failed to create the stream from the file %s\n",parameters.outfile);
+		mi_stream_destroy(l_stream);
+		return EXIT_FAILURE;
+	}
+
+	/* Get a decoder handle, the packets are read by the decoder */
+	l_codec = mi_create_decompress(mi_CODEC_J2K);
+
+	/* catch events using our callbacks and give a local context */
+	if (parameters.m_verbose) {
+		mi_set_info_handler(l_codec, info_callback,00);
+	}
+	mi_set_warning_handler(l_codec, warning_callback,00);
+	mi_set_error_handler(l_codec, error_callback,00);
+
+	if (! mi_transcode(l_codec, l_stream, l_out_stream, &parameters.parameters)) {
+		fprintf(stderr, "ERROR -> mi_transcode: failed to transcode %s\n", parameters.infile);
+	}
+	else {
+		fprintf(stdout, "[INFO] Generated outfile %s\n", parameters.outfile);
+		ret = EXIT_SUCCESS;
+	}
+
+	/* close the byte streams */
+	mi_stream_destroy(l_out_stream);
+	mi_stream_destroy(l_stream);
+
+	/* free remaining structures */
+	mi_destroy_codec(l_codec);
+
+	if (ret != EXIT_SUCCESS) {
+		remove(parameters.outfile);
+	}
+
+	return ret;
+}